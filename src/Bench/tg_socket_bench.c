@@ -0,0 +1,195 @@
+/* tg_socket_bench.c */
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+
+/*
+ * Throughput benchmark for tg_socket.c.  A sender thread pushes
+ * messages through TG_send on one end of a socket pair and the main
+ * thread takes them off the other end with TG_recv (malloc'd copy per
+ * message) or TG_recv_view (in place).  Compile the same source with
+ * different USE_READ_THREAD/USE_WRITE_THREAD/USE_LOCKED_QUEUE settings
+ * to compare the socket library's modes (see Makefile in this directory).
+ *
+ * Usage: tg_socket_bench [message count] [message size] [copy|view]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "tg_socket.h"
+#include "tg_time.h"
+#include "tg_error.h"
+
+/* Tag the sender uses to say it is done (any tag outside the data range) */
+#define BENCH_DATA_TAG 1
+#define BENCH_DONE_TAG 2
+
+typedef struct {
+    int fd;
+    int count;
+    int size;
+} Bench_sender;
+
+static void * bench_send (void *arg)
+{
+    Bench_sender *sender = (Bench_sender *)arg;
+    char *buf;
+    int i;
+
+    if ((buf = (char *)malloc (sender->size + 1)) == NULL)
+	TG_error ("bench_send: Out of memory allocating %i bytes!",
+		  sender->size);
+    memset (buf, 'x', sender->size);
+
+    for (i = 0; i < sender->count; i++)
+	TG_send (sender->fd, BENCH_DATA_TAG, i, sender->size, buf);
+    TG_send (sender->fd, BENCH_DONE_TAG, sender->count, 0, NULL);
+    TG_flush (sender->fd);
+
+    free (buf);
+    return (NULL);
+}
+
+int main (int argc, char *argv[])
+{
+    Bench_sender sender;
+    pthread_t send_thread;
+    int sv[2];
+    int use_view = 0;
+    int tag, id, size, received;
+    char *buf;
+    double start, elapsed;
+    const char *mode;
+
+    sender.count = (argc > 1) ? atoi (argv[1]) : 1000000;
+    sender.size = (argc > 2) ? atoi (argv[2]) : 200;
+    if ((argc > 3) && (strcmp (argv[3], "view") == 0))
+	use_view = 1;
+
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+	TG_errno ("tg_socket_bench: socketpair failed!");
+
+    /* Socket must be nonblocking for TG_send and TG_recv */
+    fcntl (sv[0], F_SETFL, O_NONBLOCK);
+    fcntl (sv[1], F_SETFL, O_NONBLOCK);
+    sender.fd = sv[0];
+
+    start = TG_time ();
+    if (pthread_create (&send_thread, NULL, bench_send, &sender) != 0)
+	TG_error ("tg_socket_bench: pthread_create failed!");
+
+    received = 0;
+    for (;;)
+    {
+	int retval;
+	if (use_view)
+	    retval = TG_recv_view (sv[1], &tag, &id, &size, &buf);
+	else
+	    retval = TG_recv (sv[1], &tag, &id, &size, (void **)&buf);
+	if (retval < 0)
+	    TG_error ("tg_socket_bench: socket closed early!");
+
+	if (tag == BENCH_DONE_TAG)
+	    break;
+	if ((tag != BENCH_DATA_TAG) || (id != received) ||
+	    (size != sender.size))
+	{
+	    TG_error ("tg_socket_bench: message %i arrived as "
+		      "tag %i id %i size %i!", received, tag, id, size);
+	}
+	received++;
+
+	if (!use_view && (buf != NULL))
+	    free (buf);
+    }
+    elapsed = TG_time () - start;
+    pthread_join (send_thread, NULL);
+
+#if defined(USE_READ_THREAD) && defined(USE_LOCKED_QUEUE)
+    mode = "threaded (locked queues)";
+#elif defined(USE_READ_THREAD)
+    mode = "threaded (lock-free queues)";
+#else
+    mode = "unthreaded";
+#endif
+
+    printf ("%-28s %-4s %9i msgs of %6i bytes: %8.3f s "
+	    "%10.0f msgs/s %8.1f MB/s\n",
+	    mode, use_view ? "view" : "copy", received, sender.size,
+	    elapsed, received / elapsed,
+	    ((double)received * (sender.size + 12)) / (elapsed * 1048576.0));
+
+    return (0);
+}
+
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
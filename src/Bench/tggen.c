@@ -0,0 +1,984 @@
+/* tggen.c */
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+
+/*
+ * Synthetic workload generator for scale testing.  Writes inputs of any
+ * size in the three formats Tool Gear reads:
+ *
+ *   tgui      Tool Gear XML (message_folder, message, site_column,
+ *             site_data, site_priority), as read by TGxmlserver
+ *   mpip      an mpiP 2.5 report, as read by TGmpip2xml
+ *   valgrind  Valgrind memcheck XML (one file per task), as read by
+ *             TGmemcheck2xml
+ *
+ * The output depends only on the options (including the seed), never on
+ * the host, so a workload can be regenerated anywhere instead of being
+ * copied around.  -x scales the count-like defaults (messages, callsites,
+ * errors) relative to the demo inputs; the other options are absolute.
+ * See the workloads target in the Makefile in this directory.
+ *
+ * Usage: tggen tgui|mpip|valgrind [options]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "tg_error.h"
+
+/* Options (-1 means use the default for the format times the scale) */
+typedef struct {
+    unsigned long seed;		/* -s */
+    double scale;		/* -x */
+    int tasks;			/* -t */
+    int callsites;		/* -c (mpip), or distinct stacks (others) */
+    int messages;		/* -m (tgui messages, valgrind errors/task) */
+    int depth;			/* -d traceback depth */
+    double density;		/* -l fraction of source lines with data */
+    int files;			/* -f source files referenced */
+    int file_lines;		/* -n lines per source file */
+    int bulk_site_data;		/* -D lines: site_data in <lines> form */
+    const char *output;		/* -o */
+    const char *source_dir;	/* -S write the source files here too */
+} Gen_options;
+
+/* Deterministic generator (xorshift64*, seeded through splitmix64), so
+ * the same seed gives the same workload with any C library.
+ */
+static unsigned long long gen_state;
+
+static void gen_seed (unsigned long seed)
+{
+    unsigned long long z = (unsigned long long)seed + 0x9E3779B97F4A7C15ULL;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    gen_state = z ^ (z >> 31);
+    if (gen_state == 0)
+	gen_state = 1;
+}
+
+static unsigned long long gen_next (void)
+{
+    gen_state ^= gen_state >> 12;
+    gen_state ^= gen_state << 25;
+    gen_state ^= gen_state >> 27;
+    return (gen_state * 0x2545F4914F6CDD1DULL);
+}
+
+/* Uniform integer in [0, n) */
+static int gen_int (int n)
+{
+    return ((n <= 1) ? 0 : (int)((gen_next () >> 33) % (unsigned)n));
+}
+
+/* Uniform double in [0, 1) */
+static double gen_uniform (void)
+{
+    return ((gen_next () >> 11) * (1.0 / 9007199254740992.0));
+}
+
+/* Exponentially distributed, so a few values dominate as they do in real
+ * runs
+ */
+static double gen_skewed (double mean)
+{
+    return (-mean * log (1.0 - gen_uniform ()));
+}
+
+/* Names used for synthetic functions, files, and MPI calls */
+static const char *mpi_calls[] = {
+    "Allreduce", "Isend", "Irecv", "Waitany", "Waitall", "Send", "Recv",
+    "Bcast", "Reduce", "Allgather", "Barrier", "Wait", "Alltoall",
+    "Comm_rank", "Comm_size", "Gather"
+};
+#define NUM_MPI_CALLS ((int)(sizeof(mpi_calls) / sizeof(mpi_calls[0])))
+
+/* Calls that send data (and so appear in the sent bytes sections) */
+static int sends_data (int call)
+{
+    return (call <= 2 || (call >= 5 && call <= 9) || call == 12 ||
+	    call == 15);
+}
+
+static const char *error_kinds[] = {
+    "InvalidRead", "InvalidWrite", "UninitCondition", "UninitValue",
+    "InvalidFree", "MismatchedFree", "SyscallParam", "Overlap"
+};
+static const char *error_whats[] = {
+    "Invalid read of size %d", "Invalid write of size %d",
+    "Conditional jump or move depends on uninitialised value(s)",
+    "Use of uninitialised value of size %d",
+    "Invalid free() / delete / delete[]",
+    "Mismatched free() / delete / delete []",
+    "Syscall param write(buf) points to uninitialised byte(s)",
+    "Source and destination overlap in memcpy(%d)"
+};
+#define NUM_ERROR_KINDS ((int)(sizeof(error_kinds) / sizeof(error_kinds[0])))
+
+static const char *leak_kinds[] = {
+    "Leak_DefinitelyLost", "Leak_IndirectlyLost", "Leak_PossiblyLost",
+    "Leak_StillReachable"
+};
+#define NUM_LEAK_KINDS ((int)(sizeof(leak_kinds) / sizeof(leak_kinds[0])))
+
+/* One synthetic call stack frame */
+typedef struct {
+    int file;
+    int line;
+    int function;
+} Gen_frame;
+
+static void usage (const char *program)
+{
+    fprintf (stderr,
+	     "Usage: %s tgui|mpip|valgrind [options]\n"
+	     "  -s <seed>      random seed (default 1)\n"
+	     "  -x <scale>     multiply default counts (default 1, "
+	     "about demo size)\n"
+	     "  -t <tasks>     MPI tasks (mpip 8, valgrind 2, tgui 8)\n"
+	     "  -c <sites>     callsites or distinct stacks "
+	     "(default 114 * scale)\n"
+	     "  -m <count>     messages (tgui, default 300 * scale) or "
+	     "errors per task\n"
+	     "                 (valgrind, default 100 * scale)\n"
+	     "  -d <depth>     traceback depth (default 4; valgrind 8)\n"
+	     "  -l <fraction>  fraction of source lines with site_data "
+	     "(default 0.1)\n"
+	     "  -f <files>     source files referenced (default 20)\n"
+	     "  -n <lines>     lines per source file (default 500)\n"
+	     "  -D set|lines   site_data as one <set> per line (default) "
+	     "or in bulk\n"
+	     "                 <lines>/<values> form\n"
+	     "  -o <file>      output (default stdout; for valgrind, "
+	     "required if\n"
+	     "                 more than one task, and names "
+	     "<file>.<task>.mc)\n"
+	     "  -S <dir>       also write the source files into <dir>\n",
+	     program);
+    exit (1);
+}
+
+/* Applies the format's defaults to options not given */
+static void set_defaults (Gen_options *opt, int def_tasks, int def_sites,
+			  int def_messages, int def_depth)
+{
+    if (opt->tasks < 0)
+	opt->tasks = def_tasks;
+    if (opt->callsites < 0)
+	opt->callsites = (int)(def_sites * opt->scale + 0.5);
+    if (opt->messages < 0)
+	opt->messages = (int)(def_messages * opt->scale + 0.5);
+    if (opt->depth < 0)
+	opt->depth = def_depth;
+    if (opt->density < 0.0)
+	opt->density = 0.1;
+    if (opt->files < 0)
+	opt->files = 20;
+    if (opt->file_lines < 0)
+	opt->file_lines = 500;
+
+    if (opt->tasks < 1) opt->tasks = 1;
+    if (opt->callsites < 1) opt->callsites = 1;
+    if (opt->messages < 0) opt->messages = 0;
+    if (opt->depth < 1) opt->depth = 1;
+    if (opt->files < 1) opt->files = 1;
+    if (opt->file_lines < 10) opt->file_lines = 10;
+    if (opt->density > 1.0) opt->density = 1.0;
+}
+
+static FILE * open_output (const char *path)
+{
+    FILE *out;
+
+    if (path == NULL)
+	return (stdout);
+    if ((out = fopen (path, "w")) == NULL)
+	TG_errno ("tggen: can't write %s", path);
+    return (out);
+}
+
+static void close_output (FILE *out, const char *path)
+{
+    if (fflush (out) != 0 || ferror (out))
+	TG_errno ("tggen: error writing %s", path ? path : "stdout");
+    if (out != stdout)
+	fclose (out);
+}
+
+/* Makes up num_stacks call stacks of the given depth.  Frame 0 is the
+ * innermost.  Functions are numbered within each file and a file's
+ * functions sit in order down the file, so tracebacks look plausible.
+ */
+static Gen_frame * make_stacks (const Gen_options *opt, int num_stacks)
+{
+    Gen_frame *frames;
+    int i;
+
+    frames = (Gen_frame *)malloc (sizeof(Gen_frame) * num_stacks *
+				  opt->depth);
+    if (frames == NULL)
+	TG_error ("tggen: Out of memory allocating %i stacks!", num_stacks);
+    for (i = 0; i < num_stacks * opt->depth; i++)
+    {
+	frames[i].file = gen_int (opt->files);
+	frames[i].line = 1 + gen_int (opt->file_lines);
+	frames[i].function = frames[i].line / 25;
+    }
+    return (frames);
+}
+
+/* Writes each referenced source file into opt->source_dir, so the
+ * source pane (and TGxmlserver's file serving) has something to show.
+ */
+static void write_sources (const Gen_options *opt)
+{
+    char path[2048];
+    FILE *out;
+    int f, line;
+
+    if ((mkdir (opt->source_dir, 0777) != 0) && (errno != EEXIST))
+	TG_errno ("tggen: can't create %s", opt->source_dir);
+    if (strlen (opt->source_dir) > 2000)
+	TG_error ("tggen: source directory name too long");
+
+    for (f = 0; f < opt->files; f++)
+    {
+	sprintf (path, "%s/gen%03d.c", opt->source_dir, f);
+	out = open_output (path);
+	for (line = 1; line <= opt->file_lines; line++)
+	{
+	    if (line % 25 == 0)
+		fprintf (out, "void gen%03d_f%d (int *a, int n)\n", f,
+			 line / 25);
+	    else if (line % 25 == 1 && line > 1)
+		fprintf (out, "{\n");
+	    else if (line % 25 == 24)
+		fprintf (out, "}\n");
+	    else
+		fprintf (out, "    a[%d %% n] += a[(%d + 1) %% n] * %d;\n",
+			 line, line, line % 7 + 1);
+	}
+	close_output (out, path);
+    }
+}
+
+/* Writes the body of a site_data in the bulk form: the (increasing)
+ * lines as runs ("first-last"), then their values, ten to a line
+ */
+static void write_bulk_site_data (FILE *out, const int *lines,
+				  const double *values, int count)
+{
+    int i, first;
+
+    fprintf (out, "  <lines>");
+    for (i = 0; i < count; i = first)
+    {
+	first = i + 1;
+	while ((first < count) && (lines[first] == lines[first - 1] + 1))
+	    first++;
+	if (first - i > 1)
+	    fprintf (out, "%s%d-%d", (i > 0) ? " " : "", lines[i],
+		     lines[first - 1]);
+	else
+	    fprintf (out, "%s%d", (i > 0) ? " " : "", lines[i]);
+    }
+    fprintf (out, "</lines>\n  <values>");
+    for (i = 0; i < count; i++)
+    {
+	fprintf (out, "%s%.4g", (i == 0) ? "" : ((i % 10 == 0) ? "\n    " :
+						  " "), values[i]);
+    }
+    fprintf (out, "</values>\n");
+}
+
+/* Tool Gear XML */
+static void gen_tgui (Gen_options *opt)
+{
+    static const char *columns[][3] = {
+	{"count", "Count", "Number of messages at this line"},
+	{"time", "Time (ms)", "Synthetic time attributed to this line"},
+	{"bytes", "Bytes", "Synthetic bytes attributed to this line"}
+    };
+    static const char *folders[][2] = {
+	{"errors", "  Errors"},
+	{"warnings", "  Warnings"},
+	{"leaks", "  Leaks"},
+	{"notes", "  Notes"},
+	{"timing", "  Timing"},
+	{"io", "  I/O"},
+	{"comm", "  Communication"},
+	{"misc", "  Miscellaneous"}
+    };
+    int num_columns = (int)(sizeof(columns) / sizeof(columns[0]));
+    int num_folders = (int)(sizeof(folders) / sizeof(folders[0]));
+    Gen_frame *stacks;
+    FILE *out;
+    int *lines;
+    double *values;
+    int i, j, f, c;
+
+    set_defaults (opt, 8, 114, 300, 4);
+    stacks = make_stacks (opt, opt->callsites);
+    out = open_output (opt->output);
+
+    fprintf (out, "<tool_gear><format>1</format><version>2.00</version>\n\n");
+    fprintf (out, "<tool_title>Synthetic workload (seed %lu, %d messages)"
+	     "</tool_title>\n\n", opt->seed, opt->messages);
+    fprintf (out, "<status>Reading in synthetic workload</status>\n\n");
+    fprintf (out, "<about>\n  <prepend>Synthetic Tool Gear workload "
+	     "written by tggen\n(seed %lu, scale %g, %d tasks, %d stacks, "
+	     "depth %d)</prepend>\n</about>\n\n", opt->seed, opt->scale,
+	     opt->tasks, opt->callsites, opt->depth);
+
+    /* Push the synthetic "library" file down in tracebacks */
+    fprintf (out, "<site_priority>\n  <file>gen000\\.c$</file>  "
+	     "<modifier>-1.0</modifier>\n</site_priority>\n\n");
+
+    for (c = 0; c < num_columns; c++)
+    {
+	fprintf (out, "<site_column>\n  <tag>%s</tag>\n  <title>%s</title>\n"
+		 "  <position>%d</position>\n  <tooltip>%s</tooltip>\n"
+		 "  <align>right</align>\n</site_column>\n\n",
+		 columns[c][0], columns[c][1], c, columns[c][2]);
+    }
+
+    fprintf (out, "<message_folder>\n  <tag>all_in_order</tag>\n"
+	     "  <title>All messages (in output order)</title>\n"
+	     "  <if_empty>show</if_empty>\n</message_folder>\n\n");
+    for (f = 0; f < num_folders; f++)
+    {
+	fprintf (out, "<message_folder>\n  <tag>%s</tag>\n"
+		 "  <title>%s</title>\n  <if_empty>hide</if_empty>\n"
+		 "</message_folder>\n\n", folders[f][0], folders[f][1]);
+    }
+
+    for (i = 0; i < opt->messages; i++)
+    {
+	int stack = gen_int (opt->callsites);
+	Gen_frame *frame = &stacks[stack * opt->depth];
+	int folder = gen_int (num_folders);
+	int task = gen_int (opt->tasks);
+	int body_lines = 1 + gen_int (4);
+
+	fprintf (out, "<message>\n  <folder>all_in_order</folder>\n"
+		 "  <folder>%s</folder>\n", folders[folder][0]);
+	fprintf (out, "  <heading>Task %d: synthetic %s %d at "
+		 "gen%03d_f%d() (gen%03d.c:%d)</heading>\n", task,
+		 folders[folder][0], i, frame->file, frame->function,
+		 frame->file, frame->line);
+	fprintf (out, "  <body>");
+	for (j = 0; j < body_lines; j++)
+	{
+	    fprintf (out, "%s  value %d of %d is &lt;%d&gt; after %d calls",
+		     (j > 0) ? "\n" : "", j + 1, body_lines, gen_int (100000),
+		     gen_int (1000));
+	}
+	fprintf (out, "</body>\n");
+	fprintf (out, "  <annot>\n    <title>Traceback (stack %d)</title>\n",
+		 stack);
+	for (j = 0; j < opt->depth; j++)
+	{
+	    fprintf (out, "    <site><file>gen%03d.c</file><line>%d</line>"
+		     "<desc>gen%03d_f%d()</desc></site>\n", frame[j].file,
+		     frame[j].line, frame[j].file, frame[j].function);
+	}
+	fprintf (out, "  </annot>\n</message>\n\n");
+    }
+
+    /* Line data for a fraction of each file's lines, one site_data per
+     * file and column.  Both forms hold the same data for the same seed.
+     */
+    lines = (int *)malloc (sizeof(int) * opt->file_lines);
+    values = (double *)malloc (sizeof(double) * opt->file_lines);
+    if ((lines == NULL) || (values == NULL))
+	TG_error ("tggen: Out of memory allocating %i lines!",
+		  opt->file_lines);
+    for (f = 0; f < opt->files; f++)
+    {
+	for (c = 0; c < num_columns; c++)
+	{
+	    int line, count = 0;
+
+	    for (line = 1; line <= opt->file_lines; line++)
+	    {
+		if (gen_uniform () >= opt->density)
+		    continue;
+		lines[count] = line;
+		if (c == 0)
+		    values[count] = 1 + gen_int (500);
+		else
+		    values[count] = gen_skewed (c == 1 ? 10.0 : 4096.0);
+		count++;
+	    }
+
+	    fprintf (out, "<site_data>\n  <col>%s</col>\n"
+		     "  <file>gen%03d.c</file>\n", columns[c][0], f);
+	    if (opt->bulk_site_data)
+		write_bulk_site_data (out, lines, values, count);
+	    else
+	    {
+		for (j = 0; j < count; j++)
+		{
+		    fprintf (out, "  <set><l>%d</l><v>%.4g</v></set>\n",
+			     lines[j], values[j]);
+		}
+	    }
+	    fprintf (out, "</site_data>\n\n");
+	}
+    }
+    free (lines);
+    free (values);
+
+    fprintf (out, "</tool_gear>\n");
+    close_output (out, opt->output);
+    free (stacks);
+}
+
+/* mpiP 2.5 report */
+static void gen_mpip (Gen_options *opt)
+{
+    Gen_frame *stacks;
+    int *call;
+    double *site_time, *site_bytes, *task_mpi;
+    double *mean, *size;
+    int *site_count;
+    int *order;
+    FILE *out;
+    int i, j, t, n;
+    double app_time = 997.0, total_mpi = 0.0;
+
+    set_defaults (opt, 8, 114, 0, 4);
+    n = opt->callsites;
+    stacks = make_stacks (opt, n);
+    call = (int *)malloc (sizeof(int) * n);
+    site_count = (int *)malloc (sizeof(int) * n);
+    site_time = (double *)malloc (sizeof(double) * n);
+    site_bytes = (double *)malloc (sizeof(double) * n);
+    order = (int *)malloc (sizeof(int) * n);
+    task_mpi = (double *)calloc (opt->tasks, sizeof(double));
+    mean = (double *)malloc (sizeof(double) * n * opt->tasks);
+    size = (double *)malloc (sizeof(double) * n * opt->tasks);
+    if (!call || !site_count || !site_time || !site_bytes || !order ||
+	!task_mpi || !mean || !size)
+	TG_error ("tggen: Out of memory for %i callsites!", n);
+
+    for (i = 0; i < n; i++)
+    {
+	call[i] = gen_int (NUM_MPI_CALLS);
+	site_count[i] = 1 + (int)gen_skewed (500.0);
+	site_time[i] = 0.0;
+	site_bytes[i] = 0.0;
+    }
+
+    out = open_output (opt->output);
+    fprintf (out, "@ mpiP\n");
+    fprintf (out, "@ Command : ./synthetic -seed %lu \n", opt->seed);
+    fprintf (out, "@ Version                  : 2.5\n");
+    fprintf (out, "@ MPIP Build date          : Aug 29 2003, 09:10:00\n");
+    fprintf (out, "@ Start time               : 2004 01 20 16:26:44\n");
+    fprintf (out, "@ Stop time                : 2004 01 20 16:43:21\n");
+    fprintf (out, "@ MPIP env var             : -k %d -n\n", opt->depth);
+    fprintf (out, "@ Collector Rank           : 0\n");
+    fprintf (out, "@ Collector PID            : 33248\n");
+    fprintf (out, "@ Final Output Dir         : .\n");
+    for (t = 0; t < opt->tasks; t++)
+    {
+	fprintf (out, "@ MPI Task Assignment      : %d gen%d.llnl.gov\n", t,
+		 t / 16);
+    }
+
+    /* Draw every task's statistics up front, since the summary sections
+     * come first but are totals over them
+     */
+    for (i = 0; i < n; i++)
+    {
+	for (t = 0; t < opt->tasks; t++)
+	{
+	    double *m = &mean[i * opt->tasks + t];
+	    double *sz = &size[i * opt->tasks + t];
+
+	    *m = gen_skewed (0.2);
+	    *sz = sends_data (call[i]) ? (double)(8 << gen_int (12)) : 0.0;
+	    site_time[i] += site_count[i] * *m;
+	    site_bytes[i] += site_count[i] * *sz;
+	    task_mpi[t] += site_count[i] * *m / 1000.0;
+	}
+	total_mpi += site_time[i] / 1000.0;
+    }
+    fprintf (out, "\n---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "@--- MPI Time (seconds) ---------------------------"
+	     "------------------------\n");
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "Task    AppTime    MPITime     MPI%%\n");
+    for (t = 0; t < opt->tasks; t++)
+    {
+	fprintf (out, "%4d %10.3g %10.3g %8.2f\n", t, app_time, task_mpi[t],
+		 100.0 * task_mpi[t] / app_time);
+    }
+    fprintf (out, "   * %10.3g %10.3g %8.2f\n", app_time * opt->tasks,
+	     total_mpi, 100.0 * total_mpi / (app_time * opt->tasks));
+
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "@--- Callsites: %d ---------------------------------"
+	     "----------------------\n", n);
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, " ID Lev File/Address                              "
+	     "                        Line Parent_Funct                 "
+	     "MPI_Call                 \n");
+    for (i = 0; i < n; i++)
+    {
+	for (j = 0; j < opt->depth; j++)
+	{
+	    Gen_frame *frame = &stacks[i * opt->depth + j];
+	    char function[64];
+
+	    sprintf (function, ".gen%03d_f%d", frame->file, frame->function);
+	    fprintf (out, "%3d %3d gen_src/gen%03d.c %36d %-28s %s\n",
+		     i + 1, j, frame->file, frame->line, function,
+		     (j == 0) ? mpi_calls[call[i]] : "");
+	}
+    }
+
+    /* Top twenty by time and by bytes sent */
+    for (i = 0; i < n; i++)
+	order[i] = i;
+    for (i = 0; i < n && i < 20; i++)
+    {
+	for (j = i + 1; j < n; j++)
+	{
+	    if (site_time[order[j]] > site_time[order[i]])
+	    {
+		int tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	    }
+	}
+    }
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "@--- Aggregate Time (top twenty, descending, "
+	     "milliseconds) ----------------\n");
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "Call                 Site       Time    App%%    MPI%%\n");
+    for (i = 0; i < n && i < 20; i++)
+    {
+	int s = order[i];
+	fprintf (out, "%-18s %6d %10.3g %7.2f %7.2f\n", mpi_calls[call[s]],
+		 s + 1, site_time[s],
+		 100.0 * site_time[s] / 1000.0 / (app_time * opt->tasks),
+		 100.0 * site_time[s] / 1000.0 / total_mpi);
+    }
+
+    for (i = 0; i < n; i++)
+	order[i] = i;
+    for (i = 0; i < n && i < 20; i++)
+    {
+	for (j = i + 1; j < n; j++)
+	{
+	    if (site_bytes[order[j]] > site_bytes[order[i]])
+	    {
+		int tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	    }
+	}
+    }
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "@--- Aggregate Sent Message Size (top twenty, "
+	     "descending, bytes) ----------\n");
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "Call                 Site      Count      Total       "
+	     "Avrg   MPI%%\n");
+    {
+	double all_bytes = 0.0;
+	for (i = 0; i < n; i++)
+	    all_bytes += site_bytes[i];
+	for (i = 0; i < n && i < 20; i++)
+	{
+	    int s = order[i];
+	    double count = (double)site_count[s] * opt->tasks;
+	    if (site_bytes[s] <= 0.0)
+		break;
+	    fprintf (out, "%-18s %6d %10.0f %10.3g %10.3g %6.2f\n",
+		     mpi_calls[call[s]], s + 1, count, site_bytes[s],
+		     site_bytes[s] / count, 100.0 * site_bytes[s] / all_bytes);
+	}
+    }
+
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "@--- Callsite statistics (all, milliseconds): %d "
+	     "-------------------------\n", n * (opt->tasks + 1));
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "Name              Site Rank  Count      Max     Mean"
+	     "      Min   App%%   MPI%%\n");
+    for (i = 0; i < n; i++)
+    {
+	double all_max = 0.0, all_min = 1e30, all_sum = 0.0;
+	int all_count = 0;
+
+	for (t = 0; t < opt->tasks; t++)
+	{
+	    double m = mean[i * opt->tasks + t];
+	    double max = m * (2.0 + 8.0 * gen_uniform ());
+	    double min = m * gen_uniform ();
+	    double sum = m * site_count[i];
+
+	    fprintf (out, "%-18s %4d %4d %6d %8.3g %8.3g %8.3g %6.2f %6.2f\n",
+		     mpi_calls[call[i]], i + 1, t, site_count[i], max, m,
+		     min, 100.0 * sum / 1000.0 / app_time,
+		     100.0 * sum / 1000.0 / task_mpi[t]);
+	    if (max > all_max) all_max = max;
+	    if (min < all_min) all_min = min;
+	    all_sum += sum;
+	    all_count += site_count[i];
+	}
+	fprintf (out, "%-18s %4d    * %6d %8.3g %8.3g %8.3g %6.2f %6.2f\n\n",
+		 mpi_calls[call[i]], i + 1, all_count, all_max,
+		 all_sum / all_count, all_min,
+		 100.0 * all_sum / 1000.0 / (app_time * opt->tasks),
+		 100.0 * all_sum / 1000.0 / total_mpi);
+    }
+
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "@--- Callsite statistics (all, sent bytes) ----------"
+	     "----------------------\n");
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "Name              Site Rank   Count       Max      "
+	     "Mean       Min       Sum\n");
+    for (i = 0; i < n; i++)
+    {
+	double all_max = 0.0, all_min = 1e30, all_sum = 0.0;
+	int all_count = 0;
+
+	if (!sends_data (call[i]))
+	    continue;
+	for (t = 0; t < opt->tasks; t++)
+	{
+	    double sz = size[i * opt->tasks + t];
+	    double sum = sz * site_count[i];
+
+	    fprintf (out, "%-18s %4d %4d %7d %9.4g %9.4g %9.4g %9.4g\n",
+		     mpi_calls[call[i]], i + 1, t, site_count[i], sz, sz, sz,
+		     sum);
+	    if (sz > all_max) all_max = sz;
+	    if (sz < all_min) all_min = sz;
+	    all_sum += sum;
+	    all_count += site_count[i];
+	}
+	fprintf (out, "%-18s %4d    * %7d %9.4g %9.4g %9.4g %9.4g\n\n",
+		 mpi_calls[call[i]], i + 1, all_count, all_max,
+		 all_sum / all_count, all_min, all_sum);
+    }
+
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    fprintf (out, "@--- End of Report ----------------------------------"
+	     "----------------------\n");
+    fprintf (out, "---------------------------------------------------"
+	     "------------------------\n");
+    close_output (out, opt->output);
+
+    free (stacks);
+    free (call);
+    free (site_count);
+    free (site_time);
+    free (site_bytes);
+    free (order);
+    free (task_mpi);
+    free (mean);
+    free (size);
+}
+
+/* Writes one Valgrind stack */
+static void gen_valgrind_stack (FILE *out, const Gen_options *opt,
+				const Gen_frame *frame, int alloc)
+{
+    int j;
+
+    fprintf (out, "  <stack>\n");
+    if (alloc)
+    {
+	fprintf (out, "    <frame>\n      <ip>0x4A1895E</ip>\n"
+		 "      <obj>/usr/lib/valgrind/vgpreload_memcheck.so</obj>\n"
+		 "      <fn>malloc</fn>\n    </frame>\n");
+    }
+    for (j = 0; j < opt->depth; j++)
+    {
+	fprintf (out, "    <frame>\n      <ip>0x%X</ip>\n"
+		 "      <obj>./synthetic</obj>\n"
+		 "      <fn>gen%03d_f%d</fn>\n      <dir>.</dir>\n"
+		 "      <file>gen%03d.c</file>\n      <line>%d</line>\n"
+		 "    </frame>\n",
+		 0x8048000 + frame[j].file * 0x1000 + frame[j].line * 4,
+		 frame[j].file, frame[j].function, frame[j].file,
+		 frame[j].line);
+    }
+    fprintf (out, "  </stack>\n");
+}
+
+/* Valgrind memcheck XML, one file per task */
+static void gen_valgrind (Gen_options *opt)
+{
+    Gen_frame *stacks;
+    int *counts;
+    char path[2048];
+    int t, i, k;
+
+    set_defaults (opt, 2, 114, 100, 8);
+    if ((opt->tasks > 1) && (opt->output == NULL))
+	TG_error ("tggen: valgrind output for %i tasks needs -o <prefix>",
+		  opt->tasks);
+    if ((opt->output != NULL) && (strlen (opt->output) > 2000))
+	TG_error ("tggen: output name too long");
+
+    /* Tasks share stacks, as SPMD codes do */
+    stacks = make_stacks (opt, opt->callsites);
+    counts = (int *)malloc (sizeof(int) * (opt->messages + NUM_LEAK_KINDS));
+    if (counts == NULL)
+	TG_error ("tggen: Out of memory for %i errors!", opt->messages);
+
+    for (t = 0; t < opt->tasks; t++)
+    {
+	const char *name = opt->output;
+	int unique = 0x10;
+	FILE *out;
+
+	if (opt->output != NULL)
+	{
+	    sprintf (path, "%s.%d.mc", opt->output, t);
+	    name = path;
+	}
+	out = open_output (name);
+
+	fprintf (out, "<?xml version=\"1.0\"?>\n\n<valgrindoutput>\n\n"
+		 "<protocolversion>2</protocolversion>\n\n<preamble>\n"
+		 "  <line>Memcheck, a memory error detector.</line>\n"
+		 "  <line>Synthetic output written by tggen (seed %lu)."
+		 "</line>\n</preamble>\n\n", opt->seed);
+	fprintf (out, "<pid>%d</pid>\n<ppid>%d</ppid>\n<tool>memcheck</tool>\n"
+		 "<usercomment><hostname>gen%d</hostname><date>Thu May 18 "
+		 "13:12:41 PDT 2006</date><rank>%d</rank></usercomment>\n\n",
+		 1000 + t, 999, t / 16, t);
+	fprintf (out, "<args>\n  <vargv>\n    <exe>/usr/bin/valgrind</exe>\n"
+		 "    <arg>--tool=memcheck</arg>\n    <arg>--xml=yes</arg>\n"
+		 "    <arg>--leak-check=full</arg>\n  </vargv>\n  <argv>\n"
+		 "    <exe>./synthetic</exe>\n  </argv>\n</args>\n\n");
+	fprintf (out, "<status>\n  <state>RUNNING</state>\n"
+		 "  <time>00:00:00:00.133</time>\n</status>\n\n");
+
+	for (i = 0; i < opt->messages; i++)
+	{
+	    int kind = gen_int (NUM_ERROR_KINDS);
+	    int stack = gen_int (opt->callsites);
+
+	    fprintf (out, "<error>\n  <unique>0x%x</unique>\n  <tid>1</tid>\n"
+		     "  <kind>%s</kind>\n  <what>", unique + i,
+		     error_kinds[kind]);
+	    fprintf (out, error_whats[kind], 1 << gen_int (4));
+	    fprintf (out, "</what>\n");
+	    gen_valgrind_stack (out, opt, &stacks[stack * opt->depth], 0);
+	    if (kind <= 1)
+	    {
+		fprintf (out, "  <auxwhat>Address 0x%X is %d bytes after a "
+			 "block of size %d alloc'd</auxwhat>\n",
+			 0x1BB3B000 + gen_int (0x10000), gen_int (16),
+			 8 * (1 + gen_int (64)));
+		gen_valgrind_stack (out, opt,
+			&stacks[gen_int (opt->callsites) * opt->depth], 1);
+	    }
+	    fprintf (out, "</error>\n\n");
+	    counts[i] = 1 + (int)gen_skewed (3.0);
+	}
+
+	fprintf (out, "<errorcounts>\n");
+	for (i = opt->messages - 1; i >= 0; i--)
+	{
+	    fprintf (out, "  <pair>\n    <count>%d</count>\n"
+		     "    <unique>0x%x</unique>\n  </pair>\n", counts[i],
+		     unique + i);
+	}
+	fprintf (out, "</errorcounts>\n\n");
+	fprintf (out, "<status>\n  <state>FINISHED</state>\n"
+		 "  <time>00:00:00:03.321</time>\n</status>\n\n");
+
+	/* A leak of each kind at the end, as --leak-check=full gives */
+	for (k = 0; k < NUM_LEAK_KINDS; k++)
+	{
+	    int blocks = 1 + gen_int (20);
+	    int bytes = blocks * 8 * (1 + gen_int (64));
+
+	    fprintf (out, "<error>\n  <unique>0x%x</unique>\n  <tid>1</tid>\n"
+		     "  <kind>%s</kind>\n  <what>%d bytes in %d blocks are "
+		     "lost in loss record %d of %d</what>\n"
+		     "  <leakedbytes>%d</leakedbytes>\n"
+		     "  <leakedblocks>%d</leakedblocks>\n",
+		     unique + opt->messages + k, leak_kinds[k], bytes, blocks,
+		     k + 1, NUM_LEAK_KINDS, bytes, blocks);
+	    gen_valgrind_stack (out, opt,
+		    &stacks[gen_int (opt->callsites) * opt->depth], 1);
+	    fprintf (out, "</error>\n\n");
+	}
+
+	fprintf (out, "</valgrindoutput>\n\n");
+	close_output (out, name);
+    }
+
+    free (stacks);
+    free (counts);
+}
+
+int main (int argc, char *argv[])
+{
+    Gen_options opt;
+    const char *format;
+    int i;
+
+    if (argc < 2)
+	usage (argv[0]);
+    format = argv[1];
+
+    opt.seed = 1;
+    opt.scale = 1.0;
+    opt.tasks = -1;
+    opt.callsites = -1;
+    opt.messages = -1;
+    opt.depth = -1;
+    opt.density = -1.0;
+    opt.files = -1;
+    opt.file_lines = -1;
+    opt.bulk_site_data = 0;
+    opt.output = NULL;
+    opt.source_dir = NULL;
+
+    for (i = 2; i < argc; i++)
+    {
+	const char *arg = argv[i];
+	const char *value;
+
+	if ((arg[0] != '-') || (arg[1] == 0) || (arg[2] != 0) ||
+	    (i + 1 >= argc))
+	    usage (argv[0]);
+	value = argv[++i];
+
+	switch (arg[1])
+	{
+	  case 's': opt.seed = strtoul (value, NULL, 0); break;
+	  case 'x': opt.scale = atof (value); break;
+	  case 't': opt.tasks = atoi (value); break;
+	  case 'c': opt.callsites = atoi (value); break;
+	  case 'm': opt.messages = atoi (value); break;
+	  case 'd': opt.depth = atoi (value); break;
+	  case 'l': opt.density = atof (value); break;
+	  case 'f': opt.files = atoi (value); break;
+	  case 'n': opt.file_lines = atoi (value); break;
+	  case 'D':
+	    if (strcmp (value, "lines") == 0)
+		opt.bulk_site_data = 1;
+	    else if (strcmp (value, "set") != 0)
+		usage (argv[0]);
+	    break;
+	  case 'o': opt.output = value; break;
+	  case 'S': opt.source_dir = value; break;
+	  default: usage (argv[0]);
+	}
+    }
+    if (opt.scale <= 0.0)
+	usage (argv[0]);
+
+    gen_seed (opt.seed);
+    if (strcmp (format, "tgui") == 0)
+	gen_tgui (&opt);
+    else if (strcmp (format, "mpip") == 0)
+	gen_mpip (&opt);
+    else if (strcmp (format, "valgrind") == 0)
+	gen_valgrind (&opt);
+    else
+	usage (argv[0]);
+
+    if (opt.source_dir != NULL)
+	write_sources (&opt);
+    return (0);
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -24,6 +24,8 @@ FileCollection:: FileCollection()
 	// deletion anyway)
 	pendingFileInfoTable( "pendingFileInfo", NoDealloc, 0 ),
 	nextPendingFileInfoKey( 0 ),
+	pendingLinesKey( -1 ),
+	pendingLinesFirst( 0 ),
 	// Create fileInfo table that frees FileInfo structs on deletion
 	fileInfoTable("fileInfo", DeleteData, 0),
 	progress( 0 )
@@ -69,10 +71,25 @@ QString FileCollection:: getSourceLine( const char * fileName, int lineNo )
 		(lineNo > fileInfo->maxLineNo))
 		return QString::null;
 			
-	// Lookup the source line in the table; should always find it!
+	// Lookup the source line in the table; should always find it,
+	// unless the file is windowed and the line's block isn't held
 	QString *line = fileInfo->lineTable.findEntry(lineNo);
-			
-	// Return QString.  Not checking line for NULL; it never should be!
+	if ((line == NULL) && fileInfo->windowed)
+	{
+		fetchSourceBlock (fileName, lineNo);
+
+		// clear() may have deleted fileInfo while we waited
+		fileInfo = fileInfoTable.findEntry(fileName);
+		if (fileInfo == NULL)
+			return QString::null;
+		line = fileInfo->lineTable.findEntry(lineNo);
+	}
+
+	// Still missing if a windowed file got shorter since the
+	// collector counted its lines
+	if (line == NULL)
+		return QString::null;
+
 	return (*line);		 
 }		   
 
@@ -144,6 +161,23 @@ QString FileCollection:: getSourcePath (const QString &fileName)
 	return (getSourcePath (fileNameAscii));
 }
 
+// Returns TRUE if fileName has been loaded and its lines are fetched
+// a block at a time.  Doesn't load the file.
+bool FileCollection:: isWindowed (const char *fileName)
+{
+	if ((fileName == NULL) || (*fileName == 0))
+		return (FALSE);
+
+	FileInfo *fileInfo = fileInfoTable.findEntry(fileName);
+	return ((fileInfo != NULL) && fileInfo->windowed);
+}
+
+// QString version, provided for user convenience
+bool FileCollection:: isWindowed (const QString &fileName)
+{
+	return (isWindowed (fileName.latin1()));
+}
+
 // Internal routine that creates FileInfo structure for file, loads source 
 // if possible, and puts structure into fileInfoTable.  
 // Returns pointer to FileInfo structure created.
@@ -276,6 +310,63 @@ FileCollection::createFileInfo (const char *fileName)
 	return fileInfo;
 }
 
+void FileCollection:: fetchSourceBlock( const char * fileName, int lineNo )
+{
+	// Only one request may be outstanding (see createFileInfo)
+	while( sourceState == readingFile ) {
+		qApp->processEvents();
+	}
+
+	// Waiting may have let another caller fetch the block, or
+	// clear() delete the file
+	FileInfo * fileInfo = fileInfoTable.findEntry( fileName );
+	if( fileInfo == NULL || fileInfo->lineTable.findEntry( lineNo ) ) {
+		return;
+	}
+
+	int block = (lineNo - 1) / FILE_WINDOW_BLOCK_LINES;
+	for( int i = 0; i < fileInfo->numHeld; ++i ) {
+		// Held, but the line is gone (the file got shorter)
+		if( fileInfo->heldBlocks[i] == block ) return;
+	}
+
+	// Make room by dropping the block fetched longest ago
+	if( fileInfo->numHeld == FILE_WINDOW_MAX_BLOCKS ) {
+		int dropFirst = fileInfo->heldBlocks[fileInfo->nextDrop]
+			* FILE_WINDOW_BLOCK_LINES + 1;
+		for( int i = dropFirst; i < dropFirst + FILE_WINDOW_BLOCK_LINES;
+				++i ) {
+			fileInfo->lineTable.deleteEntry( i );
+		}
+		fileInfo->heldBlocks[fileInfo->nextDrop] = block;
+		fileInfo->nextDrop = (fileInfo->nextDrop + 1)
+			% FILE_WINDOW_MAX_BLOCKS;
+	} else {
+		fileInfo->heldBlocks[fileInfo->numHeld++] = block;
+	}
+
+	// Ask for the block by the path the collector found the file at,
+	// so it doesn't search for it again
+	sourceState = readingFile;
+	pendingLinesKey = nextPendingFileInfoKey++;
+	pendingLinesFile = fileName;
+	pendingLinesFirst = block * FILE_WINDOW_BLOCK_LINES + 1;
+
+	char buf[BUFFER_SIZE]; 
+	int length = TG_pack( buf, BUFFER_SIZE, "SII",
+			fileInfo->fullPath.latin1(), pendingLinesFirst,
+			FILE_WINDOW_BLOCK_LINES );
+	TG_send( sock, COLLECTOR_READ_FILE_LINES, pendingLinesKey,
+				length, buf );
+	TG_flush( sock );
+
+	// A block comes back quickly (the collector seeks straight to
+	// it), so there's no progress dialog here
+	while( sourceState != notReadingFile ) {
+		qApp->processEvents();
+	}
+}
+
 void FileCollection:: setFullPath( char * fullPathName, int id )
 {
 
@@ -307,8 +398,6 @@ void FileCollection:: insertSourceFile(char * buf, int id, int size_estimate )
 	}
 	pendingFileInfoTable.deleteEntry( id );
 
-	int lineNo = 0;
-
 	// If have size_estimate, tweak the line table so on next resize
 	// that it is approximately the right size.   Since I don't want
 	// to run through the entire buffer to count newlines, I am just
@@ -321,6 +410,30 @@ void FileCollection:: insertSourceFile(char * buf, int id, int size_estimate )
 	    fileInfo->lineTable.tweakTableResize(line_guess);
 	}
 	
+	// Add every line, and update maxLineNo for file
+	fileInfo->maxLineNo = addSourceLines( fileInfo, buf, 1 );
+
+	// Mark file as available
+	fileInfo->unavailable = FALSE;
+
+	// Put the new file data in our list of files.  It should be
+	// the only one if createSourceFile did its job correctly!
+	fileInfoTable.addEntry( fileInfo->fileName.latin1(), fileInfo );
+
+	// Indicate that file has been read
+	sourceState = notReadingFile;
+
+#if 0
+	// DEBUG
+	TG_timestamp ("FileCollection::insertSourceFile: end id %i\n", id);
+#endif
+}
+
+int FileCollection:: addSourceLines( FileInfo * fileInfo, char * buf,
+		int firstLineNo )
+{
+	int lineNo = firstLineNo - 1;
+
 	// Run though buffer, adding lines to lineTable at the line's number
 	// This assumes that the buffer is terminated with a \0
 	char * p = buf;
@@ -358,23 +471,51 @@ void FileCollection:: insertSourceFile(char * buf, int id, int size_estimate )
 		}
 	}
 
-	// Update maxLineNo for file
-	fileInfo->maxLineNo = lineNo;
+	return (lineNo - firstLineNo + 1);
+}
 
-	// Mark file as available
+void FileCollection:: insertWindowedFile( char * buf, int id )
+{
+	// Look up the pointer to FileInfo object
+	FileInfo * fileInfo = pendingFileInfoTable.findEntry( id );
+	if( fileInfo == NULL ) {
+		TG_error( "Failed to find matching request for file line "
+				"count arrived with key %d", id );
+		return;
+	}
+
+	pendingFileInfoTable.deleteEntry( id );
+
+	// No lines yet; getSourceLine fetches them as needed
+	int lineCount;
+	TG_unpack( buf, "I", &lineCount );
+	fileInfo->maxLineNo = lineCount;
+	fileInfo->windowed = TRUE;
 	fileInfo->unavailable = FALSE;
 
-	// Put the new file data in our list of files.  It should be
-	// the only one if createSourceFile did its job correctly!
 	fileInfoTable.addEntry( fileInfo->fileName.latin1(), fileInfo );
 
 	// Indicate that file has been read
 	sourceState = notReadingFile;
+}
 
-#if 0
-	// DEBUG
-	TG_timestamp ("FileCollection::insertSourceFile: end id %i\n", id);
-#endif
+void FileCollection:: insertSourceLines( char * buf, int id )
+{
+	if( id != pendingLinesKey ) {
+		TG_error( "Failed to find matching request for file lines "
+				"arrived with key %d", id );
+		return;
+	}
+
+	// The file is gone if clear() was called while we waited
+	FileInfo * fileInfo =
+		fileInfoTable.findEntry( pendingLinesFile.latin1() );
+	if( fileInfo != NULL && fileInfo->windowed ) {
+		addSourceLines( fileInfo, buf, pendingLinesFirst );
+	}
+
+	pendingLinesKey = -1;
+	sourceState = notReadingFile;
 }
 
 /******************************************************************************
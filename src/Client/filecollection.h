@@ -29,6 +29,11 @@
 #include <qprogressdialog.h>
 #include <qtimer.h>
 
+//! Lines fetched at a time from files the collector sends by line range
+#define FILE_WINDOW_BLOCK_LINES 1000
+//! Blocks of such a file held at once; the oldest is dropped first
+#define FILE_WINDOW_MAX_BLOCKS 32
+
 //! Repository for source file contents.
 
 //! Responds to requests for specific lines from specific source
@@ -108,6 +113,23 @@ public:
 	//! that function invalidates the id.
 	void setFullPath( char * fullPath, int id );
 
+	//! Called instead of insertSourceFile when the collector found
+	//! the file too big to send whole.  buf holds the line count;
+	//! lines are then fetched a block at a time as they are asked
+	//! for, and only the most recently fetched blocks are kept.
+	void insertWindowedFile( char * buf, int id );
+
+	//! Callback for the lines requested by getSourceLine for a
+	//! windowed file.  Modifies buf like insertSourceFile.
+	void insertSourceLines( char * buf, int id );
+
+	//! Returns TRUE if fileName has been loaded and is being
+	//! fetched by line range (so viewers shouldn't load every line)
+	bool isWindowed (const char *fileName);
+
+	//! QString version of isWindowed(const char *)
+	bool isWindowed (const QString &fileName);
+
 	//! Sets the socket to be used for requesting files.
 	void setRemoteSocket( int remoteSocket )
 	{	sock = remoteSocket; }
@@ -146,11 +168,23 @@ protected:
 		//! Store lines in table, look up with line number
 		IntTable<QString> lineTable;
 
+		//! Set to true if lines are fetched a block at a time
+		//! (see insertWindowedFile)
+		bool windowed;
+
+		//! For windowed files, the blocks in lineTable (block b
+		//! holds lines b*FILE_WINDOW_BLOCK_LINES+1 on), with the
+		//! next one to drop at heldBlocks[nextDrop]
+		int heldBlocks[FILE_WINDOW_MAX_BLOCKS];
+		int numHeld;
+		int nextDrop;
+
 
 		FileInfo( const char * name ) :
 			unavailable( TRUE ), maxLineNo( 0 ), fileName( name ),
 			// Create line table that deletes QStrings on deletion
-			lineTable ("Line", DeleteData, 0)
+			lineTable ("Line", DeleteData, 0),
+			windowed( FALSE ), numHeld( 0 ), nextDrop( 0 )
 		{ }
 		~FileInfo() {}
 	};  
@@ -162,6 +196,17 @@ protected:
 	//! routines) if file created more than once!
 	FileInfo *createFileInfo (const char *fileName);
 
+	//! Internal routine that fetches the block of windowed file
+	//! fileName holding lineNo, dropping the oldest block if too
+	//! many are held.  Like createFileInfo, executes an event loop
+	//! while waiting for the data, so the file's FileInfo may have
+	//! been deleted (by clear()) when this returns.
+	void fetchSourceBlock (const char *fileName, int lineNo);
+
+	//! Adds the lines in buf to fileInfo's lineTable, starting
+	//! with line firstLineNo.  Returns the number of lines added.
+	int addSourceLines (FileInfo *fileInfo, char *buf, int firstLineNo);
+
 	//! Socket used to communicated with the collector.
 	int sock;
 
@@ -179,6 +224,13 @@ protected:
 	IntTable<FileInfo> pendingFileInfoTable;
 	int nextPendingFileInfoKey;
 
+	//! The outstanding request for lines of a windowed file, if
+	//! any.  Found by name when the lines arrive, since the
+	//! FileInfo may be deleted by clear() while we wait.
+	int pendingLinesKey;
+	QString pendingLinesFile;
+	int pendingLinesFirst;
+
 	//! The list of FileInfo objects in our collection.
 	StringTable<FileInfo> fileInfoTable;
 
@@ -0,0 +1,381 @@
+// gui_ingest.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Background thread that receives Collector messages for the
+// GUISocketReader (see gui_ingest.h).  Only built with USE_INGEST_THREAD.
+//
+// Qt (as we link it) is not thread safe: even QStrings that never leave
+// a thread share a reference-counted null string and codec tables with
+// every other thread.  So the thread never calls into Qt.  It receives
+// (and decompresses) messages and unpacks DB_ADD_MESSAGE, the only one
+// that needs no Qt.  XML snippets and .tgb records, which make up nearly
+// all of a big load, are passed along as received and parsed by the
+// UIManager on the GUI thread, so this does not make the GUI any more
+// responsive while they are being loaded.  With USE_READ_THREAD the
+// socket library already receives messages on its own thread, so this
+// mostly adds a queue and a copy; it is off by default.
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+#include "tg_socket.h"
+#include "tg_pack.h"
+#include "tg_error.h"
+#include "command_tags.h"
+#include "gui_ingest.h"
+
+// The queue to the GUI holds at most this many records or (roughly) this
+// many bytes of messages, whichever comes first
+#define GI_MAX_RECORDS 4096
+#define GI_MAX_BYTES (16*1024*1024)
+
+// How often (in ms) to look for messages if the socket library can't
+// give us a descriptor to wait on
+#define GI_POLL_TIME 10
+
+GUIIngest:: GUIIngest( int sock_in, UIManager * m )
+	: socket_in(sock_in), um(m), thread_running(FALSE),
+	  head(NULL), tail(NULL), count(0), bytes(0), closed(FALSE),
+	  stopping(FALSE), notify_pending(FALSE)
+{
+	pthread_mutex_init( &lock, NULL );
+	pthread_cond_init( &not_empty, NULL );
+	pthread_cond_init( &not_full, NULL );
+
+	if( pipe( notify_pipe ) != 0 || pipe( stop_pipe ) != 0 )
+		TG_errno( "GUIIngest: unable to create wakeup pipes!" );
+
+	// Read ends are drained without blocking
+	fcntl( notify_pipe[0], F_SETFL, O_NONBLOCK );
+	fcntl( stop_pipe[0], F_SETFL, O_NONBLOCK );
+}
+
+GUIIngest:: ~GUIIngest()
+{
+	stop();
+
+	GUIIngestRecord * rec, * next;
+	for( rec = head; rec != NULL; rec = next ) {
+		next = rec->next;
+		release( rec );
+	}
+
+	close( notify_pipe[0] );
+	close( notify_pipe[1] );
+	close( stop_pipe[0] );
+	close( stop_pipe[1] );
+	pthread_cond_destroy( &not_full );
+	pthread_cond_destroy( &not_empty );
+	pthread_mutex_destroy( &lock );
+}
+
+void GUIIngest:: start()
+{
+	if( thread_running ) return;
+
+	stopping = FALSE;
+	if( pthread_create( &thread, NULL, thread_main, this ) != 0 )
+		TG_errno( "GUIIngest: unable to create ingest thread!" );
+	thread_running = TRUE;
+}
+
+void GUIIngest:: stop()
+{
+	if( !thread_running ) return;
+
+	pthread_mutex_lock( &lock );
+	stopping = TRUE;
+	pthread_cond_broadcast( &not_full );
+	pthread_mutex_unlock( &lock );
+
+	// Wake the thread if it is waiting for the socket
+	char c = 0;
+	while( write( stop_pipe[1], &c, 1 ) < 0 && errno == EINTR )
+		;
+
+	pthread_join( thread, NULL );
+	thread_running = FALSE;
+
+	char junk[64];
+	while( read( stop_pipe[0], junk, sizeof(junk) ) > 0 )
+		;
+}
+
+void * GUIIngest:: thread_main( void * arg )
+{
+	((GUIIngest *)arg)->ingest_loop();
+	return NULL;
+}
+
+// Receive messages until the socket closes or stop() is called
+void GUIIngest:: ingest_loop()
+{
+	int tag, id, size;
+	void * buf;
+
+	// Wait on the socket library's notifier (if it has one) and
+	// our stop pipe when there's nothing to read
+	int watch_fd = TG_recv_notify_fd( socket_in );
+	int max_fd = (watch_fd > stop_pipe[0]) ? watch_fd : stop_pipe[0];
+
+	for(;;) {
+		pthread_mutex_lock( &lock );
+		bool stop_now = stopping;
+		pthread_mutex_unlock( &lock );
+		if( stop_now ) break;
+
+		int retval = TG_nb_recv( socket_in, &tag, &id, &size, &buf );
+		if( retval > 0 ) {
+			put( decode( tag, id, size, (char *)buf ) );
+		} else if( retval < 0 ) {
+			// Let the GUI know once it has taken everything else
+			pthread_mutex_lock( &lock );
+			closed = TRUE;
+			if( !notify_pending ) {
+				char c = 0;
+				while( write( notify_pipe[1], &c, 1 ) < 0
+						&& errno == EINTR )
+					;
+				notify_pending = TRUE;
+			}
+			pthread_cond_broadcast( &not_empty );
+			pthread_mutex_unlock( &lock );
+			break;
+		} else {
+			fd_set readfds;
+			struct timeval timeout;
+
+			FD_ZERO( &readfds );
+			FD_SET( stop_pipe[0], &readfds );
+			if( watch_fd >= 0 )
+				FD_SET( watch_fd, &readfds );
+			timeout.tv_sec = 0;
+			timeout.tv_usec = GI_POLL_TIME * 1000;
+			select( max_fd + 1, &readfds, NULL, NULL,
+					(watch_fd >= 0) ? NULL : &timeout );
+		}
+	}
+}
+
+// Unpack the messages that can be done without Qt.  The rest (including
+// XML snippets and .tgb records, which need Qt's XML classes) are passed
+// along as received for the GUISocketReader to handle.
+GUIIngestRecord * GUIIngest:: decode( int tag, int id, int size, char * buf )
+{
+	GUIIngestRecord * rec = new GUIIngestRecord;
+
+	rec->tag = tag;
+	rec->id = id;
+	rec->size = size;
+	rec->decoded = FALSE;
+	rec->buf = buf;
+	rec->next = NULL;
+
+	switch( tag ) {
+		case DB_ADD_MESSAGE:
+		{
+			char * messageFolderTag;
+			char * messageText;
+			char * messageTraceback;
+
+			TG_unpack( buf, "SSS", &messageFolderTag,
+					&messageText, &messageTraceback );
+			UIManager::appendXMLCommand( rec->commands,
+					UIManager::XMLCommand::AddMessage,
+					messageFolderTag, messageText,
+					messageTraceback );
+			rec->decoded = TRUE;
+			break;
+		}
+		default:
+			break;
+	}
+
+	if( rec->decoded ) {
+		free( rec->buf );
+		rec->buf = NULL;
+	}
+	return rec;
+}
+
+// Add a record to the queue, waiting for room if it is full
+void GUIIngest:: put( GUIIngestRecord * rec )
+{
+	pthread_mutex_lock( &lock );
+
+	// Always let one record through, however big, and don't hold
+	// up stop()
+	while( count > 0 && !stopping
+			&& (count >= GI_MAX_RECORDS || bytes >= GI_MAX_BYTES) )
+		pthread_cond_wait( &not_full, &lock );
+
+	if( tail != NULL )
+		tail->next = rec;
+	else
+		head = rec;
+	tail = rec;
+	count++;
+	bytes += rec->size;
+
+	// Wake the GUI if it has seen the queue empty
+	if( !notify_pending ) {
+		char c = 0;
+		while( write( notify_pipe[1], &c, 1 ) < 0 && errno == EINTR )
+			;
+		notify_pending = TRUE;
+	}
+	pthread_cond_signal( &not_empty );
+
+	pthread_mutex_unlock( &lock );
+}
+
+int GUIIngest:: state()
+{
+	int retval;
+
+	pthread_mutex_lock( &lock );
+	if( count > 0 ) {
+		retval = 1;
+	} else {
+		// Rearm the notification for the next record
+		char junk[64];
+		while( read( notify_pipe[0], junk, sizeof(junk) ) > 0 )
+			;
+		notify_pending = FALSE;
+		retval = closed ? -1 : 0;
+	}
+	pthread_mutex_unlock( &lock );
+
+	return retval;
+}
+
+int GUIIngest:: depth()
+{
+	pthread_mutex_lock( &lock );
+	int retval = count;
+	pthread_mutex_unlock( &lock );
+
+	return retval;
+}
+
+GUIIngestRecord * GUIIngest:: get()
+{
+	pthread_mutex_lock( &lock );
+	while( count == 0 && !closed )
+		pthread_cond_wait( &not_empty, &lock );
+	GUIIngestRecord * rec = take( 1 );
+	pthread_mutex_unlock( &lock );
+
+	return rec;
+}
+
+GUIIngestRecord * GUIIngest:: get_batch( int max_records )
+{
+	pthread_mutex_lock( &lock );
+	GUIIngestRecord * batch = take( max_records );
+	pthread_mutex_unlock( &lock );
+
+	return batch;
+}
+
+// Unlink up to max_records from the head of the queue (lock held)
+GUIIngestRecord * GUIIngest:: take( int max_records )
+{
+	if( count == 0 ) return NULL;
+
+	GUIIngestRecord * batch = head;
+	GUIIngestRecord * last = head;
+	bytes -= last->size;
+	count--;
+	for( int i = 1; i < max_records && last->next != NULL; i++ ) {
+		last = last->next;
+		bytes -= last->size;
+		count--;
+	}
+
+	head = last->next;
+	if( head == NULL )
+		tail = NULL;
+	last->next = NULL;
+
+	pthread_cond_signal( &not_full );
+	return batch;
+}
+
+void GUIIngest:: release( GUIIngestRecord * rec )
+{
+	UIManager::freeXMLCommands( rec->commands );
+	free( rec->buf );
+	delete rec;
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -0,0 +1,178 @@
+//! \file gui_ingest.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Reads messages from a Collector on a separate thread, so the GUI
+// thread doesn't wait on the socket (only built with USE_INGEST_THREAD;
+// XML and .tgb records are still parsed on the GUI thread).
+
+#ifndef GUI_INGEST_H
+#define GUI_INGEST_H
+
+#include <pthread.h>
+
+#include "uimanager.h"
+
+//! One message from a Collector, as prepared by the GUIIngest thread
+struct GUIIngestRecord {
+	int tag;
+	int id;
+	int size;
+	//! TRUE if the message was decoded into commands (buf is NULL);
+	//! FALSE if buf still needs to be unpacked on the GUI thread
+	bool decoded;
+	//! Message body as received (owned by the record)
+	char * buf;
+	//! UIManager updates decoded from the message
+	UIManager::XMLCommandList commands;
+	GUIIngestRecord * next;
+};
+
+//! Receives messages on a background thread
+
+//! A GUIIngest runs a thread that receives messages from the Collector
+//! socket, unpacks those that can be handled without Qt into
+//! UIManager::XMLCommands, and passes everything to the GUI thread in
+//! order through a bounded queue.  Since the Qt we link is not thread
+//! safe, XML snippets and .tgb records are parsed on the GUI thread.  The queue bound
+//! keeps a fast Collector from running the GUI out of memory; once it
+//! is full, the socket backs up instead.
+//!
+//! Only the GUISocketReader should use this class; the rest of the GUI
+//! continues to see one message at a time through check_socket().
+class GUIIngest {
+public:
+	//! Prepares (but doesn't start) ingest for sock_in.  Must be
+	//! created on the GUI thread.
+	GUIIngest( int sock_in, UIManager * m );
+	//! Stops the thread and frees any records not yet taken
+	~GUIIngest();
+
+	//! Starts the thread, if it isn't running already
+	void start();
+	//! Stops the thread without reading any further messages from
+	//! the socket (so someone else can), and waits for it to exit.
+	//! Records already queued stay queued.
+	void stop();
+	//! Returns TRUE if the thread is running
+	bool running() { return thread_running; }
+
+	//! Returns a descriptor that becomes readable when records are
+	//! queued.  Only written after state() has found the queue empty.
+	int notify_fd() { return notify_pipe[0]; }
+	//! Returns 1 if records are queued, 0 if not, or -1 if the socket
+	//! has closed and all records have been taken
+	int state();
+	//! Returns the number of records queued
+	int depth();
+	//! Returns the next record, waiting for one if necessary.  Returns
+	//! NULL if the socket has closed and all records have been taken.
+	GUIIngestRecord * get();
+	//! Returns a list (linked through next) of up to max_records
+	//! records without waiting, or NULL if none are queued
+	GUIIngestRecord * get_batch( int max_records );
+	//! Frees a record returned by get() or get_batch()
+	static void release( GUIIngestRecord * rec );
+
+private:
+	static void * thread_main( void * arg );
+	void ingest_loop();
+	GUIIngestRecord * decode( int tag, int id, int size, char * buf );
+	void put( GUIIngestRecord * rec );
+	GUIIngestRecord * take( int max_records );
+
+	int socket_in;
+	UIManager * um;
+
+	pthread_t thread;
+	bool thread_running;
+
+	//! Protects everything below
+	pthread_mutex_t lock;
+	//! Signalled when records are queued (or the socket closes)
+	pthread_cond_t not_empty;
+	//! Signalled when records are taken (or stop() is called)
+	pthread_cond_t not_full;
+	GUIIngestRecord * head;
+	GUIIngestRecord * tail;
+	int count;
+	//! Total message size of the queued records
+	long bytes;
+	//! TRUE once the socket has closed
+	bool closed;
+	//! TRUE while stop() waits for the thread to exit
+	bool stopping;
+	//! TRUE if notify_pipe has been written and not yet drained
+	bool notify_pending;
+	int notify_pipe[2];
+	//! Wakes the thread from waiting on the socket for stop()
+	int stop_pipe[2];
+};
+
+#endif // GUI_INGEST_H
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -10,6 +10,7 @@
 #include <new>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <qapplication.h>
 #include <qobject.h>
@@ -91,6 +92,83 @@ void exit_cleanup(void)
     }
 }
 
+// Writes the snapshot (or, if snapshot is FALSE, the text report) for
+// batch mode to fileName ("-" means stdout).  Returns FALSE if the file
+// can't be opened.
+static bool write_batch_output( UIManager &um, const QString &fileName,
+				bool snapshot )
+{
+    FILE *out;
+    if( fileName == "-" ) {
+	out = stdout;
+    } else if( (out = fopen( fileName.latin1(), "w" )) == NULL ) {
+	fprintf( stderr, "TGclient: Unable to open '%s' for writing!\n",
+		 fileName.latin1() );
+	return FALSE;
+    }
+
+    if( snapshot )
+	um.writeSnapshot( out );
+    else
+	um.printSnapshot( out );
+
+    if( out == stdout )
+	fflush( stdout );
+    else
+	fclose( out );
+    return TRUE;
+}
+
+// Batch mode (-b and/or -o): instead of opening a window, reads until
+// the collector says it has sent all its input (or quits), then writes
+// the snapshot and/or text report.  Reports how long each phase took
+// (start_time is when we started, connect_time when the collector
+// connected, and ready_time when it asked for a viewer).
+// Returns the exit status for TGclient.
+static int run_batch( UIManager &um, GUISocketReader &gsr,
+		      const QString &snapshotFile, const QString &reportFile,
+		      double start_time, double connect_time,
+		      double ready_time )
+{
+    int status = 0;
+    int result;
+    while( (result = gsr.check_socket()) != DB_INPUT_COMPLETE
+	   && result != DPCL_SAYS_QUIT ) {
+    }
+    double ingest_time = TG_time();
+    if( result == DPCL_SAYS_QUIT ) {
+	fprintf( stderr, "TGclient: Warning: collector quit before all of "
+		 "its input was sent\n" );
+    }
+
+    if( !snapshotFile.isNull()
+	&& !write_batch_output( um, snapshotFile, TRUE ) )
+	status = -1;
+    double snapshot_time = TG_time();
+
+    if( !reportFile.isNull()
+	&& !write_batch_output( um, reportFile, FALSE ) )
+	status = -1;
+    double report_time = TG_time();
+
+    fprintf( stderr, "TGclient: %-28s %9.3f sec\n", "connect to collector",
+	     connect_time - start_time );
+    fprintf( stderr, "TGclient: %-28s %9.3f sec\n", "wait for collector",
+	     ready_time - connect_time );
+    fprintf( stderr, "TGclient: %-28s %9.3f sec\n", "ingest",
+	     ingest_time - ready_time );
+    if( !snapshotFile.isNull() )
+	fprintf( stderr, "TGclient: %-28s %9.3f sec\n", "write snapshot",
+		 snapshot_time - ingest_time );
+    if( !reportFile.isNull() )
+	fprintf( stderr, "TGclient: %-28s %9.3f sec\n", "write text report",
+		 report_time - snapshot_time );
+    fprintf( stderr, "TGclient: %-28s %9.3f sec\n", "total",
+	     report_time - start_time );
+
+    return status;
+}
+
 int main( int argc, char * argv[] )
 {
     // Register our at_exit cleanup routine
@@ -111,7 +189,12 @@ int main( int argc, char * argv[] )
 #ifdef TG_TIMINGS    
     TG_timestamp ("GUI thread: Thread started\n");
 #endif
-    QApplication a( argc, argv );
+    double start_time = TG_time();
+
+    // Batch mode (-b/-o) reads everything into the UIManager without
+    // creating any windows, so it must not need a display
+    bool batch = TGBatchRequested( argc, argv );
+    QApplication a( argc, argv, !batch );
     
 #ifndef LOCAL_ONLY
     QString verString;
@@ -127,6 +210,7 @@ int main( int argc, char * argv[] )
     QString collectorProg;
 
     QPtrVector<QString> collargs;
+    QString batchSnapshot, batchReport;	// set by -b and -o
 
     char ** remoteArgs;             // will point into argv
     int remoteCount;                // number of values in remoteArgs
@@ -140,7 +224,7 @@ int main( int argc, char * argv[] )
     // didn't specify them
     TGParseOpts( argc, argv, remoteHost, loginName, connectPort, remoteDir,
 		 collectorProg, remoteCount, remoteArgs, 
-		 setParallel, heartbeat, collargs);
+		 setParallel, heartbeat, collargs, batchSnapshot, batchReport);
     
     QString p;
     if( collectorProg.isNull() ) {
@@ -169,6 +253,7 @@ int main( int argc, char * argv[] )
 	    (int)(collector->getStatus()) << endl;
 	return 0;
     }
+    double connect_time = TG_time();
     
     // When neeed for debugging, gives user time to start the
     // debugger on the remote side and attach to the collector
@@ -184,9 +269,11 @@ int main( int argc, char * argv[] )
 		    collector, SLOT( handleClosedSocket() ) );
     
     um.setRemoteSocket( collector->getSocket() );
+    // (Batch mode doesn't run the event loop that sends heartbeats, so
+    // it doesn't start them)
     GUIActionSender * p_sender =
 	new GUIActionSender( collector->getSocket(), &um,
-			     &programState, heartbeat );
+			     &programState, heartbeat && !batch );
     
     // Change remote directory and run the remote application,
     // then request parse
@@ -254,6 +341,20 @@ int main( int argc, char * argv[] )
 	delete collector;
 	return 0;
     }
+    double ready_time = TG_time();
+
+    // Batch mode reads the socket only in run_batch(), so it can't
+    // fetch message bodies on demand; have them sent up front instead
+    if( batch ) {
+	int kept = 0;
+	for( int i = 0; i < remoteCount; ++i ) {
+	    if( strcmp( remoteArgs[i], "-lazy" ) != 0 )
+		remoteArgs[kept++] = remoteArgs[i];
+	}
+	for( int i = kept; i < remoteCount; ++i )
+	    remoteArgs[i] = NULL;
+	remoteCount = kept;
+    }
 
     /* MS/START ASSUMED ADDED BY JCG */
     p_sender->initializeApp( remoteCount, remoteArgs,
@@ -263,6 +364,25 @@ int main( int argc, char * argv[] )
 #ifdef TG_TIMINGS    
     TG_timestamp ("GUI thread: Ending database population\n");
 #endif
+
+    if( batch ) {
+	int status = run_batch( um, gsr, batchSnapshot, batchReport,
+				start_time, connect_time, ready_time );
+	gsr.report_ingest_stats();
+
+	// The collector reads the socket itself as it shuts down
+	gsr.stop_reading();
+
+	// tells the collector process to shut down
+	delete collector;
+	delete p_sender;
+
+	normal_termination = TRUE;
+	clearCollectorOutput();
+	fflush (stdout);
+	fflush (stderr);
+	return status;
+    }
     
     // Put the socket reader on automatic
     gsr.enable_auto_read( TRUE );
@@ -422,6 +542,10 @@ int main( int argc, char * argv[] )
     // Lets the collector manage further socket messages directly
     // during the delete collector statement below (needs sole control)
     gsr.enable_auto_read(FALSE);
+
+    // Says how well we kept up with the collector, if TG_INGEST_STATS
+    // is set
+    gsr.report_ingest_stats();
     
     // tells the collector process to shut down
     delete collector;
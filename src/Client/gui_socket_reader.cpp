@@ -7,16 +7,20 @@
 // John May, 26 October 2000
 // Check socket and handle what arrives on it.
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <qapplication.h>	// for qWarning
-#include <qdatetime.h>
 #include <qmessagebox.h>
+#include <qsocketnotifier.h>
+#include <qtimer.h>
 
 #include "tg_socket.h"
 #include "tg_pack.h"
 #include "tg_program_state.h"
 #include "gui_socket_reader.h"
+#include "gui_ingest.h"
 #include "uimanager.h"
 #include "command_tags.h"
 #include "tg_error.h"
@@ -36,73 +40,185 @@
 
 #define MIN_BUF_LEN 8192
 
+// Read data for a limited time so the GUI stays responsive even when
+// being swamped with a lot of messages or huge messages.  Rather than
+// fixed constants, the time budget and how often we look at the clock
+// are derived from the measured cost of handling a message:
+//  - The budget is enough to drain the messages already queued, but
+//    never less than GSR_MIN_READ_TIME (so bulk loads make progress
+//    in reasonably big steps) or more than GSR_MAX_READ_TIME ms.
+//  - The clock is checked about every GSR_CHECK_INTERVAL ms worth of
+//    messages, and after any message of GSR_BIG_MESSAGE bytes or more
+//    (a single source file or huge snippet can take a while).
+#define GSR_MIN_READ_TIME 20.0
+#define GSR_MAX_READ_TIME 100.0
+#define GSR_CHECK_INTERVAL 5.0
+#define GSR_BIG_MESSAGE 65536
+// Starting guess for msg_cost (ms per message), refined as we go
+#define GSR_INITIAL_MSG_COST 0.05
+// Weight given to each new measurement of msg_cost
+#define GSR_COST_WEIGHT 0.25
+// Most records to take from the ingest thread at once
+#define GSR_INGEST_BATCH 64
+// Credit given to a Collector that uses flow control: at most this many
+// XML snippets (and bytes of them) may be on their way to us at once.
+// Small enough that a source file request doesn't wait behind much bulk
+// data, large enough to keep the Collector busy.  More credit is
+// granted each time a quarter of it has been used up.
+#define GSR_CREDIT_SNIPPETS 256
+#define GSR_CREDIT_BYTES (4*1024*1024)
+
+// What TG_INGEST_STATS measures (see report_ingest_stats()).  Unknown
+// tags share the last slot.
+struct GSRIngestStats {
+	long count[LAST_COMMAND_TAG + 1];
+	double bytes[LAST_COMMAND_TAG + 1];
+	//! Seconds spent handling messages with each tag
+	double time[LAST_COMMAND_TAG + 1];
+	long messages;
+	double total_bytes;
+	//! When the first message was taken and the last one finished
+	double first;
+	double last;
+	//! Seconds the GUI spent in get_pending_data(), in how many
+	//! stretches, and the longest one
+	double blocked;
+	long blocks;
+	double longest_block;
+};
+
 GUISocketReader:: GUISocketReader( int sock_in, UIManager *m,
 		TGProgramState * ps )
-	: programState(ps), socket_in(sock_in), auto_reading(FALSE), um(m)
+	: programState(ps), socket_in(sock_in), auto_reading(FALSE), um(m),
+	  timer_id(0), notifier(NULL), continue_scheduled(FALSE),
+	  msg_cost(GSR_INITIAL_MSG_COST), recv_depth(0), ingest(NULL),
+	  batch(NULL), batch_count(0), flow_control(FALSE),
+	  credit_snippets_used(0), credit_bytes_used(0), ingest_stats(NULL),
+	  held_head(NULL), held_tail(NULL)
 {
     // Set object name to aid in debugging connection issues
     setName ("GUISocketReader");
+
+    // Only look at the clock for every message if asked to
+    if( getenv( "TG_INGEST_STATS" ) != NULL ) {
+	ingest_stats = new GSRIngestStats;
+	memset( ingest_stats, 0, sizeof(*ingest_stats) );
+	ingest_stats->first = -1.0;
+    }
+
+#ifdef USE_INGEST_THREAD
+    // Receive messages on a separate thread (started when we first
+    // need a message).  Off unless tgclient.pro turns it on; see
+    // gui_ingest.cpp for why.
+    ingest = new GUIIngest( sock_in, m );
+#endif
+
+    // Catch up on what came in while a snapshot was being written
+    connect( m, SIGNAL(updatesReleased()), this, SLOT(release_held()) );
 }
 
 void GUISocketReader:: enable_auto_read( bool set_enable )
 {
-	// Set a timer to read the input queue periodically.
-	// The interval must be chosen as a compromise between
-	// keeping up with incoming data and avoiding excessive
-	// spinning (and therefore CPU usage) when the input
-	// is idle.
+	// Let the event loop tell us when data arrives rather than polling.
+	// For threaded reads, the descriptor is the input queue's (or the
+	// ingest thread's) wakeup pipe.  If the socket library can't
+	// provide one, fall back to polling the input queue every 10 ms.
+	// Turning auto-reading off also stops the ingest thread, so that
+	// others (e.g., TGCollector at shutdown) can read the socket.
 	if( set_enable && !auto_reading) {
-		timer_id = startTimer(10);
+		int notify_fd;
+		if( ingest ) {
+			ingest->start();
+			notify_fd = ingest->notify_fd();
+		} else {
+			notify_fd = TG_recv_notify_fd( socket_in );
+		}
+		if( notify_fd >= 0 ) {
+			notifier = new QSocketNotifier( notify_fd,
+					QSocketNotifier::Read, this,
+					"GUISocketReader notifier" );
+			connect( notifier, SIGNAL(activated(int)),
+					this, SLOT(get_pending_data()) );
+		} else {
+			timer_id = startTimer(10);
+		}
 		auto_reading = TRUE;
+
+		// Anything that arrived before now may not trigger the
+		// notifier, so take a look as soon as we're back in the
+		// event loop.
+		schedule_pending_data();
 	} else if ( !set_enable && auto_reading ) {
-		killTimer( timer_id );
-		timer_id = 0;
+		if( notifier ) {
+			delete notifier;
+			notifier = NULL;
+		} else {
+			killTimer( timer_id );
+			timer_id = 0;
+		}
+		stop_reading();
 		auto_reading = FALSE;
 	}
 }
 
+void GUISocketReader:: stop_reading()
+{
+	// check_socket() starts the thread even without auto-reading
+	// (e.g., in batch mode), so don't go by auto_reading here
+	if( ingest )
+		ingest->stop();
+}
+
 void GUISocketReader:: timerEvent( QTimerEvent * )
 {
 	get_pending_data();
 }
-	
-// Read data for no more than approximately 100 ms (up to 200ms delay, which is
-// fine), but only check the time after every 50 reads or 75,000 bytes of 
-// data read to minimize the time checking overhead.  
-// We want to allow GUI to respond even when being swamped with a lot 
-// of messages or huge messages.
-//
-// These numbers calibrated on 1.4Ghz Power4 processing TGui mpip_example.tgui
-// and a 145MB BG/L mpiP file (which caused byte counts to be added). 
-// -JCG 3/13/06
-#define GSR_TIME_CHECK_COUNT 50
-#define GSR_TIME_CHECK_BYTES 75000
-#define GSR_READ_TIME 100 
 
+// Come back to get_pending_data() once pending GUI events have been
+// handled (used when we stop with data still queued, since the
+// notifier only fires again after we have seen the queue empty).
+void GUISocketReader:: schedule_pending_data()
+{
+	if( !continue_scheduled ) {
+		continue_scheduled = TRUE;
+		QTimer::singleShot( 0, this, SLOT(continue_pending_data()) );
+	}
+}
+
+void GUISocketReader:: continue_pending_data()
+{
+	continue_scheduled = FALSE;
+	if( auto_reading )
+		get_pending_data();
+}
+	
 void GUISocketReader:: get_pending_data()
 {
-    // Since we poll relatively infrequently, get a bunch
-    // of data each time we check, but only read for a
-    // limited amount of time.  This is a balance between
-    // keeping up with incoming data and making the GUI responsive.
-    
-    // Before we spend time starting the timer,
-    // see if there's something to read.
-    if( TG_read_data_queued( socket_in ) == 0 ) return;
+    // Before we spend time starting the clock,
+    // see if there's something to read.  (Finding the queue empty
+    // also rearms the notifier.)
+    int retval = data_queued();
+    if( retval == 0 ) return;
     
-    int retval;
+    // Size the time budget from the work already waiting
+    double budget = queue_depth() * msg_cost;
+    if( budget < GSR_MIN_READ_TIME )
+	budget = GSR_MIN_READ_TIME;
+    else if( budget > GSR_MAX_READ_TIME )
+	budget = GSR_MAX_READ_TIME;
+
+    // How many messages to handle between clock checks
+    int check_interval = (int)(GSR_CHECK_INTERVAL / msg_cost);
+    if( check_interval < 1 )
+	check_interval = 1;
     
-    // Check elapsed time after either GSR_TIME_CHECK_COUNT messages
-    // or after GSR_TIME_CHECK_BYTES byts of data read to minimize
-    // time checking overhead (which can be significant). 
-    int next_time_check_count = GSR_TIME_CHECK_COUNT;
-    int next_time_check_bytes = GSR_TIME_CHECK_BYTES; 
+    int next_time_check_count = check_interval;
     int check_count = 0;
-    int bytes_count = 0;
-    QTime t;
-    t.start();
+    double start = TG_time();
+    double elapsed = 0.0;
+    bool out_of_time = FALSE;
     
-    while(( retval = TG_read_data_queued( socket_in ) )> 0)
+    while( retval > 0 )
     {
 	int sizeRead = 0;
 	
@@ -110,44 +226,90 @@ void GUISocketReader:: get_pending_data()
 	
 	// Count number of checks
 	check_count++;
-	bytes_count+= sizeRead;
 	
-	// Occationally check clock to see if too much time has gone by
+	// Occasionally check clock to see if too much time has gone by
 	next_time_check_count--;
-	next_time_check_bytes -= sizeRead;
-	if ((next_time_check_count < 0) || 
-	    (next_time_check_bytes < 0))
+	if ((next_time_check_count <= 0) || (sizeRead >= GSR_BIG_MESSAGE))
 	{
-	    int elapsed;
 	    // It too much time has gone by, stop checking sockets
 	    // now so GUI can respond to events
-	    if ((elapsed = t.elapsed()) > GSR_READ_TIME)
+	    elapsed = (TG_time() - start) * 1000.0;
+	    if (elapsed > budget)
 	    {
-#if 0
-		// DEBUG
-		TG_timestamp ("Socket check exited early after %i "
-			      "checks, %i bytes and %i ms\n", 
-			      check_count, bytes_count, elapsed);
-#endif
-		
+		out_of_time = TRUE;
 		break;
 	    }
 	    
-	    // Don't check time for many more interations
-	    next_time_check_count = GSR_TIME_CHECK_COUNT;
-	    next_time_check_bytes = GSR_TIME_CHECK_BYTES;
+	    next_time_check_count = check_interval;
 	}
+
+	retval = data_queued();
+    }
+
+    // Fold this batch into the per-message cost estimate.  Only a
+    // batch with enough messages to give a meaningful average counts.
+    if (!out_of_time)
+	elapsed = (TG_time() - start) * 1000.0;
+    if (check_count >= 8)
+    {
+	msg_cost += GSR_COST_WEIGHT * ((elapsed / check_count) - msg_cost);
+	if (msg_cost < 0.001)
+	    msg_cost = 0.001;
+    }
+#if 0
+    // DEBUG
+    TG_timestamp ("Socket check handled %i messages in %g ms "
+		  "(budget %g ms, %g ms/message)\n", 
+		  check_count, elapsed, budget, msg_cost);
+#endif
+    
+    if (ingest_stats)
+    {
+	ingest_stats->blocked += elapsed / 1000.0;
+	ingest_stats->blocks++;
+	if (elapsed / 1000.0 > ingest_stats->longest_block)
+	    ingest_stats->longest_block = elapsed / 1000.0;
     }
     
     // retval < 0 indicates the socket closed unexpectedly
     if( retval < 0 ) 
 	emit readerSocketClosed();
+    // Stopped with data still queued; finish after the GUI catches up
+    else if( out_of_time && auto_reading )
+	schedule_pending_data();
 }
 
 GUISocketReader:: ~GUISocketReader()
 {
-	if( auto_reading )
-		killTimer( timer_id );
+	enable_auto_read( FALSE );
+
+	GUIIngestRecord * next;
+	for( ; batch != NULL; batch = next ) {
+		next = batch->next;
+		GUIIngest::release( batch );
+	}
+	for( ; held_head != NULL; held_head = next ) {
+		next = held_head->next;
+		GUIIngest::release( held_head );
+	}
+	delete ingest;
+	delete ingest_stats;
+}
+
+int GUISocketReader:: data_queued()
+{
+	if( batch != NULL )
+		return 1;
+	if( ingest )
+		return ingest->state();
+	return TG_read_data_queued( socket_in );
+}
+
+int GUISocketReader:: queue_depth()
+{
+	if( ingest )
+		return batch_count + ingest->depth();
+	return TG_read_queue_depth( socket_in );
 }
 
 int GUISocketReader:: check_socket(int *sizeRead)
@@ -155,14 +317,71 @@ int GUISocketReader:: check_socket(int *sizeRead)
 	int tag, id, size;
 	char * buf;
 
-	int retval = CONTINUE_THREAD;
-
 	// Sanity check, set size read to 0 initially
 	size = 0;
 	if (sizeRead != NULL)
 	    *sizeRead = 0;
 
-	if( TG_recv( socket_in, &tag, &id, &size, (void **)&buf ) < 0 ) {
+	if( ingest ) {
+		// Take the ingest thread's records a batch at a time
+		// (just one if we have to wait for it)
+		if( batch == NULL ) {
+			ingest->start();
+			batch = ingest->get_batch( GSR_INGEST_BATCH );
+			if( batch == NULL )
+				batch = ingest->get();
+			if( batch == NULL ) {
+				emit readerSocketClosed();
+				return DPCL_SAYS_QUIT;
+			}
+			batch_count = 0;
+			for( GUIIngestRecord * rec = batch; rec != NULL;
+					rec = rec->next )
+				batch_count++;
+		}
+		GUIIngestRecord * rec = batch;
+		batch = rec->next;
+		batch_count--;
+
+		if (sizeRead != NULL)
+		    *sizeRead = rec->size;
+
+		if( must_hold( rec->tag ) ) {
+			hold( rec );
+			return CONTINUE_THREAD;
+		}
+
+		// Decoded records just need applying to the UIManager
+		int retval = CONTINUE_THREAD;
+		double start = ingest_stats ? TG_time() : 0.0;
+		if( rec->decoded )
+			um->applyXMLCommands( rec->commands );
+		else
+			retval = handle_message( rec->tag, rec->id,
+					rec->size, rec->buf );
+		if( ingest_stats )
+			count_message( rec->tag, rec->size, start );
+		if( is_credited( rec->tag ) )
+			credit_used( rec->size );
+
+		GUIIngest::release( rec );
+		return retval;
+	}
+
+	// Normally take the message in place from the socket library's
+	// receive buffer (no malloc/free per message).  That view is only
+	// good until the next view, so if a handler below ends up back in
+	// here (e.g., through qApp->processEvents() while waiting for a
+	// source file), take a private copy instead; the library keeps the
+	// outer view in place until this level asks for the next one.
+	bool use_view = (recv_depth == 0);
+	int recv_result;
+	if( use_view )
+		recv_result = TG_recv_view( socket_in, &tag, &id, &size, &buf );
+	else
+		recv_result = TG_recv( socket_in, &tag, &id, &size,
+				(void **)&buf );
+	if( recv_result < 0 ) {
 		emit readerSocketClosed();
 		return DPCL_SAYS_QUIT;
 	}
@@ -171,6 +390,167 @@ int GUISocketReader:: check_socket(int *sizeRead)
 	if (sizeRead != NULL)
 	    *sizeRead = size;
 
+	// Held messages outlive the receive buffer, so keep a copy
+	if( must_hold( tag ) ) {
+		GUIIngestRecord * rec = new GUIIngestRecord;
+		rec->tag = tag;
+		rec->id = id;
+		rec->size = size;
+		rec->decoded = FALSE;
+		if( use_view ) {
+			rec->buf = (char *) malloc( size > 0 ? size : 1 );
+			TG_checkAlloc( rec->buf );
+			memcpy( rec->buf, buf, size );
+		} else {
+			rec->buf = buf;
+		}
+		rec->next = NULL;
+		hold( rec );
+		return CONTINUE_THREAD;
+	}
+	recv_depth++;
+
+	double start = ingest_stats ? TG_time() : 0.0;
+	int retval = handle_message( tag, id, size, buf );
+	if( ingest_stats )
+		count_message( tag, size, start );
+	if( is_credited( tag ) )
+		credit_used( size );
+
+	recv_depth--;
+	if( !use_view )
+		free( buf );
+
+	return retval;
+}
+
+// While the UIManager writes a snapshot, it fetches message bodies
+// through the event loop, but nothing else may change the database under
+// it.  Once anything is held, later messages are held too, so they are
+// still processed in order.
+bool GUISocketReader:: must_hold( int tag )
+{
+	return( tag != DB_MESSAGE_BODY &&
+		( um->holdingUpdates() || held_head != NULL ) );
+}
+
+void GUISocketReader:: hold( GUIIngestRecord * rec )
+{
+	rec->next = NULL;
+	if( held_tail != NULL )
+		held_tail->next = rec;
+	else
+		held_head = rec;
+	held_tail = rec;
+}
+
+void GUISocketReader:: release_held()
+{
+	// Stop if handling one of them starts another snapshot; the rest
+	// wait for that one to finish
+	while( held_head != NULL && !um->holdingUpdates() ) {
+		GUIIngestRecord * rec = held_head;
+		held_head = rec->next;
+		if( held_head == NULL )
+			held_tail = NULL;
+
+		if( rec->decoded )
+			um->applyXMLCommands( rec->commands );
+		else
+			handle_message( rec->tag, rec->id, rec->size,
+					rec->buf );
+		if( is_credited( rec->tag ) )
+			credit_used( rec->size );
+		GUIIngest::release( rec );
+	}
+}
+
+// The messages the Collector only sends while it has credit
+bool GUISocketReader:: is_credited( int tag )
+{
+	return( tag == DB_PROCESS_XML_SNIPPET || tag == DB_TGB_STRINGS ||
+		tag == DB_PROCESS_TGB_RECORDS );
+}
+
+void GUISocketReader:: credit_used( int size )
+{
+	if( !flow_control )
+		return;
+
+	// Give back credit in chunks rather than a message per snippet
+	credit_snippets_used++;
+	credit_bytes_used += size;
+	if( credit_snippets_used >= GSR_CREDIT_SNIPPETS / 4 ||
+			credit_bytes_used >= GSR_CREDIT_BYTES / 4 ) {
+		grant_credit( credit_snippets_used, credit_bytes_used );
+		credit_snippets_used = 0;
+		credit_bytes_used = 0;
+	}
+}
+
+void GUISocketReader:: grant_credit( int snippets, int bytes )
+{
+	char buf[20];
+	int length = TG_pack( buf, sizeof(buf), "I", bytes );
+
+	TG_send( socket_in, COLLECTOR_GRANT_CREDIT, snippets, length, buf );
+	TG_flush( socket_in );
+}
+
+void GUISocketReader:: count_message( int tag, int size, double start )
+{
+	double end = TG_time();
+	int slot = (tag >= 0 && tag < LAST_COMMAND_TAG) ?
+		tag : LAST_COMMAND_TAG;
+
+	ingest_stats->count[slot]++;
+	ingest_stats->bytes[slot] += size;
+	ingest_stats->time[slot] += end - start;
+	ingest_stats->messages++;
+	ingest_stats->total_bytes += size;
+	if( ingest_stats->first < 0.0 )
+		ingest_stats->first = start;
+	ingest_stats->last = end;
+}
+
+void GUISocketReader:: report_ingest_stats()
+{
+	if( ingest_stats == NULL || ingest_stats->messages == 0 )
+		return;
+
+	// Throughput is measured from the first message to the last, so
+	// it includes time the GUI spent on other things in between
+	double span = ingest_stats->last - ingest_stats->first;
+	fprintf( stderr, "TGclient: handled %ld messages (%.0f KB) in %.3f "
+			"sec: %.0f messages/sec, %.2f MB/sec\n",
+			ingest_stats->messages,
+			ingest_stats->total_bytes / 1024.0, span,
+			(span > 0.0) ? ingest_stats->messages / span : 0.0,
+			(span > 0.0) ? ingest_stats->total_bytes /
+			(1024.0 * 1024.0) / span : 0.0 );
+	fprintf( stderr, "TGclient: GUI blocked %.3f sec reading messages "
+			"in %ld stretches (longest %.1f ms)\n",
+			ingest_stats->blocked, ingest_stats->blocks,
+			ingest_stats->longest_block * 1000.0 );
+	fprintf( stderr, "TGclient: %-32s %9s %10s %10s %9s\n", "tag",
+			"count", "KB", "sec", "us/msg" );
+	for( int i = 0; i <= LAST_COMMAND_TAG; i++ ) {
+		if( ingest_stats->count[i] == 0 )
+			continue;
+		fprintf( stderr, "TGclient: %-32s %9ld %10.0f %10.3f %9.1f\n",
+				(i < LAST_COMMAND_TAG) ? command_strings[i] :
+				"(other)", ingest_stats->count[i],
+				ingest_stats->bytes[i] / 1024.0,
+				ingest_stats->time[i],
+				ingest_stats->time[i] * 1e6 /
+				ingest_stats->count[i] );
+	}
+}
+
+int GUISocketReader:: handle_message( int tag, int id, int size, char * buf )
+{
+	int retval = CONTINUE_THREAD;
+
 	switch( tag ) {
 		case DB_INSERT_ENTRY:
 			unpack_and_insert_entry( buf );
@@ -226,9 +606,22 @@ int GUISocketReader:: check_socket(int *sizeRead)
 		case DB_FILE_READ_COMPLETE:
 		  um->insertSourceFile( buf, id, size );
 			break;
+		case DB_FILE_LINE_COUNT:
+			um->insertWindowedSourceFile( buf, id );
+			break;
+		case DB_FILE_LINES:
+			um->insertSourceLines( buf, id );
+			break;
+		case DB_MESSAGE_BODY:
+			um->insertMessageBody( id, buf );
+			break;
 		case DB_STATIC_DATA_COMPLETE:
 			emit setProgramMessage( "Data read complete" );
 			break;
+		case DB_INPUT_COMPLETE:
+			// Only batch mode waits for this
+			retval = tag;
+			break;
  	        case DB_DECLARE_MESSAGE_FOLDER:
 		        unpack_and_declare_message_folder (buf);
 		        break;
@@ -238,6 +631,17 @@ int GUISocketReader:: check_socket(int *sizeRead)
 	        case DB_PROCESS_XML_SNIPPET:
 		        unpack_and_process_xml_snippet (buf);
 			break;
+		case DB_TGB_STRINGS:
+			um->addTGBStrings( id, buf, size );
+			break;
+		case DB_PROCESS_TGB_RECORDS:
+			um->processTGBRecords( buf, size );
+			break;
+		case DB_ENABLE_FLOW_CONTROL:
+			// Collector waits for us to ask for snippets
+			flow_control = TRUE;
+			grant_credit( GSR_CREDIT_SNIPPETS, GSR_CREDIT_BYTES );
+			break;
 		case DPCL_CHANGE_DIR_RESULT:
 			retval = unpack_cd_result( buf );
 			break;
@@ -297,8 +701,6 @@ int GUISocketReader:: check_socket(int *sizeRead)
 			break;
 	}
 
-	free( buf );
-
 	return retval;
 }
 
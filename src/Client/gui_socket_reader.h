@@ -14,6 +14,11 @@
 #define QUIT_THREAD 0
 #include <qobject.h>
 
+class QSocketNotifier;
+class GUIIngest;
+struct GUIIngestRecord;
+struct GSRIngestStats;
+
 #include "uimanager.h"
 #include "tg_program_state.h"
 
@@ -48,14 +53,27 @@ public:
 	//! Returns state of auto-reading: TRUE if enabled, FALSE if not
 	//!
 	bool check_auto_read() { return auto_reading; }
+	//! Stops the ingest thread (if any) from reading the socket,
+	//! whether or not auto-reading is enabled, so others (e.g.,
+	//! TGCollector at shutdown) can read it.  check_socket()
+	//! starts it again if needed.
+	void stop_reading();
+	//! Prints ingest throughput, handler time by tag, and how long
+	//! the GUI was blocked handling messages to stderr.  Only
+	//! measured if TG_INGEST_STATS was set when the reader was
+	//! created; prints nothing otherwise.
+	void report_ingest_stats();
 
 public slots:
 	//! Reads an incoming message (and blocks until one becomes
 	//! available), then processes it according the the message tag
         //! If sizeRead != NULL, message size is returned
+	//! (With USE_INGEST_THREAD, the message comes from the ingest
+	//! thread, already decoded if it was worth doing there.)
 	int check_socket(int *sizeRead = NULL);
-	//! Determines whether a message is pending, and calls check_socket()
-	//! if it is
+	//! Processes pending messages (by calling check_socket()) for a
+	//! limited time, so the GUI stays responsive.  With auto-reading
+	//! enabled, this is called whenever new data arrives.
 	void get_pending_data();
 signals:
 	//! Indicates whether the target program is loaded and runnable
@@ -77,6 +95,24 @@ signals:
 	//!
 	void readerSocketClosed();
 protected:
+	//! Processes one message according to its tag; returns the
+	//! same values as check_socket()
+	int handle_message( int tag, int id, int size, char * buf );
+	//! Returns 1 if messages are waiting, 0 if not, or -1 if
+	//! the socket has closed and no messages remain
+	int data_queued();
+	//! Returns the number of messages waiting
+	int queue_depth();
+	//! Returns TRUE for the messages that use up the Collector's credit
+	//! (XML snippets and .tgb strings and records)
+	static bool is_credited( int tag );
+	//! Notes that a snippet of size bytes has been processed and
+	//! grants the Collector more credit when enough has been used
+	void credit_used( int size );
+	//! Sends a COLLECTOR_GRANT_CREDIT message
+	void grant_credit( int snippets, int bytes );
+	//! Adds one handled message to the ingest statistics
+	void count_message( int tag, int size, double start );
 	//! Process a request to insert a database entry (corresponding
 	//! to a location in the target program.)
 	void unpack_and_insert_entry( char * buf );
@@ -153,11 +189,22 @@ protected:
 	void unpack_subdir_list( char * buf );
 	//! Unpack a search path and send it to a SearchPathDialog
 	void unpack_search_path( char * buf );
-	//! Inherited virtual function that is executed automatically
-	//! whenever the Application has no pending events to process.
-	//! It calls get_pending_data().
+	//! Inherited virtual function that is executed by the polling
+	//! timer (only used if the socket library can't supply a
+	//! descriptor to watch).  It calls get_pending_data().
 	void timerEvent( QTimerEvent * );
+	//! Arranges for get_pending_data() to run again once pending
+	//! GUI events have been handled
+	void schedule_pending_data();
+
+protected slots:
+	//! Resumes get_pending_data() after it ran out of time
+	void continue_pending_data();
+	//! Processes the messages held back while the UIManager wrote a
+	//! snapshot (see UIManager::holdingUpdates())
+	void release_held();
 
+protected:
         /* MS/START - dynamic module loading */
         void unpack_and_countDynamicModules( char * buf );
         void unpack_and_recordDynamicModules( char * buf );
@@ -170,6 +217,35 @@ private:
 	bool auto_reading;
 	UIManager * um;
 	int timer_id;
+	//! Watches for incoming data when auto-reading (NULL if polling)
+	QSocketNotifier * notifier;
+	//! TRUE while a call to continue_pending_data() is pending
+	bool continue_scheduled;
+	//! Running estimate of the time (in ms) to process one message
+	double msg_cost;
+	//! Nesting depth of check_socket(); only the outermost call
+	//! may use the zero-copy receive buffer
+	int recv_depth;
+	//! Background receiving and decoding (NULL unless built
+	//! with USE_INGEST_THREAD)
+	GUIIngest * ingest;
+	//! Records taken from ingest but not yet processed
+	GUIIngestRecord * batch;
+	int batch_count;
+	//! TRUE once the Collector has said it waits for credit
+	bool flow_control;
+	//! Snippets and bytes processed since credit was last granted
+	int credit_snippets_used;
+	int credit_bytes_used;
+	//! Ingest statistics (NULL unless TG_INGEST_STATS is set)
+	GSRIngestStats * ingest_stats;
+	//! Messages held back while a snapshot was written, oldest first
+	GUIIngestRecord * held_head;
+	GUIIngestRecord * held_tail;
+	//! Returns TRUE if a message with this tag must be held back
+	bool must_hold( int tag );
+	//! Adds rec to the held messages
+	void hold( GUIIngestRecord * rec );
 
         /* MS/START - dynamic module loading */
         int number_of_modules;
@@ -0,0 +1,264 @@
+// messagebodycache.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+
+#include <qapplication.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command_tags.h"
+#include "messagebodycache.h"
+#include "tg_error.h"
+#include "tg_socket.h"
+#include "tg_time.h"
+
+MessageBodyCache::MessageBodyCache (int maxBytes_) :
+    // The Body structs are freed here, since they own two buffers
+    bodyTable ("messageBodies", NoDealloc, 0),
+    requested ("requestedBodies"),
+    newest (NULL), oldest (NULL), bytes (0), maxBytes (maxBytes_),
+    sock (-1)
+{
+}
+
+MessageBodyCache::~MessageBodyCache ()
+{
+    while (oldest != NULL)
+    {
+	Body *body = oldest;
+	unlinkBody (body);
+	free (body->text);
+	free (body->line);
+	delete body;
+    }
+}
+
+// Returns line lineNo (starting at 0) of body bodyIndex, or "" if the body
+// has fewer lines.  Fetches the body from the Collector if necessary.
+const char *MessageBodyCache::bodyLine (int bodyIndex, int lineNo)
+{
+    Body *body = bodyTable.findEntry (bodyIndex);
+    if (body == NULL)
+	body = fetchBody (bodyIndex);
+
+    // Keep the most recently used body at the front of the list
+    if (body != newest)
+    {
+	unlinkBody (body);
+	linkNewest (body);
+    }
+
+    if ((lineNo < 0) || (lineNo >= body->lineCount))
+	return ("");
+    return (body->line[lineNo]);
+}
+
+// Asks for body bodyIndex, without waiting for it (or flushing)
+void MessageBodyCache::requestBody (int bodyIndex)
+{
+    // Only one request per body, however many callers are waiting on it
+    if ((sock >= 0) && (bodyTable.findEntry (bodyIndex) == NULL) &&
+	!requested.add (bodyIndex))
+    {
+	TG_send (sock, COLLECTOR_READ_MESSAGE_BODY, bodyIndex, 0, NULL);
+    }
+}
+
+void MessageBodyCache::flushRequests ()
+{
+    if (sock >= 0)
+	TG_flush (sock);
+}
+
+// Requests body bodyIndex from the Collector and processes events until
+// it arrives.  Like FileCollection, this runs its own event loop, so
+// another request may come in (and be satisfied) while this one waits.
+// If the Collector doesn't answer, a note saying so is cached instead.
+MessageBodyCache::Body *MessageBodyCache::fetchBody (int bodyIndex)
+{
+    // Also sends any requests made with requestBody()
+    requestBody (bodyIndex);
+    flushRequests ();
+
+    double start = TG_time ();
+    Body *body;
+    while ((body = bodyTable.findEntry (bodyIndex)) == NULL)
+    {
+	if ((sock < 0) || (TG_time () - start > TG_MESSAGE_BODY_TIMEOUT))
+	{
+	    insertBody (bodyIndex, "(Message body not available: "
+			"no reply from the collector)");
+	    // Ask again if the body is needed after the note is evicted
+	    requested.remove (bodyIndex);
+	    continue;
+	}
+
+	// Keep the GUI responsive (and read the body when it comes)
+	qApp->processEvents ();
+    }
+
+    return (body);
+}
+
+// Inserts the text of body bodyIndex, split into lines the way
+// UIManager::addMessage() splits message text.  Bodies already cached
+// are left alone.
+void MessageBodyCache::insertBody (int bodyIndex, const char *text)
+{
+    requested.remove (bodyIndex);
+    if (bodyTable.findEntry (bodyIndex) != NULL)
+	return;
+
+    Body *body = new Body;
+    TG_checkAlloc (body);
+    body->index = bodyIndex;
+
+    // Every newline ends a line, plus a last line not ending in one
+    int length = strlen (text);
+    int lineCount = 0;
+    for (const char *ptr = text; *ptr != 0; ptr++)
+    {
+	if (*ptr == '\n')
+	    lineCount++;
+    }
+    if ((length > 0) && (text[length-1] != '\n'))
+	lineCount++;
+
+    body->text = (char *) malloc (length + 1);
+    TG_checkAlloc (body->text);
+    memcpy (body->text, text, length + 1);
+    body->line = (char **) malloc ((lineCount + 1) * sizeof (char *));
+    TG_checkAlloc (body->line);
+
+    int lineNo = 0;
+    char *lineStart = body->text;
+    for (char *ptr = body->text; *ptr != 0; ptr++)
+    {
+	if (*ptr == '\n')
+	{
+	    *ptr = 0;
+	    body->line[lineNo++] = lineStart;
+	    lineStart = ptr + 1;
+	}
+    }
+    if (*lineStart != 0)
+	body->line[lineNo++] = lineStart;
+    body->lineCount = lineNo;
+
+    body->bytes = length + 1 + (lineCount + 1) * sizeof (char *) +
+	sizeof (Body);
+    bytes += body->bytes;
+
+    bodyTable.addEntry (bodyIndex, body);
+    linkNewest (body);
+    evictBodies ();
+}
+
+// Removes body from the LRU list
+void MessageBodyCache::unlinkBody (Body *body)
+{
+    if (body->newer != NULL)
+	body->newer->older = body->older;
+    else
+	newest = body->older;
+    if (body->older != NULL)
+	body->older->newer = body->newer;
+    else
+	oldest = body->newer;
+}
+
+// Puts body at the front of the LRU list
+void MessageBodyCache::linkNewest (Body *body)
+{
+    body->newer = NULL;
+    body->older = newest;
+    if (newest != NULL)
+	newest->newer = body;
+    else
+	oldest = body;
+    newest = body;
+}
+
+// Frees the least recently used bodies until the rest fit in maxBytes,
+// always keeping the newest (which a caller may be about to use)
+void MessageBodyCache::evictBodies ()
+{
+    while ((bytes > maxBytes) && (oldest != newest))
+    {
+	Body *body = oldest;
+	unlinkBody (body);
+	bodyTable.deleteEntry (body->index);
+	bytes -= body->bytes;
+	free (body->text);
+	free (body->line);
+	delete body;
+    }
+}
+
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
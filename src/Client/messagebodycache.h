@@ -0,0 +1,155 @@
+//! \file messagebodycache.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Message bodies left in the input file by TGxmlserver -lazy.  The Client
+// gets only each body's index and line count up front; the text is
+// requested when a message is opened (or otherwise needed), and the
+// most recently used bodies are kept here until they no longer fit in
+// the cache.
+
+#ifndef MESSAGEBODYCACHE_H
+#define MESSAGEBODYCACHE_H
+
+// The symbol table headers below need this.
+#include <stdio.h>
+#include <inttable.h>
+#include <intset.h>
+
+//! Bytes of message body text kept before the least recently used
+//! bodies are thrown away (they are fetched again if needed)
+#define TG_MESSAGE_BODY_CACHE_BYTES (8 << 20)
+
+//! Seconds to wait for the Collector to send a body before giving up
+#define TG_MESSAGE_BODY_TIMEOUT 30.0
+
+//! Bodies to have requested ahead of the one being used, when many
+//! are read in order (e.g., for a snapshot)
+#define TG_MESSAGE_BODY_PREFETCH 64
+
+//! LRU cache of message bodies fetched from the Collector.
+class MessageBodyCache
+{
+public:
+    //! Keeps up to maxBytes of body text (but always the body last used)
+    MessageBodyCache (int maxBytes = TG_MESSAGE_BODY_CACHE_BYTES);
+
+    //! Frees all the cached bodies
+    ~MessageBodyCache ();
+
+    //! Sets the socket to be used for requesting bodies.
+    void setRemoteSocket (int remoteSocket) {sock = remoteSocket;}
+
+    //! Returns line lineNo (starting at 0) of body bodyIndex, or ""
+    //! if the body has fewer lines.  If the body isn't cached, this
+    //! requests it and does not return until it has arrived (or the
+    //! request timed out), processing events while it waits.
+    //! The pointer is only good until the next call.
+    const char *bodyLine (int bodyIndex, int lineNo);
+
+    //! Asks the Collector for body bodyIndex (unless it is cached or
+    //! already asked for) without waiting for it.  Requests are
+    //! buffered until flushRequests() or bodyLine() sends them.
+    void requestBody (int bodyIndex);
+
+    //! Sends any requests buffered by requestBody()
+    void flushRequests ();
+
+    //! Inserts the text of body bodyIndex (normally in response to
+    //! bodyLine()'s request).  text is copied.
+    void insertBody (int bodyIndex, const char *text);
+
+private:
+    //! One body, split into lines ('\n' replaced by terminators)
+    struct Body
+    {
+	int index;
+	char *text;
+	char **line;
+	int lineCount;
+	int bytes;		//!< Charged against maxBytes
+	Body *newer;		//!< LRU list, most recently used first
+	Body *older;
+    };
+
+    Body *fetchBody (int bodyIndex);
+    void unlinkBody (Body *body);
+    void linkNewest (Body *body);
+    void evictBodies ();
+
+    IntTable<Body> bodyTable;
+    IntSet requested;		//!< Bodies asked for but not yet here
+    Body *newest;
+    Body *oldest;
+    int bytes;
+    int maxBytes;
+    int sock;
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -798,6 +798,9 @@ void MessageView::updateMessageDisplay (const QString &folderTag)
 	curRecordId++;
 	int bodyStartId = curRecordId;
 
+	// Bodies still with the collector are filled in when opened
+	bool bodyIsRef = um->messageBodyIsRef (folderTag, messageTag);
+
 	// Close the tree by default (for now), if have at least one child
 	// Also, put all "children" lines below it here at once
 	if (lineCount > 1)
@@ -816,7 +819,8 @@ void MessageView::updateMessageDisplay (const QString &folderTag)
 	    messageGrid->placeRecordId (bodyStartId, bodyStartId+lineCount-2,
 					headerRecordId, headerRecordId);
 
-	    // If message in open folder, open it now
+	    // If message in open folder, open it now (fetching its body
+	    // below, once this update is done)
 	    if (openMessages->in(messageIndex))
 	    {
 		messageGrid->setTreeOpen (headerRecordId, TRUE);
@@ -844,6 +848,9 @@ void MessageView::updateMessageDisplay (const QString &folderTag)
 	    // Map this recordId to the messageIndex
 	    recordId2messageIndex.addEntry (bodyRecordId, messageIndex);
 
+	    if (bodyIsRef)
+		continue;
+
 	    // Get a pointer to the actual message line (for efficiency)
 	    const char *lineRef = um->messageTextLineRef (folderTag, messageTag,
 							  lineNo);
@@ -881,12 +888,25 @@ void MessageView::updateMessageDisplay (const QString &folderTag)
 
     // Save previous lineCount for use in tests below
     int prevLineCount = displayedLineCount;
+    int prevMessageCount = displayedMessageCount;
 
     // Update displayedLineCount and displayedMessageCount now that we
     // are done
     displayedLineCount = totalLines;
     displayedMessageCount = messageCount;
 
+    // Fetch the bodies of open messages now that the display is
+    // consistent (events are processed while they are fetched)
+    for (int messageIndex = prevMessageCount; messageIndex < messageCount;
+	 messageIndex ++)
+    {
+	if (openMessages->in(messageIndex))
+	{
+	    loadMessageBody (folderTag, messageIndex,
+			     messageIndex2recordId.findEntry (messageIndex));
+	}
+    }
+
     // Update the display width so all text is visible
     updateMessageDisplayWidth();
 
@@ -914,6 +934,71 @@ void MessageView::updateMessageDisplay (const QString &folderTag)
 #endif
 }
 
+// Copies the body of a message still with the collector (see
+// UIManager::messageBodyIsRef()) into the lines below its header,
+// fetching it if necessary.  Does nothing for other messages.
+void MessageView::loadMessageBody (const QString &folderTag, 
+				   int messageIndex, int headerRecordId)
+{
+    // The folder may have been switched while an earlier body was fetched
+    if (displayedMessageFolder != folderTag)
+	return;
+
+    QString messageTag = um->messageAt (folderTag, messageIndex);
+    if (!um->messageBodyIsRef (folderTag, messageTag))
+	return;
+
+    int lineCount = um->messageTextLineCount (folderTag, messageTag);
+    for (int lineNo = 1; lineNo < lineCount; lineNo++)
+    {
+	// Only good until the next line is asked for, so copy it
+	const char *line = um->messageTextLineRef (folderTag, messageTag,
+						   lineNo);
+
+	// Events are processed while the body is fetched (on the first
+	// line), so make sure the message is still where it was
+	if ((lineNo == 1) && 
+	    ((displayedMessageFolder != folderTag) ||
+	     (messageIndex2recordId.findEntry (messageIndex) != 
+	      headerRecordId)))
+	{
+	    return;
+	}
+
+	int bodyRecordId = headerRecordId + lineNo;
+	messageGrid->setCellText (bodyRecordId, 0, line);
+
+	// Update longest message body line, if necessary
+	int bodyLen = strlen (line);
+	if (bodyLen > maxBodyLen)
+	{
+	    maxBodyId = bodyRecordId;
+	    maxBodyLen = bodyLen;
+	    
+	    // Mark that display width needs to be recalculated
+	    displayedMaxWidth = -1;
+	}
+    }
+}
+
+// Frees the lines copied by loadMessageBody() (when the message is 
+// closed), except the longest body line, which sets the display width
+void MessageView::unloadMessageBody (const QString &folderTag, 
+				     int messageIndex, int headerRecordId)
+{
+    QString messageTag = um->messageAt (folderTag, messageIndex);
+    if (!um->messageBodyIsRef (folderTag, messageTag))
+	return;
+
+    int lineCount = um->messageTextLineCount (folderTag, messageTag);
+    for (int lineNo = 1; lineNo < lineCount; lineNo++)
+    {
+	int bodyRecordId = headerRecordId + lineNo;
+	if (bodyRecordId != maxBodyId)
+	    messageGrid->setCellTextRef (bodyRecordId, 0, "");
+    }
+}
+
 // Selects a default message, if one not already selected
 // Used by messageViewer->customEvent() to selected the
 // first message if the user hasn't already selected one
@@ -1289,6 +1374,9 @@ void MessageView::messageDoubleClickedHandler (int recordId, int /*attrId*/,
 	// Remove from set of open messages
 	openMessages->remove(messageIndex);
 
+	// Drop the copy of a body fetched when it was opened
+	unloadMessageBody (displayedMessageFolder, messageIndex, recordId);
+
 	// Make sure header visible, minimum margin
 	messageGrid->scrollCellIntoView (recordId, 0, 0);
 	
@@ -1296,6 +1384,14 @@ void MessageView::messageDoubleClickedHandler (int recordId, int /*attrId*/,
     // Otherwise, just open the tree
     else
     {
+	// Fetch the body first, if it is still with the collector
+	QString folderTag = displayedMessageFolder;
+	loadMessageBody (folderTag, messageIndex, recordId);
+	if ((displayedMessageFolder != folderTag) ||
+	    (messageIndex2recordId.findEntry (messageIndex) != recordId))
+	    return;
+	updateMessageDisplayWidth();
+
 	messageGrid->setTreeOpen(recordId, TRUE);
 
 	// Add to set of open messages
@@ -131,6 +131,17 @@ private:
     //! Updates the message display for a message folder
     void updateMessageDisplay (const QString &folderTag);
 
+    //! Copies the body of a message still with the collector (see
+    //! UIManager::messageBodyIsRef()) into the lines below its header,
+    //! fetching it if necessary.  Does nothing for other messages.
+    void loadMessageBody (const QString &folderTag, int messageIndex,
+			  int headerRecordId);
+
+    //! Frees the lines copied by loadMessageBody() (when the message
+    //! is closed)
+    void unloadMessageBody (const QString &folderTag, int messageIndex,
+			    int headerRecordId);
+
     //! Returns selected line out of a multiline string (using newlines)
     //! where lineNo == 0 returns the first line.  Returns TRUE if lineNo
     //! exists in string, FALSE otherwise
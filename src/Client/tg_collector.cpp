@@ -213,6 +213,9 @@ TGCollector:: ~TGCollector()
 
 		if( tag == DPCL_SAYS_QUIT || retval == -1 ) {
 			cerr << "Done." << endl;
+			if( getenv( "TG_SOCKET_STATS" ) != NULL ) {
+				TG_report_socket_stats( sock, "TGclient" );
+			}
 		} else {
 			cerr << endl <<
 			"Giving up!  Wait a minute or two, then" << endl <<
@@ -503,13 +506,16 @@ void TGCollector:: hasStderrData( int )
 	}
 	if( doPrompt ) {
 		cerr << data;
-		mb = new QMessageBox( remoteHostName + " login",
-				"Please enter requested information on "
-				"the command line.",
-				QMessageBox::Information,
-				QMessageBox::Ok, QMessageBox::NoButton,
-				QMessageBox::NoButton, 0, 0, FALSE );
-		mb->show();
+		// (A batch client has no display for the message box)
+		if( qApp->type() != QApplication::Tty ) {
+			mb = new QMessageBox( remoteHostName + " login",
+					"Please enter requested information "
+					"on the command line.",
+					QMessageBox::Information,
+					QMessageBox::Ok, QMessageBox::NoButton,
+					QMessageBox::NoButton, 0, 0, FALSE );
+			mb->show();
+		}
 	} else {
 		// For testing:
 		cout << "collector stderr: " << data << endl;
@@ -609,6 +615,10 @@ void TGCollector:: listenerConnected( int socket )
 		qWarning( "Couldn't make client's socket nonblocking" );
 	}
 
+	// The collector offers shared memory or compression for large
+	// messages first thing; take what we can
+	TG_accept_options( sock );
+
 	status = Connected;
 }
 
@@ -11,6 +11,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <qstring.h>
 
@@ -19,14 +20,15 @@ void TGParseOpts( int argc, char * argv[], QString& remoteHost,
 		  QString& loginName, QString& connectPort, QString& remoteDir,
 		  QString & collectorProg,
 		  int& remoteCount, char **& remoteArgs, bool& isParallel,
-		  bool& heartbeat, QPtrVector<QString>& collargs )
+		  bool& heartbeat, QPtrVector<QString>& collargs,
+		  QString& batchSnapshot, QString& batchReport )
 {
 	int c;
 	QString *tmp;
 
 	// Loop through options until we find the target program name;
 	// everything after that is considered to be options for the target.
-	while( (c = getopt( argc, argv, "r:l:d:c:p:Ph:m:")) != EOF ) {
+	while( (c = getopt( argc, argv, "r:l:d:c:p:Ph:m:b:o:")) != EOF ) {
 		switch (c) {
 		case 'r':
 			remoteHost = optarg;
@@ -54,14 +56,25 @@ void TGParseOpts( int argc, char * argv[], QString& remoteHost,
 			tmp=new QString(optarg);
 		        collargs.insert(0,tmp);
 		        break;
+		case 'b':
+			batchSnapshot = optarg;
+			break;
+		case 'o':
+			batchReport = optarg;
+			break;
 		case '?':
 			fprintf( stderr,
 				"usage: %s [-r <remote-host> [-l <login-name>] "
 				"[-p <ssh-port>]]\n"
 				 "      [-d <remote-directory>] "
 				 "[-c <collector>] [-m <dynTG-probe-to-load>]\n"
-				 "      [-P] [-h]"
-				" -- <target-program> [<target-options>]\n",
+				 "      [-P] [-h] [-b <snapshot-file>] "
+				 "[-o <report-file>]"
+				" -- <target-program> [<target-options>]\n"
+				 "  -b and -o read all the data without opening "
+				 "a window, then write\n"
+				 "  a snapshot and/or a text report "
+				 "(- for stdout) and exit\n",
 				argv[0] );
 			break;
 		}
@@ -71,6 +84,20 @@ void TGParseOpts( int argc, char * argv[], QString& remoteHost,
 	remoteCount = argc - optind;
 	remoteArgs = argv + optind;
 }
+
+bool TGBatchRequested( int argc, char * argv[] )
+{
+	// Only the separate-argument forms (-b file, -o file) are
+	// recognized here, since Qt has options such as -bg of its own
+	for( int i = 1; i < argc - 1; i++ ) {
+		if( strcmp( argv[i], "--" ) == 0 )
+			break;
+		if( strcmp( argv[i], "-b" ) == 0 ||
+				strcmp( argv[i], "-o" ) == 0 )
+			return TRUE;
+	}
+	return FALSE;
+}
 /******************************************************************************
 COPYRIGHT AND LICENSE
 
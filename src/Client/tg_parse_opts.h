@@ -19,7 +19,12 @@ void TGParseOpts( int argc, char * argv[], QString& remoteHost,
 		QString& loginName, QString& connectoPort,
 		QString& remoteDir, QString& collectorProg,
 		int& remoteCount, char **& remoteArgs, bool& isParallel,
-		bool& heartbeat, QPtrVector<QString>& collargs );
+		bool& heartbeat, QPtrVector<QString>& collargs,
+		QString& batchSnapshot, QString& batchReport );
+
+//! Returns TRUE if the arguments ask for batch mode (-b or -o), which
+//! has to be known before the QApplication is created.
+bool TGBatchRequested( int argc, char * argv[] );
 
 #endif // TG_PARSE_OPTS_H
 /******************************************************************************
@@ -8,15 +8,18 @@ SOURCES += gui_main.cpp cellgrid.cpp ../Utils/md.c ../Utils/l_alloc_new.c \
         uimanager.cpp ../Utils/int_symbol.c ../Utils/int_array_symbol.c \
         ../Utils/index_symbol.c \
         ../Utils/string_symbol.c ../Utils/tg_socket.c gui_socket_reader.cpp \
+	../Utils/tg_compress.c \
+	gui_ingest.cpp \
 	gui_action_sender.cpp ../Utils/heapsort.c \
 	tg_collector.cpp ../Utils/tg_error.c \
 	tg_parse_opts.cpp tg_gui_listener.cpp celllayout.cpp \
 	treeview.cpp mainview.cpp messageview.cpp \
 	tracebackview.cpp tabtracebackview.cpp \
         messageviewer.cpp \
-	cellgrid_searcher.cpp filecollection.cpp \
+	cellgrid_searcher.cpp filecollection.cpp messagebodycache.cpp \
 	../Utils/tg_pack.cpp ../Utils/tg_time.c ../Utils/messagebuffer.cpp \
-        ../Utils/command_tags.cpp \
+        ../Utils/command_tags.cpp ../Utils/xml_token_table.cpp \
+	../Utils/tgb_format.cpp ../Utils/number_scanner.cpp \
 	../Utils/tg_swapbytes.c ./Dialogs/inst_dialog.cpp \
 	./Dialogs/search_path_dialog.cpp ./Dialogs/drag_list_view.cpp \
 	./Dialogs/dir_view_item.cpp  ./Dialogs/path_view_item.cpp \
@@ -29,11 +32,13 @@ celllayout.h ../Utils/intset.h tg_gui_listener.h ../Utils/tabledef.h \
 tg_program_state.h ../Utils/l_punt.h ../Utils/tg_types.h \
 gui_action_sender.h mainview.h \
 messageview.h messageviewer.h tracebackview.h tabtracebackview.h \
-gui_socket_reader.h ../Utils/md.h ../Utils/heapsort.h \
+gui_socket_reader.h gui_ingest.h ../Utils/md.h ../Utils/heapsort.h \
 treeview.h ../Utils/int_array_symbol.h ../Utils/string_symbol.h uimanager.h \
-cellgrid_searcher.h filecollection.h \
+cellgrid_searcher.h filecollection.h messagebodycache.h \
 ../Utils/command_tags.h ../Utils/tg_pack.h ../Utils/tg_time.h \
 ../Utils/tg_error.h ../Utils/tg_socket.h ../Utils/tg_typetags.h \
+../Utils/tg_compress.h ../Utils/xml_token_table.h ../Utils/tgb_format.h \
+../Utils/number_scanner.h \
 ../Utils/tg_inst_point.h ../Utils/tg_swapbytes.h \
 ../Utils/messagebuffer.h \
 ./Dialogs/inst_dialog.h ./Dialogs/search_path_dialog.h \
@@ -54,6 +59,12 @@ CONFIG += qt
 
 DEFINES += USE_READ_THREAD
 
+# Uncomment to receive messages from the collector on a second thread
+# of our own (see gui_ingest.h).  Off by default: XML snippets and .tgb
+# records still have to be parsed on the GUI thread, and USE_READ_THREAD
+# already frames messages off the GUI thread, so it only adds a copy.
+#DEFINES += USE_INGEST_THREAD
+
 INCLUDEPATH += . ../Utils ./Dialogs
 
 DEPENDPATH += . ../Utils ./Dialogs
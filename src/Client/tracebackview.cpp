@@ -24,6 +24,10 @@
 #include "tg_error.h"
 #include "messagebuffer.h"
 
+// Source lines shown around the selected line for files too big to
+// hold whole (see FileCollection::insertWindowedFile)
+#define TRACEBACK_WINDOW_LINES 2000
+
 TracebackView::TracebackView(UIManager *m, CellGridSearcher * grid_searcher,
 			     bool showTracebackTitle,
 			     QWidget *parent,  const char *name) :
@@ -118,6 +122,8 @@ TracebackView::TracebackView(UIManager *m, CellGridSearcher * grid_searcher,
     // no file and line currently being displayed
     displayedFileName = "" ;
     displayedLineNo = -1;
+    displayedFirstLine = 1;
+    displayedLastLine = 0;
 
     // Initially no longest line, mark with -1
     maxSourceId = -1;
@@ -982,7 +988,8 @@ void TracebackView::showFileLine (const char *fileName, int lineNo)
     // Undo last highlighting, if present
     if (displayedLineNo > 0)
     {
-	tracebackView->setCellStyle (displayedLineNo-1, 0, CellStyleInvalid);
+	tracebackView->setCellStyle (displayedLineNo-displayedFirstLine, 0,
+				     CellStyleInvalid);
 
 	// Mark it as cleared
 	displayedLineNo = -1;
@@ -1070,15 +1077,38 @@ void TracebackView::showFileLine (const char *fileName, int lineNo)
     // Handle case where source exists
     else
     {
+	// Show every line, unless the file is too big to hold whole;
+	// then show just the lines around lineNo
+	int firstLine = 1;
+	int endLine = lastLine;
+	bool windowed = um->isSourceWindowed (fileName);
+	if (windowed)
+	{
+	    firstLine = lineNo - TRACEBACK_WINDOW_LINES/2;
+	    if (firstLine + TRACEBACK_WINDOW_LINES - 1 > lastLine)
+		firstLine = lastLine - TRACEBACK_WINDOW_LINES + 1;
+	    if (firstLine < 1)
+		firstLine = 1;
+	    endLine = firstLine + TRACEBACK_WINDOW_LINES - 1;
+	    if (endLine > lastLine)
+		endLine = lastLine;
+	}
+
 	// Display source, if not already displaying source for the file
-	if (displayedFileName.compare(fileName) != 0)
+	// (and, for big files, lineNo)
+	if ((displayedFileName.compare(fileName) != 0) ||
+	    (windowed && ((lineNo < displayedFirstLine) ||
+			  (lineNo > displayedLastLine))))
 	{
 	    // Clear the existing grid contents
 	    tracebackView->clearGridContents();
 
+	    displayedFirstLine = firstLine;
+	    displayedLastLine = endLine;
+
 //	    TG_timestamp ("Resizing traceback grid start\n");
 	    // Create one line per source line
-	    tracebackView->resizeGrid(lastLine, 1);
+	    tracebackView->resizeGrid(endLine - firstLine + 1, 1);
 //	    TG_timestamp ("Resizing traceback grid end\n");
 	    
 	    // Mark that the width will need to be update
@@ -1102,7 +1132,7 @@ void TracebackView::showFileLine (const char *fileName, int lineNo)
 
 //	    TG_timestamp ("Writing in source for %s start\n", fileName);
 	    // Loop through source, displaying it
-	    for (int lineNum = 1; lineNum <= lastLine; lineNum ++)
+	    for (int lineNum = firstLine; lineNum <= endLine; lineNum ++)
 	    {
 		// Get the source line text
 		line = um->getSourceLine (fileName, lineNum);
@@ -1112,26 +1142,28 @@ void TracebackView::showFileLine (const char *fileName, int lineNo)
 		int len = lineBuf.sprintf ("%6d: %s", lineNum, line.latin1());
 
 		// Display it in the only column
-		tracebackView->setCellText (lineNum-1, 0, lineBuf.contents());
+		tracebackView->setCellText (lineNum-firstLine, 0,
+					    lineBuf.contents());
 
 		// If longest line, record length and recordId
 		if (len > maxSourceLen)
 		{
 		    maxSourceLen = len;
-		    maxSourceId = lineNum-1;
+		    maxSourceId = lineNum-firstLine;
 		}
 	    }
 //	    TG_timestamp ("Writing in source for %s end\n", fileName);
 	}
 
 	// Highline the source line specified
-	tracebackView->setCellStyle (lineNo-1, 0, selectedLineStyle);
+	tracebackView->setCellStyle (lineNo-displayedFirstLine, 0,
+				     selectedLineStyle);
 
 	// Update the display width so all text is visible
 	updateTracebackDisplayWidth();
 
 	// Scroll the cell with the lineNo into view
-	tracebackView->centerRecordIdInView (lineNo-1);
+	tracebackView->centerRecordIdInView (lineNo-displayedFirstLine);
 
 	// Indicate what fileName and line we are displaying
 	displayedFileName = fileName;
@@ -130,6 +130,11 @@ private:
     QString displayedFileName;
     int displayedLineNo;
 
+    //! Source line in the first row (1, unless the file is too big to
+    //! hold whole and only the lines around displayedLineNo are shown)
+    int displayedFirstLine;
+    int displayedLastLine;
+
     //! Maximum width of all the source currently displayed
     int maxSourceWidth;
 
@@ -28,9 +28,15 @@
 #include <qsettings.h>
 #include <math.h>
 #include <string.h>
+#include <stdlib.h>
 #include "tg_time.h"
 #include <qxml.h>
+#include "xml_token_table.h"
+#include "tgb_format.h"
+#include "number_scanner.h"
+#include <qvaluevector.h>
 #include <ctype.h>
+#include <limits.h>
 
 // Should put this in a global place
 const QString APP_KEY = "/Tool Gear/";
@@ -62,8 +68,14 @@ UIManager::UIManager(QApplication* app, const char *desc,
     // Create unknownXML table that frees levelmask on delete
     unknownXMLTable("unknownXML", DeleteData, 0),
 
-    // Create xmlToken table that frees XML_Token structures on delete
-    xmlTokenTable("xmlToken", DeleteData, 0),
+    // Streaming XML parser created by the first parseXMLSnippet()
+    xmlStream(NULL),
+
+    // Set TG_XML_PER_SNIPPET to parse each snippet with a new parser
+    xmlPerSnippet(getenv("TG_XML_PER_SNIPPET") != NULL),
+
+    // .tgb string table and XML handler created by the first strings
+    tgbStream(NULL),
 
     a(app),   
 
@@ -75,6 +87,8 @@ UIManager::UIManager(QApplication* app, const char *desc,
 
     remoteSocket(-1), 
 
+    snapshotDepth(0),
+
 
 #if 0
     // Initially not currently reading a file
@@ -113,7 +127,11 @@ UIManager::UIManager(QApplication* app, const char *desc,
 
     // Create MessageFolderInfo table that deletss MessageFolderInfo 
     // struct on delete
-    messageFolderInfoTable("messageFolderInfo", DeleteData, 0)
+    messageFolderInfoTable("messageFolderInfo", DeleteData, 0),
+
+    // Create site data table that deletes each column's table of
+    // SiteDataInfo structs on delete
+    siteDataTable("siteData", DeleteData, 0)
 
 
 {
@@ -406,6 +424,31 @@ UIManager::UIManager(QApplication* app, const char *desc,
     // calling UIManager::addAboutText().
     aboutText = "";
 
+    // Fonts need a display, which a batch (-b/-o) client doesn't have
+    // (and has no use for fonts anyway)
+    if (QApplication::type() != QApplication::Tty)
+	initFonts ();
+
+#if 0
+    // Initialize the sequence of keys
+    nextPendingFileInfoKey = 0;
+#endif
+    // Create a souce collection object, if it doesn't already exist.
+    // A single collection is shared among all instances of UIManagers.
+    if( sourceCollection == NULL ) {
+        sourceCollection = new FileCollection();
+	TG_checkAlloc(sourceCollection);
+    }
+
+    connect( sourceCollection, SIGNAL( cleared() ),
+		    this, SIGNAL( clearedSourceCache() ) );
+
+
+}
+
+// Sets mainFont and labelFont from the settings file and defaults
+void UIManager::initFonts ()
+{
 #if defined(TG_LINUX)
     // Courier doesn't look good on linux
 //    mainFont = QFont("console", 12);
@@ -444,22 +487,6 @@ UIManager::UIManager(QApplication* app, const char *desc,
 
     // Set the labelFont to the default label font
     labelFont = QApplication::font();
-
-#if 0
-    // Initialize the sequence of keys
-    nextPendingFileInfoKey = 0;
-#endif
-    // Create a souce collection object, if it doesn't already exist.
-    // A single collection is shared among all instances of UIManagers.
-    if( sourceCollection == NULL ) {
-        sourceCollection = new FileCollection();
-	TG_checkAlloc(sourceCollection);
-    }
-
-    connect( sourceCollection, SIGNAL( cleared() ),
-		    this, SIGNAL( clearedSourceCache() ) );
-
-
 }
 
 /* Create delete routine that can be called from the "C" routine
@@ -471,6 +498,10 @@ void UIManager::deleteFuncInfo (FuncInfo *ptr)
 }
 
 // Deletes MD database and frees associated data
+// Defined after UIXMLStream and UITGBStream below
+static void deleteUIXMLStream (UIXMLStream *stream);
+static void deleteUITGBStream (UITGBStream *stream);
+
 UIManager::~UIManager()
 {
 #if 0
@@ -487,6 +518,10 @@ UIManager::~UIManager()
     // Pass "static" deleteFuncInfo to it to delete these structures
     STRING_delete_symbol_table (functionSectionTable, 
 				(void (*)(void *))UIManager::deleteFuncInfo);
+
+    // Delete the streaming XML parser, if parseXMLSnippet() created one
+    deleteUIXMLStream (xmlStream);
+    deleteUITGBStream (tgbStream);
     
     // Deletes entire md database
     // No need to delete function sections, etc. all deleted by this command
@@ -1069,6 +1104,11 @@ MD_Entry *UIManager::newIndexedEntry (MD_Section *section, const char *entryName
 // Print out snapshot in human readable format with the given page width
 void UIManager::printSnapshot (FILE *out, int pageWidth)
 {
+    // Snapshots hold whole messages, so bring in each body still with
+    // the collector just while its message is printed
+    SnapshotBodies bodies;
+    startSnapshotBodies (bodies);
+
 #if 0
     // Print out declarations, so can be recompiled if desired
     // This makes the printout less readable, may not want to do
@@ -1076,14 +1116,22 @@ void UIManager::printSnapshot (FILE *out, int pageWidth)
 #endif
 
     // Print out the actual content 
-    MD_print_md (out, md, pageWidth);
+    MD_print_md_hooked (out, md, pageWidth, snapshotEntryHook, &bodies);
+
+    finishSnapshotBodies (bodies);
 }
 
 // Write out snapshot in easy to parse, machine independent format
 // Not easily read by humans!
 void UIManager::writeSnapshot (FILE *out) 
 {
-    MD_write_md (out, md);
+    // Snapshots hold whole messages (addSnapshot() reads just the text)
+    SnapshotBodies bodies;
+    startSnapshotBodies (bodies);
+
+    MD_write_md_hooked (out, md, snapshotEntryHook, &bodies);
+
+    finishSnapshotBodies (bodies);
 }
 
 // Adds info entry set to 'string' to the info table
@@ -2523,9 +2571,12 @@ void UIManager::declarePixmap (const char *pixmapName, const char *xpm[])
     internalXpm[xpmArraySize] = NULL;
 
     // Create pixmapInfo structure with this internalXpm and a new
-    // QPixmap created from it
-    PixmapInfo *pixmapInfo = new PixmapInfo((const char **)internalXpm, 
-					  QPixmap((const char **)internalXpm));
+    // QPixmap created from it (a batch client has no display to create
+    // a QPixmap on, and never draws it, so it gets a null one)
+    PixmapInfo *pixmapInfo = 
+	new PixmapInfo((const char **)internalXpm, 
+		       (QApplication::type() != QApplication::Tty) ?
+		       QPixmap((const char **)internalXpm) : QPixmap());
     TG_checkAlloc(pixmapInfo);
 
     // Add it to pixmap table under pixmap name, it will take care
@@ -6567,6 +6618,15 @@ int UIManager::declareMessageFolder (const char *messageFolderTag,
 			   MD_OPTIONAL_FIELD);
     MD_require_string (messageTracebackDecl, 0);
 
+    // Add INT INT _messageBodyRef_ to hold the collector's index and the
+    // line count of a body not yet fetched (see addMessageRef())
+    MD_Field_Decl *messageBodyRefDecl = 
+	MD_new_field_decl (messageSection,
+			   "_messageBodyRef_",
+			   MD_OPTIONAL_FIELD);
+    MD_require_int (messageBodyRefDecl, 0);
+    MD_require_int (messageBodyRefDecl, 1);
+
     // To speed up look of message sections (I don't want to have to
     // to prefix it every time), source MessageFolderInfo struction with
     // the messageSection pointer and the field decl pointers in this
@@ -6576,7 +6636,8 @@ int UIManager::declareMessageFolder (const char *messageFolderTag,
 				indexDecl,
 				indexMap,
 				messageTextDecl,
-				messageTracebackDecl));
+				messageTracebackDecl,
+				messageBodyRefDecl));
 
     // Emit signal to notify any listeners that a messageFolder has been declared
     emit messageFolderDeclared (messageFolderTag, messageFolderTitle,
@@ -6825,6 +6886,226 @@ int UIManager::addMessage (const char *messageFolderTag,
     return (index);
 }
 
+// Like addMessage(), but messageHeading is just the first line(s) of the
+// message.  The bodyLines lines of the rest are left with the collector 
+// as body bodyIndex (see TGxmlserver -lazy) and fetched when 
+// messageTextLineRef() or messageText() needs them.
+// Return's index of message inserted.
+int UIManager::addMessageRef (const char *messageFolderTag, 
+			      const char *messageHeading,
+			      const char *messageTraceback,
+			      int bodyIndex, int bodyLines)
+{
+    // Make sure the messageFolderTag has been declared
+    MessageFolderInfo *mi = 
+	messageFolderInfoTable.findEntry (messageFolderTag);
+
+    if (mi == NULL)
+    {
+	TG_error ("UIManager::addMessageRef: messageFolderTag '%s' "
+		  "not declared!", messageFolderTag);
+    }
+
+    // The viewers must see the body lines when they hear about the
+    // message, so hold addMessage()'s signal until the ref is set.
+    // addMessage() names the message after the entry count.
+    QString messageTag;
+    messageTag.sprintf("M%i", MD_num_entries(mi->messageSection));
+    blockSignals (TRUE);
+    int index = addMessage (messageFolderTag, messageHeading, 
+			    messageTraceback);
+    blockSignals (FALSE);
+
+    // Record where to get the body
+    if (bodyLines > 0)
+    {
+	MD_Entry *messageEntry = MD_find_entry (mi->messageSection,
+						messageTag.latin1());
+	MD_Field *bodyRefField = 
+	    MD_new_field (messageEntry, mi->messageBodyRefDecl, 2);
+	MD_set_int (bodyRefField, 0, bodyIndex);
+	MD_set_int (bodyRefField, 1, bodyLines);
+    }
+
+    // Emit signal to notify any listeners that a message has been added
+    emit messageAdded (messageFolderTag, messageHeading, messageTraceback);
+
+    return (index);
+}
+
+// Returns TRUE if the message's body is still with the collector
+// (see addMessageRef())
+bool UIManager::messageBodyIsRef (const char *messageFolderTag, 
+				  const char *messageTag)
+{
+    // Get the messageFolderInfo for this messageFolderTag 
+    MessageFolderInfo *mi = 
+	messageFolderInfoTable.findEntry (messageFolderTag);
+    if (mi == NULL)
+	return (FALSE);
+
+    MD_Entry *entry = MD_find_entry (mi->messageSection, messageTag);
+    if (entry == NULL)
+	return (FALSE);
+
+    return (MD_find_field (entry, mi->messageBodyRefDecl) != NULL);
+}
+
+// Lists every body still with the collector, in the order MD_write_md()
+// and MD_print_md() will come to their messages, so they can be asked
+// for ahead of time.  Holds back updates from the collector until
+// finishSnapshotBodies() (see holdingUpdates()).
+void UIManager::startSnapshotBodies (SnapshotBodies &bodies)
+{
+    bodies.um = this;
+    bodies.bodyIndex = NULL;
+    bodies.count = 0;
+    bodies.next = 0;
+    bodies.requested = 0;
+    bodies.section = NULL;
+    bodies.textDecl = NULL;
+    bodies.bodyRefDecl = NULL;
+    bodies.filledEntry = NULL;
+    snapshotDepth++;
+
+    int maxCount = 0;
+    for (MD_Section *section = MD_first_section (md); section != NULL;
+	 section = MD_next_section (section))
+    {
+	MD_Field_Decl *bodyRefDecl = 
+	    MD_find_field_decl (section, "_messageBodyRef_");
+	if (bodyRefDecl == NULL)
+	    continue;
+
+	for (MD_Entry *entry = MD_first_entry (section); entry != NULL;
+	     entry = MD_next_entry (entry))
+	{
+	    MD_Field *bodyRefField = MD_find_field (entry, bodyRefDecl);
+	    if (bodyRefField == NULL)
+		continue;
+
+	    if (bodies.count >= maxCount)
+	    {
+		maxCount = (maxCount == 0) ? 1024 : maxCount * 2;
+		bodies.bodyIndex = (int *) realloc (bodies.bodyIndex,
+						    maxCount * sizeof (int));
+		TG_checkAlloc (bodies.bodyIndex);
+	    }
+	    bodies.bodyIndex[bodies.count++] = MD_get_int (bodyRefField, 0);
+	}
+    }
+}
+
+void UIManager::snapshotEntryHook (MD_Entry *entry, int done, void *arg)
+{
+    SnapshotBodies &bodies = *(SnapshotBodies *) arg;
+    if (!done)
+	bodies.um->fillSnapshotBody (bodies, entry);
+    else
+	bodies.um->emptySnapshotBody (bodies, entry);
+}
+
+// Appends the message's body (if still with the collector) to its text,
+// as addMessage() would have stored it, and hides its body ref, so the
+// entry is written just as if the body had been sent up front
+void UIManager::fillSnapshotBody (SnapshotBodies &bodies, MD_Entry *entry)
+{
+    if (entry->section != bodies.section)
+    {
+	bodies.section = entry->section;
+	bodies.textDecl = MD_find_field_decl (entry->section, 
+					      "_messageText_");
+	bodies.bodyRefDecl = MD_find_field_decl (entry->section, 
+						 "_messageBodyRef_");
+    }
+    if (bodies.bodyRefDecl == NULL)
+	return;
+    MD_Field *bodyRefField = MD_find_field (entry, bodies.bodyRefDecl);
+    if (bodyRefField == NULL)
+	return;
+
+    int bodyIndex = MD_get_int (bodyRefField, 0);
+    int bodyLines = MD_get_int (bodyRefField, 1);
+
+    // Keep the collector TG_MESSAGE_BODY_PREFETCH bodies ahead of us,
+    // rather than waiting for each one in turn
+    bodies.next++;
+    while ((bodies.requested < bodies.count) &&
+	   (bodies.requested < bodies.next + TG_MESSAGE_BODY_PREFETCH))
+    {
+	bodyCache.requestBody (bodies.bodyIndex[bodies.requested++]);
+    }
+    bodyCache.flushRequests ();
+
+    // Wait for this body before touching the entry (events, maybe even
+    // another snapshot, are processed while waiting).  The rest of its
+    // lines then come straight from the cache.
+    bodyCache.bodyLine (bodyIndex, 0);
+    bodyRefField = MD_find_field (entry, bodies.bodyRefDecl);
+
+    MD_Field *messageTextField = MD_find_field (entry, bodies.textDecl);
+    int headingLines = MD_num_elements (messageTextField);
+
+    // Preallocate all the lines, then fill them in
+    MD_set_string (messageTextField, headingLines + bodyLines - 1, "");
+    for (int lineNo = 0; lineNo < bodyLines; ++lineNo)
+    {
+	MD_set_string (messageTextField, headingLines + lineNo,
+		       bodyCache.bodyLine (bodyIndex, lineNo));
+    }
+
+    MD_delete_field (bodyRefField);
+
+    bodies.filledEntry = entry;
+    bodies.headingLines = headingLines;
+    bodies.refIndex = bodyIndex;
+    bodies.refLines = bodyLines;
+}
+
+// Puts the message back the way fillSnapshotBody() found it once it
+// has been written, so the body only stays in the cache
+void UIManager::emptySnapshotBody (SnapshotBodies &bodies, MD_Entry *entry)
+{
+    if (entry != bodies.filledEntry)
+	return;
+    bodies.filledEntry = NULL;
+
+    // Make a new text field with just the heading (rather than deleting
+    // the body's lines), so its element array doesn't stay body-sized
+    MD_Field *messageTextField = MD_find_field (entry, bodies.textDecl);
+    int headingLines = bodies.headingLines;
+    char **heading = (char **) malloc ((headingLines + 1) * sizeof (char *));
+    TG_checkAlloc (heading);
+    for (int lineNo = 0; lineNo < headingLines; ++lineNo)
+    {
+	heading[lineNo] = strdup (MD_get_string (messageTextField, lineNo));
+	TG_checkAlloc (heading[lineNo]);
+    }
+    MD_delete_field (messageTextField);
+
+    messageTextField = MD_new_field (entry, bodies.textDecl, headingLines);
+    for (int lineNo = 0; lineNo < headingLines; ++lineNo)
+    {
+	MD_set_string (messageTextField, lineNo, heading[lineNo]);
+	free (heading[lineNo]);
+    }
+    free (heading);
+
+    MD_Field *bodyRefField = MD_new_field (entry, bodies.bodyRefDecl, 2);
+    MD_set_int (bodyRefField, 0, bodies.refIndex);
+    MD_set_int (bodyRefField, 1, bodies.refLines);
+}
+
+void UIManager::finishSnapshotBodies (SnapshotBodies &bodies)
+{
+    free (bodies.bodyIndex);
+    bodies.bodyIndex = NULL;
+
+    snapshotDepth--;
+    if (snapshotDepth == 0)
+	emit updatesReleased ();
+}
+
 // Returns the number of messages currently in messageFolder
 int UIManager::messageCount(const char *messageFolderTag)
 {
@@ -6933,6 +7214,19 @@ QString UIManager::messageText(const char *messageFolderTag,
 	lineBuf.appendSprintf ("\n%s", nextLine);
     }
 
+    // Append the body, if it is still with the collector
+    MD_Field *bodyRefField = MD_find_field (entry, mi->messageBodyRefDecl);
+    if (bodyRefField != NULL)
+    {
+	int bodyIndex = MD_get_int (bodyRefField, 0);
+	int bodyLines = MD_get_int (bodyRefField, 1);
+	for (int index = 0; index < bodyLines; ++index)
+	{
+	    const char *nextLine = bodyCache.bodyLine (bodyIndex, index);
+	    lineBuf.appendSprintf ("\n%s", nextLine);
+	}
+    }
+
     // Return the lineBuf contents, automatically converted to QString
     return (lineBuf.contents());
 #endif
@@ -6965,6 +7259,11 @@ int UIManager::messageTextLineCount (const char *messageFolderTag,
 
     // Get the number of lines in message
     int lineCount = MD_num_elements(messageTextField);
+
+    // Add the lines of a body still with the collector
+    MD_Field *bodyRefField = MD_find_field (entry, mi->messageBodyRefDecl);
+    if (bodyRefField != NULL)
+	lineCount += MD_get_int (bodyRefField, 1);
     
     // Return this
     return (lineCount);
@@ -6999,6 +7298,19 @@ const char *UIManager::messageTextLineRef (const char *messageFolderTag,
 
     // Get the number of lines
     int lineCount = MD_num_elements(messageTextField);
+
+    // Lines after the heading may be in a body still with the collector
+    if (lineNo >= lineCount)
+    {
+	MD_Field *bodyRefField = MD_find_field (entry, 
+						mi->messageBodyRefDecl);
+	if ((bodyRefField != NULL) && 
+	    (lineNo < lineCount + MD_get_int (bodyRefField, 1)))
+	{
+	    return (bodyCache.bodyLine (MD_get_int (bodyRefField, 0),
+					lineNo - lineCount));
+	}
+    }
     
     // If out of bounds, return NULL
     if ((lineNo < 0) || (lineNo >= lineCount))
@@ -7287,6 +7599,203 @@ int UIManager::declareSiteColumn (const char *siteColumnTag,
 
 #endif
 
+// Returns the SiteDataInfo for siteColumnTag and fileName, creating
+// it (and the column's table) if create is TRUE, otherwise returning
+// NULL if it doesn't exist
+UIManager::SiteDataInfo *UIManager::findSiteData (const char *siteColumnTag,
+						  const char *fileName,
+						  bool create)
+{
+    StringTable<SiteDataInfo> *fileTable = 
+	siteDataTable.findEntry (siteColumnTag);
+    if (fileTable == NULL)
+    {
+	if (!create)
+	    return (NULL);
+	fileTable = new StringTable<SiteDataInfo> ("siteDataFiles", 
+						   DeleteData, 0);
+	TG_checkAlloc(fileTable);
+	siteDataTable.addEntry (siteColumnTag, fileTable);
+    }
+
+    SiteDataInfo *info = fileTable->findEntry (fileName);
+    if ((info == NULL) && create)
+    {
+	info = new SiteDataInfo;
+	TG_checkAlloc(info);
+	fileTable->addEntry (fileName, info);
+    }
+    return (info);
+}
+
+// One line's value from an addSiteData() batch, with its place in the
+// batch (so the last value given for a line wins)
+struct SiteDataPair
+{
+    int line;
+    int order;
+    double value;
+};
+
+// qsort() helper that orders SiteDataPairs by line, then batch order
+static int compareSiteDataPairs (const void *a, const void *b)
+{
+    const SiteDataPair *pairA = (const SiteDataPair *) a;
+    const SiteDataPair *pairB = (const SiteDataPair *) b;
+    if (pairA->line != pairB->line)
+	return ((pairA->line < pairB->line) ? -1 : 1);
+    return (pairA->order - pairB->order);
+}
+
+// Sets the values of siteColumnTag for count lines of fileName in
+// one update (see uimanager.h)
+void UIManager::addSiteData (const char *siteColumnTag, const char *fileName,
+			     const int *lines, const double *values, int count)
+{
+    SiteDataInfo *info = findSiteData (siteColumnTag, fileName, TRUE);
+
+    // Sort the batch by line (profiles are usually in order already),
+    // dropping invalid lines
+    SiteDataPair *batch = 
+	(SiteDataPair *) malloc ((count + 1) * sizeof (SiteDataPair));
+    TG_checkAlloc(batch);
+    int batchCount = 0;
+    bool sorted = TRUE;
+    for (int i = 0; i < count; i++)
+    {
+	if (lines[i] < 1)
+	{
+	    fprintf (stderr, "Warning: UIManager::addSiteData: Ignoring "
+		     "invalid line %i for '%s' in '%s'!\n", lines[i],
+		     siteColumnTag, fileName);
+	    continue;
+	}
+	if ((batchCount > 0) && (lines[i] <= batch[batchCount-1].line))
+	    sorted = FALSE;
+	batch[batchCount].line = lines[i];
+	batch[batchCount].order = i;
+	batch[batchCount].value = values[i];
+	batchCount++;
+    }
+    if (!sorted)
+    {
+	qsort (batch, batchCount, sizeof (SiteDataPair), 
+	       compareSiteDataPairs);
+
+	// Keep just the last value given for each line
+	int kept = 0;
+	for (int i = 0; i < batchCount; i++)
+	{
+	    if ((kept > 0) && (batch[kept-1].line == batch[i].line))
+		batch[kept-1] = batch[i];
+	    else
+		batch[kept++] = batch[i];
+	}
+	batchCount = kept;
+    }
+
+    // Usually the batch comes after the lines already stored, so it can
+    // just be appended
+    if ((info->count == 0) || 
+	((batchCount > 0) && (batch[0].line > info->line[info->count-1])))
+    {
+	if (info->count + batchCount > info->size)
+	{
+	    int newSize = info->size * 2;
+	    if (newSize < info->count + batchCount)
+		newSize = info->count + batchCount;
+	    info->line = (int *) realloc (info->line, 
+					  newSize * sizeof (int));
+	    TG_checkAlloc(info->line);
+	    info->value = (double *) realloc (info->value, 
+					      newSize * sizeof (double));
+	    TG_checkAlloc(info->value);
+	    info->size = newSize;
+	}
+	for (int i = 0; i < batchCount; i++)
+	{
+	    info->line[info->count] = batch[i].line;
+	    info->value[info->count] = batch[i].value;
+	    info->count++;
+	}
+    }
+
+    // Otherwise merge the two, the batch's values replacing those stored
+    else if (batchCount > 0)
+    {
+	int newSize = info->count + batchCount;
+	int *line = (int *) malloc (newSize * sizeof (int));
+	TG_checkAlloc(line);
+	double *value = (double *) malloc (newSize * sizeof (double));
+	TG_checkAlloc(value);
+
+	int newCount = 0, old = 0, i = 0;
+	while ((old < info->count) || (i < batchCount))
+	{
+	    if ((i >= batchCount) || 
+		((old < info->count) && (info->line[old] < batch[i].line)))
+	    {
+		line[newCount] = info->line[old];
+		value[newCount] = info->value[old];
+		old++;
+	    }
+	    else
+	    {
+		if ((old < info->count) && (info->line[old] == batch[i].line))
+		    old++;
+		line[newCount] = batch[i].line;
+		value[newCount] = batch[i].value;
+		i++;
+	    }
+	    newCount++;
+	}
+
+	free (info->line);
+	free (info->value);
+	info->line = line;
+	info->value = value;
+	info->count = newCount;
+	info->size = newSize;
+    }
+    free (batch);
+
+    // Emit signal to notify any listeners (once for the whole batch)
+    emit siteDataAdded (siteColumnTag, fileName, count);
+}
+
+// Returns the value of siteColumnTag for line of fileName,
+// NULL_DOUBLE if not set
+double UIManager::siteDataValue (const char *siteColumnTag, 
+				 const char *fileName, int line)
+{
+    SiteDataInfo *info = findSiteData (siteColumnTag, fileName, FALSE);
+    if (info == NULL)
+	return (NULL_DOUBLE);
+
+    int low = 0, high = info->count - 1;
+    while (low <= high)
+    {
+	int middle = low + (high - low) / 2;
+	if (info->line[middle] == line)
+	    return (info->value[middle]);
+	if (info->line[middle] < line)
+	    low = middle + 1;
+	else
+	    high = middle - 1;
+    }
+    return (NULL_DOUBLE);
+}
+
+// Returns the number of lines of fileName with siteColumnTag values
+int UIManager::siteDataLineCount (const char *siteColumnTag, 
+				  const char *fileName)
+{
+    SiteDataInfo *info = findSiteData (siteColumnTag, fileName, FALSE);
+    if (info == NULL)
+	return (0);
+    return (info->count);
+}
+
 // Maximum number of folders that may be specified in the body of a message
 // Need 2 for Valgrind, put 5 for now since appears more than enough
 #define MAX_MESSAGE_FOLDERS 5
@@ -7313,6 +7822,8 @@ enum XMLElementToken
     XML_folder,
     XML_heading,
     XML_body,
+    XML_body_ref,
+    XML_index,
     XML_annot,
     XML_site,
     XML_file,
@@ -7331,96 +7842,53 @@ enum XMLElementToken
     XML_set,
     XML_l,
     XML_v,
+    XML_lines,
+    XML_values,
     XML_site_priority,
     XML_modifier,
     XML_status
 };
 
 public:
-    UIXMLParser(UIManager *uimanager, QString &xml, int lineNoOffset) : 
-	um(uimanager), xml_text(xml), lineOffset(lineNoOffset),
-	lineNoGuess(1) 
+    UIXMLParser(UIManager *uimanager) : 
+	um(uimanager), commands(NULL), xml_text(""), xmlFirstLine(1),
+	xmlFirstColumn(0), lineOffset(0), lineNoGuess(1) 
 	{
 	    // Assume using the latest format and version
 	    xml_format = 1;
 	    xml_version = um->getToolGearVersion();
-	    
-	    
-	    // Populate XML id table, if not already populated
-	    if (!um->xmlTokenTable.entryExists("about"))
-	    {
+	}
 
-		// Use C preprocessor tricks to prevent mistakes and
-		// make it easier.   The #name expands to "(name)"
-		// and XML_##name expands to the value defined for
-		// XML_(name).
-#define declareToken(name,level) declareToken_(#name,XML_##name,level)
-
-//		fprintf (stderr, "Initializing xmlTokenTable!\n");
-
-		// Declare all the valid tokens and the levels they
-		// are expected to occur on
-
-		// XML format tokens
-		declareToken(format, 0);
-		declareToken(version, 0);
-
-		// about tokens
-		declareToken(about, 0);
-		declareToken(prepend, 1);
-		declareToken(append, 1);
-
-		// Tool Title tokens
-		declareToken(tool_title, 0);
-
-		// message_folder tokens
-		declareToken(message_folder, 0);
-		declareToken(tag, 1);
-		declareToken(title, 1);
-		declareToken(if_empty, 1);
-
-		// message tokens
-		declareToken(message, 0);
-		declareToken(title, 2);
-		declareToken(folder, 1);
-		declareToken(heading, 1);
-		declareToken(body, 1);
-		declareToken(annot, 1);
-
-		// message->annot->site tokens
-		declareToken(site, 2);
-		declareToken(file, 3);
-		declareToken(line, 3);
-		declareToken(desc, 3);
-
-		// site_column tokens
-		declareToken(site_column, 0);
-		declareToken(site_mask, 1);
-		declareToken(hide_if_empty, 1);
-		declareToken(position, 1);
-		declareToken(tooltip, 1);
-		declareToken(align, 1);
-		declareToken(min_width, 1);
-		declareToken(max_width, 1);
-
-		// site_data tokens
-		declareToken(site_data, 0);
-		declareToken(col, 1);
-		declareToken(file, 1);
-		declareToken(set, 1);
-		declareToken(l, 2);
-		declareToken(v, 2);
-
-		// site_priority tokens
-		declareToken(site_priority, 0);
-		declareToken(file, 1);
-		declareToken(line, 1);
-		declareToken(desc, 1);
-		declareToken(modifier, 1);
-
-		// Tool status tokens
-		declareToken(status, 0);
-	    }
+    // Must be called before each snippet is parsed.  The commands found
+    // are appended to commandList.  xml is the text about to be parsed
+    // (used to print error context), which the reader will report as
+    // starting at line firstLine, column firstColumn+1 (i.e., after
+    // any earlier snippets fed to the same reader).  lineNoOffset is
+    // added to line numbers (relative to xml) in messages.
+    void beginSnippet (const char *xml, int firstLine, int firstColumn,
+		       int lineNoOffset, 
+		       UIManager::XMLCommandList &commandList)
+	{
+	    commands = &commandList;
+	    xml_text = xml;
+	    xmlFirstLine = firstLine;
+	    xmlFirstColumn = firstColumn;
+	    lineOffset = lineNoOffset;
+	    lineNoGuess = 1;
+
+	    // Each snippet starts out assuming the latest format and version
+	    xml_format = 1;
+	    xml_version = um->getToolGearVersion();
+	}
+
+    // Returns the name of the outermost element still open (after the
+    // <tool_gear> or <tool_gear_XML_snippet> wrapper), or an empty
+    // string if every element opened so far has been closed
+    QString openElement () const
+	{
+	    if (nestLevel < 0)
+		return (QString (""));
+	    return (elementNameAt[0]);
 	}
 
     bool startDocument() 
@@ -7488,6 +7956,8 @@ public:
 		    message_folder_count = 0;
 		    message_heading = "";
 		    message_body = "";
+		    message_body_index = NULL_INT;
+		    message_body_lines = NULL_INT;
 		    message_traceback = "";
 		}
 		
@@ -7522,8 +7992,13 @@ public:
 		    site_data_col = "";
 		    site_data_file = "";
 
-		    // The optional 'set' commands must be after the above
-		    // are set
+		    // Clear the lines and values from 'set', 'lines',
+		    // and 'values'
+		    site_data_lines.clear();
+		    site_data_values.clear();
+		    site_data_runs.clear();
+		    site_data_bulk_values.clear();
+		    site_data_bulk_invalid = FALSE;
 		}
 	    }
 
@@ -7536,6 +8011,13 @@ public:
 		    annot_title = "";
 		    annot_traceback = "";
 		}
+		else if ((elementToken == XML_set) &&
+			 (elementTokenAt[0] == XML_site_data))
+		{
+		    // Clear set parameters
+		    set_line = NULL_INT;
+		    set_value = NULL_DOUBLE;
+		}
 	    }
 
 
@@ -7689,18 +8171,42 @@ public:
 
 		    // Ok to have empty body or traceback
 
-		    // Create messageText from heading and body
-		    QString messageText;
-		    messageText.sprintf ("%s\n%s", 
-					 (const char *) message_heading,
-					 (const char *) message_body);
+		    // If the body was left with the collector (TGxmlserver
+		    // -lazy), just note where to get it
+		    if ((message_body_index != NULL_INT) &&
+			(message_body_lines != NULL_INT))
+		    {
+			for (int i = 0; i < message_folder_count; i++)
+			{
+			    UIManager::XMLCommand *command = 
+				UIManager::appendXMLCommand (*commands,
+				       UIManager::XMLCommand::AddMessageRef,
+				       (const char *)message_folder[i], 
+				       (const char *)message_heading,
+				       (const char *)message_traceback);
+			    command->flag = message_body_index;
+			    command->count = message_body_lines;
+			}
+			elementHandled = TRUE; // Mark element handled
+		    }
 
-		    // add message to each message folder specified
-		    for (int i = 0; i < message_folder_count; i++)
+		    // Otherwise, create messageText from heading and body
+		    else
 		    {
-			um->addMessage((const char *)message_folder[i], 
+			QString messageText;
+			messageText.sprintf ("%s\n%s", 
+					     (const char *) message_heading,
+					     (const char *) message_body);
+
+			// add message to each message folder specified
+			for (int i = 0; i < message_folder_count; i++)
+			{
+			    UIManager::appendXMLCommand (*commands,
+				       UIManager::XMLCommand::AddMessage,
+				       (const char *)message_folder[i], 
 				       (const char *)messageText,
 				       (const char *)message_traceback);
+			}
 		    }
 
 		    elementHandled = TRUE; // Mark element handled
@@ -7792,38 +8298,15 @@ public:
 		    if (message_folder_if_empty == UIManager::InvalidIfEmpty)
 			message_folder_if_empty = UIManager::ShowIfEmpty;
 
-		    // Declare message folder, get index to see if duplicate
-		    int index = 
-			um->declareMessageFolder(message_folder_tag, 
-						 message_folder_title,
-						 message_folder_if_empty);
-
-		    // If tag already declared, make sure title is the same
-		    // or else print warning.
-		    if (index == -1)
-		    {
-			// Get existing title
-			QString oldTitle = 
-			    um->messageFolderTitle (message_folder_tag);
-
-			if (message_folder_title != oldTitle)
-			{
-			    fprintf (stderr,
-				     "Warning: Tool Gear ignored invalid XML"
-				     " ending on line %i:\n"
-				     "  Redeclaration of message_folder tag "
-				     "'%s' has different title:\n"
-				     "   Orig: '%s'\n"
-				     "    New: '%s'\n"
-				     "  Existing message folder declarations "
-				     "cannot currently be changed!\n\n",
-				     lineNoGuess+lineOffset,
-				     (const char *)message_folder_tag,
-				     (const char *)oldTitle,
-				     (const char *)message_folder_title);
-			}
-
-		    }
+		    // Declare message folder (applyXMLCommands() warns
+		    // if this is a redeclaration with a different title)
+		    UIManager::XMLCommand *command = 
+			UIManager::appendXMLCommand (*commands,
+				UIManager::XMLCommand::DeclareMessageFolder,
+				(const char *)message_folder_tag, 
+				(const char *)message_folder_title);
+		    command->flag = (int) message_folder_if_empty;
+		    command->lineNo = lineNoGuess+lineOffset;
 
 		    elementHandled = TRUE; // Mark element handled
 		}
@@ -7874,14 +8357,23 @@ public:
 		    else
 		    {
 			// Add site priority modifier
-			um->addSitePriority (site_priority_modifier, 
-					     fileRegExp, descRegExp, 
-					     lineRegExp);
+			UIManager::XMLCommand *command =
+			    UIManager::appendXMLCommand (*commands,
+				UIManager::XMLCommand::AddSitePriority,
+				fileRegExp, descRegExp, lineRegExp);
+			command->modifier = site_priority_modifier;
 		    }
 
 		    elementHandled = TRUE; // Mark element handled
 		}
 
+		// Process add site data commands
+		else if (elementTokenAt[0] == XML_site_data)
+		{
+		    addSiteDataCommand ();
+		    elementHandled = TRUE; // Mark element handled
+		}
+
 		// Process addAbout command 
 		else if (elementTokenAt[0] == XML_about)
 		{
@@ -7912,7 +8404,9 @@ public:
 //		    QString toolTitle = valueAt[0].stripWhiteSpace();
 
 		    // uses value at tool_title level
-		    um->setWindowCaption ((const char *)valueAt[0]);
+		    UIManager::appendXMLCommand (*commands,
+				UIManager::XMLCommand::SetWindowCaption,
+				(const char *)valueAt[0]);
 
 		    elementHandled = TRUE; // Mark element handled
 		}
@@ -7922,7 +8416,9 @@ public:
 		{
 		    // For now, signal new status set
 		    // May want to actually save status somewhere
-		    emit um->toolStatusSet (valueAt[0].latin1());
+		    UIManager::appendXMLCommand (*commands,
+				UIManager::XMLCommand::SetToolStatus,
+				valueAt[0].latin1());
 
 		    elementHandled = TRUE; // Mark element handled
 		}
@@ -7971,6 +8467,26 @@ public:
 			setIfEmpty(message_body);
 			elementHandled = TRUE; // Mark element handled
 		    }
+
+		    else if (elementTokenAt[1] == XML_body_ref)
+		    {
+			// Need both the index and line count to use it
+			if ((message_body_index == NULL_INT) ||
+			    (message_body_lines == NULL_INT))
+			{
+			    fprintf (stderr, 
+				     "Warning: Ignoring incomplete body_ref "
+				     "(needs index and lines):\n");
+
+			    // Print out line that caused error
+			    printErrorContext (lineNoGuess, -1);
+			    fprintf (stderr, "\n");
+
+			    message_body_index = NULL_INT;
+			    message_body_lines = NULL_INT;
+			}
+			elementHandled = TRUE; // Mark element handled
+		    }
 		    else if (elementTokenAt[1] == XML_annot)
 		    {
 			// Construct traceback snippet
@@ -8004,12 +8520,16 @@ public:
 		{
 		    if (elementTokenAt[1] == XML_prepend)
 		    {
-			um->addAboutText ((const char *)valueAt[1], TRUE);
+			UIManager::appendXMLCommand (*commands,
+				UIManager::XMLCommand::AddAboutText,
+				(const char *)valueAt[1])->flag = TRUE;
 			elementHandled = TRUE; // Mark element handled
 		    }
 		    else if (elementTokenAt[1] == XML_append)
 		    {
-			um->addAboutText ((const char *)valueAt[1], FALSE);
+			UIManager::appendXMLCommand (*commands,
+				UIManager::XMLCommand::AddAboutText,
+				(const char *)valueAt[1])->flag = FALSE;
 			elementHandled = TRUE; // Mark element handled
 		    }
 		}
@@ -8058,6 +8578,41 @@ public:
 			elementHandled = TRUE; // Mark element handled
 		    }
 
+		    // One line's value, in the element form
+		    else if (elementTokenAt[1] == XML_set)
+		    {
+			if ((set_line == NULL_INT) || 
+			    (set_value == NULL_DOUBLE))
+			{
+			    fprintf (stderr,
+				     "Warning: Tool Gear ignored invalid XML"
+				     " ending on line %i:\n"
+				     "  Both l and v must be specified for "
+				     "site_data set!\n\n",
+				     lineNoGuess+lineOffset);
+			}
+			else
+			{
+			    site_data_lines.push_back (set_line);
+			    site_data_values.push_back (set_value);
+			}
+			elementHandled = TRUE; // Mark element handled
+		    }
+
+		    // Many lines' values, in the bulk form
+		    else if (elementTokenAt[1] == XML_lines)
+		    {
+			if (!scanSiteDataLines ())
+			    site_data_bulk_invalid = TRUE;
+			elementHandled = TRUE; // Mark element handled
+		    }
+
+		    else if (elementTokenAt[1] == XML_values)
+		    {
+			if (!scanSiteDataValues ())
+			    site_data_bulk_invalid = TRUE;
+			elementHandled = TRUE; // Mark element handled
+		    }
 		}
 
 		// Handle message folder values
@@ -8274,6 +8829,37 @@ public:
 			}
 		    }
 
+		    // Handle where to get a body left with the collector
+		    else if (elementTokenAt[1] == XML_body_ref)
+		    {
+			if (elementTokenAt[2] == XML_index)
+			{
+			    message_body_index = xmlConvertToInt(0, NULL_INT);
+			    elementHandled = TRUE; // Mark element handled
+			}
+			else if (elementTokenAt[2] == XML_lines)
+			{
+			    message_body_lines = xmlConvertToInt(0, NULL_INT);
+			    elementHandled = TRUE; // Mark element handled
+			}
+		    }
+		}
+
+		// Handle site_data set values
+		else if ((elementTokenAt[0] == XML_site_data) &&
+			 (elementTokenAt[1] == XML_set))
+		{
+		    if (elementTokenAt[2] == XML_l)
+		    {
+			set_line = xmlConvertToInt(1, NULL_INT);
+			elementHandled = TRUE; // Mark element handled
+		    }
+		    else if (elementTokenAt[2] == XML_v)
+		    {
+			set_value = xmlConvertToDouble(NULL_DOUBLE, 
+						       NULL_DOUBLE);
+			elementHandled = TRUE; // Mark element handled
+		    }
 		}
 	    }
 
@@ -8395,8 +8981,11 @@ public:
     
     bool characters ( const QString & ch )
 	{
-	    // Append ch to the current value at this level
-	    valueAt[nestLevel].append(ch);
+	    // Append ch to the current value at this level (text between
+	    // snippets is at level -1 and is not kept, since with the
+	    // streaming parser it would just keep growing)
+	    if ((nestLevel >= 0) && (nestLevel < 10))
+		valueAt[nestLevel].append(ch);
 
 	    // Increment line number guess based on newlines in ch
 	    const char *ptr = (const char *)ch;
@@ -8416,16 +9005,18 @@ public:
 	{
 	    error_message = "Fatal XML parse error";
 
+	    // Get error location relative to the snippet
+	    int errorLine = snippetLine (exception);
+	    int errorColumn = snippetColumn (exception);
+
 	    // Print out location and description of error
 	    fprintf (stderr, 
 		     "\nXML parse error at line %i column %i: %s\n",
-		     exception.lineNumber() + lineOffset,
-		     exception.columnNumber(),
+		     errorLine + lineOffset, errorColumn,
 		     (const char *)exception.message());
 
 	    // Print out line that caused error
-	    printErrorContext (exception.lineNumber(),
-			       exception.columnNumber());
+	    printErrorContext (errorLine, errorColumn);
 
 	    // Print out XML stack when error occurred
 	    QString indent="";
@@ -8465,15 +9056,17 @@ public:
 	}
     bool warning ( const QXmlParseException & exception )
 	{
+	    // Get warning location relative to the snippet
+	    int warningLine = snippetLine (exception);
+	    int warningColumn = snippetColumn (exception);
+
 	    fprintf (stderr, 
 		     "\nXML Parse warning: Line %i, column %i: %s\n",
-		     exception.lineNumber()+lineOffset, 
-		     exception.columnNumber(),
+		     warningLine+lineOffset, warningColumn,
 		     (const char *)exception.message());
 
 	    // Print out line that caused warning
-	    printErrorContext (exception.lineNumber(),
-			       exception.columnNumber());
+	    printErrorContext (warningLine, warningColumn);
 
 	    fprintf (stderr, "\n");
 
@@ -8483,10 +9076,26 @@ public:
 
     QString errorString() {return (error_message);};
 
+    // Converts the reader's line number for exception into a line
+    // number in the snippet being parsed (line 1 is the first line)
+    int snippetLine (const QXmlParseException & exception)
+	{
+	    return (exception.lineNumber() - xmlFirstLine + 1);
+	}
+
+    // Converts the reader's column number for exception into a column
+    // in the snippet being parsed (only differs on the first line)
+    int snippetColumn (const QXmlParseException & exception)
+	{
+	    if (exception.lineNumber() == xmlFirstLine)
+		return (exception.columnNumber() - xmlFirstColumn);
+	    return (exception.columnNumber());
+	}
+
     void printErrorContext (int errorLine, int errorColumn)
 	{
 	    // Get the XML we are parsing as characters
-	    const char *xml = (const char *)xml_text;
+	    const char *xml = xml_text;
 	    const char *startPtr, *printPtr;
 	    int lineNo = 1;
 
@@ -8781,74 +9390,196 @@ private:
 	    return (val);
 	}
 
-    XMLElementToken getToken (const char *name, int nestLevel)
+    // Warns about the invalid number (or line range) at bad in the bulk
+    // site_data element at nestLevel (implicit)
+    void warnInvalidSiteDataNumber (const char *kind, const char *bad,
+				    const char *end)
 	{
+	    // Just show the offending number, not the rest of the vector
+	    int len = 0;
+	    while ((bad + len < end) && !TG_isSpace (bad[len]) && (len < 40))
+		len++;
 
-	    // Set the appropriate bit to test/set for this nestLevel
-	    int levelBit;
-		
-	    // Use a bit for each level below 31.  Treat all levels
-	    // above 31 the same (don't expect that deep but who knows)
-	    if (nestLevel < 31)
-		levelBit= (1 << nestLevel);
-	    else
-		levelBit=(1 << 31);
+	    fprintf (stderr, 
+		     "Warning: Tool Gear ignoring invalid XML %s '%.*s' in\n"
+		     "  '%s' ending on line %i:\n"
+		     "  ",
+		     kind, len, bad, (const char *)elementNameAt[nestLevel],
+		     lineNoGuess+lineOffset);
+
+	    // Print out line that caused error
+	    printErrorContext (lineNoGuess, -1);
+	    fprintf (stderr, "\n");
+	}
 
-	    // Default to unknown token;
-	    XMLElementToken token = XML_unknown;
+    // Appends the line numbers at nestLevel (implicit), given as
+    // whitespace-separated lines (e.g., "12") and runs of lines (e.g.,
+    // "20-25"), to site_data_runs as first, last pairs.
+    // Returns FALSE (after warning) if any of them are invalid.
+    bool scanSiteDataLines ()
+	{
+	    const char *pos = (const char *)valueAt[nestLevel];
+	    const char *end = pos + valueAt[nestLevel].length();
 
-	    // Is token in table?
-	    UIManager::XML_Token *entry = um->xmlTokenTable.findEntry(name);
-	    
-	    // Yes, token in table
-	    if (entry != NULL)
+	    TG_skipSpace (pos, end);
+	    while (pos < end)
 	    {
-		// Set token if levelBit is in levelMask
-		if ((entry->levelMask & levelBit) != 0)
-		    token = (XMLElementToken)entry->token;
+		const char *start = pos;
+		long long first, last;
+		bool valid = TG_scanInt (pos, end, first);
+		if (valid && (pos < end) && (*pos == '-'))
+		{
+		    ++pos;
+		    valid = TG_scanInt (pos, end, last);
+		}
+		else
+		{
+		    last = first;
+		}
+		if (!valid || ((pos < end) && !TG_isSpace (*pos)) ||
+		    (first < 1) || (last < first) || (last > INT_MAX))
+		{
+		    warnInvalidSiteDataNumber ("line", start, end);
+		    return (FALSE);
+		}
+
+		site_data_runs.push_back ((int) first);
+		site_data_runs.push_back ((int) last);
+		TG_skipSpace (pos, end);
 	    }
+	    return (TRUE);
+	}
 
-//	    fprintf (stderr, "getToken(%s, %i) returns %i\n", name, nestLevel,
-//		     (int)token);
+    // Appends the whitespace-separated numbers at nestLevel (implicit)
+    // to site_data_bulk_values.  Returns FALSE (after warning) if any
+    // of them are invalid.
+    bool scanSiteDataValues ()
+	{
+	    const char *pos = (const char *)valueAt[nestLevel];
+	    const char *end = pos + valueAt[nestLevel].length();
 
-	    // Return token found
-	    return (token);
+	    TG_skipSpace (pos, end);
+	    while (pos < end)
+	    {
+		const char *start = pos;
+		double value;
+		if (!TG_scanDouble (pos, end, value) || 
+		    ((pos < end) && !TG_isSpace (*pos)))
+		{
+		    warnInvalidSiteDataNumber ("value", start, end);
+		    return (FALSE);
+		}
+
+		site_data_bulk_values.push_back (value);
+		TG_skipSpace (pos, end);
+	    }
+	    return (TRUE);
 	}
 
-    // Utility funciton for constructor
-    void declareToken_(const char *name, XMLElementToken token, int nestLevel)
+    // Appends one AddSiteData command for the site_data element just
+    // ended, holding the lines and values from its set elements followed
+    // by those from its lines and values elements
+    void addSiteDataCommand ()
 	{
-//	    fprintf (stderr, "declareToken_(%s, %i, %i)\n",
-//		     name, token, nestLevel);
-
-	    // Set the appropriate bit to test/set for this nestLevel
-	    int levelBit;
-		
-	    // Use a bit for each level below 31.  Treat all levels
-	    // above 31 the same (don't expect that deep but who knows)
-	    if (nestLevel < 31)
-		levelBit= (1 << nestLevel);
-	    else
-		levelBit=(1 << 31);
+	    // Sanity check, col and file are required
+	    if (site_data_col.isEmpty() || site_data_file.isEmpty())
+	    {
+		fprintf (stderr,
+			 "Warning: Tool Gear ignored invalid XML"
+			 " ending on line %i:\n"
+			 "  Both col and file must be specified for "
+			 "site_data!\n\n",
+			 lineNoGuess+lineOffset);
+		return;
+	    }
 
-	    // Is it already in table?
-	    UIManager::XML_Token *entry = um->xmlTokenTable.findEntry(name);
-	    
-	    // Yes, add this levelBit to it
-	    if (entry != NULL)
+	    // The lines and values elements must give a value for
+	    // every line (invalid ones have been warned about already)
+	    long long bulkCount = 0;
+	    int runCount = site_data_runs.size();
+	    for (int i = 0; i < runCount; i += 2)
+		bulkCount += (long long) site_data_runs[i+1] - 
+		    site_data_runs[i] + 1;
+	    if (site_data_bulk_invalid)
+	    {
+		bulkCount = 0;
+	    }
+	    else if (bulkCount != (long long) site_data_bulk_values.size())
 	    {
-		entry->levelMask |= levelBit;
+		fprintf (stderr,
+			 "Warning: Tool Gear ignored invalid XML"
+			 " ending on line %i:\n"
+			 "  site_data for '%s' in '%s' has %lld lines but "
+			 "%i values!\n\n",
+			 lineNoGuess+lineOffset, site_data_col.latin1(),
+			 site_data_file.latin1(), bulkCount,
+			 (int) site_data_bulk_values.size());
+		bulkCount = 0;
 	    }
 
-	    // No, create entry and add to table
-	    else
+	    int setCount = site_data_lines.size();
+	    int count = setCount + (int) bulkCount;
+	    if (count == 0)
+		return;
+
+	    UIManager::XMLCommand *command = 
+		UIManager::appendXMLCommand (*commands,
+					     UIManager::XMLCommand::AddSiteData,
+					     site_data_col.latin1(),
+					     site_data_file.latin1());
+	    command->lines = (int *) malloc (count * sizeof (int));
+	    command->values = (double *) malloc (count * sizeof (double));
+	    if ((command->lines == NULL) || (command->values == NULL))
+		TG_error ("UIXMLParser::addSiteDataCommand: out of memory!");
+	    command->count = count;
+	    command->lineNo = lineNoGuess+lineOffset;
+
+	    for (int i = 0; i < setCount; i++)
 	    {
-		entry = new UIManager::XML_Token((int) token, levelBit);
-		um->xmlTokenTable.addEntry(name, entry);
+		command->lines[i] = site_data_lines[i];
+		command->values[i] = site_data_values[i];
 	    }
+	    if (bulkCount > 0)
+	    {
+		int index = setCount;
+		for (int i = 0; i < runCount; i += 2)
+		{
+		    int first = site_data_runs[i];
+		    int runLength = site_data_runs[i+1] - first + 1;
+		    for (int j = 0; j < runLength; j++)
+		    {
+			command->lines[index] = first + j;
+			command->values[index] = 
+			    site_data_bulk_values[index - setCount];
+			index++;
+		    }
+		}
+	    }
+	}
+
+    XMLElementToken getToken (const QString &name, int nestLevel)
+	{
+	    // Unknown names and names not valid at nestLevel are unknown
+	    int token = tokenTable.lookup (name.latin1(), name.length(),
+					   nestLevel);
+	    if (token < 0)
+		return (XML_unknown);
+
+//	    fprintf (stderr, "getToken(%s, %i) returns %i\n", name.latin1(),
+//		     nestLevel, token);
+
+	    // Return token found
+	    return ((XMLElementToken) token);
 	}
 
+    // The valid element names and the levels they are expected to
+    // occur on (see declareToken below), and the table made from them
+    static const XMLTokenDecl tokenDecls[];
+    static const XMLTokenTable tokenTable;
+
     UIManager *um;
+    // Where the commands found are put (applied later by the caller)
+    UIManager::XMLCommandList *commands;
     int nestLevel;
     XMLElementToken elementTokenAt[10];
     QString elementNameAt[10];
@@ -8869,6 +9600,8 @@ private:
     int message_folder_count; // Number of message folders
     QString message_heading;
     QString message_body;
+    int message_body_index;	// From body_ref, NULL_INT if not set
+    int message_body_lines;
     QString message_traceback;
 
     // Strings for message annot(ation) parameters
@@ -8902,13 +9635,33 @@ private:
     QString site_data_col;
     QString site_data_file;
 
+    // Lines and values from site_data set elements, in order
+    QValueVector<int> site_data_lines;
+    QValueVector<double> site_data_values;
+
+    // Lines (as first, last pairs) and values from site_data lines
+    // and values elements, and whether any of them were invalid
+    QValueVector<int> site_data_runs;
+    QValueVector<double> site_data_bulk_values;
+    bool site_data_bulk_invalid;
+
+    // Values for site_data set parameters
+    int set_line;
+    double set_value;
+
     
     // QXmlDefaultHandler expects errorString() to return something,
     // we are returning error_message;
     QString error_message;
 
     // For printing out parse error messages, the XML text being parsed
-    QString xml_text;
+    // (not copied, only valid during the parse)
+    const char *xml_text;
+
+    // Where the reader says xml_text starts, so the reader's line and
+    // column numbers can be made relative to xml_text
+    int xmlFirstLine;
+    int xmlFirstColumn;
 
     // For printing out parse error message, the lineNumberOffset
     int lineOffset;
@@ -8917,20 +9670,227 @@ private:
     int lineNoGuess;
 };
 
-// Processes the XMLSnippet (first wrapping it with <tool_gear_snippet>
-// ... </tool_gear_snippet> to make the XML parser happy with multiple
-// snippets) and process the recognized commands (warning about those
-// not recognized.   Initially XML can be used to execute
-// declareMessageFolder(), addMessage(), and addAboutText() commands.
+// Use C preprocessor tricks to prevent mistakes and make it easier.   The
+// #name expands to "(name)" and XML_##name expands to the value defined
+// for XML_(name).  Names may be declared for more than one level.
+#define declareToken(name,level) {#name, XML_##name, XML_TOKEN_LEVEL(level)}
+
+// Declare all the valid tokens and the levels they are expected to occur on
+const XMLTokenDecl UIXMLParser::tokenDecls[] = {
+    // XML format tokens
+    declareToken(format, 0),
+    declareToken(version, 0),
+
+    // about tokens
+    declareToken(about, 0),
+    declareToken(prepend, 1),
+    declareToken(append, 1),
+
+    // Tool Title tokens
+    declareToken(tool_title, 0),
+
+    // message_folder tokens
+    declareToken(message_folder, 0),
+    declareToken(tag, 1),
+    declareToken(title, 1),
+    declareToken(if_empty, 1),
+
+    // message tokens
+    declareToken(message, 0),
+    declareToken(title, 2),
+    declareToken(folder, 1),
+    declareToken(heading, 1),
+    declareToken(body, 1),
+    declareToken(body_ref, 1),
+    declareToken(index, 2),
+    declareToken(lines, 2),
+    declareToken(annot, 1),
+
+    // message->annot->site tokens
+    declareToken(site, 2),
+    declareToken(file, 3),
+    declareToken(line, 3),
+    declareToken(desc, 3),
+
+    // site_column tokens
+    declareToken(site_column, 0),
+    declareToken(site_mask, 1),
+    declareToken(hide_if_empty, 1),
+    declareToken(position, 1),
+    declareToken(tooltip, 1),
+    declareToken(align, 1),
+    declareToken(min_width, 1),
+    declareToken(max_width, 1),
+
+    // site_data tokens
+    declareToken(site_data, 0),
+    declareToken(col, 1),
+    declareToken(file, 1),
+    declareToken(set, 1),
+    declareToken(l, 2),
+    declareToken(v, 2),
+    declareToken(lines, 1),
+    declareToken(values, 1),
+
+    // site_priority tokens
+    declareToken(site_priority, 0),
+    declareToken(file, 1),
+    declareToken(line, 1),
+    declareToken(desc, 1),
+    declareToken(modifier, 1),
+
+    // Tool status tokens
+    declareToken(status, 0)
+};
+
+#undef declareToken
+
+// Built once at startup (a perfect hash, so looking up each element is
+// just one hash and compare).  Never changes after that, so every
+// parser can share it.
+const XMLTokenTable UIXMLParser::tokenTable (UIXMLParser::tokenDecls,
+					     sizeof (UIXMLParser::tokenDecls) /
+					     sizeof (XMLTokenDecl));
+
+// Parses a stream of XML snippets with one UIXMLParser, QXmlSimpleReader
+// and QXmlInputSource, feeding each snippet to the reader (in incremental
+// mode) as the next part of one long <tool_gear_XML_snippet> document.
+// This saves wrapping each snippet and setting up a new parser for it,
+// which dominated the cost of small snippets (e.g., from memcheck).
+// Element state is kept across snippets, so only the text of the snippet
+// currently being parsed needs to be available.
+class UIXMLStream
+{
+public:
+    UIXMLStream (UIManager *um) : handler (um), started (FALSE),
+				  streamLine (1), streamColumn (0)
+	{
+	    reader.setContentHandler (&handler);
+	    reader.setErrorHandler (&handler);
+	}
+
+    // Parses XMLSnippet, appending the commands found to commands.
+    // Returns FALSE if there was a parse error or the snippet left an
+    // element open, after which the stream must be replaced.
+    bool parse (const char *XMLSnippet, int lineNoOffset,
+		UIManager::XMLCommandList &commands)
+	{
+	    // Open the document the snippets are parsed as part of
+	    if (!started)
+	    {
+		source.setData (QString ("<tool_gear_XML_snippet>\n"));
+		if (!reader.parse (&source, TRUE))
+		    return (FALSE);
+		started = TRUE;
+		streamLine = 2;
+	    }
+
+	    handler.beginSnippet (XMLSnippet, streamLine, streamColumn,
+				  lineNoOffset, commands);
+
+	    // The snippet is UTF-8, like the QString::sprintf() wrapper
+	    // used to assume
+	    source.setData (QString::fromUtf8 (XMLSnippet));
+	    if (!reader.parseContinue ())
+		return (FALSE);
+
+	    // A snippet that leaves an element open would have the next
+	    // snippet parsed inside it, so treat it like a parse error (the
+	    // unclosed element's commands are never finished anyway)
+	    QString unclosed = handler.openElement ();
+	    if (!unclosed.isEmpty ())
+	    {
+		fprintf (stderr,
+			 "Warning: XML snippet ended with element '%s' "
+			 "still open, ignoring it\n", (const char *)unclosed);
+		return (FALSE);
+	    }
+
+	    // Track where the next snippet will start, for error messages
+	    const char *ptr, *lineStart = NULL;
+	    for (ptr = XMLSnippet; *ptr != 0; ++ptr)
+	    {
+		if (*ptr == '\n')
+		{
+		    streamLine++;
+		    lineStart = ptr + 1;
+		}
+	    }
+	    if (lineStart != NULL)
+		streamColumn = ptr - lineStart;
+	    else
+		streamColumn += ptr - XMLSnippet;
+
+	    return (TRUE);
+	}
+
+private:
+    UIXMLParser handler;
+    QXmlSimpleReader reader;
+    QXmlInputSource source;
+
+    // TRUE once the <tool_gear_XML_snippet> start tag has been parsed
+    bool started;
+
+    // Where the reader is in the stream (line 1, column 0 at the start)
+    int streamLine;
+    int streamColumn;
+};
+
+// Deletes stream (called by ~UIManager, before UIXMLStream is declared)
+static void deleteUIXMLStream (UIXMLStream *stream)
+{
+    delete stream;
+}
+
+// Processes the XMLSnippet (parsing it as the next part of one long
+// <tool_gear_XML_snippet> document, see UIXMLStream) and process the
+// recognized commands (warning about those not recognized.   Initially
+// XML can be used to execute declareMessageFolder(), addMessage(), and
+// addAboutText() commands.
 // lineNoOffset is used in error messages to relate line in snippet to
 // line in source file (defaults to 0).
 void UIManager::processXMLSnippet (const char *XMLSnippet,
 				   int lineNoOffset)
 {
-    QString wrappedXMLSnippet;
+    XMLCommandList commands;
+
+    parseXMLSnippet (XMLSnippet, lineNoOffset, commands);
+    applyXMLCommands (commands);
+    freeXMLCommands (commands);
+}
+
+// Parses the XMLSnippet as described above, but only records the
+// commands found.  Touches nothing in UIManager except the XML parser
+// state (but creates QStrings, so stays on the GUI thread).
+void UIManager::parseXMLSnippet (const char *XMLSnippet, int lineNoOffset,
+				 XMLCommandList &commands)
+{
+    // Unless TG_XML_PER_SNIPPET was set (so the two approaches can be
+    // compared), just feed the snippet to the streaming parser
+    if (!xmlPerSnippet)
+    {
+	if (xmlStream == NULL)
+	    xmlStream = new UIXMLStream (this);
+
+	// After a parse error, the reader discards the rest of the snippet
+	// and will not parse anything more (and an element left open would
+	// swallow the snippets after it), so start a new stream (and
+	// document) with the next snippet
+	if (!xmlStream->parse (XMLSnippet, lineNoOffset, commands))
+	{
+	    delete xmlStream;
+	    xmlStream = NULL;
+	}
+	return;
+    }
 
+    // Otherwise, wrap the snippet with <tool_gear_XML_snippet> ...
+    // </tool_gear_XML_snippet> to make it a document on its own
+    QString wrappedXMLSnippet;
     wrappedXMLSnippet.sprintf ("<tool_gear_XML_snippet>\n%s\n</tool_gear_XML_snippet>",
 			       XMLSnippet);
+
 #if 0
     // DEBUG
     fprintf (stderr, 
@@ -8940,14 +9900,290 @@ void UIManager::processXMLSnippet (const char *XMLSnippet,
 #endif
 
     // Subtract 1 from offset since adding one line
-    UIXMLParser handler (this, wrappedXMLSnippet, lineNoOffset-1);
+    UIXMLParser handler (this);
+    handler.beginSnippet ((const char *) wrappedXMLSnippet, 1, 0,
+			  lineNoOffset-1, commands);
     QXmlInputSource source;
     source.setData(wrappedXMLSnippet);
     QXmlSimpleReader reader;
     reader.setContentHandler (&handler);
     reader.setErrorHandler (&handler);
     reader.parse(source);
+}
 
+// Replays the records of a .tgb file (see tgb_format.h) into a UIXMLParser,
+// calling it just as UIXMLStream's reader would for the XML the records
+// were converted from.  Like UIXMLStream, one handler sees the whole file
+// (as one document), so element state carries over between snippets.
+class UITGBStream
+{
+public:
+    UITGBStream (UIManager *um) : handler (um), started (FALSE) {}
+
+    // Adds the strings in a strings section, replacing any from firstId on
+    void addStrings (int firstId, const char *data, int size)
+	{
+	    if (firstId > (int) strings.size())
+	    {
+		fprintf (stderr, "Warning: .tgb strings %i to %i missing, "
+			 "expect XML warnings!\n", (int) strings.size(),
+			 firstId - 1);
+	    }
+	    strings.resize (firstId);
+
+	    const char *pos = data, *end = data + size;
+	    unsigned long long count, len;
+	    if (!TGB_readVarint (pos, end, count))
+		count = 0;
+	    for (unsigned long long i = 0; i < count; i++)
+	    {
+		if (!TGB_readVarint (pos, end, len) ||
+		    (len > (unsigned long long) (end - pos)))
+		{
+		    fprintf (stderr, "Warning: Ignoring corrupt .tgb "
+			     "strings section!\n");
+		    return;
+		}
+		strings.push_back (QString::fromUtf8 (pos, (int) len));
+		pos += len;
+	    }
+	}
+
+    // Replays the records in a records section, appending the commands
+    // found to commands
+    void replay (const char *data, int size,
+		 UIManager::XMLCommandList &commands)
+	{
+	    // The whole file is one document
+	    if (!started)
+	    {
+		handler.startDocument ();
+		started = TRUE;
+	    }
+
+	    TGBRecordReader records (data, size);
+	    char number[32];
+	    int len;
+	    bool ok = TRUE;
+	    while (ok && records.next ())
+	    {
+		switch (records.op ())
+		{
+		  case TGB_OP_SNIPPET:
+		    // There is no XML text to show in error messages
+		    handler.beginSnippet ("", 1, 0, (int) records.value (),
+					  commands);
+		    break;
+
+		  case TGB_OP_START:
+		    ok = validString (records.value ());
+		    if (ok)
+		    {
+			int id = (int) records.value ();
+			openNames.push_back (id);
+			handler.startElement (QString::null, QString::null,
+					      strings[id], noAttributes);
+		    }
+		    break;
+
+		  case TGB_OP_END:
+		    ok = !openNames.empty ();
+		    if (ok)
+		    {
+			handler.endElement (QString::null, QString::null,
+					    strings[openNames.back ()]);
+			openNames.pop_back ();
+		    }
+		    break;
+
+		  case TGB_OP_STRING:
+		    ok = validString (records.value ());
+		    if (ok)
+			handler.characters (strings[(int) records.value ()]);
+		    break;
+
+		  case TGB_OP_TEXT:
+		    handler.characters (QString::fromUtf8 (records.text (),
+							  records.textLength ()));
+		    break;
+
+		  case TGB_OP_INT:
+		  case TGB_OP_DOUBLE:
+		    len = records.formatNumber (number);
+		    handler.characters (QString::fromLatin1 (number, len));
+		    break;
+		}
+	    }
+
+	    if (!ok || records.failed ())
+	    {
+		fprintf (stderr, "Warning: Discarding rest of corrupt .tgb "
+			 "records section!\n");
+	    }
+	}
+
+private:
+    bool validString (unsigned long long id)
+	{return (id < (unsigned long long) strings.size ());}
+
+    UIXMLParser handler;
+    QXmlAttributes noAttributes;
+    bool started;
+
+    // The file's string table, by id
+    QValueVector<QString> strings;
+
+    // The names (string ids) of the elements open, innermost last
+    QValueVector<int> openNames;
+};
+
+// Deletes stream (called by ~UIManager, before UITGBStream is declared)
+static void deleteUITGBStream (UITGBStream *stream)
+{
+    delete stream;
+}
+
+void UIManager::addTGBStrings (int firstId, const char *data, int size)
+{
+    if (tgbStream == NULL)
+	tgbStream = new UITGBStream (this);
+    tgbStream->addStrings (firstId, data, size);
+}
+
+void UIManager::parseTGBRecords (const char *data, int size,
+				 XMLCommandList &commands)
+{
+    if (tgbStream == NULL)
+	tgbStream = new UITGBStream (this);
+    tgbStream->replay (data, size, commands);
+}
+
+void UIManager::processTGBRecords (const char *data, int size)
+{
+    XMLCommandList commands;
+
+    parseTGBRecords (data, size, commands);
+    applyXMLCommands (commands);
+    freeXMLCommands (commands);
+}
+
+// Executes the commands recorded by parseXMLSnippet(), in order
+void UIManager::applyXMLCommands (XMLCommandList &commands)
+{
+    for (XMLCommand *command = commands.head; command != NULL; 
+	 command = command->next)
+    {
+	switch (command->kind)
+	{
+	  case XMLCommand::AddMessage:
+	    addMessage (command->arg[0], command->arg[1], command->arg[2]);
+	    break;
+
+	  case XMLCommand::AddMessageRef:
+	    addMessageRef (command->arg[0], command->arg[1], command->arg[2],
+			   command->flag, command->count);
+	    break;
+
+	  case XMLCommand::DeclareMessageFolder:
+	    // If tag already declared, make sure title is the same
+	    // or else print warning.
+	    if (declareMessageFolder (command->arg[0], command->arg[1],
+				      (PolicyIfEmpty) command->flag) == -1)
+	    {
+		// Get existing title
+		QString oldTitle = messageFolderTitle (command->arg[0]);
+
+		if (oldTitle != command->arg[1])
+		{
+		    fprintf (stderr,
+			     "Warning: Tool Gear ignored invalid XML"
+			     " ending on line %i:\n"
+			     "  Redeclaration of message_folder tag "
+			     "'%s' has different title:\n"
+			     "   Orig: '%s'\n"
+			     "    New: '%s'\n"
+			     "  Existing message folder declarations "
+			     "cannot currently be changed!\n\n",
+			     command->lineNo, command->arg[0],
+			     (const char *)oldTitle, command->arg[1]);
+		}
+	    }
+	    break;
+
+	  case XMLCommand::AddSitePriority:
+	    addSitePriority (command->modifier, command->arg[0], 
+			     command->arg[1], command->arg[2]);
+	    break;
+
+	  case XMLCommand::AddAboutText:
+	    addAboutText (command->arg[0], command->flag);
+	    break;
+
+	  case XMLCommand::SetWindowCaption:
+	    setWindowCaption (command->arg[0]);
+	    break;
+
+	  case XMLCommand::SetToolStatus:
+	    emit toolStatusSet (command->arg[0]);
+	    break;
+
+	  case XMLCommand::AddSiteData:
+	    addSiteData (command->arg[0], command->arg[1], command->lines,
+			 command->values, command->count);
+	    break;
+	}
+    }
+}
+
+// Appends a command to commands, copying the string args
+UIManager::XMLCommand *
+UIManager::appendXMLCommand (XMLCommandList &commands, 
+			     XMLCommand::Kind kind, const char *arg0,
+			     const char *arg1, const char *arg2)
+{
+    XMLCommand *command = (XMLCommand *) malloc (sizeof (XMLCommand));
+    if (command == NULL)
+	TG_error ("UIManager::appendXMLCommand: out of memory!");
+
+    command->kind = kind;
+    command->arg[0] = (arg0 != NULL) ? strdup (arg0) : NULL;
+    command->arg[1] = (arg1 != NULL) ? strdup (arg1) : NULL;
+    command->arg[2] = (arg2 != NULL) ? strdup (arg2) : NULL;
+    command->modifier = 0.0;
+    command->flag = 0;
+    command->lineNo = 0;
+    command->lines = NULL;
+    command->values = NULL;
+    command->count = 0;
+    command->next = NULL;
+
+    if (commands.tail != NULL)
+	commands.tail->next = command;
+    else
+	commands.head = command;
+    commands.tail = command;
+    commands.count++;
+
+    return (command);
+}
+
+// Frees every command in commands, leaving it empty
+void UIManager::freeXMLCommands (XMLCommandList &commands)
+{
+    XMLCommand *command, *next;
+    for (command = commands.head; command != NULL; command = next)
+    {
+	next = command->next;
+	free (command->arg[0]);
+	free (command->arg[1]);
+	free (command->arg[2]);
+	free (command->lines);
+	free (command->values);
+	free (command);
+    }
+    commands.head = NULL;
+    commands.tail = NULL;
+    commands.count = 0;
 }
 
 // Include the QT specific code that is automatically
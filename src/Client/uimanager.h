@@ -57,6 +57,9 @@
 // Include an object that collects all the source files we read
 #include "filecollection.h"
 
+// Message bodies fetched from the collector on demand
+#include "messagebodycache.h"
+
 // MessageBuffer for parsing messages into individual lines
 #include "messagebuffer.h"
 
@@ -65,6 +68,8 @@
 
 // Predefine class that are friends of UIManager;
 class UIXMLParser; 
+class UIXMLStream;
+class UITGBStream;
 
 
 //! UI manager, manages overall user interface content and
@@ -95,6 +100,13 @@ public:
     //! Write out snapshot in easy to parse, machine independent format
     void writeSnapshot (FILE *out);
 
+    //! Returns TRUE while a snapshot is being written.  Bodies still
+    //! with the collector are fetched as the snapshot is written, so
+    //! until updatesReleased() is emitted, everything the collector
+    //! sends other than message bodies must be held back (the
+    //! database can't change under the snapshot).
+    bool holdingUpdates () const { return (snapshotDepth > 0); }
+
     //! Adds contents of snapshotName (multiplied by integer 'multiplier').
     /*! To diff to snapshots, load one and then subtract a different one
     // by using multiplier of '-1'.  May be other useful multipliers.
@@ -111,7 +123,8 @@ public:
     //! Inserts a (presumably valid) socket handle for getting data
     //! from the collector process.
     void setRemoteSocket( int sock )
-    {	remoteSocket = sock; sourceCollection->setRemoteSocket( sock ); }
+    {	remoteSocket = sock; sourceCollection->setRemoteSocket( sock );
+	bodyCache.setRemoteSocket( sock ); }
 
     //! Retrieves the socket handle in use.
     int getRemoteSocket() const { return remoteSocket; };
@@ -143,6 +156,16 @@ public:
     void setFullPath( char * fullPath, int id )
     {	sourceCollection->setFullPath( fullPath, id); }
 
+    //! Callback for a source file too big for the collector to send
+    //! whole; buf holds its line count, and lines are fetched as
+    //! they are asked for (see FileCollection::insertWindowedFile)
+    void insertWindowedSourceFile( char * buf, int id )
+    {	sourceCollection->insertWindowedFile( buf, id ); }
+
+    //! Callback for lines of such a file
+    void insertSourceLines( char * buf, int id )
+    {	sourceCollection->insertSourceLines( buf, id ); }
+
     enum functionState  {functionUnparsed=0, functionParseRequested=-1, 
 			 functionParsed=1};
 
@@ -736,6 +759,12 @@ public:
     QString getSourcePath (const char * fileName)
     { 	return sourceCollection->getSourcePath( fileName ); }
 
+    //! Returns TRUE if the source file has been loaded but is too big
+    //! to hold whole, so viewers should ask only for the lines they
+    //! show
+    bool isSourceWindowed (const char * fileName)
+    { 	return sourceCollection->isWindowed( fileName ); }
+
     //! Returns double value for Tool Gear version
     double getToolGearVersion ()
     {
@@ -924,6 +953,28 @@ public:
     int addMessage (const char *messageFolderTag, const char *messageText,
 		    const char *messageTraceback);
 
+    //! Like addMessage(), but messageHeading is just the first line(s)
+    //! of the message.  The bodyLines lines of the rest are left with
+    //! the collector as body bodyIndex (see TGxmlserver -lazy) and
+    //! fetched when messageTextLineRef() or messageText() needs them.
+    //! Return's index of message inserted.
+    int addMessageRef (const char *messageFolderTag, 
+		       const char *messageHeading,
+		       const char *messageTraceback,
+		       int bodyIndex, int bodyLines);
+
+    //! Returns TRUE if the message's body is still with the collector
+    //! (see addMessageRef()).  Lines of such a body returned by
+    //! messageTextLineRef() are only good until its next call.
+    bool messageBodyIsRef (const char *messageFolderTag, 
+			   const char *messageTag);
+
+    //! Inserts the text of body bodyIndex, requested by
+    //! messageTextLineRef().  Called (usually by GUISocketReader)
+    //! when the collector sends it; text is copied.
+    void insertMessageBody (int bodyIndex, const char *text)
+    {	bodyCache.insertBody (bodyIndex, text); }
+
 
     //! Returns the number of messages currently in messageFolder
     int messageCount(const char *messageFolderTag);
@@ -943,7 +994,8 @@ public:
 			      const char *messageTag);
 
     //! Returns actual ptr to a line of the message text
-    //! Note: lineNo starts at 0!
+    //! Note: lineNo starts at 0!  May fetch the message body from the
+    //! collector (see messageBodyIsRef()).
     const char *messageTextLineRef (const char *messageFolderTag, 
 				    const char *messageTag,
 				    int lineNo);
@@ -990,15 +1042,91 @@ public:
     QString sitePriorityLine(const char *sitePriorityTag);
 
 
-    //! Processes the XMLSnippet (first wrapping it with <tool_gear_snippet>
-    //! ... </tool_gear_snippet> to make the XML parser happy with multiple
-    //! snippets) and process the recognized commands (warning about those
+    //! Processes the XMLSnippet (parsing it as the next part of one
+    //! long <tool_gear_XML_snippet> document, so element state carries
+    //! over between snippets) and process the recognized commands (warning about those
     //! not recognized.   Initially XML can be used to execute
     //! declareMessageFolder(), addMessage(), and addAboutText() commands.
     //! lineNoOffset is used in error messages to relate line in snippet to
     //! line in source file (defaults to 0).
     void processXMLSnippet (const char *XMLSnippet, int lineNoOffset = 0);
 
+    //! One UIManager update found in XML by parseXMLSnippet(), held
+    //! until applyXMLCommands() is called.  The strings are private
+    //! malloc'd copies (no Qt data), so commands may be built on a
+    //! thread other than the GUI thread (see GUIIngest).
+    struct XMLCommand
+    {
+	enum Kind {
+	    AddMessage,		  //!< arg: folder tag, text, traceback
+	    AddMessageRef,	  //!< arg: folder tag, heading, traceback;
+				  //!< flag: body index, count: body lines
+	    DeclareMessageFolder, //!< arg: tag, title; flag: ifEmpty
+	    AddSitePriority,	  //!< arg: file, desc, line RegExps
+	    AddAboutText,	  //!< arg: text; flag: prepend
+	    SetWindowCaption,	  //!< arg: caption
+	    SetToolStatus,	  //!< arg: status
+	    AddSiteData		  //!< arg: column tag, file; lines, values
+	};
+	Kind kind;
+	char *arg[3];		//!< Unused or unset args are NULL
+	double modifier;	//!< Priority modifier for AddSitePriority
+	int flag;
+	int *lines;		//!< For AddSiteData, count lines and values
+	double *values;		//!< (malloc'd, NULL otherwise)
+	int count;
+	int lineNo;		//!< Line the command ended on (for warnings)
+	XMLCommand *next;
+    };
+
+    //! XMLCommands in the order they were found
+    struct XMLCommandList
+    {
+	XMLCommandList() : head(NULL), tail(NULL), count(0) {}
+	XMLCommand *head;
+	XMLCommand *tail;
+	int count;
+    };
+
+    //! Appends a new command of the given kind to commands, with
+    //! copies of the (possibly NULL) string args.  Returns the command
+    //! so the caller can fill in modifier, flag and lineNo.
+    static XMLCommand *appendXMLCommand (XMLCommandList &commands,
+					 XMLCommand::Kind kind,
+					 const char *arg0,
+					 const char *arg1 = NULL,
+					 const char *arg2 = NULL);
+
+    //! Frees all the commands in commands and empties the list
+    static void freeXMLCommands (XMLCommandList &commands);
+
+    //! Like processXMLSnippet() but just appends the commands found to
+    //! commands, leaving UIManager untouched.  Uses Qt's XML classes,
+    //! so (with the non-thread Qt we link) must be called from the GUI
+    //! thread.
+    void parseXMLSnippet (const char *XMLSnippet, int lineNoOffset,
+			  XMLCommandList &commands);
+
+    //! Executes (in order) the commands parsed by parseXMLSnippet().
+    //! Must be called from the GUI thread.  Does not free commands.
+    void applyXMLCommands (XMLCommandList &commands);
+
+    //! Adds the strings in a strings section of a .tgb file (see
+    //! tgb_format.h) to the table its records refer to.  firstId is the
+    //! id of the first one; any strings from firstId on are replaced
+    //! (the Collector starts over at 0 if the file is rewritten).
+    //! Same threading rules as parseXMLSnippet().
+    void addTGBStrings (int firstId, const char *data, int size);
+
+    //! Like parseXMLSnippet(), but for a records section of a .tgb file.
+    //! The elements and text recorded are handed straight to the XML
+    //! handler that parseXMLSnippet() uses, without any XML parsing.
+    void parseTGBRecords (const char *data, int size,
+			  XMLCommandList &commands);
+
+    //! Like processXMLSnippet(), for a records section of a .tgb file
+    void processTGBRecords (const char *data, int size);
+
 
     enum ColumnAlign {
 	AlignInvalid = 0,
@@ -1035,6 +1163,22 @@ public:
 			   ColumnAlign align = UIManager::AlignAuto,
 			   int minWidth = 0,
 			   int maxWidth = 1000);
+
+    //! Sets the values of siteColumnTag for count lines of fileName in
+    //! one update: line lines[i] gets values[i] (if a line is given more
+    //! than once, the last value wins).  Lines must be >= 1.  Meant for
+    //! whole-file line profiles, where one call per line would be far
+    //! too slow.
+    void addSiteData (const char *siteColumnTag, const char *fileName,
+		      const int *lines, const double *values, int count);
+
+    //! Returns the value of siteColumnTag for line of fileName,
+    //! NULL_DOUBLE if not set
+    double siteDataValue (const char *siteColumnTag, const char *fileName,
+			  int line);
+
+    //! Returns the number of lines of fileName with siteColumnTag values
+    int siteDataLineCount (const char *siteColumnTag, const char *fileName);
     
 signals:
     //! Called just after new file inserted (by insertFile()
@@ -1160,8 +1304,20 @@ signals:
     //! Called when new tool status is specified by the tool
     void toolStatusSet (const char *status);
 
+    //! Called once after each addSiteData() (not once per line)
+    void siteDataAdded (const char *siteColumnTag, const char *fileName,
+			int count);
+
+    //! Called when a snapshot has been written, so updates held back
+    //! while it was (see holdingUpdates()) may now be applied
+    void updatesReleased ();
+
 protected:
 
+    //! Constructor helper that sets mainFont and labelFont (needs a
+    //! display, so batch clients skip it)
+    void initFonts ();
+
     //! Internal addSnapshot() helper routine to get first entry in a section
     //! Punts on any error (indicating addSnapshot() had error)
     MD_Entry *SSGetFirstEntry(MD *sd, const char *sectionName);
@@ -1598,20 +1754,21 @@ protected:
 
     //! Only warn about unknown XML elements once per UIManager
     //! Use int to store level mask, so warn for each level
-    //! (each snippet parsed separately, so cannot put in XML parser)
+    //! (snippets may be parsed by separate parsers, so cannot put in
+    //! XML parser)
     StringTable<int> unknownXMLTable;
 
-    //! Used to map XML elements to ids.   Only want to populate mapping
-    //! table once, so put this in UIManager.  However, since all
-    //! the enums are in a subclass, we are forced to hold a void pointer
-    //! for XML parser map.  We have to call a explicit delete routine
-    //! on deletion of UIManager to free memory
-    struct XML_Token {
-	XML_Token(int t, unsigned int l) : token(t), levelMask(l) {}
-	int token;
-	unsigned int levelMask;
-    };
-    StringTable<XML_Token> xmlTokenTable;
+    //! The parser parseXMLSnippet() feeds snippets to (NULL until the
+    //! first snippet and after parse errors).  Not used if xmlPerSnippet.
+    UIXMLStream *xmlStream;
+
+    //! TRUE if each snippet should be parsed by a new parser, as was
+    //! done before UIXMLStream (set by TG_XML_PER_SNIPPET)
+    bool xmlPerSnippet;
+
+    //! The string table and XML handler for .tgb records (NULL until
+    //! the first strings or records arrive)
+    UITGBStream *tgbStream;
 
 private:
     //! Event loop with which this object is associated
@@ -1770,6 +1927,9 @@ private:
     //! source file information that may reside on the remote system.
     int remoteSocket;
 
+    //! Snapshots being written (see holdingUpdates())
+    int snapshotDepth;
+
     //! Font to be used for drawing in main text areas
     QFont mainFont;
 
@@ -1831,6 +1991,37 @@ private:
     //! Share the collection of source files among all instances.
     static FileCollection * sourceCollection;
 
+    //! Bodies of messages added with addMessageRef(), as they are needed
+    MessageBodyCache bodyCache;
+
+    //! Bodies still with the collector, streamed into a snapshot as it
+    //! is written (see snapshotEntryHook())
+    struct SnapshotBodies
+    {
+	UIManager *um;
+	int *bodyIndex;		//!< Each of them, in the order written
+	int count;
+	int next;		//!< Next to be written
+	int requested;		//!< How many have been asked for
+	MD_Section *section;	//!< Section of the last entry seen
+	MD_Field_Decl *textDecl;	//!< Its message decls (or NULL)
+	MD_Field_Decl *bodyRefDecl;
+	MD_Entry *filledEntry;	//!< Entry given its body, if any
+	int headingLines;	//!< Its lines before the body
+	int refIndex;		//!< Its body ref, removed while written
+	int refLines;
+    };
+
+    //! Lists the bodies still with the collector, in snapshot order
+    void startSnapshotBodies (SnapshotBodies &bodies);
+    //! MD_Entry_Hook that gives each message its whole body while it is
+    //! written to a snapshot, then takes it away again
+    static void snapshotEntryHook (MD_Entry *entry, int done, void *arg);
+    void fillSnapshotBody (SnapshotBodies &bodies, MD_Entry *entry);
+    void emptySnapshotBody (SnapshotBodies &bodies, MD_Entry *entry);
+    //! Frees the list and releases any updates held back
+    void finishSnapshotBodies (SnapshotBodies &bodies);
+
     //! Cache pixmap definitions for efficiency.
     StringTable<PixmapInfo> pixmapInfoTable;
 
@@ -1859,16 +2050,19 @@ private:
         INT_Symbol_Table *indexMap;
 	MD_Field_Decl *messageTextDecl;
         MD_Field_Decl *messageTracebackDecl;
+	MD_Field_Decl *messageBodyRefDecl;
         MessageFolderInfo (MD_Section *_messageSection,
 		  MD_Field_Decl *_indexDecl, 
                   INT_Symbol_Table *_indexMap,
                   MD_Field_Decl *_messageTextDecl, 
- 		  MD_Field_Decl *_messageTracebackDecl) :
+ 		  MD_Field_Decl *_messageTracebackDecl,
+		  MD_Field_Decl *_messageBodyRefDecl = NULL) :
 	    messageSection(_messageSection),
 	    indexDecl(_indexDecl),
 	    indexMap(_indexMap),
 	    messageTextDecl(_messageTextDecl),
-	    messageTracebackDecl(_messageTracebackDecl)
+	    messageTracebackDecl(_messageTracebackDecl),
+	    messageBodyRefDecl(_messageBodyRefDecl)
 	    {}
 
         ~MessageFolderInfo() {}
@@ -1877,6 +2071,29 @@ private:
     //! Cache message folder info for efficiency.
     StringTable<MessageFolderInfo> messageFolderInfoTable;
 
+    //! Values of one site column for the lines of one file, as line,
+    //! value pairs sorted by line.  Kept sparse, since the lines given
+    //! may be anywhere up to INT_MAX; a value is found by binary search.
+    struct SiteDataInfo
+    {
+	int *line;
+	double *value;
+	int count;		//!< Lines that have a value
+	int size;		//!< Pairs there is room for
+	SiteDataInfo() : line(NULL), value(NULL), count(0), size(0) {}
+	~SiteDataInfo() {free (line); free (value);}
+    };
+
+    //! Site data added by addSiteData(), indexed by siteColumnTag, then
+    //! by fileName.  Only stored for now: no view shows site columns
+    //! yet, and snapshots don't hold it.
+    StringTable< StringTable<SiteDataInfo> > siteDataTable;
+
+    //! Returns the SiteDataInfo for siteColumnTag and fileName, NULL
+    //! if there isn't one yet and create is FALSE
+    SiteDataInfo *findSiteData (const char *siteColumnTag, 
+				const char *fileName, bool create);
+
     //! MessageBuffer used for parsing message text and traceback locations
     //! into individual lines (automatically resizes to hold any length)
     MessageBuffer lineBuf;
@@ -35,6 +35,9 @@
 #include "lineparser.h"
 #include "tempcharbuf.h"
 #include "messagebuffer.h"
+#include "snippet_reader.h"
+#include "xml_token_table.h"
+#include "file_follower.h"
 #include "logfile.h"
 #include "tg_time.h"
 #include "qxml.h"
@@ -74,13 +77,6 @@ void declareFolder (FILE *out, const char *folderTag,
 }
 
 
-//! Used to map XML elements to ids.  
-struct XML_Token {
-    XML_Token(int t, unsigned int l) : token(t), levelMask(l) {}
-    int token;
-    unsigned int levelMask;
-};
-
 //! Used to hold state for sorting messages based on count
 class ErrorInfo
 {
@@ -100,9 +96,6 @@ public:
 	// Create unknownXML table that frees levelmask on delete
 	unknownXMLTable("unknownXML", DeleteData, 0),
 	
-	// Create xmlToken table that frees XML_Token structures on delete
-	xmlTokenTable("xmlToken", DeleteData, 0),
-
 	// Create message table that uses free to free string on delete
 	messageTable ("message", FreeData, 0),
 	
@@ -122,9 +115,6 @@ public:
     //! (each snippet parsed separately, so cannot put in XML parser)
     StringTable<int> unknownXMLTable;
 
-    //! Only want to populate mapping table once, so put this here.  
-    StringTable<XML_Token> xmlTokenTable;
-
     //! Want to print out messages annotated with counts at end.
     //! Store XML for message for later annotation, indixed by unique
     StringTable<char> messageTable;
@@ -163,14 +153,29 @@ public:
     FILE *xmlOut;
 };
 
+// Top-level Valgrind XML elements XMLSnippetParser looks for
+enum SnippetTag {
+    ST_VALGRINDOUTPUT = 0, ST_XML_DECL, ST_PROTOCOLVERSION, ST_PREAMBLE,
+    ST_PID, ST_PPID, ST_TOOL, ST_USERCOMMENT, ST_ARGS, ST_STATUS, ST_ERROR,
+    ST_ERRORCOUNTS, ST_SUPPCOUNTS
+};
+static const char * const snippetTagNames[] = {
+    "valgrindoutput", "?xml", "protocolversion", "preamble",
+    "pid", "ppid", "tool", "usercomment", "args", "status", "error",
+    "errorcounts", "suppcounts"
+};
+
 //! Class for incrementally grabbing coherient Tool Gear XML snippets from
 //! a file.   
 class XMLSnippetParser
 {
 public:
-    XMLSnippetParser (FILE *file_in) : in (file_in), partialParse(FALSE),
-				       lastLT(0), lineNo(1),
-				       snippetLineOffset(0)
+    XMLSnippetParser (FILE *file_in) : reader (file_in),
+				       tags (snippetTagNames,
+					     sizeof(snippetTagNames) /
+					     sizeof(snippetTagNames[0])),
+				       partialParse(FALSE),
+				       lastLT(0), snippetLineOffset(0)
 	{
 	}
     const char *getNextSnippet(MemcheckInfo *mcinfo)
@@ -196,233 +201,107 @@ public:
 		lastLT = 0;
 
 		// Record how many lines skipped before the snippet
-		snippetLineOffset = lineNo-1;
+		snippetLineOffset = reader.lineNumber()-1;
 	    }
 	    
-	    // Read characters until run out of characters or hit
+	    // Read a tag at a time until run out of input or hit
 	    // the end of a snippet
-	    int ch;
-	    while ((ch = fgetc(in)) != EOF)
+	    for (;;)
 	    {
 		// Check for bad XML, either because of Valgrind FATAL error
 		// or because a non-xml Valgrind file was passed to this
 		// parser.  Need to check when hit '<', '>' or 'EOF' in
 		// order to catch the cases before other sanity checks fail.
 		// Optimize a little by only doing check when lastLT == 0.
-		if ((lastLT == 0) && 
-		    ((ch == '<') || (ch == '>')))
+		bool checkText = (lastLT == 0);
+
+		if (!reader.appendToTagEnd (sbuf, lastLT))
+		    break;
+
+		if (checkText && hasUnexpectedText (TRUE))
 		{
-		    // Get current partial contents to test
-		    const char *scanPtr = sbuf.contents();
-		    
-		    // Skip leading whitespace on contents
-		    while ((*scanPtr != 0) && isspace(*scanPtr))
-			scanPtr++;
-		    
-		    // Expect scanPtr to either now be empty or start 
-		    // with '<'.   
-		    if ((*scanPtr != 0) && (*scanPtr != '<'))
-		    {
-			// Have fatal parse error, append rest of text
-			// available for reading before output message
-			// (because random '<' and '>' will truncate the
-			// message otherwise
-			sbuf.appendChar(ch);
-			while ((ch = fgetc(in)) != EOF)
-			{
-			    sbuf.appendChar(ch);
-			}
-			
-			// Get pointer to completed buffer now (old scanPtr
-			// no longer valid
-			scanPtr = sbuf.contents();
-
-			// Skip leading whitespace on contents
-			while ((*scanPtr != 0) && isspace(*scanPtr))
-			    scanPtr++;
-
-			// Get local copy of unexpected text before
-			// using sbuf to write out error message.
-			QString unexpectedText = scanPtr;
-			
-			// Warn users that something weird has happened 
-			fprintf (stderr, 
-				 "\nError: Unexpected text in Valgrind XML "
-				 "file:\n"
-				 "%s\n"
-				 "Assuming FATAL Valgrind error has occurred "
-				 "(since not valid XML).\n",
-				 unexpectedText.latin1());
-			
-			// Create fake XML from error detected
-			sbuf.sprintf ("<FATAL>%s</FATAL>\n",
-				      unexpectedText.latin1());
-			
-			// Mark that we have reached the end of the XML
-			mcinfo->xmlEnded = 1;
-			
-			// Indicate memcheck terminated abnormally
-			fprintf (mcinfo->xmlOut,
-				 "<status> XML parse error (assuming fatal "
-				 "Valgrind error has occurred)</status>\n");
-			
-			fflush (mcinfo->xmlOut);
-			
-			// Treat as if have valid XML FATAL snippet
-			partialParse = FALSE;
-			return (sbuf.contents());
-		    }
+		    // Have fatal parse error, append rest of text
+		    // available for reading before output message
+		    // (because random '<' and '>' will truncate the
+		    // message otherwise
+		    reader.appendRest (sbuf);
+		    return (fatalSnippet (mcinfo));
 		}
 
-		// If got '<', get index in string we are going to place it
-		if (ch == '<')
+		// Get pointer to last element or end of element marker
+		const char *element = sbuf.contents() + lastLT;
+		bool isEnd;
+		int tag = SnippetReader::classifyTag (element, tags, isEnd);
+		    
+		// DEBUG
+//		fprintf (stderr, "Last element: '%s' (%i-%i)\n", element,
+//			 lastLT, sbuf.strlen());
+
+		// Is it a start valgrindoutput marker or
+		// a start <?xml version="1.0"?> marker?
+		if (!isEnd && ((tag == ST_VALGRINDOUTPUT) ||
+			       (tag == ST_XML_DECL)))
 		{
-		    // The last '<' will be placed at the end of the string
-		    lastLT = sbuf.strlen();
+//		    fprintf (stderr, "Deleting valgrind marker '%s'!\n",
+//			     element);
+		    sbuf.truncate(lastLT);
 		}
 
-		// Add character to end of snippet buffer
-		sbuf.appendChar(ch);
+		// Only end of element markers matter otherwise
+		else if (!isEnd || (tag < 0) || (tag == ST_XML_DECL))
+		{
+		}
 
-		// If got '>', see if at end of known snippet terminator
-		if (ch == '>')
+		// Is it a end valgrindoutput marker?
+		else if (tag == ST_VALGRINDOUTPUT)
 		{
-		    // Get pointer to last element or end of element marker
-		    const char *element = sbuf.contents() + lastLT;
-		    
-		    // DEBUG
-//		    fprintf (stderr, "Last element: '%s' (%i-%i)\n", element,
-//			     lastLT, sbuf.strlen());
 
+//		    fflush (stdout);
+//		    fprintf (stderr, "Deleting valgrind marker '%s'!\n",
+//			     element);
+
+		    // Mark that we have reached the end of the XML
+		    mcinfo->xmlEnded = 1;
+
+		    // Indicate memcheck exited normally
+		    fprintf (mcinfo->xmlOut,
+			     "<status>Memcheck exited "
+			     "normally</status>\n"
+			     "\n");
+		    fflush (mcinfo->xmlOut);
 
-		    // Is it a start valgrindoutput marker?
-		    if (isStartElement (element, "valgrindoutput"))
-		    {
-//			fprintf (stderr, "Deleting valgrind marker '%s'!\n",
-//				 element);
-			sbuf.truncate(lastLT);
-		    }
-		    // Is it a start <?xml version="1.0"?> marker?
-		    else if (isStartElement (element, "?xml"))
-		    {
-//			fprintf (stderr, "Deleting xml version marker '%s'!\n",
-//				 element);
-			sbuf.truncate(lastLT);
-		    }
 
-		    // Is it a end of element marker we recognize?
-		    else if (isEndElement (element, "protocolversion") ||
-			     isEndElement (element, "preamble") ||
-			     isEndElement (element, "pid") ||
-			     isEndElement (element, "ppid") ||
-			     isEndElement (element, "tool") ||
-			     isEndElement (element, "usercomment") ||
-			     isEndElement (element, "args") ||
-			     isEndElement (element, "status") ||
-			     isEndElement (element, "error") ||
-			     isEndElement (element, "errorcounts") ||
-			     isEndElement (element, "suppcounts"))
+		    sbuf.truncate(lastLT);
+
+		    // If has XML in there, return it now
+		    if (strchr (sbuf.contents(), '<') != NULL)
 		    {
-//			fprintf (stderr, "End snippet marker %s detected!\n", 
-//				 element);
+			fprintf (stderr, 
+				 "\nTool Gear Valgrind XML Parser Warning: \n"
+				 "   Unrecognized XML at end, sending:\n"
+				 "   '%s'\n",
+				 sbuf.contents());
 			partialParse = FALSE;
 			return (sbuf.contents());
 		    }
-
-		    // Is it a end valgrindoutput marker?
-		    else if (isEndElement (element, "valgrindoutput"))
-		    {
-
-//			fflush (stdout);
-//			fprintf (stderr, "Deleting valgrind marker '%s'!\n",
-//				 element);
-
-			// Mark that we have reached the end of the XML
-			mcinfo->xmlEnded = 1;
-
-			// Indicate memcheck exited normally
-			fprintf (mcinfo->xmlOut,
-				 "<status>Memcheck exited "
-				 "normally</status>\n"
-				 "\n");
-			fflush (mcinfo->xmlOut);
-
-
-			sbuf.truncate(lastLT);
-
-			// If has XML in there, return it now
-			const char *ptr = sbuf.contents();
-			char ch;
-			while ((ch=*ptr) != 0)
-			{
-			    if (ch == '<')
-			    {
-				fprintf (stderr, 
-					 "\nTool Gear Valgrind XML Parser Warning: \n"
-					 "   Unrecognized XML at end, sending:\n"
-					 "   '%s'\n",
-					 sbuf.contents());
-				partialParse = FALSE;
-				return (sbuf.contents());
-			    }
-			    ptr++;
-			}
-		    }
 		}
 
-		// Increment line number if newline
-		if (ch == '\n')
-		    ++lineNo;
-	    }
-
-	    // Detect Valgrind printing out error message (not in XML in 
-	    // Valgrind 3.0.1, may be in later versions)
-	    // Only do test if sbuf is not empty
-	    if (sbuf.strlen() > 0)
-	    {
-		// Get current partial contents to test
-		const char *scanPtr = sbuf.contents();
-		
-		// Skip leading whitespace on contents
-		while ((*scanPtr != 0) && isspace(*scanPtr))
-		    scanPtr++;
-		
-		// Expect scanPtr to either now be empty or start with '<'.   
-		if ((*scanPtr != 0) && (*scanPtr != '<'))
+		// Must be an end of element marker we recognize
+		else
 		{
-		    // Get local copy of unexpected text before
-		    // using sbuf to write out error message.
-		    QString unexpectedText = scanPtr;
-		    
-		    // Warn users that something weird has happened 
-		    fprintf (stderr, 
-			     "\nError: Unexpected text in Valgrind XML "
-			     "file:\n"
-			     "%s\n"
-			     "Assuming FATAL Valgrind error has occurred "
-			     "(since not valid XML).\n",
-			     unexpectedText.latin1());
-		    
-		    // Create fake XML from error detected
-		    sbuf.sprintf ("<FATAL>%s</FATAL>\n",
-				  unexpectedText.latin1());
-		    
-		    // Mark that we have reached the end of the XML
-		    mcinfo->xmlEnded = 1;
-		    
-		    // Indicate memcheck terminated abnormally
-		    fprintf (mcinfo->xmlOut,
-			     "<status> XML parse error (assuming fatal "
-			     "Valgrind error has occurred)</status>\n");
-		    
-		    fflush (mcinfo->xmlOut);
-		    
-		    // Treat as if have valid XML FATAL snippet
+//		    fprintf (stderr, "End snippet marker %s detected!\n", 
+//			     element);
 		    partialParse = FALSE;
 		    return (sbuf.contents());
 		}
 	    }
 
+	    // Detect Valgrind printing out error message (not in XML in 
+	    // Valgrind 3.0.1, may be in later versions)
+	    // Only do test if sbuf is not empty
+	    if ((sbuf.strlen() > 0) && hasUnexpectedText (FALSE))
+		return (fatalSnippet (mcinfo));
+
 	    // If got here, must be in partial parse
 	    partialParse = TRUE;
 
@@ -434,75 +313,85 @@ public:
     // Returns the number of lines skipped/processed before the snippet
     int getSnippetOffset () {return (snippetLineOffset);}
 
-private:
-    bool isEndElement (const char *element, const char *name)
+    // Throws away any partial snippet and starts over at line 1, for
+    // when the input file has been truncated or replaced
+    void restart ()
 	{
-	    // Expect element[0] == '<'
-	    if (element[0] != '<')
-	    {
-		fprintf (stderr, "Error in XMLSnippetParser::isEndElement: \n"
-			 "  Expect < not '%c' in '%s'!\n", element[0],
-			 element);
-		exit (1);
-	    }
+	    reader.restart();
+	    partialParse = FALSE;
+	}
 
-	    // For now, treat as end element only if starts with </
-	    // (Not expecting <foo/> right now as select ending element)
-	    if (element [1] != '/')
-		return (FALSE);
+private:
+    //! Returns TRUE if the snippet so far starts (after white space) with
+    //! something other than '<'.  If atTag, sbuf ends with the '>' just
+    //! read, which only counts as following the unexpected text if that
+    //! text began before it.
+    bool hasUnexpectedText (bool atTag)
+	{
+	    // Get current partial contents to test
+	    const char *contents = sbuf.contents();
+	    const char *scanPtr = contents;
 	    
-	    // Get length of name to limit search
-	    int nameLen = strlen (name);
+	    // Skip leading whitespace on contents
+	    while ((*scanPtr != 0) && isspace(*scanPtr))
+		scanPtr++;
 	    
-	    // Expect name to follow / if end element of this name
-	    if (strncmp (&element[2], name, nameLen) != 0)
+	    // Expect scanPtr to either now be empty or start with '<'.   
+	    if ((*scanPtr == 0) || (*scanPtr == '<'))
 		return (FALSE);
-
-	    // Have </name but need to make sure 'name' not part of
-	    // longer name by testing character after name in element
-	    // (that is, distinguish </message> from </message_folder>
-	    int nextChar = element[2+nameLen];
-	    if ((nextChar != '>') && !isspace(nextChar))
+	    if (atTag && (scanPtr - contents == sbuf.strlen() - 1))
 		return (FALSE);
-
-	    // If got here, must be end element for 'name'
 	    return (TRUE);
 	}
 
-    bool isStartElement (const char *element, const char *name)
+    //! Replaces the snippet with a <FATAL> snippet holding the unexpected
+    //! text, since Valgrind must have died (or this isn't Valgrind XML)
+    const char *fatalSnippet (MemcheckInfo *mcinfo)
 	{
-	    // Expect element[0] == '<'
-	    if (element[0] != '<')
-	    {
-		fprintf (stderr, "Error in XMLSnippetParser::isStartElement: "
-			 "Expect < not '%c' in '%s'!\n", element[0], element);
-		exit (1);
-	    }
-
-	    // Get length of name to limit search
-	    int nameLen = strlen (name);
-	    
-	    // Expect name to follow < if start element of this name
-	    if (strncmp (&element[1], name, nameLen) != 0)
-		return (FALSE);
+	    // Get pointer to completed buffer
+	    const char *scanPtr = sbuf.contents();
 
-	    // Have <name but need to make sure 'name' not part of
-	    // longer name by testing character after name in element
-	    // (that is, distinguish <message> from <message_folder>
-	    int nextChar = element[1+nameLen];
-	    if ((nextChar != '>') && !isspace(nextChar))
-		return (FALSE);
+	    // Skip leading whitespace on contents
+	    while ((*scanPtr != 0) && isspace(*scanPtr))
+		scanPtr++;
 
-	    // If got here, must be end element for 'name'
-	    return (TRUE);
+	    // Get local copy of unexpected text before
+	    // using sbuf to write out error message.
+	    QString unexpectedText = scanPtr;
+	    
+	    // Warn users that something weird has happened 
+	    fprintf (stderr, 
+		     "\nError: Unexpected text in Valgrind XML "
+		     "file:\n"
+		     "%s\n"
+		     "Assuming FATAL Valgrind error has occurred "
+		     "(since not valid XML).\n",
+		     unexpectedText.latin1());
+	    
+	    // Create fake XML from error detected
+	    sbuf.sprintf ("<FATAL>%s</FATAL>\n",
+			  unexpectedText.latin1());
+	    
+	    // Mark that we have reached the end of the XML
+	    mcinfo->xmlEnded = 1;
+	    
+	    // Indicate memcheck terminated abnormally
+	    fprintf (mcinfo->xmlOut,
+		     "<status> XML parse error (assuming fatal "
+		     "Valgrind error has occurred)</status>\n");
+	    
+	    fflush (mcinfo->xmlOut);
+	    
+	    // Treat as if have valid XML FATAL snippet
+	    partialParse = FALSE;
+	    return (sbuf.contents());
 	}
 
-
+    SnippetReader reader;
+    XMLTokenTable tags;
     MessageBuffer sbuf;
-    FILE *in;
     bool partialParse;
     int lastLT;
-    int lineNo;
     int snippetLineOffset;
 };
 
@@ -560,88 +449,6 @@ public:
         mcinfo(mci), xml_out(out), xml_text(xml), lineOffset(lineNoOffset),
 	lineNoGuess(1) 
 	{
-	    // Populate XML id table, if not already populated
-	    if (!mcinfo->xmlTokenTable.entryExists("error"))
-	    {
-
-		// Use C preprocessor tricks to prevent mistakes and
-		// make it easier.   The #name expands to "(name)"
-		// and XML_##name expands to the value defined for
-		// XML_(name).
-#define declareToken(name,level) declareToken_(#name,XML_##name,level)
-
-//		fprintf (stderr, "Initializing xmlTokenTable!\n");
-
-		// Declare all the valid tokens and the levels they
-		// are expected to occur on
-
-		// protocolversion token
-		declareToken(protocolversion, 0);
-
-		// preamble tokens
-		declareToken(preamble, 0);
-		declareToken(line, 1);
-		
-		// pid token
-		declareToken(pid, 0);
-
-		// ppid token
-		declareToken(ppid, 0);
-
-		// tool token
-		declareToken(tool, 0);
-
-		// usercomment tokens (inserted by memcheck scripts)
-		declareToken(usercomment, 0);
-		declareToken(date, 1);
-		declareToken(hostname, 1);
-		declareToken(rank, 1);
-
-		// argv tokens
-		declareToken(args, 0);
-		declareToken(vargv, 1);
-		declareToken(argv, 1);
-		declareToken(exe, 2);
-		declareToken(arg, 2);
-		
-		// error tokens
-		declareToken(error, 0);
-		declareToken(unique, 1);
-		declareToken(tid, 1);
-		declareToken(kind, 1);
-		declareToken(what, 1);
-		declareToken(leakedbytes, 1);
-		declareToken(leakedblocks, 1);
-		declareToken(stack, 1);
-		declareToken(frame, 2);
-		declareToken(ip, 3);
-		declareToken(obj, 3);
-		declareToken(fn, 3);
-		declareToken(dir, 3);
-		declareToken(file, 3);
-		declareToken(line, 3);
-		declareToken(auxwhat, 1);
-
-		// errorcounts tokens
-		declareToken(errorcounts, 0);
-		declareToken(pair, 1);
-		declareToken(count, 2);
-		declareToken(unique, 2);
-
-		// status tokens
-		declareToken(status, 0);
-		declareToken(state, 1);
-		declareToken(time, 1);
-
-		// suppcounts tokens
-		declareToken(suppcounts, 0);
-		declareToken(pair, 1);
-		declareToken(count, 2);
-		declareToken(name, 2);
-
-		// FATAL tokens (created by get_snippet when weirdnes happens)
-		declareToken(FATAL, 0);
-	    }
 	}
 
     bool startDocument() 
@@ -936,72 +743,25 @@ private:
 	    return (val);
 	}
 
-    XMLElementToken getToken (const char *name, int nestLevel)
+    XMLElementToken getToken (const QString &name, int nestLevel)
 	{
+	    // Unknown names and names not valid at nestLevel are unknown
+	    int token = tokenTable.lookup (name.latin1(), name.length(),
+					   nestLevel);
+	    if (token < 0)
+		return (XML_unknown);
 
-	    // Set the appropriate bit to test/set for this nestLevel
-	    int levelBit;
-		
-	    // Use a bit for each level below 31.  Treat all levels
-	    // above 31 the same (don't expect that deep but who knows)
-	    if (nestLevel < 31)
-		levelBit= (1 << nestLevel);
-	    else
-		levelBit=(1 << 31);
-
-	    // Default to unknown token;
-	    XMLElementToken token = XML_unknown;
-
-	    // Is token in table?
-	    XML_Token *entry = mcinfo->xmlTokenTable.findEntry(name);
-	    
-	    // Yes, token in table
-	    if (entry != NULL)
-	    {
-		// Set token if levelBit is in levelMask
-		if ((entry->levelMask & levelBit) != 0)
-		    token = (XMLElementToken)entry->token;
-	    }
-
-//	    fprintf (stderr, "getToken(%s, %i) returns %i\n", name, nestLevel,
-//		     (int)token);
+//	    fprintf (stderr, "getToken(%s, %i) returns %i\n", name.latin1(),
+//		     nestLevel, token);
 
 	    // Return token found
-	    return (token);
+	    return ((XMLElementToken) token);
 	}
 
-    // Utility funciton for constructor
-    void declareToken_(const char *name, XMLElementToken token, int nestLevel)
-	{
-//	    fprintf (stderr, "declareToken_(%s, %i, %i)\n",
-//		     name, token, nestLevel);
-
-	    // Set the appropriate bit to test/set for this nestLevel
-	    int levelBit;
-		
-	    // Use a bit for each level below 31.  Treat all levels
-	    // above 31 the same (don't expect that deep but who knows)
-	    if (nestLevel < 31)
-		levelBit= (1 << nestLevel);
-	    else
-		levelBit=(1 << 31);
-
-	    // Is it already in table?
-	    XML_Token *entry = mcinfo->xmlTokenTable.findEntry(name);
-	    
-	    // Yes, add this levelBit to it
-	    if (entry != NULL)
-	    {
-		entry->levelMask |= levelBit;
-	    }
-
-	    // No, create entry and add to table
-	    else
-	    {
-		entry = new XML_Token((int) token, levelBit);
-		mcinfo->xmlTokenTable.addEntry(name, entry);
-	    }
-	}
+    // The valid element names and the levels they are expected to
+    // occur on (see declareToken below), and the table made from them
+    static const XMLTokenDecl tokenDecls[];
+    static const XMLTokenTable tokenTable;
 
     MemcheckInfo *mcinfo;
     FILE *xml_out;
@@ -1080,6 +840,89 @@ private:
     int lineNoGuess;
 };
 
+// Use C preprocessor tricks to prevent mistakes and make it easier.   The
+// #name expands to "(name)" and XML_##name expands to the value defined
+// for XML_(name).  Names may be declared for more than one level.
+#define declareToken(name,level) {#name, XML_##name, XML_TOKEN_LEVEL(level)}
+
+// Declare all the valid tokens and the levels they are expected to occur on
+const XMLTokenDecl MCXMLParser::tokenDecls[] = {
+    // protocolversion token
+    declareToken(protocolversion, 0),
+
+    // preamble tokens
+    declareToken(preamble, 0),
+    declareToken(line, 1),
+
+    // pid token
+    declareToken(pid, 0),
+
+    // ppid token
+    declareToken(ppid, 0),
+
+    // tool token
+    declareToken(tool, 0),
+
+    // usercomment tokens (inserted by memcheck scripts)
+    declareToken(usercomment, 0),
+    declareToken(date, 1),
+    declareToken(hostname, 1),
+    declareToken(rank, 1),
+
+    // argv tokens
+    declareToken(args, 0),
+    declareToken(vargv, 1),
+    declareToken(argv, 1),
+    declareToken(exe, 2),
+    declareToken(arg, 2),
+
+    // error tokens
+    declareToken(error, 0),
+    declareToken(unique, 1),
+    declareToken(tid, 1),
+    declareToken(kind, 1),
+    declareToken(what, 1),
+    declareToken(leakedbytes, 1),
+    declareToken(leakedblocks, 1),
+    declareToken(stack, 1),
+    declareToken(frame, 2),
+    declareToken(ip, 3),
+    declareToken(obj, 3),
+    declareToken(fn, 3),
+    declareToken(dir, 3),
+    declareToken(file, 3),
+    declareToken(line, 3),
+    declareToken(auxwhat, 1),
+
+    // errorcounts tokens
+    declareToken(errorcounts, 0),
+    declareToken(pair, 1),
+    declareToken(count, 2),
+    declareToken(unique, 2),
+
+    // status tokens
+    declareToken(status, 0),
+    declareToken(state, 1),
+    declareToken(time, 1),
+
+    // suppcounts tokens
+    declareToken(suppcounts, 0),
+    declareToken(pair, 1),
+    declareToken(count, 2),
+    declareToken(name, 2),
+
+    // FATAL tokens (created by get_snippet when weirdnes happens)
+    declareToken(FATAL, 0)
+};
+
+#undef declareToken
+
+// Built once at startup (a perfect hash, so looking up each element is
+// just one hash and compare)
+const XMLTokenTable MCXMLParser::tokenTable (MCXMLParser::tokenDecls,
+					     sizeof (MCXMLParser::tokenDecls) /
+					     sizeof (XMLTokenDecl));
+
 bool MCXMLParser::startElement( const QString&, const QString&, 
 				const QString& elementName,
 				const QXmlAttributes& )
@@ -2753,6 +2596,10 @@ int main (int argc, char *argv[])
     // DEBUG, create XML parser
     XMLSnippetParser  XMLParser (in);
 
+    // Follow the file as Valgrind writes it (see file_follower.h),
+    // looking at it every .1 seconds if we can't be told when it changes
+    FileFollower follower (memcheck_file_name, fd, 100, TRUE);
+
     parse_input (&mcinfo, XMLParser, xml_out);
 
 
@@ -2767,49 +2614,45 @@ int main (int argc, char *argv[])
     }
 
     // For now, allow parser to go approximately 10 hours without 
-    // seeing XML before giving up and exiting.   I say approximate
-    // since nanosleep calls are not delaying as long as expected.
+    // seeing XML before giving up and exiting.
     while ((!mcinfo.xmlEnded) && (mcinfo.minutesIdle < 600))
     {
 	// DEBUG 
 //	fprintf (stderr, "Minutes idle %i\n", mcinfo.minutesIdle);
 
-	// Spin for a minute before updating idle minutes
-	for (int seconds = 0; (!mcinfo.xmlEnded) && (seconds < 60); seconds++)
+	// Wait for a minute before updating idle minutes
+	double minuteEnd = TG_time() + 60.0;
+	while ((!mcinfo.xmlEnded) && (TG_time() < minuteEnd))
 	{
-	    // Check for new messages 10 times a second
-	    for (int tenths = 0; (!mcinfo.xmlEnded) && (tenths < 10); tenths++)
-	    {
-		// Sleep for .1 seconds (I hope)
-		struct timespec mytimespec;
-		mytimespec.tv_sec = 0;
-		mytimespec.tv_nsec = 100000000;
-		nanosleep (&mytimespec, NULL);
-		parse_input (&mcinfo, XMLParser, xml_out);	
-
-		// Make sure parent hasn't gone away
-		long cur_ppid = getppid();
-		if (cur_ppid != initial_ppid)
-		{
-		    // Assume parent killed, die now in graceful way
-		    fprintf (stderr, "\nWarning: MemcheckView termination "
-			     "detected. "
-			     "Exiting Valgrind XML output monitor.\n");
-
-		    fprintf (xml_out,
-			     "<status> Memcheck XML to Tool Gear XML "
-			     "converter terminated abnormally</status>\n");
-
-		    // End the xml file
-		    fprintf (xml_out, "</tool_gear>\n");
-		    fflush (xml_out);
+	    // Wait for new messages, but wake up at least once a
+	    // second to check on our parent
+	    follower.wait (1000);
+	    if (follower.update ())
+		XMLParser.restart ();
+	    parse_input (&mcinfo, XMLParser, xml_out);
+
+	    // Make sure parent hasn't gone away
+	    long cur_ppid = getppid();
+	    if (cur_ppid != initial_ppid)
+	    {
+		// Assume parent killed, die now in graceful way
+		fprintf (stderr, "\nWarning: MemcheckView termination "
+			 "detected. "
+			 "Exiting Valgrind XML output monitor.\n");
+
+		fprintf (xml_out,
+			 "<status> Memcheck XML to Tool Gear XML "
+			 "converter terminated abnormally</status>\n");
+
+		// End the xml file
+		fprintf (xml_out, "</tool_gear>\n");
+		fflush (xml_out);
 		    
-		    // Close the xml file (if not stdout)
-		    if (xml_out != stdout)
-			fclose (xml_out);
+		// Close the xml file (if not stdout)
+		if (xml_out != stdout)
+		    fclose (xml_out);
 
-		    exit (1);
-		}
+		exit (1);
 	    }
 	}
 
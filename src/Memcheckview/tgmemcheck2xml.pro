@@ -17,9 +17,13 @@ CONFIG += console
 SOURCES = TGmemcheck2xml.cpp \
            ../Utils/tg_error.c \
            ../Utils/tg_time.c ../Utils/messagebuffer.cpp \
+           ../Utils/snippet_reader.cpp ../Utils/xml_token_table.cpp \
+           ../Utils/file_follower.cpp \
            ../Utils/string_symbol.c ../Utils/l_alloc_new.c
 
 HEADERS =  ../Utils/messagebuffer.h ../Utils/tempcharbuf.h \
+           ../Utils/snippet_reader.h ../Utils/xml_token_table.h \
+           ../Utils/file_follower.h \
            ../Utils/tg_error.h ../Utils/lineparser.h \
            ../Utils/tg_time.h ../Utils/logfile.h ../Utils/tg_types.h \
            ../Utils/string_symbol.h
@@ -0,0 +1,2955 @@
+//! \file mpip_info.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.01                                              July 19, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Reading mpiP reports and writing their messages, moved here from
+// TGmpip2xml.cpp so TGxmlserver can read mpiP reports itself (see
+// mpip_info.h).
+
+// No Qt needed by this code, make sure header files don't bring it in
+#define NO_QT
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifndef FALSE
+#define FALSE 0
+#define TRUE (!FALSE)
+#endif
+
+#include "tg_error.h"
+#include "lineparser.h"
+#include "field_tokenizer.h"
+#include "tempcharbuf.h"
+#include "messagebuffer.h"
+#include "tg_types.h"
+#include "xml_convert_dup.h"
+#include "stringtable.h"
+#include "mpip_info.h"
+
+// Thread-safe version of error string library for IBM
+#ifdef THREAD_SAFE
+#define USE_STRERROR_R 
+#endif
+
+#define COUNT_COLUMN "count"
+#define MAX_TIME_COLUMN "max_time"
+#define MIN_TIME_COLUMN "min_time"
+#define MEAN_TIME_COLUMN "mean_time"
+#define APP_PERCENT_TIME_COLUMN "app_percent_time"
+#define MPI_PERCENT_TIME_COLUMN "mpi_percent_time"
+
+// Per-rank statistics can be stored as floats (-DTG_MPIP_FLOAT_STATS),
+// halving their memory at the cost of precision in the values shown
+#ifdef TG_MPIP_FLOAT_STATS
+typedef float StatValue;
+#else
+typedef double StatValue;
+#endif
+
+// Returns the statistic in column for task, or -1 if the column was
+// never allocated
+static inline double statAt (const StatValue *column, int task)
+{
+    return ((column != NULL) ? (double) column[task] : -1.0);
+}
+
+// Holds the stats for a CallSite, a column per statistic with an entry
+// per mpi rank (the aggregate '*' stats are at num_tasks).  The columns
+// for a section (timing, data sent, or I/O) are allocated only when the
+// site has a row in that section, so sections and callsites mpiP didn't
+// report cost nothing.  Entries not read in are -1 (obviously bad).
+struct SiteStats {
+    // Times called
+    int *count;
+
+    // Timing stats
+    StatValue *max;
+    StatValue *mean;
+    StatValue *min;
+    StatValue *app_pct;
+    StatValue *mpi_pct;
+
+    // Data sent stats
+    StatValue *maxSent;
+    StatValue *meanSent;
+    StatValue *minSent;
+    StatValue *sumSent;
+
+    // IO stats
+    StatValue *maxIO;
+    StatValue *meanIO;
+    StatValue *minIO;
+    StatValue *sumIO;
+
+    // No sections read in yet
+    SiteStats() : count(NULL), max(NULL), mean(NULL), min(NULL), 
+		  app_pct(NULL), mpi_pct(NULL), 
+		  maxSent(NULL), meanSent(NULL),
+		  minSent(NULL), sumSent(NULL),
+		  maxIO(NULL), meanIO(NULL),
+		  minIO(NULL), sumIO(NULL)
+	{}
+
+    ~SiteStats()
+	{
+	    delete [] count;
+	    delete [] max;
+	    delete [] mean;
+	    delete [] min;
+	    delete [] app_pct;
+	    delete [] mpi_pct;
+	    delete [] maxSent;
+	    delete [] meanSent;
+	    delete [] minSent;
+	    delete [] sumSent;
+	    delete [] maxIO;
+	    delete [] meanIO;
+	    delete [] minIO;
+	    delete [] sumIO;
+	}
+
+    //! Allocates the columns for a section (a StatsKind), with
+    //! entries entries each, if they are not allocated already
+    void allocate (int kind, int entries)
+	{
+	    if (kind == TIMING_STATS)
+	    {
+		if (count != NULL)
+		    return;
+		count = new int[entries];
+		for (int e = 0; e < entries; ++e)
+		    count[e] = -1;
+		max = newColumn (entries);
+		mean = newColumn (entries);
+		min = newColumn (entries);
+		app_pct = newColumn (entries);
+		mpi_pct = newColumn (entries);
+	    }
+	    else if (kind == SENT_STATS)
+	    {
+		if (maxSent != NULL)
+		    return;
+		maxSent = newColumn (entries);
+		meanSent = newColumn (entries);
+		minSent = newColumn (entries);
+		sumSent = newColumn (entries);
+	    }
+	    else
+	    {
+		if (maxIO != NULL)
+		    return;
+		maxIO = newColumn (entries);
+		meanIO = newColumn (entries);
+		minIO = newColumn (entries);
+		sumIO = newColumn (entries);
+	    }
+	}
+
+    //! Returns the count for task, or -1 if it has no timing stats
+    int countAt (int task) const
+	{
+	    return ((count != NULL) ? count[task] : -1);
+	}
+
+    //! Returns how many of the first numTasks tasks have timing stats
+    int tasksReporting (int numTasks) const
+	{
+	    if (count == NULL)
+		return (0);
+	    int reporting = 0;
+	    for (int task = 0; task < numTasks; ++task)
+		reporting += (count[task] != -1);
+	    return (reporting);
+	}
+
+private:
+    static StatValue *newColumn (int entries)
+	{
+	    StatValue *column = new StatValue[entries];
+	    for (int e = 0; e < entries; ++e)
+		column[e] = -1;
+	    return (column);
+	}
+};
+
+// Holds location info for one level in the call stack
+struct LocationInfo {
+    char *filename;
+    int   line_number;
+    char *function;
+    int   format;  // 1 indicates info available, 2 indicates only address
+};
+
+// Holds MpiP info for each call site
+struct CallSite {
+    int   siteID;	
+    char *call;
+    char *annot_function;
+    char *entry_key;
+    char *traceback;          // messageTraceback formatted 
+    SiteStats stats;          // Stats columns, an entry per rank
+    LocationInfo *location;   // Array of locations, one per call stack level
+    double sorting_mpi_pct;   // For sorting, aggregate MPI percent
+    double sorting_sumSent;   // For sorting, aggregate bytes sent
+    double sorting_sumIO;     // For sorting, aggregate IO bytes 
+    int timingLineNo;	      // First line of Timing stats
+    int sentLineNo;           // First line of Data Sent stats
+    int ioLineNo;             // First line of I/O stats
+};
+
+// Each per-rank callsite statistics section is indexed as it is found,
+// with a checkpoint (file offset and line number) every
+// STATS_CHECKPOINT_LINES lines, and then parsed.  Checkpoints let the
+// section be split among up to STATS_MAX_THREADS threads at known lines.
+#define STATS_CHECKPOINT_LINES 8192
+#define STATS_MAX_THREADS 16
+
+struct StatsCheckpoint {
+    long long offset;         // Where the line starts in the file
+    int lineNo;               // Its line number
+};
+
+struct StatsSection {
+    int kind;                 // A StatsKind
+    StatsCheckpoint *checkpoints; // The first is at the first row
+    int numCheckpoints;
+    long long end;            // Offset just past the last row
+};
+
+// One thread's share of a statistics section, the rows from checkpoint
+// firstCheckpoint up to (not including) endCheckpoint.  Per-site values
+// are kept here (indexed by siteindex) until readCallsiteStats() merges
+// them, in file order.
+struct StatsChunk {
+    MpipInfo *info;
+    const char *fileName;
+    StatsSection *section;
+    int firstCheckpoint;
+    int endCheckpoint;
+    int *firstLineNo;         // First row for each site, -1 if none
+    double *aggregate;        // The value that sorts the site ('*' row)
+    bool *hasAggregate;
+    pthread_t thread;
+};
+
+// By default, include references to the raw MpiP data in all messagse.
+// The mpiP file's text isn't in the XML; the Client asks for it when
+// a reference is clicked, and huge (100MB) mpiP files are sent only a
+// few thousand lines at a time (see TGSourceReader::read_file).  Can
+// still be disabled for testing purposes.
+static int outputMpiPRefs = 1;
+
+#define MAX_LEN 1024
+
+#if 0
+// This function is used in sorting the list of sites by file and
+// line number
+static int compareCallSitesByLine( const void * cs1, const void * cs2 )
+{
+	int fileCompare = strcmp( ((CallSite *)cs1)->location[0].filename,
+				((CallSite *)cs2)->location[0].filename );
+
+	if( fileCompare ) return fileCompare;
+
+	return (((CallSite *)cs1)->location[0].line_number - 
+		((CallSite *)cs2)->location[0].line_number);
+}
+
+// This function is used in sorting the list by call site id
+static int compareCallSitesByID( const void * cs1, const void * cs2 )
+{
+	return ((CallSite *)cs1)->siteID - ((CallSite *)cs2)->siteID;
+}
+#endif
+
+// Fills in the values of a line in the callsite list from its fields the
+// way sscanf (line, "%d %d %s %d %s %s", ...) would for format 1, or
+// sscanf (line, "%d %d %s %s %s", ...) for format 2 (which has no line
+// number), and returns how many values were filled in.  The string
+// buffers must be longer than any field.
+static int scanCallsiteFields (int format, int numFields,
+			       const char **field, const int *fieldLen,
+			       int &siteID, int &level, char *filename,
+			       int &line_number, char *function, char *call)
+{
+    int *ints[3] = {&siteID, &level, &line_number};
+    char *strings[3] = {filename, function, call};
+    const char *kinds = (format == 1) ? "iisiss" : "iisss";
+    int nextInt = 0, nextString = 0;
+
+    int count;
+    for (count = 0; (kinds[count] != 0) && (count < numFields); ++count)
+    {
+	if (kinds[count] == 'i')
+	{
+	    FieldTokenizer number (field[count], fieldLen[count]);
+	    if (!number.nextInt (*ints[nextInt++]))
+		break;
+	}
+	else
+	{
+	    memcpy (strings[nextString], field[count], fieldLen[count]);
+	    strings[nextString][fieldLen[count]] = 0;
+	    ++nextString;
+	}
+    }
+
+    return (count);
+}
+
+// Read in the start of the mpip info file into internal data structures
+MpipInfo::MpipInfo(const char *mpipfile)
+{
+    // Initialize variables before setting/updating them below
+    // We will do sanity checks below to verify they have changed 
+    // from these initial values
+    version = 0.0;
+    MPIP_settings = NULL;
+    trace_depth = 1; // (defaults to 1, set with -k in MPIP env variable)
+    num_callsites = 0;
+    num_tasks = 0;  
+    sites = NULL;
+    siteIdBase = 0; // Normally 0, but for mpiP 1.7 mid dumps, will be non-zero
+
+    // Intialize Line number of various interesting points in the input 
+    // mpiP file to -1
+    commandLineNo = -1; // @ Command 
+    versionLineNo = -1; // @ Version     
+    envLineNo = -1;     // @ MPIP env var
+    nodesLineNo = -1;   // First: @ MPI Task Assignment
+    mpiTimeLineNo = -1; // @--- MPI Time (seconds)
+    sitesLineNo = -1;   // @--- Callsites
+    topTimeLineNo = -1; // @--- Aggregate Time (top twenty
+    topSentLineNo = -1; // @--- Aggregate Sent Message Size (top twenty
+    topIOLineNo = -1;   // @--- Aggregate I/O Size (top twenty
+    allTimeLineNo = -1; // @--- Callsite Time statistics (all, milliseconds)
+    allSentLineNo = -1; // @--- Callsite Message Sent statistics (all, sent...
+    allIOLineNo = -1;   // @--- Callsite I/O statistics (all, I/O bytes)
+
+    // Messages name the file in references to the raw data
+    mpip_file_name = strdup (mpipfile);
+    TG_checkAlloc (mpip_file_name);
+
+
+    // Open the mpiP file for reading
+    FILE * fp = fopen( mpipfile, "r" );
+    if( fp == NULL ) {
+	TG_error ("Failed to open mpiP file %s!", mpipfile );
+    }
+
+    // Create a line parser to handle reading in arbitrarily long
+    // lines and close the fp on deconstruction of parser.  It is
+    // kept for readNextStatsSection().
+    statsParser = new LineParser(fp, TRUE);
+    LineParser &parser = *statsParser;
+
+    // Get pointer to const char * line returned by lineparser
+    const char *line = NULL;
+    
+    // Read the file and look for the list of call sites
+    // Also read in pieces of the file header in the process
+    while ((line = parser.getNextLine()) != NULL)
+    {
+	// Record location of @ Command header
+	if (strncmp (line, "@ Command", 9) == 0)
+	{
+	    // Record lineNo for this point in the file
+	    commandLineNo = parser.lineNo();
+	}
+
+	// Read in mpiP version line
+	if (strncmp (line, "@ Version", 9) == 0)
+	{
+	    char versionString[200];
+
+	    // Record lineNo for this point in the file
+	    versionLineNo = parser.lineNo();
+	    
+	    // Line format is: @ Version                  : 2.6
+	    if (sscanf( line, "@ Version : %f", &version) != 1)
+		TG_error ("Error reading in Mpip version!");
+
+	    // Warn if haven't tested with this version of mpiP
+	    // Tested with 2.8.5 and the upcoming 2.9 was promised to
+	    // have the same format - JCG 3/15/06
+	    // Upcoming 3.0 release has same default format, so update
+	    // version.   New concise format not yet supported -JCG 3/19/06
+	    // Currently read 2.8.5 as 2.8, so this is only rough version info
+	    if (version > 3.01)
+	    {
+		// Default to converted from float string
+		sprintf (versionString, "%g", version);
+
+		// Parse string out of raw input, so can handle 2.8.5
+		sscanf ( line, "@ Version : %s", versionString);
+		fprintf (stderr, 
+			 "Warning: MpiP version %s has not been tested with "
+			 "this reader!\n",  versionString);
+	    }
+
+#if 0
+	    // 2.7 now fully supported.
+	    // Warn about limited support for 2.7 right now
+	    if ((version < 2.701) && (version > 2.699))
+	    {
+		fprintf (stderr, 
+			 "Warning: Only subset of MpiP 2.7 currently "
+			 "supported by this reader!\n");
+	    }
+#endif
+	}
+
+	// Read in MPIP env var setting and look for -k <n> setting in order
+	// to get the expected trace_depth
+	if (strncmp (line, "@ MPIP env var", 14) == 0)
+	{
+	    // Record lineNo for this point in the file
+	    envLineNo = parser.lineNo();
+
+	    // Line format is: @ MPIP env var             : -k 4 -n
+	    // (Space between k and number is optional)
+
+	    // Easiest to just grab the string after :, so
+	    // advance the pointer to that point
+	    const char *ptr = line;
+	    while (*ptr != 0)
+	    {
+		// If found ':', advance to second character after it
+		if (*ptr == ':')
+		{
+		    // Don't advance 2 if goes past terminator
+		    if (ptr[1] == 0)
+			ptr++;
+		    else
+			ptr+=2;
+		    break;
+		}
+		ptr++;
+	    }
+
+	    // Copy the environment variable setting
+	    MPIP_settings = strdup (ptr);
+
+	    // Remove newline terminator
+	    MPIP_settings[strlen(MPIP_settings)-1] = 0;
+
+	    // If not '[null]', search for -k trace_depth in configuration
+	    if (strcmp (MPIP_settings, "[null]") != 0)
+	    {
+		// Start scanning at start of settings
+		ptr = MPIP_settings;
+
+		// Search for -k
+		while (*ptr != 0)
+		{
+		    // Do we have "-k"? (number may follow k directly)
+		    if ((ptr[0] == '-') &&
+			(ptr[1] == 'k')) 
+		    {
+			// Yes, convert next argument to number (atoi ignores
+			// any leading whitespace)
+			int level = atoi (&ptr[2]);
+		       
+			// If a valid number, atoi returns it
+			if (level >= 1)
+			    trace_depth = level;
+			
+			break;
+		    }
+		    
+		    // No, goto next character
+		    ptr++;
+		}
+	    }
+	}
+
+	// Read in MPI Task Assignments to file number of tasks
+	if (strncmp (line, "@ MPI Task Assignment", 21) == 0)
+	{
+	    // Record lineNo for this point in the file (first match only)
+	    if (nodesLineNo == -1)
+		nodesLineNo = parser.lineNo();
+
+	    // Line format is: @ MPI Task Assignment      : 3 berg01.llnl.gov
+	    int rank;
+	    if (sscanf( line, "@ MPI Task Assignment : %i", &rank) != 1)
+		TG_error ("Error reading in MPI Task Assignment!");
+	    
+	    // Update number of tasks, if necessary
+	    if ( num_tasks < (rank + 1))
+		num_tasks = rank + 1;
+	}
+
+	// Record location of @--- MPI Time (seconds) header
+	if (strncmp (line, "@--- MPI Time (seconds)", 23) == 0)
+	{
+	    // Record lineNo for this point in the file
+	    mpiTimeLineNo = parser.lineNo();
+	}
+
+	// Stop when find the list of callsites 
+	// and get the number of callsites from the header
+	if( strncmp( line, "@--- Callsites:", 15) == 0)
+	{
+	    // Record lineNo for this point in the file
+	    sitesLineNo = parser.lineNo();
+
+	    // Line format is: @--- Callsites: 14 -------------------
+	    if (sscanf (line, "@--- Callsites: %i", &num_callsites) != 1)
+		TG_error ("Error reading in number of callsites!");
+
+	    break;
+	}
+    } 
+
+    // Sanity check, should not reach end of file!
+    if( line == NULL ) 
+	TG_error ("Error reading mpiP file: no callsite list");
+
+    // Sanity check, version must be set by now
+    if (version < 0.1)
+	TG_error ("mpiP version not found!");
+
+    // Sanity check, MPIP_settings must be set by now
+    if (MPIP_settings == NULL)
+	TG_error ("MPIP env var not found!");
+    
+    // Sanity check, number of tasks should be set by now
+    if (num_tasks < 1)
+	TG_error ("MPI Task Assignment (and thus number of tasks) not found!");
+
+    // Sanity check, num_callsites should be > 0
+    if (num_callsites < 1)
+	TG_error ("Expect number of callsites (%i) > 0!", num_callsites);
+
+
+    // First we'll build a list of callsite data objects, then
+    // sort them so that they appear in file/line order.  Only
+    // then can we report everything to the Client, since we
+    // want everything from a given function to be sent together.
+    sites = new CallSite[num_callsites];
+
+    // For each callsite, create a stats array
+    for(int i = 0; i < num_callsites; ++i ) 
+    {
+	// Sanity check, set this site's structure to obviously bad values
+	sites[i].siteID = -1;
+	sites[i].call = NULL;
+	sites[i].annot_function = NULL;
+	sites[i].entry_key = NULL;
+	sites[i].traceback = NULL;
+	sites[i].sorting_mpi_pct = -1.0;
+	sites[i].sorting_sumSent = -1.0;
+	sites[i].sorting_sumIO = -1.0;
+	sites[i].timingLineNo = -1;
+	sites[i].sentLineNo = -1;
+	sites[i].ioLineNo = -1;
+
+	// The stats columns (one entry for each task plus 1 more for
+	// the "aggregate" stats) are allocated as sections are read in
+
+	// For each level in the call stack traced (minimum one), 
+	// create a LocationInfo structure
+	sites[i].location = new LocationInfo[trace_depth];
+
+	// Sanity check, initialize LocationInfo to obviously bad values
+	for (int d = 0; d < trace_depth; ++d)
+	{
+	    sites[i].location[d].filename = NULL;
+	    sites[i].location[d].line_number = -1;
+	    sites[i].location[d].function = NULL;
+	    sites[i].location[d].format = -1;
+	}
+    }
+
+    
+    // Throw out the next two lines
+    parser.getNextLine();
+    parser.getNextLine();
+    
+    int i;
+
+    // Create resizable temporary buffers for the function name, call site,
+    // and filename
+    TempCharBuf functionBuf, callBuf, filenameBuf;
+    
+    // Create an automatically expandable character buffer to hold the
+    // traceback info
+    MessageBuffer tbuf;
+
+    // Get the first line
+    for( i = 0; i < num_callsites; ++i ) {
+	int line_number, siteID, level;
+	char *function, *call, *filename;
+	int levels_processed;
+	
+	// Scan in all the lines to do with this site id, should process
+	// at least one level
+	levels_processed = 0;
+	while (1)
+	{
+	    // Peek at the next line to see if it belongs to this site
+	    line = parser.peekNextLine();
+	    if (line == NULL)
+	    {
+		TG_error("Error reading mpiP file: "
+			 "callsite list ends unexpectedly at site %i!",  i);
+	    }
+
+	    // Resize temporary buffers to be big enough to handle entire
+	    // line.  To reduce overhead, just use parser's max length
+	    // (instead of counting each strings length).
+	    int maxSize = parser.getMaxLen();
+	    function = functionBuf.resize(maxSize);
+	    call = callBuf.resize(maxSize);
+	    filename = filenameBuf.resize(maxSize);
+
+
+	    // Set all variables to be read in to invalid values
+	    siteID = -1;
+	    level = -1;
+	    line_number = -1;
+	    filename[0] = 0;
+	    function[0] = 0;
+	    call[0] = 0;
+	    int format = -1; 
+
+	    // Detect end of call sites
+	    if (line[0] == '-')
+	    {
+		// Sanity check, should have processed at least on level
+		if (levels_processed < 1)
+		{
+		    TG_error("Error reading mpiP file: "
+			     "Expected callsite %i info, not end marker!\n",
+			    i+1);
+		}
+
+		// The siteID = -1 will cause loop to exit below
+		siteID = -1;
+	    }
+
+	    // Otherwise process line, should be valid
+	    else
+	    {
+		// Two line formats, either: 
+		//
+		//   site-id level file-name line func mpi-call
+		//
+		// or when callsite location info is not available:
+		//
+		//   site-id level Address [unknown] mpi-call
+		// 
+		// Split the line into fields once for both formats
+		// (at most six are used)
+		FieldTokenizer fields (line, parser.lineLength());
+		const char *field[6];
+		int fieldLen[6];
+		int numFields = 0;
+		while ((numFields < 6) &&
+		       fields.nextField (field[numFields], fieldLen[numFields]))
+		    ++numFields;
+
+		// Try to parse the first format first:
+		format = 1;  // Mark trying format 1
+		int parse_count = 
+		    scanCallsiteFields (1, numFields, field, fieldLen,
+					siteID, level, filename, line_number,
+					function, call);
+
+		// If in format one, expect 6 items read for level 0 or
+		// 5 items read in for level 1.  If didn't get either of
+		// these, try format two.
+		if (((level == 0) && (parse_count != 6)) ||
+		    ((level != 0) && (parse_count != 5)))
+		{
+		    // reset all variables (except call) to be read in to 
+		    // invalid values
+		    siteID = -1;
+		    level = -1;
+		    line_number = -1;
+		    filename[0] = 0;
+		    function[0] = 0;
+
+		    // Try parsing format two, address goes into filename.
+		    int parse_count2 = 
+			scanCallsiteFields (2, numFields, field, fieldLen,
+					    siteID, level, filename,
+					    line_number, function, call);
+
+		    // If at level 0, expect 5 items read
+		    // If at level 1, expect 4 items read
+		    if (((level == 0) && (parse_count2 == 5)) ||
+			((level != 0) && (parse_count2 == 4)))
+		    {
+			// Sanity check, make sure not new format
+			// that we haven't seen before.
+			// Expect function to be '[unknown]' for format 2
+			if (strcmp (function, "[unknown]") != 0)
+			{
+			    TG_error ("Error reading callsite %i info "
+				      "(format two)!\n"
+				      "Expected '[unknown]' not '%s' "
+				      "for Parent_Funct!\n"
+				      "'%s'\n", i, function, line);
+			}
+			
+			// Mark that this is format 2
+			format = 2;
+		    }
+		    // Otherwise, don't know how to parse this line
+		    else
+		    {
+			TG_error ("Error reading callsite %i info for "
+				  "level %i!\n"
+				  "Format 1 parsed %i items!\n"
+				  "Format 2 parsed %i items!\n"
+				  "'%s'\n", i, level, 
+				  parse_count, parse_count2, line);
+		    }
+		}
+
+		// For levels past 0, call will be still set correctly,
+		// since there is no field for it.
+	    }
+
+	    // Set siteIdBase using the first callsite read in
+	    // to deal with mpiP 1.7 mid-run dump callsites not starting
+	    // with 1
+	    if ((i == 0) && (levels_processed == 0) && (siteID != 1))
+	    {
+		// Set siteIdBase to the first siteID -1, so the normallized
+		// siteID will be 1 below and where siteId is converted
+		// into siteIndexes.
+		siteIdBase = siteID -1;
+	    }
+	    
+
+	    // If not for this siteID, exit loop
+	    if ((siteID - siteIdBase) != (i+1))
+	    {
+		// Sanity check, should have processed at least on level
+		if (levels_processed < 1)
+		{
+		    TG_error ("Error reading mpiP file: "
+			      "Expected callsite %i info, not %i!\n",  i,
+			      siteID);
+		}
+
+		// Exit this siteID's processing loop
+		break;
+	    }
+
+	    // Store some level 0 info in top level sites structure
+	    if (level == 0)
+	    {
+		sites[i].siteID = siteID;
+		sites[i].call = strdup( call );
+	    }
+
+	    // Sanity check, level must be < trace_depth!
+	    // Otherwise, will corrupt memory
+	    if ((level <0) || (level >= trace_depth))
+	    {
+		TG_error ("Error reading mpiP file: level (%i) not in"
+			  "expected range (0-%i)!\n",
+			  level, trace_depth-1);
+	    }
+
+	    // Sanity check, this level's info better not already be set
+	    if (sites[i].location[level].filename != NULL)
+	    {
+		TG_error ("Error reading mpiP file: callsite's %i level %i's "
+			  "information already read in!!\n", i, level);
+	    }
+	    
+	    // Copy this level's info into location array
+	    sites[i].location[level].filename = XML_convert_dup (filename);
+	    sites[i].location[level].line_number = line_number;
+	    sites[i].location[level].function = XML_convert_dup (function);
+	    sites[i].location[level].format = format;
+
+	    // If for this siteID, consume the line by getting it
+	    parser.getNextLine();
+
+	    // Indicate that we have processed a level
+	    levels_processed ++;
+	}
+
+	// Create traceback structure from call stack info read in
+	// for callsite, using an automatically resizing buffer, tbuf
+
+	// Sanity check, better have been read in
+	if (sites[i].location[0].filename == NULL)
+	{
+	    TG_error ("Error reading mpiP file: callsite's %i level 0's "
+		      "information not found!\n", sites[i].siteID);
+	}
+
+	// Handle format 1, have all info
+	if (sites[i].location[0].format == 1)
+	{
+	    tbuf.sprintf ("  <annot>\n"
+			  "    <title>%s[%d] Source</title>\n"
+			  "    <site>\n"
+			  "      <file>%s</file>\n"
+			  "      <line>%d</line>\n"
+			  "      <desc>%s</desc>\n"
+			  "    </site>\n", 
+			  sites[i].call,
+			  sites[i].siteID,
+			  sites[i].location[0].filename, 
+			  sites[i].location[0].line_number,
+			  sites[i].location[0].function);
+	}
+
+	// Handle format 2, only have address in code
+	else if (sites[i].location[0].format == 2)
+	{
+	    tbuf.sprintf ("  <annot>\n"
+			  "    <title>%s[%d] Source</title>\n"
+			  "    <site>\n"
+			  "      <desc>[Addr: %s] (unknown location, source mapping failed for this callsite address)</desc>\n"
+			  "    </site>\n",
+			  sites[i].call,
+			  sites[i].siteID,
+			  sites[i].location[0].filename);
+	}
+	
+	// No other formats yet
+	else
+	{
+	    TG_error ("Unexpected level 0 callsite format %i\n", 
+		      sites[i].location[0].format);
+	}
+	    
+	// Append all levels below 0 (if any)
+	for (int d = 1; d < trace_depth; ++d)
+	{
+	    // If read in less levels than specified, stop now
+	    if (sites[i].location[d].filename == NULL)
+		break;
+
+	    // Handle format 1, have all info
+	    if (sites[i].location[d].format == 1)
+	    {
+		// Append this level's info into traceback info
+		tbuf.appendSprintf ("    <site>\n"
+				    "      <file>%s</file>\n"
+				    "      <line>%d</line>\n"
+				    "      <desc>%s</desc>\n"
+				    "    </site>\n", 
+				    sites[i].location[d].filename, 
+				    sites[i].location[d].line_number, 
+				    sites[i].location[d].function);
+	    }
+
+	    // Handle format 2, only have address in code
+	    else if (sites[i].location[d].format == 2)
+	    {
+		tbuf.appendSprintf ("    <site>\n"
+				    "      <desc>[Addr: %s] (unknown location, source mapping failed for this callsite address)</desc>\n"
+				    "    </site>\n", 
+				    sites[i].location[d].filename);
+	    }
+
+	    // No other formats yet
+	    else
+	    {
+		TG_error ("Unexpected level %i callsite format %i\n", 
+			  d, sites[i].location[d].format);
+	    }
+
+	}
+
+	// Append end annot XML marker
+	tbuf.appendSprintf ("  </annot>\n");
+
+	// Store duplicate of the formated "trackback" string for ease of
+	// use in generating messages
+	sites[i].traceback = tbuf.strdup();
+    }
+
+
+    // The statistics sections are read by readNextStatsSection()
+}
+
+// Reads on through the mpip file, noting where the sections of interest
+// are, until the next per-rank callsite stats section has been read and
+// parsed.  Returns its StatsKind, or -1 at the end of the file.
+int MpipInfo::readNextStatsSection ()
+{
+    // Already read the whole file
+    if (statsParser == NULL)
+	return (-1);
+
+    LineParser &parser = *statsParser;
+    const char *line;
+
+    // Look for the beginning of the stats sections and read in
+    // those sections we care about
+    while ((line = parser.getNextLine()) != NULL)
+    {
+	// Record location of @--- Aggregate Time (top twenty header
+	if (strncmp (line, "@--- Aggregate Time (top twenty", 31) == 0)
+	{
+	    // Record lineNo for this point in the file
+	    topTimeLineNo = parser.lineNo();
+	}
+
+	// Record location of @--- Aggregate Sent Message Size (top twenty
+	if (strncmp (line, 
+		     "@--- Aggregate Sent Message Size (top twenty", 44) == 0)
+	{
+	    // Record lineNo for this point in the file
+	    topSentLineNo = parser.lineNo();
+	}
+
+	// Record location of @--- Aggregate I/O Size (top twenty header
+	if (strncmp (line, "@--- Aggregate I/O Size (top twenty", 35) == 0)
+	{
+	    // Record lineNo for this point in the file
+	    topIOLineNo = parser.lineNo();
+	}
+
+	int kind = -1;
+
+	// Read in (and record location) of callsite timing stats
+	if( (strncmp( line, "@--- Callsite statistics (all, milliseconds", 43) == 0 ) ||
+	    (strncmp( line, "@--- Callsite Time statistics", 29 ) == 0 ))
+	{
+	    kind = TIMING_STATS;
+	}
+
+	// Read in (and record location) of callsite bytes sent stats
+	else if ((strncmp (line, 
+			   "@--- Callsite statistics (all, sent bytes", 41) == 0) ||
+		 (strncmp (line,
+			   "@--- Callsite Message Sent statistics", 37) == 0))
+	{
+	    kind = SENT_STATS;
+	}
+
+	// Read in (and record location) of callsite I/O stats
+	else if (strncmp (line, "@--- Callsite I/O statistics", 28) == 0)
+	{
+	    kind = IO_STATS;
+	}
+
+	if (kind != -1)
+	{
+	    // Use helper routines to index the section's rows, then
+	    // parse them
+	    StatsSection section;
+	    indexCallsiteStats(parser, section, kind);
+	    readCallsiteStats(section);
+
+	    // Free the index of them
+	    free (section.checkpoints);
+	    return (kind);
+	}
+    } 
+
+    // Destructor in parser automatically closes fp
+    delete statsParser;
+    statsParser = NULL;
+    return (-1);
+}
+
+
+// Delete all internal data structures used
+MpipInfo::~MpipInfo()
+{
+    // Free all memory allocated for each callsite
+    // Note mixture of free and delete [] is needed
+    for( int i = 0; i < num_callsites; ++i ) 
+    {
+	// Delete all the strdups, if exist
+	if (sites[i].call != NULL)
+	    free( sites[i].call );
+	if (sites[i].entry_key != NULL)
+	    free( sites[i].entry_key );
+	if (sites[i].annot_function != NULL)
+	    free( sites[i].annot_function );
+	if (sites[i].traceback != NULL)
+	    free( sites[i].traceback );
+
+	// Delete the strings strduped in location
+	for (int d = 0; d < trace_depth; ++d)
+	{
+	    // May not exists at all levels, so free only if exists
+	    if (sites[i].location[d].filename != NULL)
+		free (sites[i].location[d].filename);
+
+	    // May not exists at all levels, so free only if exists
+	    if (sites[i].location[d].function != NULL)
+		free (sites[i].location[d].function);
+	}
+
+	// Delete the array of locations for each callsite
+	delete [] sites[i].location;
+    }
+
+    // Free copy of MPIP environment variable settings
+    if (MPIP_settings != NULL)
+    {
+	free (MPIP_settings);
+    }
+
+    // Delete array of call sites
+    delete [] sites;
+
+    // Done with the file name and, if not read to the end, the file
+    free (mpip_file_name);
+    delete statsParser;
+}
+
+// Parses a row of one of the per-rank callsite statistics sections,
+//   Name Site Rank Count value1 ... valueN
+// where Rank is '*' for the aggregate row (returned as task starTask).
+// There is a row per rank per callsite, so the fields are scanned in
+// place rather than with sscanf.  Returns FALSE if the row doesn't
+// have that form.
+static bool parseCallsiteStatsRow (const char *line, int len, int starTask,
+				   int &site, int &task, int &count,
+				   double *values, int numValues)
+{
+    FieldTokenizer fields (line, len);
+
+    // Skip the MPI call name, the site id already identifies it
+    if (!fields.skipField () || !fields.nextInt (site))
+	return (FALSE);
+
+    // Determine task id from 'rank' field (may be *)
+    const char *rank;
+    int rankLen;
+    if (!fields.nextField (rank, rankLen))
+	return (FALSE);
+    if (rank[0] == '*')
+    {
+	task = starTask;
+    }
+    else
+    {
+	FieldTokenizer rankField (rank, rankLen);
+	if (!rankField.nextInt (task))
+	    return (FALSE);
+    }
+
+    if (!fields.nextInt (count))
+	return (FALSE);
+
+    for (int v = 0; v < numValues; ++v)
+    {
+	if (!fields.nextDouble (values[v]))
+	    return (FALSE);
+    }
+
+    return (TRUE);
+}
+
+// Helper routine that notes where the rows of a per-rank callsite
+// statistics section are (parser has just read its header), with a
+// checkpoint every STATS_CHECKPOINT_LINES lines.  The rows are parsed
+// next by readCallsiteStats(), which can then split them among threads.
+void MpipInfo::indexCallsiteStats(LineParser &parser, StatsSection &section,
+				  int kind)
+{
+    // Record lineNo for this point in the file
+    if (kind == TIMING_STATS)
+	allTimeLineNo = parser.lineNo();
+    else if (kind == SENT_STATS)
+	allSentLineNo = parser.lineNo();
+    else
+	allIOLineNo = parser.lineNo();
+
+    // Throw out "-----------------------------------------------"
+    parser.getNextLine();
+
+    // Throw out "Name Site Rank Count Max Mean Min ..."
+    parser.getNextLine();
+
+    // Start the section's index
+    section.kind = kind;
+    section.checkpoints = NULL;
+    section.numCheckpoints = 0;
+    section.end = 0;
+
+    // Scan (but don't parse) the data lines
+    int rows = 0;
+    const char *line;
+    while (1)
+    {
+	// Get the next line
+        line = parser.getNextLine();
+
+	// Detect end of data
+        if( (line == NULL) || (line[0] == '-') ) 
+	    break;     
+
+	// Checkpoint this line if due
+	if ((rows % STATS_CHECKPOINT_LINES) == 0)
+	{
+	    if ((section.numCheckpoints % 64) == 0)
+	    {
+		section.checkpoints = (StatsCheckpoint *)
+		    realloc (section.checkpoints,
+			     (section.numCheckpoints + 64) * 
+			     sizeof (StatsCheckpoint));
+		TG_checkAlloc (section.checkpoints);
+	    }
+	    StatsCheckpoint &checkpoint = 
+		section.checkpoints[section.numCheckpoints++];
+	    checkpoint.offset = parser.lineOffset();
+	    checkpoint.lineNo = parser.lineNo();
+	}
+	++rows;
+
+	// Data lines end here, so far
+	section.end = parser.lineOffset() + parser.lineLength();
+    }
+}
+
+// Returns how many threads to parse a statistics section with, one per
+// processor (or TG_MPIP_THREADS, if set) up to STATS_MAX_THREADS
+static int statsThreadCount ()
+{
+    long threads;
+    const char *env = getenv ("TG_MPIP_THREADS");
+    if (env != NULL)
+	threads = atol (env);
+    else
+	threads = sysconf (_SC_NPROCESSORS_ONLN);
+
+    if (threads < 1)
+	threads = 1;
+    if (threads > STATS_MAX_THREADS)
+	threads = STATS_MAX_THREADS;
+    return ((int) threads);
+}
+
+// Helper routine to parse the statistics section just indexed by
+// indexCallsiteStats().  Its rows are split at checkpoints among
+// threads, each reading its own part of the file.
+void MpipInfo::readCallsiteStats(StatsSection &section)
+{
+    int maxThreads = statsThreadCount();
+
+    // Skip sections with no rows
+    if (section.numCheckpoints == 0)
+	return;
+
+    // Use no more threads than there are checkpoints
+    int numThreads = maxThreads;
+    if (numThreads > section.numCheckpoints)
+	numThreads = section.numCheckpoints;
+
+    // Give each thread an even share of the checkpoints
+    StatsChunk *chunks = new StatsChunk[numThreads];
+    for (int t = 0; t < numThreads; ++t)
+    {
+	StatsChunk &chunk = chunks[t];
+	chunk.info = this;
+	chunk.fileName = mpip_file_name;
+	chunk.section = &section;
+	chunk.firstCheckpoint = 
+	    (int) (((long long) section.numCheckpoints * t) / numThreads);
+	chunk.endCheckpoint = 
+	    (int) (((long long) section.numCheckpoints * (t + 1)) / 
+		   numThreads);
+	chunk.firstLineNo = new int[num_callsites];
+	chunk.aggregate = new double[num_callsites];
+	chunk.hasAggregate = new bool[num_callsites];
+	for (int i = 0; i < num_callsites; ++i)
+	{
+	    chunk.firstLineNo[i] = -1;
+	    chunk.hasAggregate[i] = FALSE;
+	}
+    }
+
+    // Parse the chunks, in this thread if there is just one
+    if (numThreads == 1)
+    {
+	parseStatsChunk (&chunks[0]);
+    }
+    else
+    {
+	for (int t = 0; t < numThreads; ++t)
+	{
+	    if (pthread_create (&chunks[t].thread, NULL, statsThreadMain,
+				&chunks[t]) != 0)
+		TG_errno ("Unable to create mpiP parsing thread!");
+	}
+	for (int t = 0; t < numThreads; ++t)
+	    pthread_join (chunks[t].thread, NULL);
+    }
+
+    // Merge the per-site values in file order: the first line
+    // for each site, and the last aggregate read for it
+    for (int t = 0; t < numThreads; ++t)
+    {
+	StatsChunk &chunk = chunks[t];
+	for (int i = 0; i < num_callsites; ++i)
+	{
+	    int *lineNo;
+	    double *sorting;
+	    if (section.kind == TIMING_STATS)
+	    {
+		lineNo = &sites[i].timingLineNo;
+		sorting = &sites[i].sorting_mpi_pct;
+	    }
+	    else if (section.kind == SENT_STATS)
+	    {
+		lineNo = &sites[i].sentLineNo;
+		sorting = &sites[i].sorting_sumSent;
+	    }
+	    else
+	    {
+		lineNo = &sites[i].ioLineNo;
+		sorting = &sites[i].sorting_sumIO;
+	    }
+
+	    // If have not set the lineNo for this site yet, set it
+	    if ((*lineNo == -1) && (chunk.firstLineNo[i] != -1))
+		*lineNo = chunk.firstLineNo[i];
+
+	    // If have aggregate, set site's sorting value with it
+	    if (chunk.hasAggregate[i])
+		*sorting = chunk.aggregate[i];
+	}
+	delete [] chunk.firstLineNo;
+	delete [] chunk.aggregate;
+	delete [] chunk.hasAggregate;
+    }
+    delete [] chunks;
+}
+
+// Held while a thread allocates a site's stats columns
+static pthread_mutex_t statsAllocLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Thread entry point for parseStatsChunk()
+void *MpipInfo::statsThreadMain(void *arg)
+{
+    StatsChunk *chunk = (StatsChunk *) arg;
+    chunk->info->parseStatsChunk (chunk);
+    return (NULL);
+}
+
+// Helper routine to parse one thread's share of a statistics section
+// from its own stream on the mpiP file.  Rows go straight into the
+// SiteStats entries they name (no two rows name the same one), while each
+// site's first line and aggregate value are kept in the chunk for
+// readCallsiteStats() to merge.
+void MpipInfo::parseStatsChunk(StatsChunk *chunk)
+{
+    StatsSection *section = chunk->section;
+    StatsCheckpoint &first = section->checkpoints[chunk->firstCheckpoint];
+    long long end = section->end;
+    if (chunk->endCheckpoint < section->numCheckpoints)
+	end = section->checkpoints[chunk->endCheckpoint].offset;
+
+    // Open the mpiP file again and start at the first checkpoint
+    FILE * fp = fopen( chunk->fileName, "r" );
+    if( fp == NULL ) {
+	TG_error ("Failed to open mpiP file %s!", chunk->fileName );
+    }
+    if (fseeko (fp, (off_t) first.offset, SEEK_SET) != 0)
+	TG_errno ("Failed to seek in mpiP file %s!", chunk->fileName);
+
+    LineParser parser(fp, TRUE);
+
+    // Get pointer to const char * line returned by lineparser
+    const char *line = NULL;
+
+    int numValues = (section->kind == TIMING_STATS) ? 5 : 4;
+
+    // Parse all the data lines in the chunk
+    while (1)
+    {
+        int site = -1;
+        int task = -1;
+        int count = -1;
+        double values[5];
+
+	// Get the next line, stopping at the end of the chunk
+        line = parser.getNextLine();
+        if ((line == NULL) || (first.offset + parser.lineOffset() >= end))
+	    break;
+	int lineNo = first.lineNo + parser.lineNo() - 1;
+
+        // Skip blank lines
+        if (parser.lineLength() < 5)
+            continue;
+
+	// Parse all the data values in the line.  Task is set
+	// to max_task + 1 if rank is '*'.
+        if (!parseCallsiteStatsRow (line, parser.lineLength(), num_tasks,
+				    site, task, count, values, numValues))
+        {
+	    if (section->kind == TIMING_STATS)
+	    {
+		TG_error ("Error parsing callsite statistics!  "
+			  "Could not parse\n"
+			  "  '%s'!\n", line);
+	    }
+	    else
+	    {
+		TG_error ("Error parsing callsite bytes sent statistics!  "
+			  "Could not parse:\n"
+			  "  '%s'!\n", line);
+	    }
+        }
+
+        // Sanity check, make sure siteId within expected bounds
+	// Now have to subtract siteIdBase to get 1 to num_callsites range
+	// due to mpiP 1.7 output with mid-run dumps.
+        if (((site - siteIdBase) < 1) || ((site - siteIdBase) > num_callsites))
+        {
+            TG_error ("SiteId (%i) out of bounds (%i-%i) in line:\n"
+                      "  '%s'!", site, 1+siteIdBase, num_callsites+siteIdBase,
+		      line);
+        }
+
+        // To fit within C array, subtract 1 from siteId to get siteindex
+        int siteindex = (site -siteIdBase) - 1;
+
+        // Sanity check, make sure taskId within expected bounds
+        // (Yes > than num_tasks, not >= num_tasks. '*' id is num_tasks)
+        if ((task < 0) || (task > num_tasks))
+        {
+            TG_error ("TaskId (%i) out of bounds (0-%i) in line:\n"
+                      "  '%s'!", task, num_tasks, line);
+        }
+
+	// If have not seen this siteindex yet, note its first line and
+	// make sure its columns for this section exist (another thread
+	// may be about to allocate them, too)
+	SiteStats &stats = sites[siteindex].stats;
+	if (chunk->firstLineNo[siteindex] == -1)
+	{
+	    chunk->firstLineNo[siteindex] = lineNo;
+	    pthread_mutex_lock (&statsAllocLock);
+	    stats.allocate (section->kind, num_tasks + 1);
+	    pthread_mutex_unlock (&statsAllocLock);
+	}
+
+        // Save statistics in the callsite stats columns, indexed by taskId
+	double aggregate;
+	if (section->kind == TIMING_STATS)
+	{
+	    // Sanity check, make sure count is positive (don't think legal
+	    // to be 0, but we will just make sure not negative for now
+	    // so doesn't conflict with -1 markings this reader uses)
+	    if (count < 0)
+	    {
+		TG_error ("Count (%i) < 0 in line:\n"
+			  "  '%s'!", count, line);
+	    }
+
+	    stats.count[task] = count;
+	    stats.max[task] = values[0];
+	    stats.mean[task] = values[1];
+	    stats.min[task] = values[2];
+	    stats.app_pct[task] = values[3];
+	    stats.mpi_pct[task] = values[4];
+
+	    // Aggregate mpi_pct is used by compareCallSitePtrsByMpiPct()
+	    aggregate = values[4];
+	}
+	else if (section->kind == SENT_STATS)
+	{
+	    // Don't check count against the timing count: mpiP's
+	    // bytes-sent stats do not currently include calls that send
+	    // zero bytes, although these calls are included in timing
+	    // stats (JMM 5/24/04)
+	    stats.maxSent[task] = values[0];
+	    stats.meanSent[task] = values[1];
+	    stats.minSent[task] = values[2];
+	    stats.sumSent[task] = values[3];
+	    aggregate = values[3];
+	}
+	else
+	{
+	    stats.maxIO[task] = values[0];
+	    stats.meanIO[task] = values[1];
+	    stats.minIO[task] = values[2];
+	    stats.sumIO[task] = values[3];
+	    aggregate = values[3];
+	}
+
+	// Note the aggregate for sorting
+        if (task == num_tasks)
+	{
+	    chunk->aggregate[siteindex] = aggregate;
+	    chunk->hasAggregate[siteindex] = TRUE;
+	}
+    }
+}
+
+
+// This function is used in sorting a list of CallSite pointers by
+// the percent MPI time spents in aggregate breaking ties with callsiteId
+static int compareCallSitePtrsByMpiPct(const void * cs1ptr, 
+				       const void * cs2ptr)
+{
+    const CallSite *cs1 = *((const CallSite **)cs1ptr);
+    const CallSite *cs2 = *((const CallSite **)cs2ptr);
+    
+    // Return 1 if cs2 spends more time in MPI in aggregate
+    if (cs2->sorting_mpi_pct > cs1->sorting_mpi_pct)
+	return (1);
+
+    // Return -1 if cs2 spends less time in MPI in aggregate
+    if (cs2->sorting_mpi_pct < cs1->sorting_mpi_pct)
+	return (-1);
+
+    // Break ties using siteId
+    return (cs1->siteID - cs2->siteID);
+}
+
+// Sort callsite timing statistic messages by MPI% and then callsiteId, then 
+// format and write in XML the MPIP callsite timing messages
+void MpipInfo::writeCallsiteTimingMessages(MpipXMLOutput &out)
+{
+    // Create message folder for callsite statistic messages in XML format
+    out.writef ( 
+	     "<message_folder>\n"
+	     "  <tag>timings</tag>\n"
+	     "  <title>MpiP Callsite Timing Statistics (all, milliseconds)</title>\n"
+	     "</message_folder>\n"
+	     "\n");
+
+    // Flush out folder, so something will be visible in GUI early for
+    // huge (145MB) mpiP files
+    out.flush ();
+
+
+    // Create pointer array for sorting callsites 
+    CallSite **sortedSites = new CallSite *[num_callsites];
+
+    // Initialize sortedSites with pointers to the unsorted array
+    for (int i = 0; i < num_callsites; ++i)
+    {
+	sortedSites[i] = &sites[i];
+    }
+    
+    // Sort pointers to the callsites by percent MPI and to break ties,
+    // callsite id
+    qsort( (void *)sortedSites, num_callsites, sizeof( CallSite *),
+	   compareCallSitePtrsByMpiPct );
+
+    // Create an automatically resized message buffer that we can create 
+    // message and traceback in without fear of overflowing the buffer
+    MessageBuffer mbuf, tbuf;
+
+    // Small buffer so can append callsite to call type (i.e., Bcast[12])
+    char typebuf[200];
+
+    // Figure out how many digits required to print num_tasks
+    sprintf (typebuf, "%i", num_tasks);
+    int taskDigits = strlen (typebuf);
+
+    // Print out call statistics with largest MPI % first
+    for (int i = 0; i < num_callsites; ++i)
+    {
+	// Create callsite type and siteId identifier
+	sprintf (typebuf, "%s[%i]", sortedSites[i]->call, 
+		 sortedSites[i]->siteID);
+
+	// Determine how many tasks have data filled in (count != -1)
+	SiteStats &stats = sortedSites[i]->stats;
+	int taskCount = stats.tasksReporting (num_tasks);
+    
+	// Create the heading, a one-line description line for this callsite,
+	// depends on callsite format (whether location info exists)
+	if (sortedSites[i]->location[0].format == 1)
+	{
+	    mbuf.sprintf ( 
+		"  <heading>%-18s %6.2f%% of MPI %6.2f%% of App   "
+		"%*i/%i Tasks   %s:%i  (%s)</heading>\n",
+		typebuf, 
+		statAt (stats.mpi_pct, num_tasks),
+		statAt (stats.app_pct, num_tasks),
+		taskDigits, taskCount, num_tasks,
+		sortedSites[i]->location[0].function, 
+		sortedSites[i]->location[0].line_number,
+		sortedSites[i]->location[0].filename);
+	}
+
+	// Create the heading where location info does not exist
+	else if (sortedSites[i]->location[0].format == 2)
+	{
+	    mbuf.sprintf ( 
+		"  <heading>%-18s %6.2f%% of MPI %6.2f%% of App   "
+		"%*i/%i Tasks   [Addr: %s] (unknown location)</heading>\n",
+		typebuf, 
+		statAt (stats.mpi_pct, num_tasks),
+		statAt (stats.app_pct, num_tasks),
+		taskDigits, taskCount, num_tasks,
+		sortedSites[i]->location[0].filename);
+	}
+
+	// No other formats right now
+	else
+	{
+	    TG_error ("Creating Timing Heading: "
+		      "Unexpected callsite format %i\n", 
+		      sortedSites[i]->location[0].format);
+	}
+
+	// Append header for stats (first line of the message body)
+	mbuf.appendSprintf ("  <body>   Task      Count     Max(ms)   Mean(ms)    "
+			    "Min(ms)     MPI%%    App%%\n");
+
+	// The stats at 'num_tasks' are the aggregate stats
+	int all = num_tasks;
+
+	// Append out aggregate stats after header
+	mbuf.appendSprintf ("   ALL: %10i %11.4f %10.4f %10.4f   %6.2f  %6.2f",
+			    stats.countAt (all), statAt (stats.max, all),
+			    statAt (stats.mean, all), statAt (stats.min, all),
+			    statAt (stats.mpi_pct, all),
+			    statAt (stats.app_pct, all));
+
+	// Append to the message a stats line for each task
+	for (int rank=0; rank < num_tasks; ++rank)
+	{
+	    // Only print stats for tasks that reached callsite (count != -1)
+	    if (stats.countAt (rank) != -1)
+	    {
+		mbuf.appendSprintf (
+		    "\n%6i: %10i %11.4f %10.4f %10.4f   %6.2f  %6.2f",
+		    rank, stats.count[rank], stats.max[rank],
+		    stats.mean[rank], stats.min[rank], stats.mpi_pct[rank],
+		    stats.app_pct[rank]);
+	    }
+	}
+
+	// Don't end message with '\n' unless you want a blank line
+	// after the message
+
+	// Put end body tag after message
+	mbuf.appendSprintf("</body>\n");
+
+	// Start traceback with callsite info
+	tbuf.sprintf ("%s", sortedSites[i]->traceback);
+
+	// If have timingLineNo info (not -1), append traceback to
+	// the MpiP output that generated this message
+	if ((sortedSites[i]->timingLineNo > -1) && (outputMpiPRefs))
+	{
+	    tbuf.appendSprintf ("  <annot>\n"
+				"    <title>Raw MpiP Data</title>\n"
+				"    <site>\n"
+				"      <file>%s</file>\n"
+				"      <line>%i</line>\n"
+				"    </site>\n"
+				"  </annot>\n", 
+				mpip_file_name, sortedSites[i]->timingLineNo);
+	}
+
+	// DEBUG, stress out GUI by sending multiple of same message!
+	for (int dupl = 0; dupl < 1; ++dupl)
+	{
+
+	    // Write out stats message with callsite traceback in XML
+	    out.writef ( 
+		     "<message>\n"
+		     "  <folder>timings</folder>\n"
+		     "%s"
+		     "%s"
+		     "</message>\n"
+		     "\n", 
+		     mbuf.contents(),
+		     tbuf.contents());
+	}
+    }
+
+    // Delete the sorted callsite info pointers (only)
+    delete [] sortedSites;
+}
+
+#if 0
+// Not currently used; call is commented out
+// This function is used in sorting a list of CallSite pointers by
+// the sum of bytes sent, in aggregate, breaking ties with callsiteId
+static int compareCallSitePtrsByBytesSent(const void * cs1ptr, 
+					  const void * cs2ptr)
+{
+    const CallSite *cs1 = *((const CallSite **)cs1ptr);
+    const CallSite *cs2 = *((const CallSite **)cs2ptr);
+    
+    // Return 1 if cs2 sent more bytes
+    if (cs2->sorting_sumSent > cs1->sorting_sumSent)
+	return (1);
+
+    // Return -1 if cs2 sent list bytes
+    if (cs2->sorting_sumSent < cs1->sorting_sumSent)
+	return (-1);
+
+    // Break ties using siteId
+    return (cs1->siteID - cs2->siteID);
+}
+#endif
+
+// Sort callsite bytes sent messages by MPI% (instead of total bytes sent)
+// and then  callsiteId, then format and write in XML the MPIP 
+// callsite bytes sent messages
+void MpipInfo::writeCallsiteBytesSentMessages(MpipXMLOutput &out)
+{
+    // Create message folder for callsite data sent messages in XML format
+    out.writef ( 
+	     "<message_folder>\n"
+	     "  <tag>bytesSent</tag>\n"
+	     "  <title>MpiP Callsite Bytes Sent Statistics (all, bytes)</title>\n"
+	     "</message_folder>\n"
+	     "\n");
+
+    // If no stats provided, send message to folder to indicate
+    if (allSentLineNo == -1)
+    {
+	// write just one message, indicating no data
+	out.writef (
+		 "<message>\n"
+		 "  <folder>bytesSent</folder>\n"
+		 "  <heading>(No bytes sent statistics in mpiP file)</heading>\n"
+		 "</message>\n"
+		 "\n");
+
+	// Return now
+	return;
+    }
+
+
+
+    // Create pointer array for sorting callsites 
+    CallSite **sortedSites = new CallSite *[num_callsites];
+
+    // Initialize sortedSites with pointers to the unsorted array
+    for (int i = 0; i < num_callsites; ++i)
+    {
+	sortedSites[i] = &sites[i];
+    }
+
+#if 0
+    // REALLY WANT SORTED BY %MPI, NOT MESSAGE SIZE
+    // Sort pointers to the callsites by percent MPI and to break ties,
+    // callsite id
+    qsort( (void *)sortedSites, num_callsites, sizeof( CallSite *),
+	   compareCallSitePtrsByBytesSent );
+#endif
+
+    // Sort pointers to the callsites by percent MPI and to break ties,
+    // callsite id
+    qsort( (void *)sortedSites, num_callsites, sizeof( CallSite *),
+	   compareCallSitePtrsByMpiPct );
+
+    // Create an automatically resized message buffer that we can create 
+    // message and traceback in without fear of overflowing the buffer
+    MessageBuffer mbuf, tbuf;
+
+
+    // Small buffer so can append callsite to call type (i.e., Bcast[12])
+    char typebuf[200];
+
+    // Figure out how many digits required to print num_tasks
+    sprintf (typebuf, "%i", num_tasks);
+    int taskDigits = strlen (typebuf);
+
+    // Print out call statistics with largest total bytes sent first
+    for (int i = 0; i < num_callsites; ++i)
+    {
+	// Skip messages that mpiP didn't report about
+	if (statAt (sortedSites[i]->stats.sumSent, num_tasks) < 0)
+	    continue;
+	
+	// Create callsite type and siteId identifier
+	sprintf (typebuf, "%s[%i]", sortedSites[i]->call, 
+		 sortedSites[i]->siteID);
+    
+	// Create the one-line description line for this callsite
+
+	// Determine how many tasks have data filled in (count != -1)
+	SiteStats &stats = sortedSites[i]->stats;
+	int taskCount = stats.tasksReporting (num_tasks);
+
+	// Create heading, the one-line description line for this callsite,
+	// depends on callsite format (whether location info exists)
+	if (sortedSites[i]->location[0].format == 1)
+	{
+	    mbuf.sprintf ( 
+		"  <heading>%-18s %6.2f%% of MPI  %13.8g Total  %13.8g Mean   "
+		"%*i/%i Tasks   %s:%i  (%s)</heading>\n",
+		typebuf, 
+		statAt (stats.mpi_pct, num_tasks),
+		statAt (stats.sumSent, num_tasks),
+		statAt (stats.meanSent, num_tasks),
+		taskDigits, taskCount, num_tasks,
+		sortedSites[i]->location[0].function, 
+		sortedSites[i]->location[0].line_number,
+		sortedSites[i]->location[0].filename);
+	}
+	// Create heading where location info does not exist
+	else if (sortedSites[i]->location[0].format == 2)
+	{
+	    mbuf.sprintf ( 
+		"  <heading>%-18s %6.2f%% of MPI  %13.8g Total  %13.8g Mean   "
+		"%*i/%i Tasks   [Addr: %s] (unknown location)</heading>\n",
+		typebuf, 
+		statAt (stats.mpi_pct, num_tasks),
+		statAt (stats.sumSent, num_tasks),
+		statAt (stats.meanSent, num_tasks),
+		taskDigits, taskCount, num_tasks,
+		sortedSites[i]->location[0].filename);
+	}
+	// No other formats right now
+	else
+	{
+	    TG_error ("Creating Bytes Sent Header: "
+		      "Unexpected callsite format %i\n", 
+		      sortedSites[i]->location[0].format);
+	}
+
+	// Append header for stats (first line of message body)
+	mbuf.appendSprintf ("  <body>   Task      Count     Max(bytes)    Mean(bytes)     Min(bytes)     Sum(bytes)\n");
+
+	// The stats at 'num_tasks' are the aggregate stats
+	int all = num_tasks;
+
+	// Append out aggregate stats after header
+	mbuf.appendSprintf ("   ALL: %10i  %13.8g  %13.8g  %13.8g  %13.8g",
+			    stats.countAt (all), statAt (stats.maxSent, all),
+			    statAt (stats.meanSent, all), 
+			    statAt (stats.minSent, all), 
+			    statAt (stats.sumSent, all));
+
+	// Append to the message a stats line for each task
+	for (int rank=0; rank < num_tasks; ++rank)
+	{
+	    // Only print stats for tasks that reached callsite (count != -1)
+	    if (stats.countAt (rank) != -1)
+	    {
+		mbuf.appendSprintf (
+		    "\n%6i: %10i  %13.8g  %13.8g  %13.8g  %13.8g",
+		    rank, stats.count[rank], 
+		    statAt (stats.maxSent, rank), statAt (stats.meanSent, rank), 
+		    statAt (stats.minSent, rank), statAt (stats.sumSent, rank));
+	    }
+	}
+
+	// Don't end message with '\n' unless you want a blank line
+	// after the message
+
+	// Put end body tag after message
+        mbuf.appendSprintf("</body>\n");
+
+
+	// Start traceback with callsite info
+	tbuf.sprintf ("%s", sortedSites[i]->traceback);
+
+	// If have sentLineNo info (not -1), append traceback to
+	// the MpiP output that generated this message
+	if ((sortedSites[i]->sentLineNo > -1) && (outputMpiPRefs))
+	{
+	    tbuf.appendSprintf ("  <annot>\n"
+				"    <title>Raw MpiP Data</title>\n"
+				"    <site>\n"
+				"      <file>%s</file>\n"
+				"      <line>%i</line>\n"
+				"    </site>\n"
+				"  </annot>\n", 
+				mpip_file_name, sortedSites[i]->sentLineNo);
+	}
+
+	// Write out stats message with callsite traceback
+	out.writef (
+		 "<message>\n"
+		 "  <folder>bytesSent</folder>\n"
+		 "%s"
+		 "%s"
+		 "</message>\n"
+		 "\n",
+		 mbuf.contents(),
+		 tbuf.contents());
+    }
+
+    // Delete the sorted callsite info pointers (only)
+    delete [] sortedSites;
+}
+
+// Sort callsite IO messages by MPI% (instead of total IO)
+// and then callsiteId, then format and write in XML the MPIP 
+// callsite IO messages
+void MpipInfo::writeCallsiteIOMessages(MpipXMLOutput &out)
+{
+    // Create message folder for callsite IO messages in XML format
+    out.writef (
+             "<message_folder>\n"
+             "  <tag>IO</tag>\n"
+             "  <title>MpiP Callsite I/O Statistics (all, I/O bytes)</title>\n"
+             "</message_folder>\n"
+             "\n");
+
+
+    // If no stats provided, send message to folder to indicate
+    if (allIOLineNo == -1)
+    {
+        // write just one message, indicating no data
+        out.writef (
+                 "<message>\n"
+                 "  <folder>IO</folder>\n"
+                 "  <heading>(No I/O statistics in mpiP file)</heading>\n"
+                 "</message>\n"
+                 "\n");
+
+	// Return now
+	return;
+    }
+
+
+    // Create pointer array for sorting callsites 
+    CallSite **sortedSites = new CallSite *[num_callsites];
+
+    // Initialize sortedSites with pointers to the unsorted array
+    for (int i = 0; i < num_callsites; ++i)
+    {
+	sortedSites[i] = &sites[i];
+    }
+
+    // Sort pointers to the callsites by percent MPI and to break ties,
+    // callsite id
+    qsort( (void *)sortedSites, num_callsites, sizeof( CallSite *),
+	   compareCallSitePtrsByMpiPct );
+
+    // Create an automatically resized message buffer that we can create 
+    // message and traceback in without fear of overflowing the buffer
+    MessageBuffer mbuf, tbuf;
+
+    // Small buffer so can append callsite to call type (i.e., Bcast[12])
+    char typebuf[200];
+
+    // Figure out how many digits required to print num_tasks
+    sprintf (typebuf, "%i", num_tasks);
+    int taskDigits = strlen (typebuf);
+
+    // Print out call I/O statistics in sorted order
+    for (int i = 0; i < num_callsites; ++i)
+    {
+	// Skip messages that mpiP didn't report about
+	if (statAt (sortedSites[i]->stats.sumIO, num_tasks) < 0)
+	    continue;
+	
+	// Create callsite type and siteId identifier
+	sprintf (typebuf, "%s[%i]", sortedSites[i]->call, 
+		 sortedSites[i]->siteID);
+    
+	// Create the one-line description line for this callsite
+
+	// Determine how many tasks have data filled in (count != -1)
+	SiteStats &stats = sortedSites[i]->stats;
+	int taskCount = stats.tasksReporting (num_tasks);
+
+	// Create heading, the one-line description line for this callsite,
+	// depends on callsite format (whether location info exists)
+	if (sortedSites[i]->location[0].format == 1)
+	{
+	    mbuf.sprintf ( 
+		"  <heading>%-18s %6.2f%% of MPI  %13.8g Total I/O  %13.8g Mean I/O  "
+		"%*i/%i Tasks   %s:%i  (%s)</heading>\n",
+		typebuf, 
+		statAt (stats.mpi_pct, num_tasks),
+		statAt (stats.sumIO, num_tasks),
+		statAt (stats.meanIO, num_tasks),
+		taskDigits, taskCount, num_tasks,
+		sortedSites[i]->location[0].function, 
+		sortedSites[i]->location[0].line_number,
+		sortedSites[i]->location[0].filename);
+	}
+	// Create heading where location info does not exist
+	else if (sortedSites[i]->location[0].format == 2)
+	{
+	    mbuf.sprintf ( 
+		"  <heading>%-18s %6.2f%% of MPI  %13.8g Total I/O  %13.8g Mean I/O   "
+		"%*i/%i Tasks   [Addr: %s] (unknown location)</heading>\n",
+		typebuf, 
+		statAt (stats.mpi_pct, num_tasks),
+		statAt (stats.sumIO, num_tasks),
+		statAt (stats.meanIO, num_tasks),
+		taskDigits, taskCount, num_tasks,
+		sortedSites[i]->location[0].filename);
+	}
+	// No other formats right now
+	else
+	{
+	    TG_error ("Creating I/O Header: "
+		      "Unexpected callsite format %i\n", 
+		      sortedSites[i]->location[0].format);
+	}
+
+	// Append header for stats (first line of message body)
+	mbuf.appendSprintf ("  <body>   Task      Count     Max(bytes)    Mean(bytes)     Min(bytes)     Sum(bytes)\n");
+
+	// The stats at 'num_tasks' are the aggregate stats
+	int all = num_tasks;
+
+	// Append out aggregate stats after header
+	mbuf.appendSprintf ("   ALL: %10i  %13.8g  %13.8g  %13.8g  %13.8g",
+			    stats.countAt (all), statAt (stats.maxIO, all),
+			    statAt (stats.meanIO, all), 
+			    statAt (stats.minIO, all), 
+			    statAt (stats.sumIO, all));
+
+	// Append to the message a stats line for each task
+	for (int rank=0; rank < num_tasks; ++rank)
+	{
+	    // Only print stats for tasks that reached callsite (count != -1)
+	    if (stats.countAt (rank) != -1)
+	    {
+		mbuf.appendSprintf (
+		    "\n%6i: %10i  %13.8g  %13.8g  %13.8g  %13.8g",
+		    rank, stats.count[rank], 
+		    statAt (stats.maxIO, rank), statAt (stats.meanIO, rank), 
+		    statAt (stats.minIO, rank), statAt (stats.sumIO, rank));
+	    }
+	}
+
+	// Don't end message with '\n' unless you want a blank line
+	// after the message
+
+	// Put end body tag after message
+        mbuf.appendSprintf("</body>\n");
+
+	// Start traceback with callsite info
+	tbuf.sprintf ("%s", sortedSites[i]->traceback);
+
+	// If have ioLineNo info (not -1), append traceback to
+	// the MpiP output that generated this message
+	if ((sortedSites[i]->ioLineNo > -1) && (outputMpiPRefs))
+	{
+	    tbuf.appendSprintf ("  <annot>\n"
+				"    <title>Raw MpiP Data</title>\n"
+				"    <site>\n"
+				"      <file>%s</file>\n"
+				"      <line>%i</line>\n"
+				"    </site>\n"
+				"  </annot>\n", 
+				mpip_file_name, sortedSites[i]->ioLineNo);
+	}
+
+	// Write out stats message with callsite traceback
+	out.writef (
+                 "<message>\n"
+                 "  <folder>IO</folder>\n"
+                 "%s"
+                 "%s"
+                 "</message>\n"
+                 "\n",
+                 mbuf.contents(),
+                 tbuf.contents());
+    }
+
+
+    // Delete the sorted callsite info pointers (only)
+    delete [] sortedSites;
+}
+
+
+
+
+// Create and write in XML the callsite location messages in the order
+// of the callsites.  Mainly to allow user to see each callsite location.
+void MpipInfo::writeCallsiteLocationMessages(MpipXMLOutput &out)
+{
+    // Create callsite message forlder in XML format
+    out.writef (
+             "<message_folder>\n"
+             "  <tag>sites</tag>\n"
+             "  <title>MpiP Call Sites</title>\n"
+             "</message_folder>\n"
+             "\n");
+    
+    // Create an automatically resized message buffer that we can create 
+    // message in without fear of overflowing the buffer
+    MessageBuffer mbuf;
+
+    // Print out each call site location, in siteID order
+    for (int i = 0; i < num_callsites; ++i)
+    {
+	// As heading, print out first level trackback info for callsite
+	// depends on callsite format (whether location info exists)
+	if (sites[i].location[0].format == 1)
+	{
+	    mbuf.sprintf ("  <heading>%4.0i %s:%i (%s)  %s</heading>\n", 
+			  sites[i].siteID, sites[i].location[0].function, 
+			  sites[i].location[0].line_number, 
+			  sites[i].location[0].filename, sites[i].call);
+	}
+	// Create heading where location info does not exist
+	else if (sites[i].location[0].format == 2)
+	{
+	    mbuf.sprintf ("  <heading>%4.0i [Addr: %s] (unknown location)  %s</heading>\n", 
+			  sites[i].siteID,
+			  sites[i].location[0].filename, sites[i].call);
+	}
+	// No other formats right now
+	else
+	{
+	    TG_error ("Creating Callsite Header: "
+		      "Unexpected callsite format %i\n", 
+		      sites[i].location[0].format);
+	}
+
+	// If have body (more than one level traceback), start body
+	if ((trace_depth > 1) && (sites[i].location[1].function != NULL))
+	    mbuf.appendSprintf ("  <body>");
+
+	// Print out any remaining levels that are actually specified
+	// (if hit main, doesn't go lower, so may have fewer levels)
+	for (int level = 1; level < trace_depth; ++level)
+	{
+	    // Stop if info not specified for this level
+	    if (sites[i].location[level].function == NULL)
+		break;
+
+	    // If printing second or later line, append newline 
+	    if (level > 1)
+		mbuf.appendSprintf("\n");
+
+	    // Append this level's info onto end of message
+	    // Handle case where location is known
+	    if (sites[i].location[level].format == 1)
+	    {
+		mbuf.appendSprintf ("   %s:%i (%s)", 
+				    sites[i].location[level].function, 
+				    sites[i].location[level].line_number, 
+				    sites[i].location[level].filename);
+	    }
+	    // Handle case where location not known, only address is known
+	    else if (sites[i].location[level].format == 2)
+	    {
+		mbuf.appendSprintf ("   [Addr: %s] (unknown location)", 
+				    sites[i].location[level].filename);
+	    }
+
+	    // No other formats yet
+	    else
+	    {
+		TG_error ("Callsite Body: Unexpected level %i callsite "
+			  "format %i\n", 
+			  level, sites[i].location[level].format);
+	    }
+	}
+
+	// If have body (more than one level traceback), end body
+	if ((trace_depth > 1) && (sites[i].location[1].function != NULL))
+	    mbuf.appendSprintf ("</body>\n");
+
+        // Write out call sites in siteID order to call site message folder
+        out.writef (
+                 "<message>\n"
+                 "  <folder>sites</folder>\n"
+                 "%s"
+                 "%s"
+                 "</message>\n"
+                 "\n",
+                 mbuf.contents(),
+                 sites[i].traceback);
+    }
+}
+
+// Write out messages about the mpiP file itself to indicate
+// section headings
+void MpipInfo::writeMpiPFileMessages(MpipXMLOutput &out)
+{
+    // Create mpiP message folder
+    out.writef (
+             "<message_folder>\n"
+             "  <tag>mpiP</tag>\n"
+             "  <title>Indexed MpiP Output Text</title>\n"
+             "</message_folder>\n"
+             "\n");
+
+    // Create indexes for various interesting points in the mpiP file
+    writeMpiPFileIndex (out, commandLineNo, "Invocation Command");
+    writeMpiPFileIndex (out, versionLineNo, "mpiP Version");
+    writeMpiPFileIndex (out, envLineNo, 
+			"MPIP Environment Variable Setting");
+    writeMpiPFileIndex (out, nodesLineNo, "MPI Task Assignment");
+    writeMpiPFileIndex (out, mpiTimeLineNo, 
+			"MPI Time Breakdown By MPI Task");
+    writeMpiPFileIndex (out, sitesLineNo, "Callsites Measured By mpiP");
+    writeMpiPFileIndex (out, topTimeLineNo, 
+		       "Aggregate Time Statistics for Top Twenty Callsites");
+    writeMpiPFileIndex (out, topSentLineNo, 
+       "Aggregate Bytes Sent Statistics for Top Twenty Callsites");
+    writeMpiPFileIndex (out, topIOLineNo, 
+       "Aggregate I/O Size Statistics for Top Twenty Callsites");
+    writeMpiPFileIndex (out, allTimeLineNo, 
+		       "Detailed Time Statistics for All Callsites");
+    writeMpiPFileIndex (out, allSentLineNo, 
+		       "Detailed Bytes Sent Statistics for All Callsites");
+    writeMpiPFileIndex (out, allIOLineNo, 
+		       "Detailed I/O Statistics for All Callsites");
+}
+
+// Helper routine that creates and writes index message for the mpip file
+// Automatically prepends line number into message
+// Automatically skips message if lineNo is -1
+void MpipInfo::writeMpiPFileIndex (MpipXMLOutput &out, int lineNo, 
+				  const char *fmt, ...)
+{
+    va_list args;
+
+    // If didn't find a section, don't put out message
+    if (lineNo == -1)
+	return;
+
+    // Create automatically resized message and traceback buffers to 
+    // prevent overflow
+    MessageBuffer mbuf, tbuf;
+
+    // Create traceback to lineNo in mpiP file
+    tbuf.sprintf ("  <annot>\n"
+		  "    <site>\n"
+		  "      <file>%s</file>\n"
+		  "      <line>%i</line>\n"
+		  "    </site>\n"
+		  "  </annot>\n", 				
+		  mpip_file_name, lineNo);
+
+    // Prepend message with lineNo
+    mbuf.sprintf ("%5i: ", lineNo);
+
+    // Append message passed in with fmt
+    va_start (args, fmt);
+    mbuf.vappendSprintf (fmt, args);
+    va_end(args);
+
+    // write message to "mpiP" message section
+    out.writef (
+	     "<message>\n"
+	     "  <folder>mpiP</folder>\n"
+                 "  <heading>%s</heading>\n"
+                 "%s"
+                 "</message>\n"
+                 "\n",
+                 mbuf.contents(),
+                 tbuf.contents());
+}
+
+// Formats whole elements, as with printf, and writes them
+void MpipXMLOutput::writef (const char *fmt, ...)
+{
+    va_list args;
+    va_start (args, fmt);
+    buf.vsprintf (fmt, args);
+    va_end (args);
+
+    write (buf.contents(), buf.strlen());
+}
+
+// Helper routine that writes the sorted callsite messages for one kind
+// of statistics in Tool Gear's XML format
+static void writeStatsMessages (MpipInfo &mpipData, int kind, 
+				MpipXMLOutput &out)
+{
+    if (kind == TIMING_STATS)
+	mpipData.writeCallsiteTimingMessages(out);
+    else if (kind == SENT_STATS)
+	mpipData.writeCallsiteBytesSentMessages(out);
+    else
+	mpipData.writeCallsiteIOMessages(out);
+    out.flush ();
+}
+
+// Helper routine that describes the tool for the About... box
+static void writeAboutXML (MpipXMLOutput &out)
+{
+    out.writef (
+	     "<about>\n"
+	     "  <prepend>Tool Gear %4.2f's mpiP View GUI:\n"
+	     "Reports timing data for MPI calls using data gathered through mpiP\n"
+	     "Written (using Tool Gear's XML interface) by\n"
+	     "John Gyllenhaal and John May\n"
+	     "\n"
+	     "The mpiP library was written by\n"
+	     "Jeffrey Vetter and Chris Chambreau\n"
+	     "www.llnl.gov/CASC/mpip</prepend>\n"
+	     "</about>\n"
+	     "\n", TG_VERSION);
+}
+
+// Returns the file name without its path
+static const char *noPathName (const char *fileName)
+{
+    int lastSlash = 0;
+    for (int index=0; fileName[index] != 0; index++)
+    {
+	if (fileName[index] == '/')
+	    lastSlash = index + 1;
+    }
+    return (&fileName[lastSlash]);
+}
+
+// Reads mpipFileName and writes everything that goes inside Tool Gear's
+// <tool_gear> element to out
+void writeMpipXML (const char *mpipFileName, MpipXMLOutput &out)
+{
+    // Describe the tool for the About... box
+    writeAboutXML (out);
+
+    // Get file name without path
+    const char *noPathFileName = noPathName (mpipFileName);
+
+    // Set the initial main tool title
+    out.writef (
+	     "<tool_title>MpiP View - %s</tool_title>\n"
+	     "\n",
+	     mpipFileName);
+
+    // Set the initial tool status message
+    out.writef (
+             "<status>Reading in %s</status>\n"
+             "\n",
+	     noPathFileName);
+    out.flush ();
+
+    // Read in the start of the mpip data, through the callsite list
+    MpipInfo mpipData (mpipFileName);
+
+    // Write each kind of statistics' sorted callsite messages as soon
+    // as its section has been read.  Kinds with no section are written
+    // (as mpiP writes them, in StatsKind order) when a later one is found
+    // or at the end of the file, just as they would be after reading it
+    // all, so the messages come out in the same order either way.
+    int written = 0;
+    int kind;
+    while ((kind = mpipData.readNextStatsSection ()) != -1)
+    {
+	while (written <= kind)
+	    writeStatsMessages (mpipData, written++, out);
+
+	// Stop reading if nothing more is wanted
+	if (out.stopped ())
+	    return;
+    }
+    while (written <= IO_STATS)
+	writeStatsMessages (mpipData, written++, out);
+
+    // Write callsite locations in Tool Gear's XML format
+    mpipData.writeCallsiteLocationMessages(out);
+    out.flush ();
+
+    // Write details about the mpiP file itself with messages indicating
+    // section headings (since we don't grab everything in the file)
+    mpipData.writeMpiPFileMessages(out);
+    
+    // Set the Final tool status message
+    out.writef (
+             "<status>Finished reading in %s</status>\n"
+             "\n",
+	     noPathFileName);
+    out.flush ();
+}
+
+// Aggregate stats for a compared callsite in one of the reports (all 0,
+// and not present, if the callsite isn't in that report)
+struct ComparedStats {
+    bool present;
+    double mpi_pct;           // Aggregate MPI%
+    double time;              // Aggregate time (ms), count * mean
+    double sent;              // Aggregate bytes sent
+    int timingLineNo;         // First line of Timing stats, or -1
+};
+
+// A callsite found in one or more of the reports being compared
+struct ComparedSite {
+    char *call;
+    LocationInfo location;    // Level 0, where the call is made
+    char *traceback;          // From the first report it was found in
+    ComparedStats *stats;     // One per report
+    double sorting_mpi_pct;   // For sorting, largest MPI% in any report
+    int order;                // Order found, for breaking ties
+};
+
+// The site columns' values for one source line, summed over the compared
+// callsites made from it.  The lines in a file are chained in the order
+// found.
+struct ComparedLine {
+    int line_number;
+    int nextInFile;           // Next line in the same file, or -1
+    ComparedStats *stats;     // One per report
+};
+
+// A source file with compared callsites in it
+struct ComparedFile {
+    const char *filename;     // Points into a ComparedSite
+    int firstLine;            // First of its ComparedLines
+    int lastLine;
+};
+
+// What the site columns show, for each report or change between reports
+enum ComparedValue {COMPARED_MPI_PCT, COMPARED_TIME, COMPARED_SENT,
+		    COMPARED_EFFICIENCY};
+
+// Matches up the callsites of several mpiP reports by their call and
+// call stack.  Each report's callsites are looked up by a fingerprint
+// string of both in a hash table, so matching takes time linear in the
+// total number of callsites, and only the aggregate stats for each
+// report are kept (the MpipInfo for a report can be deleted once it
+// has been added).
+class MpipComparison
+{
+public:
+    MpipComparison (const char * const *fileNames, int numReports);
+    ~MpipComparison ();
+
+    //! Matches up info's callsites (whose stats must all have been read)
+    //! with those of the reports added before it
+    void addReport (MpipInfo &info, int report);
+
+    //! Writes a message describing each report, then one for each
+    //! callsite comparing its stats, with the largest MPI% first
+    void writeMessages (MpipXMLOutput &out);
+
+    //! Writes site columns with each report's stats (summed for each
+    //! line making MPI calls), the change from the first report, and
+    //! the scaling efficiency relative to the first report
+    void writeColumns (MpipXMLOutput &out);
+
+private:
+    int addSite (CallSite &site);
+    bool columnValue (const ComparedStats *stats, int value, int report,
+		      bool change, double &result);
+
+    const char * const *fileNames;
+    int numReports;
+    int *numTasks;            // Job size of each report
+
+    ComparedSite *sites;
+    int numSites;
+    int maxSites;
+    StringTable<int> siteIndex; // Fingerprint to index in sites
+    MessageBuffer fingerprint;
+};
+
+MpipComparison::MpipComparison (const char * const *fileNames_,
+				int numReports_) :
+    fileNames (fileNames_),
+    numReports (numReports_),
+    sites (NULL),
+    numSites (0),
+    maxSites (0),
+    siteIndex ("mpipComparedSites", DeleteData, 0)
+{
+    numTasks = new int[numReports];
+    for (int r = 0; r < numReports; ++r)
+	numTasks[r] = 0;
+}
+
+MpipComparison::~MpipComparison ()
+{
+    for (int i = 0; i < numSites; ++i)
+    {
+	free (sites[i].call);
+	free (sites[i].location.filename);
+	if (sites[i].location.function != NULL)
+	    free (sites[i].location.function);
+	free (sites[i].traceback);
+	delete [] sites[i].stats;
+    }
+    free (sites);
+    delete [] numTasks;
+}
+
+// Helper routine that adds a copy of site (from the first report it is
+// found in) and returns its index
+int MpipComparison::addSite (CallSite &site)
+{
+    if (numSites >= maxSites)
+    {
+	maxSites = (maxSites > 0) ? maxSites * 2 : 256;
+	sites = (ComparedSite *) realloc (sites,
+					  maxSites * sizeof (ComparedSite));
+	TG_checkAlloc (sites);
+    }
+    ComparedSite &compared = sites[numSites];
+    compared.call = strdup (site.call);
+    compared.location = site.location[0];
+    compared.location.filename = strdup (site.location[0].filename);
+    if (site.location[0].function != NULL)
+	compared.location.function = strdup (site.location[0].function);
+    compared.traceback = strdup (site.traceback);
+    TG_checkAlloc (compared.call);
+    TG_checkAlloc (compared.location.filename);
+    TG_checkAlloc (compared.traceback);
+
+    compared.stats = new ComparedStats[numReports];
+    for (int r = 0; r < numReports; ++r)
+    {
+	compared.stats[r].present = FALSE;
+	compared.stats[r].mpi_pct = 0.0;
+	compared.stats[r].time = 0.0;
+	compared.stats[r].sent = 0.0;
+	compared.stats[r].timingLineNo = -1;
+    }
+    compared.sorting_mpi_pct = 0.0;
+    compared.order = numSites;
+
+    return (numSites++);
+}
+
+// Matches up info's callsites with those of the reports added before it
+void MpipComparison::addReport (MpipInfo &info, int report)
+{
+    numTasks[report] = info.num_tasks;
+
+    // The stats at 'num_tasks' are the aggregate stats
+    int all = info.num_tasks;
+
+    for (int i = 0; i < info.num_callsites; ++i)
+    {
+	CallSite &site = info.sites[i];
+
+	// Fingerprint the callsite by its call and every level of its
+	// call stack (siteIDs aren't the same from run to run)
+	fingerprint.sprintf ("%s", site.call);
+	for (int d = 0; d < info.trace_depth; ++d)
+	{
+	    LocationInfo &location = site.location[d];
+
+	    // If read in less levels than specified, stop now
+	    if (location.filename == NULL)
+		break;
+
+	    fingerprint.appendSprintf ("\001%s\001%i\001%s",
+				       location.filename,
+				       location.line_number,
+				       (location.function != NULL) ? 
+				       location.function : "");
+	}
+
+	// Find the callsite in the reports before, or add it
+	int *index = siteIndex.findEntry (fingerprint.contents());
+	if (index == NULL)
+	{
+	    index = new int (addSite (site));
+	    siteIndex.addEntry (fingerprint.contents(), index);
+	}
+
+	// Add in its aggregate stats (summed, in the unlikely case a
+	// report has the same call and stack twice)
+	ComparedStats &stats = sites[*index].stats[report];
+	SiteStats &siteStats = site.stats;
+	stats.present = TRUE;
+	if (statAt (siteStats.mpi_pct, all) > 0.0)
+	    stats.mpi_pct += statAt (siteStats.mpi_pct, all);
+	if (siteStats.countAt (all) > 0)
+	{
+	    stats.time += siteStats.countAt (all) * 
+		statAt (siteStats.mean, all);
+	}
+	if (statAt (siteStats.sumSent, all) > 0.0)
+	    stats.sent += statAt (siteStats.sumSent, all);
+	if (stats.timingLineNo == -1)
+	    stats.timingLineNo = site.timingLineNo;
+
+	if (stats.mpi_pct > sites[*index].sorting_mpi_pct)
+	    sites[*index].sorting_mpi_pct = stats.mpi_pct;
+    }
+}
+
+// This function is used in sorting a list of ComparedSite pointers by
+// the largest percent MPI time in any report, breaking ties with the
+// order found
+static int compareComparedSitePtrsByMpiPct (const void * cs1ptr, 
+					    const void * cs2ptr)
+{
+    const ComparedSite *cs1 = *((const ComparedSite **)cs1ptr);
+    const ComparedSite *cs2 = *((const ComparedSite **)cs2ptr);
+
+    if (cs2->sorting_mpi_pct > cs1->sorting_mpi_pct)
+	return (1);
+    if (cs2->sorting_mpi_pct < cs1->sorting_mpi_pct)
+	return (-1);
+    return (cs1->order - cs2->order);
+}
+
+// Helper routine that returns (in result) the scaling efficiency of
+// report relative to the first report: 100% if the callsite's total
+// time over all tasks stayed the same, as it would with perfect strong
+// scaling.  Returns FALSE if there is no time to compare.
+static bool scalingEfficiency (const ComparedStats *stats, int report,
+			       double &result)
+{
+    if (!stats[0].present || !stats[report].present || 
+	(stats[0].time <= 0.0) || (stats[report].time <= 0.0))
+	return (FALSE);
+
+    result = 100.0 * stats[0].time / stats[report].time;
+    return (TRUE);
+}
+
+// Writes a message describing each report, then one for each callsite
+// comparing its stats, with the largest MPI% first
+void MpipComparison::writeMessages (MpipXMLOutput &out)
+{
+    out.writef (
+	     "<message_folder>\n"
+	     "  <tag>compared_reports</tag>\n"
+	     "  <title>MpiP Reports Compared (numbers used in columns)</title>\n"
+	     "</message_folder>\n"
+	     "\n"
+	     "<message_folder>\n"
+	     "  <tag>comparison</tag>\n"
+	     "  <title>MpiP Callsite Comparison (by largest MPI%%)</title>\n"
+	     "</message_folder>\n"
+	     "\n");
+
+    for (int r = 0; r < numReports; ++r)
+    {
+	out.writef (
+		 "<message>\n"
+		 "  <folder>compared_reports</folder>\n"
+		 "  <heading>Report %i: %s (%i tasks)</heading>\n"
+		 "  <annot>\n"
+		 "    <title>MpiP Report</title>\n"
+		 "    <site>\n"
+		 "      <file>%s</file>\n"
+		 "      <line>1</line>\n"
+		 "    </site>\n"
+		 "  </annot>\n"
+		 "</message>\n"
+		 "\n",
+		 r + 1, noPathName (fileNames[r]), numTasks[r], fileNames[r]);
+    }
+    out.flush ();
+
+    // Create pointer array for sorting callsites 
+    ComparedSite **sortedSites = new ComparedSite *[numSites];
+    for (int i = 0; i < numSites; ++i)
+	sortedSites[i] = &sites[i];
+    qsort ((void *)sortedSites, numSites, sizeof (ComparedSite *),
+	   compareComparedSitePtrsByMpiPct);
+
+    // Create an automatically resized message buffer that we can create 
+    // message and traceback in without fear of overflowing the buffer
+    MessageBuffer mbuf, tbuf;
+
+    for (int i = 0; i < numSites; ++i)
+    {
+	ComparedSite &site = *sortedSites[i];
+
+	// The heading shows the MPI% in each report ('-' if not in it)
+	mbuf.sprintf ("  <heading>%-14s MPI%%:", site.call);
+	for (int r = 0; r < numReports; ++r)
+	{
+	    if (site.stats[r].present)
+		mbuf.appendSprintf (" %6.2f", site.stats[r].mpi_pct);
+	    else
+		mbuf.appendSprintf ("      -");
+	}
+	if (site.location.format == 1)
+	{
+	    mbuf.appendSprintf ("   %s:%i  (%s)</heading>\n",
+				site.location.function,
+				site.location.line_number,
+				site.location.filename);
+	}
+	else
+	{
+	    mbuf.appendSprintf ("   [Addr: %s] (unknown location)"
+				"</heading>\n", site.location.filename);
+	}
+
+	// A line of aggregate stats for each report
+	mbuf.appendSprintf ("  <body>Report      Tasks     MPI%%         "
+			    "Time(ms)      Sent(bytes)    Eff%%");
+	for (int r = 0; r < numReports; ++r)
+	{
+	    ComparedStats &stats = site.stats[r];
+	    if (!stats.present)
+	    {
+		mbuf.appendSprintf ("\n%6i: %10i  (callsite not in report)",
+				    r + 1, numTasks[r]);
+		continue;
+	    }
+	    mbuf.appendSprintf ("\n%6i: %10i   %6.2f %16.4f %16.6g", 
+				r + 1, numTasks[r], stats.mpi_pct,
+				stats.time, stats.sent);
+	    double efficiency;
+	    if ((r > 0) && scalingEfficiency (site.stats, r, efficiency))
+		mbuf.appendSprintf ("  %6.1f", efficiency);
+	}
+	mbuf.appendSprintf ("</body>\n");
+
+	// Start traceback with callsite info, then the raw data in each
+	// report
+	tbuf.sprintf ("%s", site.traceback);
+	for (int r = 0; r < numReports; ++r)
+	{
+	    if ((site.stats[r].timingLineNo > -1) && (outputMpiPRefs))
+	    {
+		tbuf.appendSprintf ("  <annot>\n"
+				    "    <title>Raw MpiP Data (Report %i)"
+				    "</title>\n"
+				    "    <site>\n"
+				    "      <file>%s</file>\n"
+				    "      <line>%i</line>\n"
+				    "    </site>\n"
+				    "  </annot>\n", 
+				    r + 1, fileNames[r],
+				    site.stats[r].timingLineNo);
+	    }
+	}
+
+	out.writef (
+		 "<message>\n"
+		 "  <folder>comparison</folder>\n"
+		 "%s"
+		 "%s"
+		 "</message>\n"
+		 "\n", 
+		 mbuf.contents(),
+		 tbuf.contents());
+    }
+
+    delete [] sortedSites;
+}
+
+// Helper routine that returns (in result) a site column's value for a
+// line: value (a ComparedValue) in report, or if change, its change
+// from the first report.  Returns FALSE if the column has no value.
+bool MpipComparison::columnValue (const ComparedStats *stats, int value,
+				  int report, bool change, double &result)
+{
+    if (value == COMPARED_EFFICIENCY)
+	return (scalingEfficiency (stats, report, result));
+
+    // A change is shown if the line is in either report (a callsite
+    // that isn't in one counts as 0 there)
+    if (!stats[report].present && (!change || !stats[0].present))
+	return (FALSE);
+
+    const ComparedStats &now = stats[report];
+    if (value == COMPARED_MPI_PCT)
+	result = now.mpi_pct - (change ? stats[0].mpi_pct : 0.0);
+    else if (value == COMPARED_TIME)
+	result = now.time - (change ? stats[0].time : 0.0);
+    else
+	result = now.sent - (change ? stats[0].sent : 0.0);
+    return (TRUE);
+}
+
+// Appends the lines and values of a site_data in the bulk form: the
+// lines as runs ("first-last") where they are consecutive, then their
+// values, ten to a line
+static void appendBulkSiteData (MessageBuffer &dbuf, const int *lineNumbers,
+				const double *values, int count)
+{
+    dbuf.appendSprintf ("  <lines>");
+    for (int i = 0, next; i < count; i = next)
+    {
+	next = i + 1;
+	while ((next < count) &&
+	       (lineNumbers[next] == lineNumbers[next - 1] + 1))
+	    next++;
+	if (next - i > 1)
+	    dbuf.appendSprintf ("%s%i-%i", (i > 0) ? " " : "", lineNumbers[i],
+				lineNumbers[next - 1]);
+	else
+	    dbuf.appendSprintf ("%s%i", (i > 0) ? " " : "", lineNumbers[i]);
+    }
+    dbuf.appendSprintf ("</lines>\n  <values>");
+    for (int i = 0; i < count; i++)
+    {
+	dbuf.appendSprintf ("%s%.6g", (i == 0) ? "" :
+			    ((i % 10 == 0) ? "\n    " : " "), values[i]);
+    }
+    dbuf.appendSprintf ("</values>\n");
+}
+
+// Writes site columns with each report's stats, summed for each line
+// making MPI calls, the change from the first report, and the scaling
+// efficiency relative to the first report.  The Client only stores site
+// data for now (no view shows it, and snapshots don't hold it); each
+// callsite's message has the reports' stats for that callsite.
+void MpipComparison::writeColumns (MpipXMLOutput &out)
+{
+    // Sum the callsites made from each line (just the ones with a
+    // location), using a table to find each file and line
+    StringTable<int> fileIndex ("mpipComparedFiles", DeleteData, 0);
+    StringTable<int> lineIndex ("mpipComparedLines", DeleteData, 0);
+    ComparedFile *files = new ComparedFile[numSites];
+    ComparedLine *lines = new ComparedLine[numSites];
+    int numFiles = 0;
+    int numLines = 0;
+    MessageBuffer lineKey;
+
+    for (int i = 0; i < numSites; ++i)
+    {
+	ComparedSite &site = sites[i];
+	if (site.location.format != 1)
+	    continue;
+
+	lineKey.sprintf ("%s\001%i", site.location.filename,
+			 site.location.line_number);
+	int *line = lineIndex.findEntry (lineKey.contents());
+	if (line == NULL)
+	{
+	    // Chain a new line onto its file's lines
+	    int *file = fileIndex.findEntry (site.location.filename);
+	    if (file == NULL)
+	    {
+		file = new int (numFiles++);
+		fileIndex.addEntry (site.location.filename, file);
+		files[*file].filename = site.location.filename;
+		files[*file].firstLine = -1;
+	    }
+
+	    line = new int (numLines++);
+	    lineIndex.addEntry (lineKey.contents(), line);
+	    ComparedLine &newLine = lines[*line];
+	    newLine.line_number = site.location.line_number;
+	    newLine.nextInFile = -1;
+	    newLine.stats = new ComparedStats[numReports];
+	    for (int r = 0; r < numReports; ++r)
+	    {
+		newLine.stats[r].present = FALSE;
+		newLine.stats[r].mpi_pct = 0.0;
+		newLine.stats[r].time = 0.0;
+		newLine.stats[r].sent = 0.0;
+		newLine.stats[r].timingLineNo = -1;
+	    }
+
+	    if (files[*file].firstLine == -1)
+		files[*file].firstLine = *line;
+	    else
+		lines[files[*file].lastLine].nextInFile = *line;
+	    files[*file].lastLine = *line;
+	}
+
+	for (int r = 0; r < numReports; ++r)
+	{
+	    ComparedStats &lineStats = lines[*line].stats[r];
+	    ComparedStats &siteStats = site.stats[r];
+	    if (!siteStats.present)
+		continue;
+	    lineStats.present = TRUE;
+	    lineStats.mpi_pct += siteStats.mpi_pct;
+	    lineStats.time += siteStats.time;
+	    lineStats.sent += siteStats.sent;
+	}
+    }
+
+    // The columns: each statistic for every report, then its changes
+    // from the first report, and last the scaling efficiencies
+    static const char *valueTags[] = {"mpi_pct", "time", "sent", "eff"};
+    static const char *valueTitles[] = {"MPI%", "Time", "Sent", "Eff%"};
+    static const char *valueTooltips[] = {
+	"Percent of MPI time spent in the calls at this line",
+	"Total time (ms) over all tasks in the calls at this line",
+	"Total bytes sent by the calls at this line",
+	"Total time in report 1 over total time in this report, as a "
+	"percent (100 is perfect strong scaling)"};
+    int position = 0;
+    MessageBuffer dbuf;
+    int *colLines = new int[numLines];
+    double *colValues = new double[numLines];
+    for (int value = COMPARED_MPI_PCT; value <= COMPARED_EFFICIENCY; ++value)
+    {
+	for (int pass = 0; pass < 2; ++pass)
+	{
+	    // Only efficiencies relative to report 1, and no changes of them
+	    bool change = (pass == 1);
+	    if ((value == COMPARED_EFFICIENCY) && change)
+		continue;
+
+	    for (int r = 0; r < numReports; ++r)
+	    {
+		if ((r == 0) && (change || (value == COMPARED_EFFICIENCY)))
+		    continue;
+
+		out.writef (
+			 "<site_column>\n"
+			 "  <tag>%s%s_%i</tag>\n"
+			 "  <title>%s %s%i</title>\n"
+			 "  <position>%i</position>\n"
+			 "  <tooltip>%s%s (report %i, %s)</tooltip>\n"
+			 "  <align>right</align>\n"
+			 "  <hide_if_empty>1</hide_if_empty>\n"
+			 "</site_column>\n"
+			 "\n",
+			 valueTags[value], change ? "_change" : "", r + 1,
+			 valueTitles[value], change ? "+" : "#", r + 1,
+			 position++,
+			 change ? "Change from report 1 in: " : "",
+			 valueTooltips[value], r + 1,
+			 noPathName (fileNames[r]));
+
+		// Each file's values for the column, in the bulk form
+		for (int f = 0; f < numFiles; ++f)
+		{
+		    // Kept sorted by line (a file has few callsite lines),
+		    // so consecutive lines can be written as runs
+		    int count = 0;
+		    for (int l = files[f].firstLine; l != -1;
+			 l = lines[l].nextInFile)
+		    {
+			double result;
+			if (!columnValue (lines[l].stats, value, r, change,
+					  result))
+			    continue;
+			int pos = count++;
+			while ((pos > 0) &&
+			       (colLines[pos - 1] > lines[l].line_number))
+			{
+			    colLines[pos] = colLines[pos - 1];
+			    colValues[pos] = colValues[pos - 1];
+			    --pos;
+			}
+			colLines[pos] = lines[l].line_number;
+			colValues[pos] = result;
+		    }
+		    if (count == 0)
+			continue;
+
+		    dbuf.sprintf ("<site_data>\n"
+				  "  <col>%s%s_%i</col>\n"
+				  "  <file>%s</file>\n",
+				  valueTags[value], change ? "_change" : "",
+				  r + 1, files[f].filename);
+		    appendBulkSiteData (dbuf, colLines, colValues, count);
+		    dbuf.appendSprintf ("</site_data>\n"
+					"\n");
+		    out.write (dbuf.contents(), dbuf.strlen());
+		}
+	    }
+	}
+    }
+
+    delete [] colValues;
+    delete [] colLines;
+    for (int l = 0; l < numLines; ++l)
+	delete [] lines[l].stats;
+    delete [] lines;
+    delete [] files;
+}
+
+// Reads the numFiles mpiP reports named and writes messages and source
+// columns comparing them
+void writeMpipComparisonXML (const char * const *mpipFileNames, int numFiles,
+			     MpipXMLOutput &out)
+{
+    // Describe the tool for the About... box
+    writeAboutXML (out);
+
+    // Set the initial main tool title
+    out.writef (
+	     "<tool_title>MpiP View - %s and %i more</tool_title>\n"
+	     "\n",
+	     mpipFileNames[0], numFiles - 1);
+
+    // Read in each report in turn, keeping just the stats compared
+    MpipComparison comparison (mpipFileNames, numFiles);
+    for (int r = 0; r < numFiles; ++r)
+    {
+	out.writef (
+		 "<status>Reading in %s (%i of %i)</status>\n"
+		 "\n",
+		 noPathName (mpipFileNames[r]), r + 1, numFiles);
+	out.flush ();
+
+	MpipInfo mpipData (mpipFileNames[r]);
+	while (mpipData.readNextStatsSection () != -1)
+	{
+	    // Stop reading if nothing more is wanted
+	    if (out.stopped ())
+		return;
+	}
+	comparison.addReport (mpipData, r);
+    }
+
+    // Write the comparison messages and columns
+    comparison.writeMessages (out);
+    out.flush ();
+    comparison.writeColumns (out);
+
+    // Set the Final tool status message
+    out.writef (
+             "<status>Finished comparing %i mpiP reports</status>\n"
+             "\n",
+	     numFiles);
+    out.flush ();
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -0,0 +1,221 @@
+//! \file mpip_info.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.01                                              July 19, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Reads an mpiP report and writes Tool Gear XML messages for it.  Used
+// by TGmpip2xml, which writes the XML to a file, and by TGxmlserver
+// (-mpip), which sends each message to the Client as an XML snippet as
+// soon as it is written, with no XML file in between.
+
+#ifndef TG_MPIP_INFO_H
+#define TG_MPIP_INFO_H
+
+#include "messagebuffer.h"
+
+class LineParser;
+struct CallSite;
+struct StatsSection;
+struct StatsChunk;
+class MpipComparison;
+
+// Kinds of per-rank callsite statistics sections, in the order mpiP
+// writes them
+enum StatsKind {TIMING_STATS, SENT_STATS, IO_STATS};
+
+//! Where MpipInfo writes its XML.  Each write() gets one or more whole
+//! top-level elements (a message, a message folder, etc.), so it can be
+//! sent on as an XML snippet just as it is.
+class MpipXMLOutput
+{
+public:
+    MpipXMLOutput () {}
+    virtual ~MpipXMLOutput () {}
+
+    //! Takes the next top-level elements, len bytes of text (with a
+    //! terminating NUL after them)
+    virtual void write (const char *xml, int len) = 0;
+
+    //! Called after each group of messages, so they can be shown
+    //! before the rest of the report is read
+    virtual void flush () {}
+
+    //! Returns TRUE if no more XML is wanted (e.g., the Client quit),
+    //! so reading can stop early
+    virtual bool stopped () {return (FALSE);}
+
+    //! Formats whole elements, as with printf, and writes them
+    void writef (const char *fmt, ...);
+
+private:
+    MessageBuffer buf;
+};
+
+//! Reads mpipFileName and writes everything that goes inside Tool Gear's
+//! <tool_gear> element to out.  Each kind of statistic's messages are
+//! written as soon as its section has been read, so the top callsites
+//! can be shown while the rest of a big report is still being read.
+void writeMpipXML (const char *mpipFileName, MpipXMLOutput &out);
+
+//! Reads the numFiles mpiP reports named (e.g., runs at several job sizes
+//! or of several code versions) and writes, instead of each report's own
+//! messages, messages and source columns comparing them.  Callsites are
+//! matched by call and call stack, since siteIDs differ from run to run.
+//! No Client view shows the site columns yet, so for now the comparison
+//! is only visible in the messages.
+void writeMpipComparisonXML (const char * const *mpipFileNames, int numFiles,
+			     MpipXMLOutput &out);
+
+// Use class to hold mpiP data and then to print out messages
+// in Tool Gear's format
+class MpipInfo {
+ public:
+    //! Initialize internal data structures from the start of the
+    //! mpip file, through the list of callsites (tested on mpiP
+    //! versions 2.5 and 2.6).  The statistics sections are read by
+    //! readNextStatsSection().
+    MpipInfo (const char *mpipFileName);
+
+    //! Free all the data inside MpipInfo
+    ~MpipInfo();
+
+    //! Reads the mpip file through the next per-rank callsite stats
+    //! section (timing, data sent, or IO) and parses that section.
+    //! Returns the section's StatsKind, or -1 once the whole file has
+    //! been read.
+    int readNextStatsSection ();
+
+    //! Sort callsite timing messages by MPI% and then callsiteId, then format
+    //! and write in XML the messageViewer the MPIP callsite timing  messages
+    void writeCallsiteTimingMessages(MpipXMLOutput &out);
+
+    //! Sort callsite bytes sent messages by MPI% (instead of total bytes sent)
+    //! and then  callsiteId, then format and write in XML the MPIP 
+    //! callsite bytes sent messages
+    void writeCallsiteBytesSentMessages(MpipXMLOutput &out);
+
+    //! Sort callsite IO messages by MPI% (instead of total IO)
+    //! and then callsiteId, then format and write in XML the MPIP
+    //! callsite IO messages
+    void writeCallsiteIOMessages (MpipXMLOutput &out);
+
+    //! Create and write in XML callsite location messages in the order
+    //! of the callsites.  Mainly to allow user to see each callsite location.
+    void writeCallsiteLocationMessages(MpipXMLOutput &out);
+
+    //! Write in XML the mpiP file itself with messages indicating
+    //! section headings
+    void writeMpiPFileMessages(MpipXMLOutput &out);
+
+ private:
+    // Matches up the callsites of several MpipInfos
+    friend class MpipComparison;
+
+    //! Helper routine to index the rows of a callsite stats section
+    //! (timing, data sent, or IO) in the mpip file
+    void indexCallsiteStats(LineParser &parser, StatsSection &section,
+			    int kind);
+
+    //! Helper routine to parse an indexed callsite stats section
+    void readCallsiteStats(StatsSection &section);
+
+    //! Helper routine to parse part of a callsite stats section
+    void parseStatsChunk(StatsChunk *chunk);
+    static void *statsThreadMain(void *arg);
+
+
+    //! Helper routine that creates and sends index message for the mpip file
+    void writeMpiPFileIndex (MpipXMLOutput &out, int lineNo, 
+			     const char *fmt, ...);
+
+    char      *mpip_file_name; // Named in references to the raw data
+    LineParser *statsParser;  // Reads the stats sections (NULL at the end)
+    float      version;       // MpiP version
+    char      *MPIP_settings; // MPIP env var settings (from file)
+    int        trace_depth;   // callsite stack walking depth (default = 1)
+    int	       num_callsites; // Number of callsites
+    int        num_tasks;     // Number of mpi tasks
+    CallSite  *sites;         // Array of call site info
+    int        siteIdBase;    // Offset for siteIds to support mpiP 1.7
+
+    // Line number of various interesting points in the input mpiP file
+    int        commandLineNo; // @ Command 
+    int        versionLineNo; // @ Version     
+    int        envLineNo;     // @ MPIP env var
+    int        nodesLineNo;   // First: @ MPI Task Assignment
+    int        mpiTimeLineNo; // @--- MPI Time (seconds)
+    int	       sitesLineNo;   // @--- Callsites
+    int	       topTimeLineNo; // @--- Aggregate Time (top twenty
+    int	       topSentLineNo; // @--- Aggregate Sent Message Size (top twenty
+    int        topIOLineNo;   // @--- Aggregate I/O Size (top twenty
+    int	       allTimeLineNo; // @--- Callsite Time statistics (...
+    int	       allSentLineNo; // @--- Callsite Message Sent statistics (...
+    int        allIOLineNo;   // @--- Callsite I/O statistics (all, I/O bytes)
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -4,25 +4,28 @@
 #  Version 2.00                                              March 29, 2006
 #  Please see COPYRIGHT AND LICENSE information at the end of this file.
 # **************************************************************************
-SOURCES += TGmpip2xml.cpp logfile.cpp ../Utils/search_path.cpp \
+SOURCES += TGmpip2xml.cpp mpip_info.cpp logfile.cpp ../Utils/search_path.cpp \
 	   ../Utils/tg_source_reader.cpp ../Utils/tg_socket.c \
+           ../Utils/tg_compress.c \
            ../Utils/tg_pack.cpp ../Utils/tg_swapbytes.c ../Utils/tg_error.c \
            ../Utils/command_tags.cpp ../Utils/collector_pack.cpp \
            ../Utils/lookup_function_lines.cpp \
            ../Utils/tg_time.c ../Utils/messagebuffer.cpp \
            ../Utils/string_symbol.c ../Utils/l_alloc_new.c \
-           ../Utils/xml_convert_dup.c
+           ../Utils/xml_convert_dup.c ../Utils/number_scanner.cpp
 
-HEADERS += lineparser.h logfile.h ../Utils/search_path.h \
+HEADERS += mpip_info.h lineparser.h logfile.h ../Utils/stringtable.h ../Utils/search_path.h \
 	   ../Utils/tg_source_reader.h \
            ../Utils/messagebuffer.h ../Utils/command_tags.h \
            ../Utils/socketmanager.h ../Utils/tempcharbuf.h \
            ../Utils/tg_error.h ../Utils/tg_inst_point.h \
            ../Utils/tg_pack.h ../Utils/tg_socket.h \
+           ../Utils/tg_compress.h \
            ../Utils/tg_swapbytes.h ../Utils/tg_time.h \
            ../Utils/tg_typetags.h \
            ../Utils/string_symbol.h \
-           ../Utils/xml_convert_dup.h
+           ../Utils/xml_convert_dup.h ../Utils/number_scanner.h \
+           ../Utils/field_tokenizer.h
 
 #CONFIG += debug
 CONFIG += warn_on
@@ -0,0 +1,456 @@
+//! \file tgreplay.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+//! Stands in for a Collector and replays a capture made with TG_RECORD
+//! (see TG_record_socket in tg_socket.h) into TGclient, so the Client's
+//! ingest can be measured and tuned without the original Collector,
+//! input files, or target program.  Run it as the Client's collector:
+//!
+//!   TGclient -c tgreplay -m <capture> -- <capture>
+//!
+//! (the capture can also be named by TG_REPLAY_FILE).  Either end's
+//! capture works; only the Collector's messages are replayed.  Requests
+//! from the Client are read and ignored, except for quitting; replies
+//! the original Collector sent (e.g., source files) are replayed when
+//! they were originally sent.
+//!
+//! TG_REPLAY_SPEED sets the pace: 1 (the default) replays with the
+//! original timing, 2 twice as fast, and so on; 0 sends everything as
+//! fast as the Client will take it.  When the replay is done, the time
+//! spent waiting for the Client to take messages (i.e., while it was
+//! busy) and how far the replay fell behind the original timing are
+//! reported, along with counts by tag.  Run the Client with
+//! TG_INGEST_STATS set to have it report its handler time by tag and
+//! how long its GUI was blocked.  Also setting TG_XML_PER_SNIPPET makes
+//! the Client parse each XML snippet with a new parser, as it used to,
+//! so the DB_PROCESS_XML_SNIPPET times can be compared.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "command_tags.h"
+#include "tg_socket.h"
+#include "tg_swapbytes.h"
+#include "tg_time.h"
+
+/* TRUE and FALSE not defined on some systems */
+#ifndef FALSE
+#define FALSE 0
+#define TRUE (!FALSE)
+#endif
+
+// Look for Client messages every this many replayed messages
+#define REPLAY_POLL_INTERVAL 16
+
+// Counts for one tag (unknown tags share the last slot)
+struct ReplayTagStats {
+	long count;
+	double bytes;
+	double send_time;	// seconds in TG_send (waiting on the Client)
+};
+
+static ReplayTagStats tag_stats[LAST_COMMAND_TAG + 1];
+
+int sock = -1;
+static bool client_quit = FALSE;
+
+int connectToClient( int port );
+void serve_client( void );
+void usage( char * program );
+
+//! A capture file being read back
+class ReplayCapture {
+public:
+	ReplayCapture() : in(NULL), swap(FALSE), buf(NULL), capacity(0) {}
+	~ReplayCapture() { if( in ) fclose( in ); free( buf ); }
+
+	//! Opens path and reads its header.  Returns FALSE (after saying
+	//! why) if it isn't a capture we can read.
+	bool open( const char * path )
+	{
+		TG_record_header header;
+
+		if( (in = fopen( path, "r" )) == NULL ) {
+			perror( path );
+			return FALSE;
+		}
+		if( fread( &header, sizeof(header), 1, in ) != 1 ) {
+			fprintf( stderr, "%s: not a Tool Gear capture\n", path );
+			return FALSE;
+		}
+		if( header.magic != TG_RECORD_MAGIC ) {
+			if( (int)SWAP_BYTES(header.magic) != TG_RECORD_MAGIC ) {
+				fprintf( stderr, "%s: not a Tool Gear capture\n",
+						path );
+				return FALSE;
+			}
+			swap = TRUE;
+			header.version = (int)SWAP_BYTES(header.version);
+			header.role = (int)SWAP_BYTES(header.role);
+		}
+		if( header.version != TG_RECORD_VERSION ) {
+			fprintf( stderr, "%s: capture version %d, expected %d\n",
+					path, header.version, TG_RECORD_VERSION );
+			return FALSE;
+		}
+		role = header.role;
+		return TRUE;
+	}
+
+	//! Reads the next message the Collector sent.  Returns FALSE at
+	//! the end of the capture.  The payload is good until the next call.
+	bool next( double * when, int * tag, int * id, int * size,
+			char ** payload )
+	{
+		TG_record_entry entry;
+
+		for( ;; ) {
+			if( fread( &entry, sizeof(entry), 1, in ) != 1 )
+				return FALSE;
+			if( swap ) {
+				entry.sec = (int)SWAP_BYTES(entry.sec);
+				entry.usec = (int)SWAP_BYTES(entry.usec);
+				entry.direction = (int)SWAP_BYTES(entry.direction);
+				entry.tag = (int)SWAP_BYTES(entry.tag);
+				entry.id = (int)SWAP_BYTES(entry.id);
+				entry.size = (int)SWAP_BYTES(entry.size);
+			}
+			if( entry.size < 0 ) {
+				fprintf( stderr, "Capture is corrupt (size %d)\n",
+						entry.size );
+				return FALSE;
+			}
+			if( entry.size + 1 > capacity ) {
+				free( buf );
+				capacity = entry.size + 1;
+				if( (buf = (char *)malloc( capacity )) == NULL ) {
+					fprintf( stderr, "Out of memory allocating "
+						"%d bytes\n", capacity );
+					exit( -1 );
+				}
+			}
+			if( entry.size > 0 &&
+			    fread( buf, 1, entry.size, in ) != (size_t)entry.size ) {
+				fprintf( stderr, "Capture ends in the middle of "
+						"a message\n" );
+				return FALSE;
+			}
+
+			// Only replay what went from the Collector to the Client
+			bool from_collector = (role == TG_RECORD_COLLECTOR) ?
+				(entry.direction == TG_RECORD_SENT) :
+				(entry.direction == TG_RECORD_RECEIVED);
+			if( from_collector )
+				break;
+		}
+
+		*when = entry.sec + entry.usec * 1e-6;
+		*tag = entry.tag;
+		*id = entry.id;
+		*size = entry.size;
+		*payload = (entry.size > 0) ? buf : NULL;
+		return TRUE;
+	}
+
+private:
+	FILE * in;
+	bool swap;
+	int role;
+	char * buf;
+	int capacity;
+};
+
+void usage( char * program )
+{
+	fprintf( stderr, "Usage: %s <port> [<capture>]\n", program );
+	fprintf( stderr, "   Expects to be called by TGclient to replay a capture made with TG_RECORD.\n" );
+	fprintf( stderr, "   The capture may also be named by TG_REPLAY_FILE; TG_REPLAY_SPEED sets the\n" );
+	fprintf( stderr, "   pace (1 = original timing, the default; 0 = as fast as possible).\n" );
+}
+
+int main( int argc, char * argv[] )
+{
+	// Expect at least one argument, the port
+	if( argc < 2 ) {
+		usage( argv[0] );
+		return -1;
+	}
+
+	const char * capture_name = (argc > 2) ? argv[2] :
+		getenv( "TG_REPLAY_FILE" );
+	if( capture_name == NULL ) {
+		usage( argv[0] );
+		return -1;
+	}
+
+	double speed = 1.0;
+	const char * speed_string = getenv( "TG_REPLAY_SPEED" );
+	if( speed_string != NULL ) {
+		speed = atof( speed_string );
+		if( speed < 0.0 )
+			speed = 0.0;
+	}
+
+	// Check the capture before the Client starts waiting on us
+	ReplayCapture capture;
+	if( !capture.open( capture_name ) )
+		return -1;
+
+	// The port to which we should connect to talk to the Client
+	int port = atoi( argv[1] );
+	if( (sock = connectToClient( port )) < 0 )
+		return -1;
+
+	long messages = 0;
+	double bytes = 0.0;
+	double send_time = 0.0;
+	double max_behind = 0.0;
+	double first_when = -1.0;
+	double when;
+	int tag, id, size;
+	char * payload;
+	double start = TG_time();
+
+	while( !client_quit &&
+	       capture.next( &when, &tag, &id, &size, &payload ) ) {
+		// We say goodbye ourselves, once the Client quits
+		if( tag == DPCL_SAYS_QUIT )
+			break;
+
+		if( first_when < 0.0 )
+			first_when = when;
+
+		// Wait until the message is due, answering the Client
+		// in the meantime
+		if( speed > 0.0 ) {
+			double due = start + (when - first_when) / speed;
+			double now = TG_time();
+			while( !client_quit && now < due ) {
+				if( TG_poll_socket( sock ) ) {
+					serve_client();
+				} else {
+					double wait = due - now;
+					struct timeval timeout;
+					timeout.tv_sec = (int)wait;
+					timeout.tv_usec =
+						(int)((wait - (int)wait) * 1e6);
+					fd_set readfds;
+					FD_ZERO( &readfds );
+					FD_SET( sock, &readfds );
+					select( sock + 1, &readfds, NULL, NULL,
+							&timeout );
+				}
+				now = TG_time();
+			}
+			if( now - due > max_behind )
+				max_behind = now - due;
+		} else if( messages % REPLAY_POLL_INTERVAL == 0 ) {
+			while( !client_quit && TG_poll_socket( sock ) )
+				serve_client();
+		}
+		if( client_quit )
+			break;
+
+		// TG_send only waits when the Client isn't keeping up
+		double send_start = TG_time();
+		TG_send( sock, tag, id, size, payload );
+		double elapsed = TG_time() - send_start;
+
+		int slot = (tag >= 0 && tag < LAST_COMMAND_TAG) ?
+			tag : LAST_COMMAND_TAG;
+		tag_stats[slot].count++;
+		tag_stats[slot].bytes += size;
+		tag_stats[slot].send_time += elapsed;
+		messages++;
+		bytes += size;
+		send_time += elapsed;
+	}
+	TG_flush( sock );
+	double total = TG_time() - start;
+
+	fprintf( stderr, "tgreplay: replayed %ld messages (%.0f KB) in %.3f "
+			"sec: %.0f messages/sec, %.2f MB/sec\n", messages,
+			bytes / 1024.0, total,
+			(total > 0.0) ? messages / total : 0.0,
+			(total > 0.0) ? bytes / (1024.0 * 1024.0) / total : 0.0 );
+	fprintf( stderr, "tgreplay: waited %.3f sec for the Client to take "
+			"messages", send_time );
+	if( speed > 0.0 )
+		fprintf( stderr, ", fell up to %.3f sec behind (speed %g)",
+				max_behind, speed );
+	fprintf( stderr, "\n" );
+	fprintf( stderr, "tgreplay: %-32s %9s %10s %10s\n", "tag", "count",
+			"KB", "wait sec" );
+	for( int i = 0; i <= LAST_COMMAND_TAG; i++ ) {
+		if( tag_stats[i].count == 0 )
+			continue;
+		fprintf( stderr, "tgreplay: %-32s %9ld %10.0f %10.3f\n",
+				(i < LAST_COMMAND_TAG) ? command_strings[i] :
+				"(other)", tag_stats[i].count,
+				tag_stats[i].bytes / 1024.0,
+				tag_stats[i].send_time );
+	}
+
+	// Keep the Client company until it is done looking
+	while( !client_quit )
+		serve_client();
+
+	if( getenv( "TG_SOCKET_STATS" ) != NULL ) {
+		TG_report_socket_stats( sock, "tgreplay" );
+	}
+
+	return 0;
+}
+
+// Reads one message from the Client and drops it, unless it says to quit
+void serve_client( void )
+{
+	int tag, id, size;
+	char * buf;
+
+	if( TG_recv_view( sock, &tag, &id, &size, &buf ) < 0 ) {
+		fprintf( stderr, "tgreplay: Client closed the connection\n" );
+		client_quit = TRUE;
+		return;
+	}
+	if( tag == GUI_SAYS_QUIT ) {
+		TG_send( sock, DPCL_SAYS_QUIT, 0, 0, NULL );
+		TG_flush( sock );
+		client_quit = TRUE;
+	}
+}
+
+// Establishes a connection with the Tool Gear Client on a specified
+// port and performs the hand shake, just as TGxmlserver does.
+int connectToClient( int port )
+{
+	int sock = socket( PF_INET, SOCK_STREAM, 0 );
+	if( sock == -1 ) {
+		perror( "error creating socket" );
+		return -1;
+	}
+
+	// Setting TCP_NODELAY avoids pauses for short messages
+	int ndelay = 1;
+	setsockopt( sock, IPPROTO_TCP, TCP_NODELAY, &ndelay, sizeof(ndelay) );
+
+	struct sockaddr_in address;
+	bzero( &address, sizeof(address) );
+	address.sin_family = AF_INET;
+	struct hostent * hp = gethostbyname( "localhost" );
+	if( hp == NULL ) {
+		perror( "error looking up localhost address" );
+		return -1;
+	}
+
+	bcopy( hp->h_addr, &address.sin_addr, hp->h_length );
+	address.sin_port = htons( port );
+
+	if( connect( sock, (struct sockaddr *)&address,
+				sizeof(address) ) != 0 ) {
+		perror( "connect failed" );
+		return -1;
+	}
+
+	// Socket must be nonblocking for TG_send and TG_recv
+	if( fcntl( sock, F_SETFL, O_NONBLOCK ) == -1 ) {
+		fprintf( stderr, "Error making collector socket nonblocking" );
+	}
+
+	// Shake hands with the spawning process
+	char checkValue[20];
+	if( fgets( checkValue, 20, stdin ) == NULL ) {
+		perror( "reading in collector" );
+		exit( -1 );
+	}
+	char *end_ptr = NULL;
+	unsigned int outval = strtoul( checkValue, &end_ptr, 0 );
+	if( (*end_ptr != 0) && (*end_ptr != '\n') ) {
+		fprintf( stderr, "Error parsing authentication value\n" );
+		exit( -1 );
+	}
+	write( sock, (void *) &outval, sizeof(outval) );
+
+	// Replay over the same transport the Client would otherwise get
+	TG_offer_options( sock );
+
+	return sock;
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
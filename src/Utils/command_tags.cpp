@@ -63,6 +63,7 @@ char * command_strings[] = {
 	"COLLECTOR_SET_SEARCH_PATH",
 	"GUI_SAYS_QUIT",
 	"DPCL_SAYS_QUIT",
+	"COLLECTOR_ERROR_MESSAGE",
 	"SOCKET_ERROR",
 
 	/* MS/START - dynamic collector loading */
@@ -74,6 +75,16 @@ char * command_strings[] = {
 
 	/* MS/END - dynamic collector loading */
 
+	"DB_ENABLE_FLOW_CONTROL",
+	"COLLECTOR_GRANT_CREDIT",
+	"DB_INPUT_COMPLETE",
+	"DB_TGB_STRINGS",
+	"DB_PROCESS_TGB_RECORDS",
+	"COLLECTOR_READ_MESSAGE_BODY",
+	"DB_MESSAGE_BODY",
+	"DB_FILE_LINE_COUNT",
+	"COLLECTOR_READ_FILE_LINES",
+	"DB_FILE_LINES",
 	"LAST_COMMAND_TAG"
 };
 /******************************************************************************
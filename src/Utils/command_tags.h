@@ -142,6 +142,31 @@ typedef enum {
 
 	/* MS/END - dynamic collector loading */
 
+	/* flow control for bulk data (XML snippets) */
+	DB_ENABLE_FLOW_CONTROL,		//!< Collector will pause sending
+					//!< snippets until granted credit
+	COLLECTOR_GRANT_CREDIT,		//!< Client allows Collector to send
+					//!< id more snippets (and more bytes)
+	DB_INPUT_COMPLETE,		//!< Collector has sent the end of its
+					//!< input (not just what's there now)
+	DB_TGB_STRINGS,			//!< Strings section of a .tgb file
+					//!< (see tgb_format.h); id is the
+					//!< first string's id
+	DB_PROCESS_TGB_RECORDS,		//!< Records section of a .tgb file;
+					//!< counts as a snippet for credit
+
+	/* message bodies left in the input file (TGxmlserver -lazy) */
+	COLLECTOR_READ_MESSAGE_BODY,	//!< Client asks for the body with
+					//!< index id
+	DB_MESSAGE_BODY,		//!< Text of the body with index id
+
+	/* source files too big to send whole (see TGSourceReader) */
+	DB_FILE_LINE_COUNT,		//!< Sent instead of the file's text;
+					//!< buf holds its line count
+	COLLECTOR_READ_FILE_LINES,	//!< Client asks for a range of lines
+					//!< from such a file
+	DB_FILE_LINES,			//!< Text of the lines asked for
+
 	LAST_COMMAND_TAG		//!< Indicated number of items in
 					//!< this enum
 } command_tags;
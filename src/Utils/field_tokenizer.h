@@ -0,0 +1,159 @@
+//! \file field_tokenizer.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Splits a line of text into whitespace-separated fields in place, for
+// reading tables such as the per-rank rows of an mpiP report without
+// sscanf().  Fields are returned as a pointer into the line and a
+// length (they are not terminated), and numbers are converted with the
+// scanners in number_scanner.h.
+
+#ifndef TG_FIELD_TOKENIZER_H
+#define TG_FIELD_TOKENIZER_H
+
+#include <string.h>
+#include <limits.h>
+#include "number_scanner.h"
+
+class FieldTokenizer
+{
+public:
+    //! Tokenizes the len characters of line (which need not be
+    //! terminated)
+    FieldTokenizer (const char *line, int len) :
+	pos (line), end (line + len) {}
+
+    //! Tokenizes the NUL-terminated line
+    FieldTokenizer (const char *line) :
+	pos (line), end (line + strlen (line)) {}
+
+    //! Sets start and len to the next field and returns TRUE, or
+    //! returns FALSE if there are no fields left
+    bool nextField (const char *&start, int &len)
+	{
+	    TG_skipSpace (pos, end);
+	    if (pos >= end)
+		return (FALSE);
+	    start = pos;
+	    while ((pos < end) && !TG_isSpace (*pos))
+		++pos;
+	    len = pos - start;
+	    return (TRUE);
+	}
+
+    //! Skips the next field.  Returns FALSE if there are no fields left.
+    bool skipField ()
+	{
+	    const char *start;
+	    int len;
+	    return (nextField (start, len));
+	}
+
+    //! Reads the next field, which must be a whole integer that fits
+    //! in an int, into value.  Returns FALSE if it isn't one (or there
+    //! are no fields left); the field is used up either way.
+    bool nextInt (int &value)
+	{
+	    const char *start;
+	    int len;
+	    if (!nextField (start, len))
+		return (FALSE);
+	    long long val;
+	    if (!TG_scanInt (start, pos, val) || (start != pos) ||
+		(val < INT_MIN) || (val > INT_MAX))
+		return (FALSE);
+	    value = (int) val;
+	    return (TRUE);
+	}
+
+    //! Reads the next field, which must be a whole floating point
+    //! number, into value.  Returns FALSE if it isn't one (or there
+    //! are no fields left); the field is used up either way.
+    bool nextDouble (double &value)
+	{
+	    const char *start;
+	    int len;
+	    if (!nextField (start, len))
+		return (FALSE);
+	    return (TG_scanDouble (start, pos, value) && (start == pos));
+	}
+
+    //! Returns TRUE if only whitespace is left
+    bool atEnd ()
+	{
+	    TG_skipSpace (pos, end);
+	    return (pos >= end);
+	}
+
+private:
+    const char *pos;
+    const char *end;
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
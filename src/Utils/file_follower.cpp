@@ -0,0 +1,414 @@
+//! \file file_follower.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+/*
+ * Follows files that are still being written (see file_follower.h), using
+ * inotify where it can and polling everywhere else.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include "file_follower.h"
+
+#ifdef TG_USE_INOTIFY
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#endif
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+// Makes a new inotify descriptor, or returns -1 if inotify can't be used
+static int newInotifyFd ()
+{
+    int inotifyFd = -1;
+#ifdef TG_USE_INOTIFY
+    inotifyFd = inotify_init ();
+    if (inotifyFd >= 0)
+    {
+	fcntl (inotifyFd, F_SETFL, O_NONBLOCK);
+	fcntl (inotifyFd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+    return (inotifyFd);
+}
+
+// Reads and discards the events pending on inotifyFd, calling
+// handle (arg, wd, mask) for each
+static void readInotifyEvents (int inotifyFd,
+			       void (*handle) (void *arg, int wd,
+					       unsigned int mask),
+			       void *arg)
+{
+#ifdef TG_USE_INOTIFY
+    if (inotifyFd < 0)
+	return;
+
+    // Keep the buffer aligned for struct inotify_event
+    union {
+	struct inotify_event event;
+	char buf[4096];
+    } events;
+
+    for (;;)
+    {
+	int len = read (inotifyFd, events.buf, sizeof (events.buf));
+	if ((len < 0) && (errno == EINTR))
+	    continue;
+	if (len <= 0)
+	    break;
+
+	char *ptr = events.buf;
+	while (ptr < events.buf + len)
+	{
+	    struct inotify_event *event = (struct inotify_event *) ptr;
+	    handle (arg, event->wd, event->mask);
+	    ptr += sizeof (struct inotify_event) + event->len;
+	}
+    }
+#endif
+}
+
+FileWatchSet::FileWatchSet () :
+    inotifyFd (newInotifyFd ()), followers (NULL), maxFollowers (0)
+{
+}
+
+FileWatchSet::~FileWatchSet ()
+{
+    if (inotifyFd >= 0)
+	close (inotifyFd);
+    free (followers);
+}
+
+void FileWatchSet::setFollower (int watchDesc, FileFollower *watcher)
+{
+    if (watchDesc < 0)
+	return;
+
+    // Watch descriptors are small and handed out in turn, so index
+    // by them directly
+    if (watchDesc >= maxFollowers)
+    {
+	if (watcher == NULL)
+	    return;
+	int newMax = (maxFollowers > 0) ? maxFollowers * 2 : 64;
+	while (newMax <= watchDesc)
+	    newMax *= 2;
+	FileFollower **newFollowers = (FileFollower **)
+	    realloc (followers, newMax * sizeof (FileFollower *));
+	if (newFollowers == NULL)
+	    return;
+	for (int i = maxFollowers; i < newMax; i++)
+	    newFollowers[i] = NULL;
+	followers = newFollowers;
+	maxFollowers = newMax;
+    }
+    followers[watchDesc] = watcher;
+}
+
+void FileWatchSet::dispatchEvent (void *set, int wd, unsigned int mask)
+{
+    FileFollower *watcher = ((FileWatchSet *) set)->follower (wd);
+    if (watcher != NULL)
+	watcher->handleEvent (mask);
+}
+
+void FileWatchSet::drainEvents ()
+{
+    readInotifyEvents (inotifyFd, dispatchEvent, this);
+}
+
+FileFollower::FileFollower (const char *filePath, int fileFd,
+			    int pollInterval, bool reopenReplaced,
+			    FileWatchSet *sharedSet) :
+    path (NULL), fd (fileFd), poll (pollInterval), reopen (reopenReplaced),
+    inotifyFd (-1), watchSet (sharedSet), watchDesc (-1), watching (FALSE),
+    replaced (FALSE)
+{
+    // Keep an absolute path, since the Collector may change directory
+    if (filePath != NULL)
+    {
+	char cwd[PATH_MAX + 1];
+	if ((filePath[0] != '/') && (getcwd (cwd, sizeof (cwd)) != NULL))
+	{
+	    path = (char *) malloc (strlen (cwd) + strlen (filePath) + 2);
+	    if (path != NULL)
+		sprintf (path, "%s/%s", cwd, filePath);
+	}
+	else
+	{
+	    path = strdup (filePath);
+	}
+    }
+
+    inotifyFd = (watchSet != NULL) ? watchSet->notifyFd () : newInotifyFd ();
+
+    startWatch ();
+}
+
+FileFollower::~FileFollower ()
+{
+    if (watchSet != NULL)
+    {
+	// Just take our watch out of the shared set
+#ifdef TG_USE_INOTIFY
+	if (watchDesc >= 0)
+	    inotify_rm_watch (inotifyFd, watchDesc);
+#endif
+	watchSet->setFollower (watchDesc, NULL);
+    }
+    else if (inotifyFd >= 0)
+    {
+	close (inotifyFd);
+    }
+    free (path);
+}
+
+void FileFollower::startWatch ()
+{
+    watching = FALSE;
+    replaced = FALSE;
+
+#ifdef TG_USE_INOTIFY
+    if ((inotifyFd < 0) || (path == NULL))
+	return;
+
+    // Drop any watch on a previous file
+    if (watchDesc >= 0)
+    {
+	inotify_rm_watch (inotifyFd, watchDesc);
+	if (watchSet != NULL)
+	    watchSet->setFollower (watchDesc, NULL);
+	watchDesc = -1;
+    }
+
+    // Only watch regular files that path still names and that are on
+    // a local file system
+    struct stat fdStat, pathStat;
+    if ((fstat (fd, &fdStat) != 0) || !S_ISREG (fdStat.st_mode) ||
+	(stat (path, &pathStat) != 0) ||
+	(pathStat.st_dev != fdStat.st_dev) ||
+	(pathStat.st_ino != fdStat.st_ino) || onNetworkFileSystem ())
+	return;
+
+    watchDesc = inotify_add_watch (inotifyFd, path,
+				   IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+				   IN_MOVE_SELF | IN_DELETE_SELF);
+    if (watchDesc < 0)
+	return;
+
+    // A file followed twice in one set gets the same watch, which
+    // belongs to the first follower, so the other just polls
+    if (watchSet != NULL)
+    {
+	if (watchSet->follower (watchDesc) != NULL)
+	{
+	    watchDesc = -1;
+	    return;
+	}
+	watchSet->setFollower (watchDesc, this);
+    }
+    watching = TRUE;
+#endif
+}
+
+bool FileFollower::onNetworkFileSystem ()
+{
+#ifdef TG_USE_INOTIFY
+    struct statfs fs;
+    if (fstatfs (fd, &fs) != 0)
+	return (TRUE);
+
+    switch ((unsigned int) fs.f_type)
+    {
+      case 0x6969u:		// NFS
+      case 0x517Bu:		// SMB
+      case 0xFF534D42u:		// CIFS
+      case 0x0BD00BD0u:		// Lustre
+      case 0x47504653u:		// GPFS
+      case 0x65735546u:		// FUSE (e.g., sshfs)
+	return (TRUE);
+    }
+#endif
+    return (FALSE);
+}
+
+void FileFollower::checkEvent (void *follower, int wd, unsigned int mask)
+{
+    // Ignore leftover events for the watch on a previous file
+    FileFollower *watcher = (FileFollower *) follower;
+    if (wd == watcher->watchDesc)
+	watcher->handleEvent (mask);
+}
+
+void FileFollower::drainEvents ()
+{
+    if (watchSet != NULL)
+	watchSet->drainEvents ();
+    else
+	readInotifyEvents (inotifyFd, checkEvent, this);
+}
+
+void FileFollower::handleEvent (unsigned int mask)
+{
+#ifdef TG_USE_INOTIFY
+    // Watch ends when the file is deleted (or on unmount)
+    if (mask & IN_IGNORED)
+    {
+	if (watchSet != NULL)
+	    watchSet->setFollower (watchDesc, NULL);
+	watching = FALSE;
+	watchDesc = -1;
+    }
+
+    // Renamed, so poll for a new file at path
+    if ((mask & IN_MOVE_SELF) && reopen)
+	replaced = TRUE;
+#else
+    mask = mask;	// avoid compiler warnings
+#endif
+}
+
+void FileFollower::wait (int maxWait)
+{
+    int interval = waitInterval ();
+    if (maxWait < interval)
+	interval = maxWait;
+
+    struct timeval timeout;
+    timeout.tv_sec = interval / 1000;
+    timeout.tv_usec = (interval % 1000) * 1000;
+
+    // With nothing to watch, this just sleeps
+    fd_set readfds;
+    FD_ZERO (&readfds);
+    int watchFd = notifyFd ();
+    if (watchFd >= 0)
+	FD_SET (watchFd, &readfds);
+    select (watchFd + 1, &readfds, NULL, NULL, &timeout);
+}
+
+bool FileFollower::update ()
+{
+    drainEvents ();
+
+    struct stat fdStat;
+    if (fstat (fd, &fdStat) != 0)
+	return (FALSE);
+    off_t offset = lseek (fd, 0, SEEK_CUR);
+
+    // Truncated (shorter than what has been read)?  Start over, as
+    // "tail -f" does.
+    if (S_ISREG (fdStat.st_mode) && (offset > fdStat.st_size))
+    {
+	fprintf (stderr, "Warning: %s was truncated, reading it again from "
+		 "the start\n", (path != NULL) ? path : "input");
+	lseek (fd, 0, SEEK_SET);
+	return (TRUE);
+    }
+
+    // Replaced by a new file (e.g., log rotation)?  Finish reading the
+    // old one first, then switch to the new one.
+    struct stat pathStat;
+    if (reopen && (path != NULL) && (stat (path, &pathStat) == 0) &&
+	((pathStat.st_dev != fdStat.st_dev) ||
+	 (pathStat.st_ino != fdStat.st_ino)))
+    {
+	// Poll until switched, since the watch is on the old file
+	replaced = TRUE;
+
+	if (offset >= fdStat.st_size)
+	{
+	    int newFd = open (path, O_RDONLY);
+	    if (newFd >= 0)
+	    {
+		// Keep the same descriptor, so the reader can keep using it
+		dup2 (newFd, fd);
+		close (newFd);
+		fprintf (stderr, "Warning: %s was replaced, reading the new "
+			 "file from the start\n", path);
+		startWatch ();
+		return (TRUE);
+	    }
+	}
+    }
+
+    return (FALSE);
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -0,0 +1,206 @@
+//! \file file_follower.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+
+#ifndef TG_FILE_FOLLOWER_H
+#define TG_FILE_FOLLOWER_H
+
+#include <sys/types.h>
+
+// Handle platforms that do not define TRUE and FALSE
+#ifndef TRUE
+#define FALSE 0
+#define TRUE (!FALSE)
+#endif
+
+// inotify is Linux only (2.6.13 and later).  Define TG_NO_INOTIFY to
+// always poll instead (also done at run time if inotify_init() fails).
+#if defined(__linux__) && !defined(TG_NO_INOTIFY)
+#define TG_USE_INOTIFY
+#endif
+
+//! How often (in ms) a file watched with inotify is looked at anyway,
+//! in case a change notice is missed
+#define TG_FOLLOW_SAFETY_INTERVAL 30000
+
+class FileFollower;
+
+//! One inotify descriptor shared by several FileFollowers.  A process
+//! may only have a few (128 by default) but may follow thousands of
+//! files (e.g., TGxmlserver merging a file per MPI task), so each one
+//! just adds a watch here.  Like the followers, a set may only be used
+//! by one thread.
+class FileWatchSet
+{
+public:
+    FileWatchSet ();
+    //! Delete the followers using the set first
+    ~FileWatchSet ();
+
+    //! Descriptor that select() finds readable when any of the files
+    //! may have changed, or -1 if inotify can't be used
+    int notifyFd () const {return (inotifyFd);}
+
+    //! Reads and discards the pending change notices for all the files,
+    //! passing on those that end a watch to the file's follower
+    void drainEvents ();
+
+private:
+    friend class FileFollower;
+
+    //! Records which follower watchDesc belongs to (NULL for none)
+    void setFollower (int watchDesc, FileFollower *follower);
+    //! Returns the follower watchDesc belongs to, or NULL
+    FileFollower *follower (int watchDesc) const
+	{return ((watchDesc >= 0) && (watchDesc < maxFollowers) ?
+		 followers[watchDesc] : NULL);}
+    //! Passes an event for watch wd on to its follower (set is a
+    //! FileWatchSet)
+    static void dispatchEvent (void *set, int wd, unsigned int mask);
+
+    int inotifyFd;		// -1 if not using inotify
+    FileFollower **followers;	// Indexed by watch descriptor
+    int maxFollowers;
+};
+
+//! Watches a file that is still being written (like "tail -f"), for
+//! TGxmlserver and TGmemcheck2xml.
+//! Where inotify can be used, the file is looked at as soon as it changes
+//! instead of every pollInterval ms.  Files on network file systems
+//! (NFS, Lustre, GPFS, ...) are always polled, since inotify does not see
+//! writes made on other nodes.  The follower does not read the file; its
+//! owner reads fd up to end of file whenever the follower says the file
+//! may have changed, calling update() first.
+class FileFollower
+{
+public:
+    //! Follows path, which the caller has open as fd.  If pollInterval
+    //! ms go by without a change notice, the file is looked at anyway.
+    //! If reopen is TRUE and path is replaced by a new file (e.g., log
+    //! rotation), the new file is followed from its start.  path may be
+    //! NULL (e.g., for stdin), in which case fd is just polled.  If
+    //! watchSet is given, the file is watched through its descriptor
+    //! rather than one of the follower's own.
+    FileFollower (const char *path, int fd, int pollInterval, bool reopen,
+		  FileWatchSet *watchSet = NULL);
+    ~FileFollower ();
+
+    //! Descriptor that select() finds readable when the file may have
+    //! changed, or -1 if changes can only be found by polling
+    int notifyFd () const {return (watching ? inotifyFd : -1);}
+
+    //! How long (in ms) to wait for notifyFd() before looking at the
+    //! file anyway
+    int waitInterval () const
+	{return (watching && !replaced ? TG_FOLLOW_SAFETY_INTERVAL : poll);}
+
+    //! Waits until the file may have changed, but no longer than maxWait
+    //! ms (or waitInterval(), if less)
+    void wait (int maxWait);
+
+    //! Call before reading the file after a wait.  Collects all the
+    //! pending change notices (so a burst of writes is handled by one
+    //! read to end of file) and checks whether the file was truncated or
+    //! replaced.  Returns TRUE if fd now reads a file from the start, in
+    //! which case anything partially read from the old one should be
+    //! thrown away.
+    bool update ();
+
+private:
+    friend class FileWatchSet;
+
+    //! Reads and discards pending inotify events, noting if the file
+    //! was moved or deleted (which ends the watch)
+    void drainEvents ();
+
+    //! Notes an inotify event (mask) for the file's watch
+    void handleEvent (unsigned int mask);
+    //! Calls handleEvent if watch wd is the follower's own (follower is
+    //! a FileFollower)
+    static void checkEvent (void *follower, int wd, unsigned int mask);
+
+    //! Starts watching path with inotify, if appropriate
+    void startWatch ();
+
+    //! TRUE if fd is on a file system where inotify can't be trusted
+    bool onNetworkFileSystem ();
+
+    char *path;		// NULL if not known
+    int fd;
+    int poll;
+    bool reopen;
+    int inotifyFd;	// -1 if not using inotify
+    FileWatchSet *watchSet;	// Owns inotifyFd, if not NULL
+    int watchDesc;
+    bool watching;	// TRUE if notifyFd() will report changes
+    bool replaced;	// TRUE if path was moved or deleted from under us
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
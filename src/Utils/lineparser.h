@@ -13,14 +13,17 @@
 #include <stdio.h>
 #include "tg_error.h"
 #include <stdlib.h>
+#include <string.h>
 
 //! Simple line parsing library that can read in arbitrarily long
 //! lines from files and returns const char * pointers to them. 
+//!
+//! The file is read in large blocks and each line is returned in place
+//! in the block (terminated by temporarily overwriting the character
+//! after it), so lines are never copied one character at a time.
 class LineParser
 {
-
 public:
-
     /*! Initialize with the file that the lines are to be read from 
      * Flag if want parser to fclose the file on exit.
      */
@@ -33,13 +36,25 @@ public:
 	    lineNumber = 0;
 
 	    // Always create a buffer upfront to simplify control logic
-	    maxLen = 128;
-	    if ((buf = (char *) malloc (maxLen)) == NULL)
-		TG_error ("Out of memory allocating %i bytes\n", maxLen);
+	    // (one extra byte so a last line without a newline can
+	    // always be terminated)
+	    maxLen = LINEPARSER_BLOCK_SIZE;
+	    if ((buf = (char *) malloc (maxLen + 1)) == NULL)
+		TG_error ("Out of memory allocating %i bytes\n", maxLen + 1);
+
+	    // Nothing read in yet
+	    lineStart = 0;
+	    lineLen = 0;
+	    dataEnd = 0;
+	    bufOffset = 0;
+	    savedChar = -1;
+	    atEOF = FALSE;
 
 	    // Need to read the next line before returning anything to user
 	    peekedAt = FALSE;
+	    lastLine = NULL;
 	}
+
     ~LineParser ()
 	{
 	    // Free the line buffer 
@@ -66,11 +81,11 @@ public:
 	    peekedAt = FALSE;
 
 	    // Increment lineNumber, so now "points" at this line just read in
-	    if (buf != NULL)
+	    if (lastLine != NULL)
 		++lineNumber;
 
 	    // Return buffer holding line (may be NULL if at EOF)
-	    return (buf);
+	    return (lastLine);
 	}
     
     /*! Returns pointer to internal buffer holding the value of the
@@ -81,58 +96,102 @@ public:
      */
     const char *peekNextLine ()
 	{
-	    /* If already peeked at, or if buf NULL (EOF), return buf) */
-	    if (peekedAt || (buf == NULL))
-		return (buf);
+	    /* If already peeked at, return the same line again */
+	    if (peekedAt)
+		return (lastLine);
 
 	    /* Mark that we are peeking at the next line */
 	    peekedAt = TRUE;
-	    
-	    /* Read from file until hit end of line */
-	    int index = 0;
-	    int ch;
-	    
-	    /* Loop and read until end of line or file */
-	    while ((ch = fgetc(in)) != EOF)
+
+	    /* Put back the character the last line's terminator overwrote
+	     * and move past that line
+	     */
+	    if (savedChar != -1)
 	    {
-		/* Store next character (guarenteed to have space) */
-		buf[index] = ch;
+		buf[lineStart + lineLen] = (char) savedChar;
+		savedChar = -1;
+	    }
+	    lineStart += lineLen;
+	    lineLen = 0;
+
+	    /* Look for the end of the line, reading in more of the file
+	     * as needed
+	     */
+	    int searched = lineStart;
+	    char *newline;
+	    while ((newline = (char *) memchr (&buf[searched], '\n',
+					       dataEnd - searched)) == NULL)
+	    {
+		/* At end of file, whatever is left is the last line */
+		if (atEOF)
+		    break;
+
+		/* Don't search the same characters again */
+		searched = dataEnd;
 
-		/* Advance pointer to next empty space */
-		index++;
+		/* Slide the partial line to the front of the buffer */
+		if (lineStart > 0)
+		{
+		    memmove (buf, &buf[lineStart], dataEnd - lineStart);
+		    bufOffset += lineStart;
+		    dataEnd -= lineStart;
+		    searched -= lineStart;
+		    lineStart = 0;
+		}
 
-		/* Do we need to expand the buffer for the next character or
-		 * terminator? 
-		 */
-		if (index >= maxLen)
+		/* If the partial line fills the buffer, double its size */
+		if (dataEnd >= maxLen)
 		{
-		    /* If so, double the current size using realloc */
 		    maxLen = maxLen * 2;
-		    buf = (char *) realloc (buf, maxLen);
+		    if ((buf = (char *) realloc (buf, maxLen + 1)) == NULL)
+			TG_error ("Out of memory allocating %i bytes\n",
+				  maxLen + 1);
 		}
 
-		// Exit loop if have hit end of line 
-		if (ch == '\n')
-		    break;
+		/* Read in as much as will fit */
+		size_t count = fread (&buf[dataEnd], 1, maxLen - dataEnd, in);
+		if (count == 0)
+		    atEOF = TRUE;
+		dataEnd += count;
 	    }
-	    
-	    /* If read something, terminate it */
-	    if (index > 0)
-	    {
-		/* Terminate string, guarenteed to have space */
-		buf[index] = 0;
-	    }
-	    /* Otherwise, at end of file, free buffer and set to NULL */
+
+	    /* The line includes its newline, if it has one */
+	    if (newline != NULL)
+		lineLen = (newline - &buf[lineStart]) + 1;
 	    else
+		lineLen = dataEnd - lineStart;
+
+	    /* If read nothing, at end of file */
+	    if (lineLen == 0)
 	    {
-		free (buf);
-		buf = NULL;
+		lastLine = NULL;
+		return (NULL);
 	    }
-		
-	    /* Return the peeked line (may be null) */
-	    return (buf);
+
+	    /* Terminate the line in place (there is always room after
+	     * the data), saving the character it overwrites
+	     */
+	    if (lineStart + lineLen < dataEnd)
+		savedChar = (unsigned char) buf[lineStart + lineLen];
+	    buf[lineStart + lineLen] = 0;
+
+	    /* Return the peeked line */
+	    lastLine = &buf[lineStart];
+	    return (lastLine);
 	}
 
+    /*! Returns the length (including any newline) of the line last
+     * returned by getNextLine() or peekNextLine(), so callers need not
+     * call strlen() on it.  Returns 0 at end of file.
+     */
+    int lineLength () {return (lineLen);}
+
+    /*! Returns how far into the file (from where it was when the parser
+     * was created) the line last returned by getNextLine() or
+     * peekNextLine() starts.
+     */
+    long long lineOffset () {return (bufOffset + lineStart);}
+
     /*! Returns the maximum line length that can be processed without a 
      * reallocation (terminator must also fit in length to avoid reallocation)
      */
@@ -144,16 +203,24 @@ public:
     int lineNo () {return (lineNumber);}
 
 private:
+    // Bytes read from the file at a time (and the initial buffer size)
+    enum {LINEPARSER_BLOCK_SIZE = 256 * 1024};
 
     FILE *in;
     char *buf;
-    int maxLen;
+    int maxLen;		// Size of buf, not counting the extra byte
+    int lineStart;	// Offset of the current line in buf
+    int lineLen;	// Length of the current line (0 at EOF)
+    int dataEnd;	// End of the data read into buf
+    long long bufOffset;	// Where buf starts in the file
+    int savedChar;	// Character under the line's terminator, or -1
+    bool atEOF;
+    const char *lastLine;
     bool peekedAt;
     bool closeOnExit;
     int lineNumber;
 };
 
-
 #endif
 /******************************************************************************
 COPYRIGHT AND LICENSE
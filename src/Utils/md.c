@@ -228,6 +228,9 @@ static char *MD_type_name[] = {"(UNDEFINED)", "INT", "DOUBLE", "STRING",
 static void MD_resize_field_arrays (MD_Section *section, int max_index);
 static void MD_resize_element_array (MD_Field *field, int max_index);
 static int MD_legal_ident (const char *ident);
+static void MD_print_section_hooked (FILE *out, MD_Section *section, 
+				     int page_width, MD_Entry_Hook hook,
+				     void *arg);
 
 
 /*
@@ -1704,6 +1707,14 @@ MD *MD_read_md (FILE *in, const char *name)
  * that MD_read_md() expects.
  */
 void MD_write_md (FILE *out, MD *md)
+{
+    MD_write_md_hooked (out, md, NULL, NULL);
+}
+
+/* Same as MD_write_md(), but calls hook (if not NULL) for each entry
+ * just before and just after its fields are written (see MD_Entry_Hook).
+ */
+void MD_write_md_hooked (FILE *out, MD *md, MD_Entry_Hook hook, void *arg)
 {
     MD_Symbol *section_symbol, *entry_symbol, *field_decl_symbol;
     MD_Section *section, **link_array;
@@ -1935,6 +1946,10 @@ void MD_write_md (FILE *out, MD *md)
 	{
 	    /* Get the entry for ease of use */
 	    entry = (MD_Entry *) entry_symbol->data;
+
+	    /* Let the user fill in the entry before it is written */
+	    if (hook != NULL)
+		hook (entry, 0, arg);
 	    
 	    /* Get the field array for ease of use */
 	    field_array = entry->field;
@@ -2091,6 +2106,10 @@ void MD_write_md (FILE *out, MD *md)
 		
 		putc ('\n', out);
 	    }
+
+	    /* Let the user undo what it did before the entry was written */
+	    if (hook != NULL)
+		hook (entry, 1, arg);
 	}
 	
 	putc ('\n', out);
@@ -2104,6 +2123,15 @@ void MD_write_md (FILE *out, MD *md)
 
 /* Prints the md's contents to out in text format */
 void MD_print_md (FILE *out, MD *md, int page_width)
+{
+    MD_print_md_hooked (out, md, page_width, NULL, NULL);
+}
+
+/* Same as MD_print_md(), but calls hook (if not NULL) for each entry
+ * just before and just after it is printed (see MD_Entry_Hook).
+ */
+void MD_print_md_hooked (FILE *out, MD *md, int page_width, 
+			 MD_Entry_Hook hook, void *arg)
 {
     MD_Section *section;
     MD_Symbol *symbol;
@@ -2124,7 +2152,7 @@ void MD_print_md (FILE *out, MD *md, int page_width)
 	putc ('\n', out);
 
 	/* Print out the section */
-	MD_print_section (out, section, page_width);
+	MD_print_section_hooked (out, section, page_width, hook, arg);
     }
 
     /* Flush output to make result available right away -JCG 7/29/97 */
@@ -2548,6 +2576,16 @@ int _MD_check_section (FILE *out, MD_Section *section, const char *caller_name)
 
 /* Prints the section's contents to out in text format */
 void MD_print_section (FILE *out, MD_Section *section, int page_width)
+{
+    MD_print_section_hooked (out, section, page_width, NULL, NULL);
+}
+
+/* Prints the section, calling hook (if not NULL) for each entry just 
+ * before and just after it is printed.  Called by MD_print_md_hooked().
+ */
+static void MD_print_section_hooked (FILE *out, MD_Section *section, 
+				     int page_width, MD_Entry_Hook hook,
+				     void *arg)
 {
     MD_Field_Decl *field_decl;
     MD_Symbol *symbol;
@@ -2574,7 +2612,11 @@ void MD_print_section (FILE *out, MD_Section *section, int page_width)
 	entry = (MD_Entry *) symbol->data;
 
 	/* Print the entry */
+	if (hook != NULL)
+	    hook (entry, 0, arg);
 	MD_print_entry (out, entry, page_width);
+	if (hook != NULL)
+	    hook (entry, 1, arg);
     }
 
     fprintf (out, "}\n");
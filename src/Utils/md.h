@@ -338,6 +338,12 @@ typedef struct MD_Field
     int			element_array_size;/* Size of above element array */
 } MD_Field;
 
+/* Called by MD_write_md_hooked() and MD_print_md_hooked() for each entry,
+ * with done == 0 just before the entry is written out and done == 1 just
+ * after.  Lets the user supply fields only while they are being written.
+ */
+typedef void (*MD_Entry_Hook) (MD_Entry *entry, int done, void *arg);
+
 
 /*
  * MD prototypes/macros declarations
@@ -398,7 +404,11 @@ extern void MD_delete_element (MD_Field *field, int index);
 
 extern MD *MD_read_md (FILE *in, const char *name);
 extern void MD_write_md (FILE *out, MD *md);
+extern void MD_write_md_hooked (FILE *out, MD *md, MD_Entry_Hook hook, 
+				void *arg);
 extern void MD_print_md (FILE *out, MD *md, int page_width);
+extern void MD_print_md_hooked (FILE *out, MD *md, int page_width, 
+				MD_Entry_Hook hook, void *arg);
 extern void MD_print_md_declarations (FILE *out, MD *md, int page_width);
 extern void MD_print_md_template (FILE *out, MD *md);
 
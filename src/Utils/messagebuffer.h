@@ -96,6 +96,34 @@ public:
 	    curLen++;
 	}
 
+    //! Appends len bytes from data to the existing message (if any) 
+    //! and automatically resizes the message buffer.  Data should not
+    //! contain a terminator.
+    void appendBytes (const char *data, int len)
+	{
+	    // Get the current length of message buffer 
+	    // (buffer is actually 1 character bigger, reserved for terminator)
+	    int bufLen = buf.getMaxLen();
+
+	    // Resize buffer, if necessary, doubling so that appending a
+	    // piece at a time stays linear
+	    if (curLen + len > bufLen)
+	    {
+		int newLen = bufLen;
+		while (curLen + len > newLen)
+		    newLen = (newLen * 2) + 1;
+		buf.resize (newLen);
+	    }
+	    
+	    // Copy data and terminator
+	    char *bufPtr = buf.contents();
+	    memcpy (bufPtr + curLen, data, len);
+	    bufPtr[curLen+len] = 0;
+		
+	    // Update current length
+	    curLen += len;
+	}
+
     //! If newLen is less than the length of the string, then the string
     //! is truncated at position newLen.  Otherwise nothing happens
     void truncate (int newLen)
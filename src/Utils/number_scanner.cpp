@@ -0,0 +1,259 @@
+//! \file number_scanner.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+/*
+ * Scanning numbers in place.  See number_scanner.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "number_scanner.h"
+
+// Powers of ten that are exact doubles
+static const double exactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define MAX_EXACT_POWER 22
+
+// Largest integer a double holds exactly (2^53)
+#define MAX_EXACT_MANTISSA 9007199254740992ULL
+
+// Longest number handed to strtod()
+#define MAX_STRTOD_LENGTH 127
+
+static inline bool isDigit (char ch)
+{
+    return ((ch >= '0') && (ch <= '9'));
+}
+
+bool TG_scanInt (const char *&pos, const char *end, long long &value)
+{
+    const char *scan = pos;
+    bool negative = FALSE;
+    if ((scan < end) && ((*scan == '-') || (*scan == '+')))
+    {
+	negative = (*scan == '-');
+	++scan;
+    }
+    if ((scan >= end) || !isDigit (*scan))
+	return (FALSE);
+
+    // Accumulate as a negative number, which has room for LLONG_MIN
+    long long val = 0;
+    while ((scan < end) && isDigit (*scan))
+    {
+	int digit = *scan - '0';
+	if (val < (LLONG_MIN + digit) / 10)
+	    return (FALSE);
+	val = val * 10 - digit;
+	++scan;
+    }
+    if (!negative)
+    {
+	if (val == LLONG_MIN)
+	    return (FALSE);
+	val = -val;
+    }
+
+    value = val;
+    pos = scan;
+    return (TRUE);
+}
+
+// Converts the number at pos with strtod(), for the forms the fast path
+// in TG_scanDouble() doesn't handle (long mantissas, big exponents,
+// hex, inf, nan).  len is how much text the number may take up.
+static bool scanDoubleWithStrtod (const char *&pos, int len, double &value)
+{
+    char buf[MAX_STRTOD_LENGTH+1];
+    if (len > MAX_STRTOD_LENGTH)
+	len = MAX_STRTOD_LENGTH;
+    memcpy (buf, pos, len);
+    buf[len] = 0;
+
+    char *stop;
+    double val = strtod (buf, &stop);
+    if (stop == buf)
+	return (FALSE);
+
+    value = val;
+    pos += stop - buf;
+    return (TRUE);
+}
+
+bool TG_scanDouble (const char *&pos, const char *end, double &value)
+{
+    const char *scan = pos;
+    bool negative = FALSE;
+    if ((scan < end) && ((*scan == '-') || (*scan == '+')))
+    {
+	negative = (*scan == '-');
+	++scan;
+    }
+
+    // Collect up to 19 significant digits (all that fit) in mantissa,
+    // tracking where the decimal point goes in exponent
+    unsigned long long mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool sawDigit = FALSE;
+    bool tooLong = FALSE;
+    while ((scan < end) && isDigit (*scan))
+    {
+	sawDigit = TRUE;
+	if ((mantissa != 0) || (*scan != '0'))
+	{
+	    if (significantDigits < 19)
+		mantissa = mantissa * 10 + (*scan - '0');
+	    else
+		tooLong = TRUE;
+	    ++significantDigits;
+	}
+	++scan;
+    }
+    if ((scan < end) && (*scan == '.'))
+    {
+	++scan;
+	while ((scan < end) && isDigit (*scan))
+	{
+	    sawDigit = TRUE;
+	    if ((mantissa != 0) || (*scan != '0'))
+	    {
+		if (significantDigits < 19)
+		    mantissa = mantissa * 10 + (*scan - '0');
+		else
+		    tooLong = TRUE;
+		++significantDigits;
+	    }
+	    --exponent;
+	    ++scan;
+	}
+    }
+
+    // Not a plain decimal number (maybe inf, nan, or hex); let strtod()
+    // decide how much of the text up to the next whitespace is a number
+    if (!sawDigit || ((scan < end) && ((*scan == 'x') || (*scan == 'X'))))
+    {
+	const char *tokenEnd = pos;
+	while ((tokenEnd < end) && !TG_isSpace (*tokenEnd))
+	    ++tokenEnd;
+	return (scanDoubleWithStrtod (pos, tokenEnd - pos, value));
+    }
+
+    // An exponent only counts if it has digits ("1e" is 1, then "e")
+    if ((scan < end) && ((*scan == 'e') || (*scan == 'E')))
+    {
+	const char *expScan = scan + 1;
+	bool expNegative = FALSE;
+	if ((expScan < end) && ((*expScan == '-') || (*expScan == '+')))
+	{
+	    expNegative = (*expScan == '-');
+	    ++expScan;
+	}
+	if ((expScan < end) && isDigit (*expScan))
+	{
+	    int expValue = 0;
+	    while ((expScan < end) && isDigit (*expScan))
+	    {
+		if (expValue < 100000)
+		    expValue = expValue * 10 + (*expScan - '0');
+		++expScan;
+	    }
+	    exponent += expNegative ? -expValue : expValue;
+	    scan = expScan;
+	}
+    }
+
+    // With a mantissa and power of ten that are both exact, one multiply
+    // or divide gives the correctly rounded result, just like strtod()
+    if (tooLong || (mantissa > MAX_EXACT_MANTISSA) ||
+	(exponent > MAX_EXACT_POWER) || (exponent < -MAX_EXACT_POWER))
+    {
+	if ((mantissa == 0) && !tooLong)
+	{
+	    // Zero with any exponent is still zero
+	    value = negative ? -0.0 : 0.0;
+	    pos = scan;
+	    return (TRUE);
+	}
+	return (scanDoubleWithStrtod (pos, scan - pos, value));
+    }
+
+    double val = (double) mantissa;
+    if (exponent > 0)
+	val *= exactPowersOfTen[exponent];
+    else if (exponent < 0)
+	val /= exactPowersOfTen[-exponent];
+
+    value = negative ? -val : val;
+    pos = scan;
+    return (TRUE);
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -0,0 +1,191 @@
+//! \file snippet_reader.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+/*
+ * Block reader and top-level tag classification shared by the
+ * XMLSnippetParsers in TGxmlserver and TGmemcheck2xml.  Snippets (and
+ * their line offsets) come out exactly as they did when the parsers read
+ * with fgetc(); only the way the input is read and scanned has changed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include "snippet_reader.h"
+#include "tg_error.h"
+
+SnippetReader::SnippetReader (FILE *in) : fd (fileno (in)), pos (0),
+					  end (0), lineNo (1), blockOffset (0)
+{
+    if ((block = (char *) malloc (TG_SNIPPET_READ_SIZE)) == NULL)
+	TG_error ("Out of memory allocating %i bytes\n", TG_SNIPPET_READ_SIZE);
+}
+
+SnippetReader::~SnippetReader ()
+{
+    free (block);
+}
+
+bool SnippetReader::fill ()
+{
+    if (pos < end)
+	return (TRUE);
+
+    // The next block starts where this one ended
+    blockOffset += end;
+
+    int got;
+    do
+    {
+	got = read (fd, block, TG_SNIPPET_READ_SIZE);
+    } while ((got < 0) && (errno == EINTR));
+
+    // Treat errors like end of file (fgetc() returned EOF for both)
+    pos = 0;
+    end = (got > 0) ? got : 0;
+    return (end > 0);
+}
+
+void SnippetReader::append (MessageBuffer &sbuf, const char *data, int len)
+{
+    sbuf.appendBytes (data, len);
+
+    const char *scan = data, *stop = data + len;
+    while ((scan = (const char *) memchr (scan, '\n', stop - scan)) != NULL)
+    {
+	lineNo++;
+	scan++;
+    }
+}
+
+bool SnippetReader::appendToTagEnd (MessageBuffer &sbuf, int &lastLT)
+{
+    while (fill ())
+    {
+	const char *start = block + pos;
+	int avail = end - pos;
+	const char *gt = (const char *) memchr (start, '>', avail);
+	int len = (gt != NULL) ? (gt - start) + 1 : avail;
+
+	// The tag begins at the last '<' in this piece, if there is one
+	// (usually just a few characters back from the '>')
+	for (const char *lt = start + len - 1; lt >= start; lt--)
+	{
+	    if (*lt == '<')
+	    {
+		lastLT = sbuf.strlen() + (lt - start);
+		break;
+	    }
+	}
+
+	append (sbuf, start, len);
+	pos += len;
+	if (gt != NULL)
+	    return (TRUE);
+    }
+    return (FALSE);
+}
+
+void SnippetReader::appendRest (MessageBuffer &sbuf)
+{
+    while (fill ())
+    {
+	append (sbuf, block + pos, end - pos);
+	pos = end;
+    }
+}
+
+int SnippetReader::classifyTag (const char *element,
+				const XMLTokenTable &table, bool &isEnd)
+{
+    // Expect element[0] == '<'
+    if (element[0] != '<')
+    {
+	fprintf (stderr, "Error in XMLSnippetParser::classifyTag: \n"
+		 "  Expect < not '%c' in '%s'!\n", element[0], element);
+	exit (1);
+    }
+
+    // For now, treat as end element only if starts with </
+    // (Not expecting <foo/> right now as select ending element)
+    const char *name = element + 1;
+    isEnd = (*name == '/');
+    if (isEnd)
+	name++;
+
+    // The name runs to the '>' or the first white space, so that
+    // </message> is distinguished from </message_folder>
+    int len = 0;
+    while ((name[len] != '>') && (name[len] != 0) && !isspace(name[len]))
+	len++;
+
+    return (table.lookup (name, len));
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
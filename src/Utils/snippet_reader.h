@@ -0,0 +1,149 @@
+//! \file snippet_reader.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+
+#ifndef TG_SNIPPET_READER_H
+#define TG_SNIPPET_READER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "messagebuffer.h"
+#include "xml_token_table.h"
+
+//! Bytes read from the input at a time
+#define TG_SNIPPET_READ_SIZE (256 * 1024)
+
+//! Block reader that feeds XMLSnippetParser.
+
+//! Reads the input with read() in TG_SNIPPET_READ_SIZE blocks (not a
+//! character at a time) and hands it over a tag at a time, finding the
+//! '<' and '>' characters with memchr.  A read that finds nothing (end of
+//! file for now) is simply retried on the next call, so a file that is
+//! still being written can be followed.
+class SnippetReader
+{
+public:
+    //! Reads from in's file descriptor; in must not have been read
+    //! with stdio.
+    SnippetReader (FILE *in);
+    ~SnippetReader ();
+
+    //! Appends the input up to and including the next '>' to sbuf and
+    //! returns TRUE.  If there is a '<' in what was appended, lastLT is
+    //! set to the offset in sbuf of the last one (so sbuf + lastLT is the
+    //! tag just ended).  Returns FALSE, having appended all the input
+    //! read so far, if there is no '>' available yet.
+    bool appendToTagEnd (MessageBuffer &sbuf, int &lastLT);
+
+    //! Appends all the remaining input (until read() finds no more) to sbuf
+    void appendRest (MessageBuffer &sbuf);
+
+    //! Returns the line number of the next character to be appended
+    int lineNumber () {return (lineNo);}
+
+    //! Returns the offset in the file of the next character to be
+    //! appended
+    off_t fileOffset () {return (blockOffset + pos);}
+
+    //! Throws away input read but not yet appended, and counts lines
+    //! (and offsets) from the start again (for after the file is
+    //! rewound or replaced)
+    void restart () {pos = 0; end = 0; lineNo = 1; blockOffset = 0;}
+
+    //! Carries on reading from in's file descriptor, which must be at
+    //! the offset the old one had reached (e.g., the same file, closed
+    //! to save descriptors and opened again)
+    void setInput (FILE *in) {fd = fileno (in);}
+
+    //! Looks up the name of the tag starting at element (which must
+    //! start with '<' and run to the end of the tag) in table, setting
+    //! isEnd if the tag is an end tag (</name>).  The name ends at '>'
+    //! or white space, as in "<name attr=...>".  Returns the id from
+    //! table, or -1 if not found.
+    static int classifyTag (const char *element, const XMLTokenTable &table,
+			    bool &isEnd);
+
+private:
+    //! Reads the next block if the current one is used up.  Returns
+    //! FALSE if there is nothing more to read right now.
+    bool fill ();
+
+    //! Appends len bytes at data to sbuf, counting newlines
+    void append (MessageBuffer &sbuf, const char *data, int len);
+
+    int fd;
+    char *block;
+    int pos;		// Next unused byte in block
+    int end;		// Bytes in block
+    int lineNo;
+    off_t blockOffset;	// File offset of block[0]
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
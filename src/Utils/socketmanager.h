@@ -28,8 +28,9 @@ public:
     SocketManager (int socketId, FILE *logFile=NULL) : 
 	sock (socketId), log (logFile) {}
 
-    //! Packs and sends message to socket with format 'fmt'
-    void packSend (int tag, int id, const char *fmt, ...)
+    //! Packs and sends message to socket with format 'fmt'.
+    //! Returns the size of the packed message.
+    int packSend (int tag, int id, const char *fmt, ...)
 	{
 	    va_list ap;
 
@@ -49,6 +50,7 @@ public:
 
 	    // Send message to socket
 	    TG_send (sock, tag, id, len, mbuf.contents());
+	    return (len);
 	}
 
     //! If log file enabled, writes message to log file
@@ -79,6 +81,9 @@ public:
     void sendStaticDataComplete ()
 	{TG_send (sock, DB_STATIC_DATA_COMPLETE, 0,  0, 0);}
 
+    void sendInputComplete ()
+	{TG_send (sock, DB_INPUT_COMPLETE, 0,  0, 0);}
+
     void sendDeclareMessageFolder (const char *messageFolderTag,
 				 const char *messageFolderTitle)
 	{ 
@@ -148,8 +153,21 @@ public:
 			int tag)
 	{packSend (tag, 0, "IS", result, message );}
 
-    void sendXMLSnippet (const char *XMLSnippet, int lineOffset)
-	{packSend (DB_PROCESS_XML_SNIPPET,0, "IS", lineOffset, XMLSnippet);}
+    //! Returns the size of the message sent (for flow control)
+    int sendXMLSnippet (const char *XMLSnippet, int lineOffset)
+	{return packSend (DB_PROCESS_XML_SNIPPET,0, "IS", lineOffset,
+			  XMLSnippet);}
+    //! Send the strings and records sections of a .tgb file as is
+    //! (see tgb_format.h); return their size (for flow control).
+    //! firstId is the string table id of the first string sent.
+    int sendTGBStrings (int firstId, const char *data, int size)
+	{TG_send (sock, DB_TGB_STRINGS, firstId, size, data);
+	 return (size);}
+    int sendTGBRecords (const char *data, int size)
+	{TG_send (sock, DB_PROCESS_TGB_RECORDS, 0, size, data);
+	 return (size);}
+    void sendEnableFlowControl ()
+	{TG_send (sock, DB_ENABLE_FLOW_CONTROL, 0,  0, 0);}
 
 
     void flush ()
@@ -0,0 +1,287 @@
+/* tg_compress.c */
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+/* Fast LZ compressor for socket messages (see tg_compress.h).
+ *
+ * The compressed data is a series of sequences, each made of:
+ *   a token byte: literal count in the high 4 bits, match length
+ *	(minus MIN_MATCH) in the low 4 bits; 15 in either means more
+ *	length bytes follow (each added in, until one is not 255)
+ *   the extra literal length bytes, then the literal bytes
+ *   a 2-byte little-endian offset back into the output to copy from
+ *   the extra match length bytes
+ * The last sequence has only literals; the data ends right after them.
+ * Matches are found with a single hash table probe per position, which
+ * is what keeps it fast.
+ */
+
+#include <string.h>
+#include "tg_compress.h"
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define HASH_BITS 12
+#define HASH(v) (((v) * 2654435761U) >> (32 - HASH_BITS))
+
+static unsigned TG_read32 (const unsigned char *p)
+{
+    unsigned v;
+
+    /* memcpy keeps unaligned reads legal everywhere */
+    memcpy (&v, p, sizeof(v));
+    return (v);
+}
+
+/* Writes the extra bytes for a length that didn't fit in a token nibble */
+static unsigned char * TG_put_length (unsigned char *op, int len)
+{
+    while (len >= 255)
+    {
+	*op++ = 255;
+	len -= 255;
+    }
+    *op++ = (unsigned char) len;
+    return (op);
+}
+
+/* Writes one sequence.  Returns the new output position, or NULL if
+ * it won't fit before oend.  A match_len of 0 marks the last sequence.
+ */
+static unsigned char * TG_put_sequence (unsigned char *op, unsigned char *oend,
+		const unsigned char *lit, int lit_len, int offset, int match_len)
+{
+    unsigned char *token = op;
+    int extra = match_len - MIN_MATCH;
+
+    /* Worst case for the length bytes, so we only check once */
+    if ((oend - op) < 1 + lit_len + lit_len / 255 + 1 + 2 +
+	(match_len / 255) + 1)
+	return (NULL);
+
+    op++;
+    if (lit_len >= 15)
+    {
+	*token = 15 << 4;
+	op = TG_put_length (op, lit_len - 15);
+    }
+    else
+	*token = (unsigned char) (lit_len << 4);
+    memcpy (op, lit, lit_len);
+    op += lit_len;
+
+    if (match_len == 0)
+	return (op);
+
+    *op++ = (unsigned char) (offset & 0xff);
+    *op++ = (unsigned char) (offset >> 8);
+    if (extra >= 15)
+    {
+	*token |= 15;
+	op = TG_put_length (op, extra - 15);
+    }
+    else
+	*token |= (unsigned char) extra;
+    return (op);
+}
+
+int TG_compress_bound (int size)
+{
+    return (size + size / 255 + 16);
+}
+
+int TG_compress (const char *in, int size, char *out, int out_size)
+{
+    const unsigned char *base = (const unsigned char *) in;
+    const unsigned char *ip = base;
+    const unsigned char *anchor = base;
+    const unsigned char *iend = base + size;
+    const unsigned char *mflimit = iend - MIN_MATCH;
+    unsigned char *op = (unsigned char *) out;
+    unsigned char *oend = op + out_size;
+    /* Position + 1 of the last place each hash was seen (0 if never) */
+    int table[1 << HASH_BITS];
+
+    if (size <= MIN_MATCH)
+	return (0);
+    memset (table, 0, sizeof(table));
+
+    while (ip <= mflimit)
+    {
+	unsigned v = TG_read32 (ip);
+	unsigned h = HASH (v);
+	int ref = table[h] - 1;
+	int pos = (int) (ip - base);
+
+	table[h] = pos + 1;
+	if ((ref >= 0) && (pos - ref <= MAX_OFFSET) &&
+	    (TG_read32 (base + ref) == v))
+	{
+	    int len = MIN_MATCH;
+
+	    while ((ip + len < iend) && (base[ref + len] == ip[len]))
+		len++;
+	    op = TG_put_sequence (op, oend, anchor, (int) (ip - anchor),
+				  pos - ref, len);
+	    if (op == NULL)
+		return (0);
+	    ip += len;
+	    anchor = ip;
+	}
+	else
+	{
+	    /* Skip ahead faster through data that isn't matching */
+	    ip += 1 + ((ip - anchor) >> 6);
+	}
+    }
+
+    op = TG_put_sequence (op, oend, anchor, (int) (iend - anchor), 0, 0);
+    if ((op == NULL) || (op - (unsigned char *) out >= size))
+	return (0);
+    return ((int) (op - (unsigned char *) out));
+}
+
+/* Reads the extra bytes of a length.  Returns -1 if they run past iend. */
+static int TG_get_length (const unsigned char **ipp, const unsigned char *iend,
+		int len)
+{
+    const unsigned char *ip = *ipp;
+    int b;
+
+    do
+    {
+	if (ip >= iend)
+	    return (-1);
+	b = *ip++;
+	len += b;
+    } while (b == 255);
+    *ipp = ip;
+    return (len);
+}
+
+int TG_decompress (const char *in, int size, char *out, int out_size)
+{
+    const unsigned char *ip = (const unsigned char *) in;
+    const unsigned char *iend = ip + size;
+    unsigned char *op = (unsigned char *) out;
+    unsigned char *oend = op + out_size;
+    int token, lit_len, match_len, offset;
+
+    while (1)
+    {
+	if (ip >= iend)
+	    return (-1);
+	token = *ip++;
+
+	lit_len = token >> 4;
+	if ((lit_len == 15) &&
+	    ((lit_len = TG_get_length (&ip, iend, lit_len)) < 0))
+	    return (-1);
+	if ((lit_len > iend - ip) || (lit_len > oend - op))
+	    return (-1);
+	memcpy (op, ip, lit_len);
+	op += lit_len;
+	ip += lit_len;
+
+	/* The last sequence has no match */
+	if (ip == iend)
+	    break;
+
+	if (iend - ip < 2)
+	    return (-1);
+	offset = ip[0] | (ip[1] << 8);
+	ip += 2;
+	if ((offset == 0) || (offset > op - (unsigned char *) out))
+	    return (-1);
+
+	match_len = token & 15;
+	if ((match_len == 15) &&
+	    ((match_len = TG_get_length (&ip, iend, match_len)) < 0))
+	    return (-1);
+	match_len += MIN_MATCH;
+	if (match_len > oend - op)
+	    return (-1);
+
+	if (offset >= match_len)
+	{
+	    memcpy (op, op - offset, match_len);
+	    op += match_len;
+	}
+	else
+	{
+	    /* Overlapping copy repeats the last offset bytes */
+	    const unsigned char *match = op - offset;
+	    while (match_len-- > 0)
+		*op++ = *match++;
+	}
+    }
+
+    if (op != oend)
+	return (-1);
+    return (out_size);
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -13,6 +13,15 @@
  * Created by John C. Gyllenhaal, 4/21/00 
  * John May--added write queuing in separate thread 3/22/01
  * John May--added read queuing in separate thread 12/5/01
+ * Added per-socket receive ring so many messages can be framed from a
+ * single read() and handed out in place (TG_nb_recv_view) 
+ * Replaced the locked thread queues with lock-free single-producer/
+ * single-consumer queues (USE_LOCKED_QUEUE keeps the old ones)
+ * Added optional same-host shared memory transport for large messages
+ * and optional compression, negotiated by TG_offer_options/
+ * TG_accept_options, along with per-connection traffic counts
+ * Added recording of a connection's messages (TG_record_socket) for
+ * replaying them later with tgreplay
  */
 #if defined(USE_WRITE_THREAD) || defined(USE_READ_THREAD)
 #include <pthread.h>
@@ -20,21 +29,54 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
 #include "tg_socket.h"
 #include "tg_swapbytes.h"
 #include "tg_error.h"
+#include "tg_compress.h"
 #include <signal.h>
 #include <unistd.h>
 #include <sys/time.h>  /* defines select() on tru64 */
+#include <sys/uio.h>   /* writev() */
+#include <sys/mman.h>  /* mmap() for the shared memory transport */
+#include <sys/stat.h>
+
+/* Full memory barrier, where we know how to issue one.  Used by the
+ * lock-free thread queues and the shared memory transport.
+ */
+#if defined(__GNUC__)
+#define TG_MEMORY_BARRIER() __sync_synchronize()
+#elif defined(TG_AIX)
+#define TG_MEMORY_BARRIER() __sync()
+#endif
 
 
 #if defined(USE_WRITE_THREAD) || defined(USE_READ_THREAD)
 static int forever = 0;	/* avoids compiler warning for infinite loop */
+
+/* Messages pass between a socket thread and the rest of the process
+ * through a bounded single-producer/single-consumer queue that takes
+ * no locks: only the producer advances tail and only the consumer
+ * advances head.  Small payloads are copied into the queue slot itself,
+ * so most messages cost no malloc/free.  A side that has to block first
+ * says so (consumer_idle/producer_idle) and then waits on a pipe, and
+ * the other side writes to the pipe only in that case.
+ *
+ * Compiling with USE_LOCKED_QUEUE selects the original linked list
+ * protected by a mutex and condition variable instead (useful for
+ * comparison and debugging, and used where we know no memory barrier).
+ */
+#if !defined(USE_LOCKED_QUEUE) && !defined(TG_MEMORY_BARRIER)
+#define USE_LOCKED_QUEUE
+#endif
+
+#ifdef USE_LOCKED_QUEUE
 typedef struct _queue_entry {
 	int tag;
 	int id;
@@ -42,25 +84,72 @@ typedef struct _queue_entry {
 	void * buf;
 	struct _queue_entry * next;
 } Queue_entry;
+#else
+/* Number of messages a queue can hold (must be a power of two) */
+#define QUEUE_SLOTS 512
+/* Payloads up to this size are copied into the slot; larger ones
+ * are malloc'd.  Chosen so a slot is 1K and most XML snippets fit.
+ */
+#define INLINE_PAYLOAD_SIZE (1024 - 3 * (int)sizeof(int) - (int)sizeof(char *))
+typedef struct {
+	int tag;
+	int id;
+	int size;
+	char * buf;	/* inline_data, a malloc'd copy, or NULL */
+	char inline_data[INLINE_PAYLOAD_SIZE];
+} Queue_slot;
+#endif
 
 typedef struct {
 	int		fd;
 	pthread_t	thread;
+#ifdef USE_LOCKED_QUEUE
 	pthread_cond_t	cond;
 	pthread_mutex_t	lock;
 	Queue_entry * head;
 	Queue_entry * tail;
+	Queue_entry * viewed;	/* handed out by TG_queue_get, not freed */
+	int count;		/* number of entries from head to tail */
+#else
+	Queue_slot * slots;
+	volatile unsigned head;	/* oldest slot in use (consumer writes) */
+	volatile unsigned tail;	/* next slot to fill (producer writes) */
+	unsigned next;		/* next slot to hand out (consumer only) */
+	int viewing;		/* slots from head to next are still in use */
+	volatile int consumer_idle;	/* consumer is waiting for a message */
+	volatile int producer_idle;	/* producer is waiting for a slot */
+	int consumer_wake[2];	/* pipe used to wake the consumer */
+	int producer_wake[2];	/* pipe used to wake the producer */
+#endif
+	volatile int closed;	/* set once the socket is seen to be closed */
 } Socket_thread;
-int socket_closed = 0;	/* set to nonzero if socket is seen to be closed */
 /* Create threads with a 1 MB stack */
 #define THREAD_STACK_SIZE (1<<20)
+
+static void TG_queue_init (Socket_thread *st);
+static void TG_queue_put (Socket_thread *st, int tag, int id, int size,
+		const void *buf);
+#ifdef USE_READ_THREAD
+static void TG_queue_close (Socket_thread *st);
+#endif
+static int TG_queue_state (Socket_thread *st);
+static void TG_queue_wait (Socket_thread *st);
+static void TG_queue_get (Socket_thread *st, int *tag, int *id, int *size,
+		char **buf, int copy);
+static void TG_queue_release (Socket_thread *st);
+#ifdef USE_READ_THREAD
+static int TG_queue_depth (Socket_thread *st);
+static int TG_queue_notify_fd (Socket_thread *st);
+#endif
 #endif
 
 #ifdef USE_WRITE_THREAD
 #define NUM_WRITE_THREADS 2
+/* Maximum number of messages the writer thread sends per writev() */
+#define WRITE_BATCH 8
 static Socket_thread write_socket_thread[NUM_WRITE_THREADS];
 static void * TG_write_queue_handler(void * thread_data);
-static int TG_init_write_thread( int fd )
+static int TG_init_write_thread( int fd );
 #endif
 
 #ifdef USE_READ_THREAD
@@ -68,6 +157,8 @@ static int TG_init_write_thread( int fd )
 static Socket_thread read_socket_thread[NUM_READ_THREADS];
 static void * TG_read_queue_handler(void * thread_data);
 static int TG_init_read_thread( int fd );
+static Socket_thread * TG_find_read_thread( int fd );
+static Socket_thread * TG_get_read_thread( int fd );
 #endif
 
 #ifdef USE_LOG
@@ -75,8 +166,145 @@ static int TG_init_read_thread( int fd );
 FILE * logfile = NULL;
 #endif
 
+#ifndef USE_READ_THREAD
 static int TG_internal_nb_recv (int fd, int *tag, int *id, int *size,
 		void **buf);
+#endif
+
+/* Shared memory transport (see TG_offer_options).  The sending side owns
+ * a ring of bytes in a file that both processes map.  A large payload
+ * is copied into the ring, and the message sent on the socket carries
+ * only TG_SHM_TAG_FLAG in its tag and a Shm_ref to the payload, so the
+ * socket still decides the order of messages.  The receiver hands out
+ * the payload in place and gives the space back (by advancing head) on
+ * its next receive.  If the ring is full, the sender just uses the
+ * socket.  Needs a memory barrier, so it is left out where we don't
+ * know how to issue one (the offer is then always declined).
+ */
+#ifdef TG_MEMORY_BARRIER
+#define USE_SHM_TRANSPORT
+#endif
+
+/* Internal tags and tag flags (never seen by callers).  Flags only
+ * mark nonnegative tags, since negative ones have those bits set already.
+ */
+#define TG_SHM_TAG_FLAG 0x40000000
+#define TG_COMPRESS_TAG_FLAG 0x20000000
+#define TG_INTERNAL_TAG_FLAGS (TG_SHM_TAG_FLAG | TG_COMPRESS_TAG_FLAG)
+#define TG_TAG_FLAGGED(tag, flag) (((tag) >= 0) && ((tag) & (flag)))
+#define TG_OFFER_TAG (-4001)
+#define TG_REPLY_TAG (-4002)
+
+#ifdef USE_SHM_TRANSPORT
+/* Payloads smaller than this aren't worth the trip */
+#define TG_SHM_MIN_SIZE (8*1024)
+/* Size of the ring (must be a power of two) */
+#define TG_SHM_RING_SIZE (8*1024*1024)
+#define TG_SHM_MAGIC 0x54475348	/* "TGSH" */
+#define NUM_SHM_CHANNELS 4
+
+/* Start of the mapped file; the ring follows at SHM_DATA_OFFSET */
+typedef struct {
+	unsigned magic;
+	unsigned cookie;	/* random, to be sure both map the same file */
+	unsigned capacity;	/* bytes in the ring */
+	volatile unsigned head;	/* bytes released so far (receiver writes) */
+} Shm_header;
+#define SHM_DATA_OFFSET 64
+
+/* Body of a message whose payload is in the ring */
+typedef struct {
+	unsigned offset;	/* where the payload starts in the ring */
+	unsigned length;	/* payload bytes */
+	unsigned end;		/* head once the payload has been released */
+} Shm_ref;
+
+typedef struct _shm_channel {
+	int	fd;
+	int	sending;	/* nonzero if this end fills the ring */
+	Shm_header * header;	/* NULL if channel slot is unused */
+	char *	data;
+	unsigned tail;		/* sender: bytes put in the ring so far */
+	unsigned release;	/* receiver: head once current payload is done */
+} Shm_channel;
+
+static Shm_channel shm_channel[NUM_SHM_CHANNELS];
+
+static Shm_channel * TG_lookup_shm (int fd);
+static int TG_shm_put (Shm_channel *shm, const void *buf, int size,
+		Shm_ref *ref);
+static void TG_shm_release (Shm_channel *shm);
+#endif
+
+/* Payloads smaller than this are never compressed */
+#define TG_COMPRESS_MIN_SIZE 1024
+/* Compressed payloads start with the original size (4 bytes, big-endian,
+ * since the library doesn't swap payloads)
+ */
+#define COMPRESS_HEADER_SIZE 4
+
+/* Options and traffic counts for a connection, set up when the options
+ * are negotiated.  The sending fields are only touched by TG_send's
+ * caller and the receiving ones only by whoever frames messages (the
+ * reader thread, if there is one).
+ */
+typedef struct {
+	int	fd;
+	int	options;	/* TG_OPTION_* in use */
+	char *	pack_buf;	/* sender: compressed payload */
+	int	pack_capacity;
+	TG_socket_stats stats;
+	FILE *	record;		/* capture of every message, if recording */
+	double	record_start;
+	int	in_use;
+} Socket_info;
+
+#define NUM_SOCKET_INFO 4
+static Socket_info socket_info[NUM_SOCKET_INFO];
+
+static Socket_info * TG_lookup_socket_info (int fd);
+static void TG_record_message (Socket_info *info, int direction, int tag,
+		int id, int size, const void *buf);
+static void TG_record_from_env (int fd, int role);
+
+/* Receive ring: bytes are read from the socket in large chunks into
+ * a per-socket buffer and complete messages are framed in place.  A
+ * message handed out by TG_ring_nb_recv stays put until the next call
+ * on the same socket, so callers can use the payload without copying it.
+ * Once a socket has a ring, every receive path on that socket goes
+ * through it (otherwise buffered bytes would be skipped).
+ */
+typedef struct {
+	int	fd;
+	char *	data;
+	int	capacity;
+	int	start;		/* first byte not yet handed out */
+	int	end;		/* one past last byte read from socket */
+	int	last_frame;	/* bytes of frame handed out by last call */
+	struct _shm_channel * shm_held;	/* payload handed out from shared
+					 * memory by last call, if any */
+	char *	unpack;		/* decompressed payload of last call */
+	int	unpack_capacity;
+	int	viewing;	/* last frame was handed out as a view */
+	char *	held_data;	/* old ring buffer still holding a view */
+	char *	held_unpack;	/* old unpack buffer still holding a view */
+	struct _shm_channel * held_shm;	/* shared memory release put off
+					 * until the view is done */
+} Recv_ring;
+
+#define NUM_RECV_RINGS 4
+#define RECV_HEADER_SIZE (3 * (int)sizeof(int))
+/* Big enough to hold hundreds of typical XML snippets per read */
+#define RECV_RING_SIZE (256*1024)
+static Recv_ring recv_ring[NUM_RECV_RINGS];
+
+static Recv_ring * TG_lookup_recv_ring (int fd, int create);
+static int TG_ring_nb_recv (Recv_ring *ring, int *tag, int *id, int *size,
+		char **buf);
+#ifndef USE_READ_THREAD
+static void TG_ring_keep_view (Recv_ring *ring);
+static void TG_ring_drop_held (Recv_ring *ring);
+#endif
 
 #ifdef USE_WRITE_THREAD
 /*! Works for a maximum of NUM_THREADS threads (probably only one is
@@ -103,21 +331,8 @@ int TG_init_write_thread( int fd )
 	for( i = 0; i < NUM_WRITE_THREADS; i++ ) {
 		if( write_socket_thread[i].fd == 0 ) { /* default initial val */
 			write_socket_thread[i].fd = fd;
-			write_socket_thread[i].head
-				= write_socket_thread[i].tail = NULL;
+			TG_queue_init( &(write_socket_thread[i]) );
 
-			rc = pthread_cond_init( &(write_socket_thread[i].cond),
-					NULL );
-			if( rc != 0 )
-				    TG_error( "TG_init_write_thread: "
-					    "pthread_cond_init returned %d",
-					    rc );
-			rc = pthread_mutex_init( &(write_socket_thread[i].lock),
-					NULL );
-			if( rc != 0 )
-				    TG_error( "TG_init_write_thread: "
-					    "pthread_mutex_init returned %d",
-					    rc );
 			rc = pthread_create( &(write_socket_thread[i].thread),
 					&attr, TG_write_queue_handler,
 					(void *)(&(write_socket_thread[i])) );
@@ -132,6 +347,7 @@ int TG_init_write_thread( int fd )
 
 	if( i == NUM_WRITE_THREADS )
 		TG_error( "TG_init_write_thread: ran out of thread slots\n" );
+	return i;
 }
 #endif
 
@@ -158,23 +374,8 @@ int TG_init_read_thread( int fd )
 	for( i = 0; i < NUM_READ_THREADS; i++ ) {
 		if( read_socket_thread[i].fd == 0 ) { /* default initial val */
 			read_socket_thread[i].fd = fd;
-			read_socket_thread[i].head
-				= read_socket_thread[i].tail = NULL;
+			TG_queue_init( &(read_socket_thread[i]) );
 
-			rc = pthread_cond_init( &(read_socket_thread[i].cond),
-					NULL );
-			if( rc != 0 )
-				    TG_error( "TG_init_read_thread: "
-					    "pthread_cond_init returned %d"
-						    "errno = %d",
-						    rc, errno );
-			rc = pthread_mutex_init( &(read_socket_thread[i].lock),
-					NULL );
-			if( rc != 0 )
-				    TG_error( "TG_init_read_thread: "
-					    "pthread_mutex_init returned %d"
-						    "errno = %d",
-						    rc, errno );
 			rc = pthread_create( &(read_socket_thread[i].thread),
 					&attr, TG_read_queue_handler,
 					(void *)(&(read_socket_thread[i])) );
@@ -195,54 +396,96 @@ int TG_init_read_thread( int fd )
 		TG_error( "TG_init_read_thread: ran out of thread slots\n" );
 	return i;
 }
+
+/* Returns the reader thread handling fd, or NULL if none has been
+ * started for it yet.
+ */
+Socket_thread * TG_find_read_thread( int fd )
+{
+	int i;
+
+	for( i = 0; i < NUM_READ_THREADS; i++ ) {
+		if( fd == read_socket_thread[i].fd )
+			return &(read_socket_thread[i]);
+	}
+	return NULL;
+}
+
+/* Returns the reader thread handling fd, starting one if necessary.
+ * Punts if no thread slots are left.
+ */
+Socket_thread * TG_get_read_thread( int fd )
+{
+	int i;
+
+	for( i = 0; i < NUM_READ_THREADS; i++ ) {
+		if( fd == read_socket_thread[i].fd ) break;
+
+		/* If not found yet, initialize this location 
+		 * (assumes slots in array are always filled in
+		 * order, so threads should never be removed)
+		 */
+		if( read_socket_thread[i].fd == 0 ) {
+			TG_init_read_thread( fd );
+			break;
+		}
+	}
+
+	if( i == NUM_READ_THREADS ) {
+		TG_error( "Couldn't find or allocate a thread for fd %d\n",
+				fd );
+	}
+	return &(read_socket_thread[i]);
+}
 #endif
 
 
 /* Internal routine for writing to a non-blocking socket.
- * Handles all the retries necessary and punts on error.
+ * Writes count buffers described by iov (e.g., a header and its message)
+ * with as few system calls as possible, handling all the retries
+ * necessary.  The iov array is modified.  Punts on error.
  */
-static void TG_internal_write (int fd, char *buf, int size)
+static void TG_internal_writev (int fd, struct iovec *iov, int count)
 {
-    int size_left, size_written;
-    char *buf_left;
+    int size_written;
 
-    /* Handle non-atomic writes */
-    buf_left = buf;
-    size_left = size;
+    /* Skip over empty buffers so we never pass writev nothing */
+    while ((count > 0) && (iov->iov_len == 0))
+    {
+	iov++;
+	count--;
+    }
 
-    /* Loop until everything has been written out */
-    while (size_left > 0)
+    while (count > 0)
     {
-	/* Write out as much as can */
-	if ((size_written = write (fd, (void *)buf_left, size_left)) <= 0)
+	if ((size_written = writev (fd, iov, count)) <= 0)
 	{
 	    /* For now, only loop if errno is EAGAIN or EINTR */
 	    if ((errno == EAGAIN) || (errno == EINTR))
-	    {
-#ifdef USE_LOG
-		fprintf( logfile, "write interrupted; sent %d bytes\n",
-				size_written );
-		fflush( logfile );
-#endif
 		continue;
-	    }
-	    else
-	    {
-		/* Punt otherwise */
-		TG_errno ("TG_internal_write: error during write(%i, x, %i)!",
-			  fd, size_left);
-	    }
+
+	    /* Punt otherwise */
+	    TG_errno ("TG_internal_writev: error during writev(%i, x, %i)!",
+		      fd, count);
 	}
-	/* If sucessfully write something, updates pointer and counter */
-	else
+
+	/* Advance past everything that was written */
+	while ((count > 0) && ((size_t)size_written >= iov->iov_len))
 	{
-	    buf_left += size_written;
-	    size_left -= size_written;
+	    size_written -= iov->iov_len;
+	    iov++;
+	    count--;
+	}
+	if (count > 0)
+	{
+	    iov->iov_base = (char *)iov->iov_base + size_written;
+	    iov->iov_len -= size_written;
 	}
     }
 }
 
 
+#ifndef USE_READ_THREAD
 /* Internal routine for reading from a non-blocking socket.
  * If no data is available for the first read, it returns 0.
  * Otherwise, it will read all the data (with retries) and return 1.
@@ -313,17 +556,1157 @@ static int TG_internal_read (int fd, char *buf, int size)
 			    fprintf(logfile, "<%x>", buf_left[i]);
             }
 
-	    putc('\n', logfile );
-	    fflush(logfile);
-#endif
+	    putc('\n', logfile );
+	    fflush(logfile);
+#endif
+
+	    buf_left += size_read;
+	    size_left -= size_read;
+	}
+    }
+    return (1);
+}
+#endif /* !USE_READ_THREAD */
+
+/* Returns the receive ring for fd, or NULL if fd has none.  If create
+ * is nonzero, a ring is allocated for fd if it doesn't already have one.
+ * Punts if all ring slots are in use.
+ */
+static Recv_ring * TG_lookup_recv_ring (int fd, int create)
+{
+    int i;
+    Recv_ring *ring;
+
+    for (i = 0; i < NUM_RECV_RINGS; i++)
+    {
+	if (recv_ring[i].data != NULL && recv_ring[i].fd == fd)
+	    return (&recv_ring[i]);
+    }
+
+    if (!create)
+	return (NULL);
+
+    for (i = 0; i < NUM_RECV_RINGS; i++)
+    {
+	if (recv_ring[i].data == NULL)
+	    break;
+    }
+    if (i == NUM_RECV_RINGS)
+	TG_error ("TG_lookup_recv_ring: ran out of ring slots for fd %i", fd);
+
+    ring = &recv_ring[i];
+    if ((ring->data = (char *)malloc (RECV_RING_SIZE)) == NULL)
+    {
+	TG_error ("TG_lookup_recv_ring: Out of memory allocating %i bytes!",
+		  RECV_RING_SIZE);
+    }
+    ring->fd = fd;
+    ring->capacity = RECV_RING_SIZE;
+    ring->start = 0;
+    ring->end = 0;
+    ring->last_frame = 0;
+    ring->shm_held = NULL;
+    ring->unpack = NULL;
+    ring->unpack_capacity = 0;
+    ring->viewing = 0;
+    ring->held_data = NULL;
+    ring->held_unpack = NULL;
+    ring->held_shm = NULL;
+    return (ring);
+}
+
+#ifndef USE_READ_THREAD
+/* Called before a copying receive while the caller may still be using
+ * a view of the last frame (e.g., a GUI handler that spins the event
+ * loop and ends up receiving again).  Rather than release the frame,
+ * sets the buffers holding it aside and carries on with fresh ones, so
+ * the view stays put until the next view call (TG_ring_drop_held).
+ */
+static void TG_ring_keep_view (Recv_ring *ring)
+{
+    int unread = ring->end - ring->start - ring->last_frame;
+    int capacity = (unread > RECV_RING_SIZE) ? unread : RECV_RING_SIZE;
+    char *new_data;
+
+    if ((new_data = (char *)malloc (capacity)) == NULL)
+    {
+	TG_error ("TG_ring_keep_view: Out of memory allocating %i bytes!",
+		  capacity);
+    }
+    if (unread > 0)
+	memcpy (new_data, ring->data + ring->start + ring->last_frame, unread);
+
+    /* Only one view is outstanding at a time, so nothing is held yet */
+    ring->held_data = ring->data;
+    ring->data = new_data;
+    ring->capacity = capacity;
+    ring->start = 0;
+    ring->end = unread;
+    ring->last_frame = 0;
+
+    ring->held_unpack = ring->unpack;
+    ring->unpack = NULL;
+    ring->unpack_capacity = 0;
+
+    /* Shared memory is consumed in order, so releasing anything after
+     * the view would release it too.  Hold off until the view is done.
+     */
+    ring->held_shm = ring->shm_held;
+    ring->shm_held = NULL;
+
+    ring->viewing = 0;
+}
+
+/* The caller is done with the view TG_ring_keep_view set aside */
+static void TG_ring_drop_held (Recv_ring *ring)
+{
+    if (ring->held_data != NULL)
+    {
+	free (ring->held_data);
+	ring->held_data = NULL;
+    }
+    if (ring->held_unpack != NULL)
+    {
+	free (ring->held_unpack);
+	ring->held_unpack = NULL;
+    }
+#ifdef USE_SHM_TRANSPORT
+    if (ring->held_shm != NULL)
+    {
+	/* Covers every payload received since, which are all done with */
+	TG_shm_release (ring->held_shm);
+	ring->held_shm = NULL;
+    }
+#endif
+}
+#endif /* !USE_READ_THREAD */
+
+/* Returns nonzero if the ring holds bytes that have not been handed
+ * out yet (i.e., the socket may look idle but a message is buffered).
+ */
+static int TG_ring_pending (Recv_ring *ring)
+{
+    if (ring == NULL)
+	return (0);
+    return ((ring->end - ring->start - ring->last_frame) > 0);
+}
+
+/* Makes sure there is room for at least need contiguous bytes starting
+ * at ring->start, sliding unread bytes to the front of the buffer and
+ * growing it if necessary.  Only called after the previous frame has
+ * been released, so outstanding views are never moved.
+ */
+static void TG_ring_reserve (Recv_ring *ring, int need)
+{
+    int used = ring->end - ring->start;
+
+    /* Slide the partial message to the front so reads stay contiguous */
+    if ((ring->start > 0) && (ring->capacity - ring->start < need))
+    {
+	if (used > 0)
+	    memmove (ring->data, ring->data + ring->start, used);
+	ring->start = 0;
+	ring->end = used;
+    }
+
+    /* Grow for messages bigger than the ring (e.g., source files) */
+    if (ring->capacity < need)
+    {
+	char *new_data;
+	if ((new_data = (char *)realloc (ring->data, need)) == NULL)
+	{
+	    TG_error ("TG_ring_reserve: Out of memory growing ring to %i "
+		      "bytes!", need);
+	}
+	ring->data = new_data;
+	ring->capacity = need;
+    }
+}
+
+/* Does a single read() of as much as fits in the ring.
+ * Returns the number of bytes read, 0 if no data was available,
+ * or -1 if the socket was closed.  Punts on error.
+ */
+static int TG_ring_read (Recv_ring *ring)
+{
+    int size_read;
+
+    /* If at the end of the buffer, make room by sliding data forward */
+    if (ring->end == ring->capacity)
+	TG_ring_reserve (ring, ring->end - ring->start + RECV_HEADER_SIZE);
+
+    while ((size_read = read (ring->fd, ring->data + ring->end,
+			      ring->capacity - ring->end)) < 0)
+    {
+	if (errno == EAGAIN)
+	    return (0);
+	if (errno != EINTR)
+	{
+	    TG_errno ("TG_ring_read: error during read(%i, x, %i)!",
+		      ring->fd, ring->capacity - ring->end);
+	}
+    }
+
+    if (size_read == 0)
+	return (-1);
+
+    ring->end += size_read;
+    return (size_read);
+}
+
+/* Waits (without spinning) until fd becomes readable */
+static void TG_wait_readable (int fd)
+{
+    fd_set readfds;
+    int ready;
+    do {
+	FD_ZERO( &readfds );
+	FD_SET( fd, &readfds );
+	ready = select( fd + 1, &readfds, NULL, NULL, NULL );
+	/* restart if select was interrupted */
+    } while( ready < 0 && errno == EINTR );
+}
+
+/* Wall-clock seconds, for timing compression */
+static double TG_socket_clock (void)
+{
+    struct timeval now;
+
+    gettimeofday (&now, NULL);
+    return (now.tv_sec + now.tv_usec * 1e-6);
+}
+
+/* Returns the options and counts for fd, or NULL if it has none */
+static Socket_info * TG_lookup_socket_info (int fd)
+{
+    int i;
+
+    for (i = 0; i < NUM_SOCKET_INFO; i++)
+    {
+	if (socket_info[i].in_use && socket_info[i].fd == fd)
+	    return (&socket_info[i]);
+    }
+    return (NULL);
+}
+
+/* Starts keeping options and counts for fd.  Punts if all slots are
+ * in use.
+ */
+static void TG_add_socket_info (int fd, int options)
+{
+    int i;
+    Socket_info *info;
+
+    for (i = 0; i < NUM_SOCKET_INFO; i++)
+    {
+	if (!socket_info[i].in_use)
+	    break;
+    }
+    if (i == NUM_SOCKET_INFO)
+	TG_error ("TG_add_socket_info: ran out of slots for fd %i", fd);
+
+    info = &socket_info[i];
+    memset (info, 0, sizeof(*info));
+    info->fd = fd;
+    info->options = options;
+
+    /* A reader thread may look this up as soon as in_use is set */
+#ifdef TG_MEMORY_BARRIER
+    TG_MEMORY_BARRIER();
+#endif
+    info->in_use = 1;
+}
+
+/* Writes one message to info's capture, if it has one.  The sender and
+ * a reader thread may both be recording, so each entry is written with
+ * the stream locked.
+ */
+static void TG_record_message (Socket_info *info, int direction, int tag,
+		int id, int size, const void *buf)
+{
+    FILE *record = info->record;
+    TG_record_entry entry;
+    double when;
+
+    if (record == NULL)
+	return;
+
+    when = TG_socket_clock () - info->record_start;
+    entry.sec = (int)when;
+    entry.usec = (int)((when - entry.sec) * 1e6);
+    entry.direction = direction;
+    entry.tag = tag;
+    entry.id = id;
+    entry.size = size;
+
+    flockfile (record);
+    fwrite (&entry, sizeof(entry), 1, record);
+    if (size > 0)
+	fwrite (buf, 1, size, record);
+    funlockfile (record);
+}
+
+/* Starts recording fd if TG_RECORD is set in the environment.  The
+ * Collector inherits the Client's environment, so the file name says
+ * which end wrote it (and which fd, if one end records more than one).
+ */
+static void TG_record_from_env (int fd, int role)
+{
+    static int recording = 0;
+    const char *prefix = getenv ("TG_RECORD");
+    const char *end = (role == TG_RECORD_COLLECTOR) ? "collector" : "client";
+    char path[1024];
+
+    if ((prefix == NULL) || (*prefix == 0))
+	return;
+    if (recording == 0)
+	sprintf (path, "%.900s.%s", prefix, end);
+    else
+	sprintf (path, "%.900s.%s.%i", prefix, end, fd);
+
+    if (TG_record_socket (fd, path, role))
+	recording++;
+    else
+	fprintf (stderr, "TG_record_from_env: can't record fd %i to %s\n",
+		 fd, path);
+}
+
+/* Sender side: compresses size bytes of buf into info->pack_buf.
+ * Returns the size of the result (original size first), or 0 if the
+ * payload didn't shrink enough to be worth it.
+ */
+static int TG_pack_payload (Socket_info *info, const void *buf, int size)
+{
+    double start = TG_socket_clock ();
+    int packed;
+
+    if (info->pack_capacity < size)
+    {
+	free (info->pack_buf);
+	if ((info->pack_buf = (char *)malloc (size)) == NULL)
+	{
+	    TG_error ("TG_pack_payload: Out of memory allocating %i bytes!",
+		      size);
+	}
+	info->pack_capacity = size;
+    }
+
+    /* Demand at least 1/8 savings, or it isn't worth the receiver's time */
+    packed = TG_compress ((const char *)buf, size,
+			  info->pack_buf + COMPRESS_HEADER_SIZE,
+			  size - size / 8 - COMPRESS_HEADER_SIZE);
+    info->stats.compress_time += TG_socket_clock () - start;
+    if (packed == 0)
+    {
+	info->stats.compress_skipped++;
+	return (0);
+    }
+    packed += COMPRESS_HEADER_SIZE;
+
+    info->pack_buf[0] = (char)((size >> 24) & 0xff);
+    info->pack_buf[1] = (char)((size >> 16) & 0xff);
+    info->pack_buf[2] = (char)((size >> 8) & 0xff);
+    info->pack_buf[3] = (char)(size & 0xff);
+    info->stats.compressed_sent++;
+    info->stats.compress_in += size;
+    info->stats.compress_out += packed;
+    return (packed);
+}
+
+/* Receiver side: expands the compressed payload just framed into
+ * ring->unpack and points *buf at it.  Punts if the payload is bad.
+ */
+static void TG_unpack_payload (Recv_ring *ring, Socket_info *info,
+		int *tag, int *size, char **buf)
+{
+    const unsigned char *in = (const unsigned char *)*buf;
+    double start = TG_socket_clock ();
+    unsigned int header;
+    int original;
+
+    if ((info == NULL) || !(info->options & TG_OPTION_COMPRESS) ||
+	(*size < COMPRESS_HEADER_SIZE))
+    {
+	TG_error ("TG_unpack_payload: bad compressed message (tag %i, "
+		  "size %i) on fd %i!", *tag, *size, ring->fd);
+    }
+    header = ((unsigned int)in[0] << 24) | ((unsigned int)in[1] << 16) |
+	((unsigned int)in[2] << 8) | (unsigned int)in[3];
+    if (header > (unsigned int)INT_MAX)
+    {
+	TG_error ("TG_unpack_payload: bad original size (%u) on fd %i!",
+		  header, ring->fd);
+    }
+    original = (int)header;
+
+    if (ring->unpack_capacity < original)
+    {
+	free (ring->unpack);
+	if ((ring->unpack = (char *)malloc (original)) == NULL)
+	{
+	    TG_error ("TG_unpack_payload: Out of memory allocating %i bytes!",
+		      original);
+	}
+	ring->unpack_capacity = original;
+    }
+    if (TG_decompress (*buf + COMPRESS_HEADER_SIZE,
+		       *size - COMPRESS_HEADER_SIZE,
+		       ring->unpack, original) != original)
+    {
+	TG_error ("TG_unpack_payload: corrupt compressed message (tag %i, "
+		  "size %i) on fd %i!", *tag, *size, ring->fd);
+    }
+
+    *tag &= ~TG_COMPRESS_TAG_FLAG;
+    *size = original;
+    *buf = (original > 0) ? ring->unpack : NULL;
+    info->stats.compressed_received++;
+    info->stats.decompress_time += TG_socket_clock () - start;
+}
+
+/* Ring version of TG_internal_nb_recv.  Releases the message handed out
+ * by the previous call, then frames the next message from the ring,
+ * reading from the socket only when the ring doesn't hold a complete one.
+ * On success, sets *buf to point at the payload inside the ring (NULL
+ * if size is 0) and returns 1.  The payload remains valid until the
+ * next call for this socket.  Returns 0 if no message has started to
+ * arrive, and -1 if the socket closed.  Once part of a message has
+ * arrived, waits for the rest of it (as TG_internal_nb_recv does).
+ */
+static int TG_ring_nb_recv (Recv_ring *ring, int *tag, int *id, int *size,
+			    char **buf)
+{
+    int header[3];
+    int avail, frame_size, retval;
+    Socket_info *info;
+
+    /* The previous message is no longer needed */
+    ring->start += ring->last_frame;
+    ring->last_frame = 0;
+#ifdef USE_SHM_TRANSPORT
+    if (ring->shm_held != NULL)
+    {
+	/* Not while a set-aside view still points into shared memory */
+	if (ring->held_shm == NULL)
+	    TG_shm_release (ring->shm_held);
+	ring->shm_held = NULL;
+    }
+#endif
+    if (ring->start == ring->end)
+    {
+	ring->start = ring->end = 0;
+
+	/* Give back memory grabbed for an unusually big message */
+	if (ring->capacity > 4 * RECV_RING_SIZE)
+	{
+	    char *new_data = (char *)realloc (ring->data, RECV_RING_SIZE);
+	    if (new_data != NULL)
+	    {
+		ring->data = new_data;
+		ring->capacity = RECV_RING_SIZE;
+	    }
+	}
+    }
+    if (ring->unpack_capacity > 4 * RECV_RING_SIZE)
+    {
+	free (ring->unpack);
+	ring->unpack = NULL;
+	ring->unpack_capacity = 0;
+    }
+
+    /* Sanity check, clear all fields */
+    *tag = 0;
+    *id = 0;
+    *size = 0;
+    *buf = NULL;
+
+    /* Get a complete header */
+    while ((avail = ring->end - ring->start) < RECV_HEADER_SIZE)
+    {
+	TG_ring_reserve (ring, RECV_HEADER_SIZE);
+	if ((retval = TG_ring_read (ring)) < 0)
+	    return (-1);
+	if (retval == 0)
+	{
+	    /* Nothing at all has arrived yet, so don't wait for it */
+	    if (ring->end == ring->start)
+		return (0);
+	    TG_wait_readable (ring->fd);
+	}
+    }
+
+    /* Header may not be aligned within the ring, so copy it out */
+    memcpy (header, ring->data + ring->start, sizeof(header));
+    if( tg_need_swap ) {
+	    *tag = SWAP_BYTES(header[0]);
+	    *id = SWAP_BYTES(header[1]);
+	    *size = SWAP_BYTES(header[2]);
+    } else {
+	    *tag = header[0];
+	    *id = header[1];
+	    *size = header[2];
+    }
+
+    /* Sanity check */
+    if (*size < 0)
+    {
+	TG_error ("TG_ring_nb_recv: size recieved (%i) < 0!", *size);
+    }
+
+    /* Get the rest of the message into contiguous memory */
+    frame_size = RECV_HEADER_SIZE + *size;
+    if (ring->end - ring->start < frame_size)
+	TG_ring_reserve (ring, frame_size);
+    while (ring->end - ring->start < frame_size)
+    {
+	if ((retval = TG_ring_read (ring)) < 0)
+	    return (-1);
+	if (retval == 0)
+	    TG_wait_readable (ring->fd);
+    }
+
+#ifdef USE_LOG
+    fprintf( logfile, "received tag %d, id %d, size %d (ring)\n",
+		    *tag, *id, *size );
+    fflush( logfile );
+#endif
+
+    if (*size > 0)
+	*buf = ring->data + ring->start + RECV_HEADER_SIZE;
+    ring->last_frame = frame_size;
+
+    info = TG_lookup_socket_info (ring->fd);
+
+#ifdef USE_SHM_TRANSPORT
+    /* The payload itself is waiting in shared memory */
+    if (TG_TAG_FLAGGED (*tag, TG_SHM_TAG_FLAG))
+    {
+	Shm_channel *shm = TG_lookup_shm (ring->fd);
+	Shm_ref ref;
+	unsigned capacity;
+
+	if ((shm == NULL) || (*size != (int)sizeof(ref)))
+	{
+	    TG_error ("TG_ring_nb_recv: bad shared memory message (tag %i, "
+		      "size %i) on fd %i!", *tag, *size, ring->fd);
+	}
+	memcpy (&ref, *buf, sizeof(ref));
+
+	/* The ring is shared, so don't trust the reference blindly */
+	capacity = shm->header->capacity;
+	if ((ref.length > (unsigned)INT_MAX) || (ref.offset > capacity) ||
+	    (ref.length > capacity - ref.offset))
+	{
+	    TG_error ("TG_ring_nb_recv: shared memory payload (offset %u, "
+		      "length %u) outside the %u byte ring on fd %i!",
+		      ref.offset, ref.length, capacity, ring->fd);
+	}
+	if (ref.end - shm->release > capacity)
+	{
+	    TG_error ("TG_ring_nb_recv: shared memory payload ends at %u, "
+		      "more than the ring (%u bytes) past %u on fd %i!",
+		      ref.end, capacity, shm->release, ring->fd);
+	}
+	*tag &= ~TG_SHM_TAG_FLAG;
+	*size = ref.length;
+	*buf = (ref.length > 0) ? shm->data + ref.offset : NULL;
+	shm->release = ref.end;
+	ring->shm_held = shm;
+	if (info != NULL)
+	    info->stats.shm_messages_received++;
+    }
+#endif
+
+    if (TG_TAG_FLAGGED (*tag, TG_COMPRESS_TAG_FLAG))
+	TG_unpack_payload (ring, info, tag, size, buf);
+
+    if (info != NULL)
+    {
+	info->stats.messages_received++;
+	info->stats.bytes_received += *size;
+	info->stats.wire_bytes_received += frame_size;
+	TG_record_message (info, TG_RECORD_RECEIVED, *tag, *id, *size, *buf);
+    }
+    return (1);
+}
+
+#ifdef USE_SHM_TRANSPORT
+/* Returns the shared memory channel for fd, or NULL if it has none */
+static Shm_channel * TG_lookup_shm (int fd)
+{
+    int i;
+
+    for (i = 0; i < NUM_SHM_CHANNELS; i++)
+    {
+	if (shm_channel[i].header != NULL && shm_channel[i].fd == fd)
+	    return (&shm_channel[i]);
+    }
+    return (NULL);
+}
+
+/* Sets up a channel for fd using the mapped ring at header.
+ * Punts if all channel slots are in use.
+ */
+static void TG_shm_add_channel (int fd, int sending, Shm_header *header)
+{
+    int i;
+    Shm_channel *shm;
+
+    for (i = 0; i < NUM_SHM_CHANNELS; i++)
+    {
+	if (shm_channel[i].header == NULL)
+	    break;
+    }
+    if (i == NUM_SHM_CHANNELS)
+	TG_error ("TG_shm_add_channel: ran out of channel slots for fd %i", fd);
+
+    shm = &shm_channel[i];
+    shm->fd = fd;
+    shm->sending = sending;
+    shm->data = (char *)header + SHM_DATA_OFFSET;
+    shm->tail = header->head;
+    shm->release = header->head;
+
+    /* A reader thread may look this up as soon as header is set */
+    TG_MEMORY_BARRIER();
+    shm->header = header;
+}
+
+/* Sender side: copies size bytes of buf into the ring and fills in ref.
+ * Returns 0 (and copies nothing) if the ring doesn't have room.
+ */
+static int TG_shm_put (Shm_channel *shm, const void *buf, int size,
+		       Shm_ref *ref)
+{
+    unsigned capacity = shm->header->capacity;
+    unsigned length = ((unsigned)size + 7) & ~7u;
+    unsigned pos = shm->tail & (capacity - 1);
+    unsigned skip = 0;
+
+    /* Payloads are contiguous, so skip the end of the ring if needed */
+    if (pos + length > capacity)
+	skip = capacity - pos;
+    if (shm->tail + skip + length - shm->header->head > capacity)
+	return (0);
+
+    /* Make sure the receiver is done with the space before reusing it */
+    TG_MEMORY_BARRIER();
+
+    ref->offset = (skip > 0) ? 0 : pos;
+    ref->length = size;
+    memcpy (shm->data + ref->offset, buf, size);
+    shm->tail += skip + length;
+    ref->end = shm->tail;
+
+    /* Payload must be visible before the reference is */
+    TG_MEMORY_BARRIER();
+    return (1);
+}
+
+/* Receiver side: gives back the space of the last payload handed out */
+static void TG_shm_release (Shm_channel *shm)
+{
+    /* Finish with the payload before the sender can overwrite it */
+    TG_MEMORY_BARRIER();
+    shm->header->head = shm->release;
+}
+
+/* Creates and maps a file for the ring, preferring memory-backed
+ * /dev/shm.  Puts its name in path.  Returns NULL on failure.
+ */
+static Shm_header * TG_shm_create (char *path, int path_size)
+{
+    const char *dirs[3];
+    Shm_header *header;
+    struct timeval now;
+    int i, fd = -1;
+    int map_size = SHM_DATA_OFFSET + TG_SHM_RING_SIZE;
+
+    dirs[0] = "/dev/shm";
+    dirs[1] = getenv ("TMPDIR");
+    dirs[2] = "/tmp";
+    for (i = 0; (i < 3) && (fd < 0); i++)
+    {
+	if (dirs[i] == NULL)
+	    continue;
+	snprintf (path, path_size, "%s/tgshm.XXXXXX", dirs[i]);
+	fd = mkstemp (path);
+    }
+    if (fd < 0)
+	return (NULL);
+
+    if (ftruncate (fd, map_size) != 0)
+    {
+	close (fd);
+	unlink (path);
+	return (NULL);
+    }
+    header = (Shm_header *)mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, fd, 0);
+    close (fd);
+    if (header == (Shm_header *)MAP_FAILED)
+    {
+	unlink (path);
+	return (NULL);
+    }
+
+    gettimeofday (&now, NULL);
+    header->magic = TG_SHM_MAGIC;
+    header->cookie = (unsigned)now.tv_usec * 2654435761u ^
+	(unsigned)now.tv_sec ^ ((unsigned)getpid () << 16);
+    header->capacity = TG_SHM_RING_SIZE;
+    header->head = 0;
+    return (header);
+}
+
+/* Maps the ring described by offer ("path\nhost\ncookie") if it is on
+ * this host.  Returns the header, or NULL if it can't be used.
+ */
+static Shm_header * TG_shm_attach (char *offer)
+{
+    char host[256];
+    char *offer_host, *offer_cookie;
+    struct stat info;
+    Shm_header *header;
+    int fd;
+
+    if (((offer_host = strchr (offer, '\n')) == NULL) ||
+	((offer_cookie = strchr (offer_host + 1, '\n')) == NULL))
+	return (NULL);
+    *offer_host++ = 0;
+    *offer_cookie++ = 0;
+
+    /* Don't trust a file of the same name on a shared file system */
+    if ((gethostname (host, sizeof(host)) != 0) ||
+	(strncmp (host, offer_host, sizeof(host)) != 0))
+	return (NULL);
+
+    if ((fd = open (offer, O_RDWR)) < 0)
+	return (NULL);
+    if ((fstat (fd, &info) != 0) ||
+	(info.st_size != SHM_DATA_OFFSET + TG_SHM_RING_SIZE))
+    {
+	close (fd);
+	return (NULL);
+    }
+    header = (Shm_header *)mmap (NULL, info.st_size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, fd, 0);
+    close (fd);
+    if (header == (Shm_header *)MAP_FAILED)
+	return (NULL);
+
+    if ((header->magic != TG_SHM_MAGIC) ||
+	(header->cookie != (unsigned)strtoul (offer_cookie, NULL, 0)) ||
+	(header->capacity != TG_SHM_RING_SIZE))
+    {
+	munmap ((void *)header, info.st_size);
+	return (NULL);
+    }
+    return (header);
+}
+#endif /* USE_SHM_TRANSPORT */
+
+#if defined(USE_WRITE_THREAD) || defined(USE_READ_THREAD)
+#ifndef USE_LOCKED_QUEUE
+/* Writes a byte to a wakeup pipe */
+static void TG_queue_wake (int fd)
+{
+    char c = 0;
+    while ((write (fd, &c, 1) < 0) && (errno == EINTR))
+	;
+}
+
+/* Throws away any wakeups already sitting in a (nonblocking) pipe */
+static void TG_queue_drain (int fd)
+{
+    char junk[64];
+    while (read (fd, junk, sizeof(junk)) > 0)
+	;
+}
+
+/* Producer side: wakes the consumer if it has said it is waiting */
+static void TG_queue_notify_consumer (Socket_thread *st)
+{
+    /* Publish our update before looking at consumer_idle; the consumer
+     * sets consumer_idle before its final look at the queue, so one of
+     * us is guaranteed to see the other.
+     */
+    TG_MEMORY_BARRIER();
+    if (st->consumer_idle)
+    {
+	st->consumer_idle = 0;
+	TG_queue_wake (st->consumer_wake[1]);
+    }
+}
+
+/* Allocates the slots and wakeup pipes for a new queue */
+static void TG_queue_init (Socket_thread *st)
+{
+    int i;
+
+    if ((st->slots = (Queue_slot *)malloc (QUEUE_SLOTS * sizeof(Queue_slot)))
+	== NULL)
+    {
+	TG_error ("TG_queue_init: Out of memory allocating %i queue slots!",
+		  QUEUE_SLOTS);
+    }
+    for (i = 0; i < QUEUE_SLOTS; i++)
+	st->slots[i].buf = NULL;
+
+    st->head = st->tail = st->next = 0;
+    st->viewing = 0;
+    st->consumer_idle = st->producer_idle = 0;
+    st->closed = 0;
+
+    if ((pipe (st->consumer_wake) != 0) || (pipe (st->producer_wake) != 0))
+	TG_errno ("TG_queue_init: unable to create wakeup pipes!");
+
+    /* Read ends are drained without blocking */
+    fcntl (st->consumer_wake[0], F_SETFL, O_NONBLOCK);
+    fcntl (st->producer_wake[0], F_SETFL, O_NONBLOCK);
+}
+
+/* Producer side: copies a message into the queue, waiting for a free
+ * slot if the queue is full.
+ */
+static void TG_queue_put (Socket_thread *st, int tag, int id, int size,
+			  const void *buf)
+{
+    Queue_slot *slot;
+
+    while ((st->tail - st->head) == QUEUE_SLOTS)
+    {
+	/* Tell the consumer we're stuck, then look once more before
+	 * sleeping in case it freed a slot in the meantime.
+	 */
+	TG_queue_drain (st->producer_wake[0]);
+	st->producer_idle = 1;
+	TG_MEMORY_BARRIER();
+	if ((st->tail - st->head) != QUEUE_SLOTS)
+	{
+	    st->producer_idle = 0;
+	    break;
+	}
+	TG_wait_readable (st->producer_wake[0]);
+    }
+
+    slot = &st->slots[st->tail & (QUEUE_SLOTS - 1)];
+    slot->tag = tag;
+    slot->id = id;
+    slot->size = size;
+    if (size == 0)
+    {
+	slot->buf = NULL;
+    }
+    else
+    {
+	if (size <= INLINE_PAYLOAD_SIZE)
+	    slot->buf = slot->inline_data;
+	else if ((slot->buf = (char *)malloc (size)) == NULL)
+	{
+	    TG_error ("TG_queue_put: Out of memory allocating %i bytes!",
+		      size);
+	}
+	memcpy (slot->buf, buf, size);
+    }
+
+    /* Slot contents must be visible before the slot is */
+    TG_MEMORY_BARRIER();
+    st->tail++;
+
+    TG_queue_notify_consumer (st);
+}
+
+#ifdef USE_READ_THREAD
+/* Producer side: marks the queue closed (no more messages will come) */
+static void TG_queue_close (Socket_thread *st)
+{
+    st->closed = 1;
+    TG_queue_notify_consumer (st);
+}
+#endif
+
+/* Consumer side: returns 1 if a message is waiting, -1 if the queue is
+ * closed and empty, or 0 otherwise.  When returning 0, the producer has
+ * been asked to write to consumer_wake[0] as soon as it adds a message.
+ */
+static int TG_queue_state (Socket_thread *st)
+{
+    if (st->next != st->tail)
+	return (1);
+
+    /* Ask to be woken up, then look once more in case a message arrived
+     * in the meantime.  Wakeups left over from earlier races are thrown
+     * away first, so a caller waiting on consumer_wake[0] in an event
+     * loop is not woken over and over for nothing.
+     */
+    TG_queue_drain (st->consumer_wake[0]);
+    st->consumer_idle = 1;
+    TG_MEMORY_BARRIER();
+    if (st->next != st->tail)
+    {
+	st->consumer_idle = 0;
+	return (1);
+    }
+
+    if (st->closed)
+    {
+	/* Messages queued before the close still count */
+	TG_MEMORY_BARRIER();
+	return ((st->next != st->tail) ? 1 : -1);
+    }
+    return (0);
+}
+
+/* Consumer side: blocks until a message is waiting or the queue closes */
+static void TG_queue_wait (Socket_thread *st)
+{
+    while (TG_queue_state (st) == 0)
+	TG_wait_readable (st->consumer_wake[0]);
+}
+
+/* Consumer side: hands out the next message (TG_queue_state must have
+ * returned 1).  If copy is nonzero, *buf belongs to the caller, who must
+ * free it.  Otherwise *buf points into the queue and stays valid until
+ * TG_queue_release is called.
+ */
+static void TG_queue_get (Socket_thread *st, int *tag, int *id, int *size,
+			  char **buf, int copy)
+{
+    Queue_slot *slot;
+
+    /* Don't read the slot before we have seen tail move past it */
+    TG_MEMORY_BARRIER();
+    slot = &st->slots[st->next & (QUEUE_SLOTS - 1)];
+    *tag = slot->tag;
+    *id = slot->id;
+    *size = slot->size;
+    st->next++;
+
+    if (!copy || (slot->buf == NULL))
+    {
+	*buf = slot->buf;
+	if (!copy)
+	    st->viewing = 1;
+	else if (!st->viewing)
+	    TG_queue_release (st);
+	return;
+    }
+
+    /* Hand over malloc'd payloads as is; copy out inline ones */
+    if (slot->buf != slot->inline_data)
+    {
+	*buf = slot->buf;
+	slot->buf = NULL;
+    }
+    else
+    {
+	if ((*buf = (char *)malloc (slot->size)) == NULL)
+	{
+	    TG_error ("TG_queue_get: Out of memory allocating %i bytes!",
+		      slot->size);
+	}
+	memcpy (*buf, slot->inline_data, slot->size);
+    }
+
+    /* Slots can't be given back while an earlier one is being viewed */
+    if (!st->viewing)
+	TG_queue_release (st);
+}
+
+/* Consumer side: gives every handed-out slot back to the producer */
+static void TG_queue_release (Socket_thread *st)
+{
+    unsigned h = st->head;
+
+    while (h != st->next)
+    {
+	Queue_slot *slot = &st->slots[h & (QUEUE_SLOTS - 1)];
+	if ((slot->buf != NULL) && (slot->buf != slot->inline_data))
+	    free (slot->buf);
+	slot->buf = NULL;
+	h++;
+    }
+    st->viewing = 0;
+
+    /* Finish with the slots before the producer may reuse them */
+    TG_MEMORY_BARRIER();
+    st->head = h;
+
+    TG_MEMORY_BARRIER();
+    if (st->producer_idle)
+    {
+	st->producer_idle = 0;
+	TG_queue_wake (st->producer_wake[1]);
+    }
+}
+
+#ifdef USE_READ_THREAD
+/* Consumer side: number of messages not yet handed out */
+static int TG_queue_depth (Socket_thread *st)
+{
+    return ((int)(st->tail - st->next));
+}
+
+/* Consumer side: descriptor that becomes readable when a message is
+ * queued after TG_queue_state has reported the queue empty.
+ */
+static int TG_queue_notify_fd (Socket_thread *st)
+{
+    return (st->consumer_wake[0]);
+}
+#endif
+
+#else /* USE_LOCKED_QUEUE */
+
+static void TG_queue_init (Socket_thread *st)
+{
+    int rc;
+
+    st->head = st->tail = st->viewed = NULL;
+    st->count = 0;
+    st->closed = 0;
+
+    if ((rc = pthread_cond_init (&(st->cond), NULL)) != 0)
+	TG_error ("TG_queue_init: pthread_cond_init returned %d", rc);
+    if ((rc = pthread_mutex_init (&(st->lock), NULL)) != 0)
+	TG_error ("TG_queue_init: pthread_mutex_init returned %d", rc);
+}
+
+static void TG_queue_put (Socket_thread *st, int tag, int id, int size,
+			  const void *buf)
+{
+    Queue_entry * entry;
+
+    /* Create a new queue entry and put it on the end of the queue */
+    entry = (Queue_entry *)malloc( sizeof(Queue_entry) );
+    if( entry == NULL ) {
+	    TG_error( "TG_queue_put: malloc failed for new queue entry" );
+    }
+
+    if( size > 0 ) {
+	    entry->buf = (void *)malloc(size);
+	    if( entry->buf == NULL ) {
+		    TG_error( "TG_queue_put: malloc failed for buffer of "
+				    "size %d", size );
+	    }
+	    memcpy( entry->buf, buf, size );
+    } else {
+	    entry->buf = NULL;
+    }
+
+    entry->tag = tag;
+    entry->id = id;
+    entry->size = size;
+    entry->next = NULL;
+
+    pthread_mutex_lock( &(st->lock) );
+    if( st->tail != NULL )
+	    st->tail->next = entry;
+    st->tail = entry;
+    if( st->head == NULL )
+	    st->head = entry;
+    st->count++;
+    pthread_mutex_unlock( &(st->lock) );
+    pthread_cond_signal( &(st->cond) );
+}
+
+#ifdef USE_READ_THREAD
+static void TG_queue_close (Socket_thread *st)
+{
+    pthread_mutex_lock( &(st->lock) );
+    st->closed = 1;
+    pthread_mutex_unlock( &(st->lock) );
+    pthread_cond_broadcast( &(st->cond) );
+}
+#endif
+
+static int TG_queue_state (Socket_thread *st)
+{
+    int state;
+
+    pthread_mutex_lock( &(st->lock) );
+    if( st->head != NULL )
+	    state = 1;
+    else
+	    state = st->closed ? -1 : 0;
+    pthread_mutex_unlock( &(st->lock) );
+
+    return state;
+}
+
+static void TG_queue_wait (Socket_thread *st)
+{
+    pthread_mutex_lock( &(st->lock) );
+    while( st->head == NULL && !st->closed ) {
+	    pthread_cond_wait( &(st->cond), &(st->lock) );
+    }
+    pthread_mutex_unlock( &(st->lock) );
+}
+
+static void TG_queue_get (Socket_thread *st, int *tag, int *id, int *size,
+			  char **buf, int copy)
+{
+    Queue_entry * entry;
+
+    pthread_mutex_lock( &(st->lock) );
+    entry = st->head;
+    st->head = entry->next;
+    if( entry->next == NULL ) st->tail = NULL;
+    st->count--;
+    pthread_mutex_unlock( &(st->lock) );
 
-	    buf_left += size_read;
-	    size_left -= size_read;
-	}
+    *tag = entry->tag;
+    *id = entry->id;
+    *size = entry->size;
+    *buf = (char *)entry->buf;
+
+    /* Keep viewed entries around until they are released */
+    if( copy ) {
+	    free( entry );
+    } else {
+	    entry->next = st->viewed;
+	    st->viewed = entry;
     }
-    return (1);
 }
 
+static void TG_queue_release (Socket_thread *st)
+{
+    Queue_entry * entry, * next;
+
+    for( entry = st->viewed; entry != NULL; entry = next ) {
+	    next = entry->next;
+	    if( entry->buf != NULL )
+		    free( entry->buf );
+	    free( entry );
+    }
+    st->viewed = NULL;
+}
+
+#ifdef USE_READ_THREAD
+static int TG_queue_depth (Socket_thread *st)
+{
+    int depth;
+
+    pthread_mutex_lock( &(st->lock) );
+    depth = st->count;
+    pthread_mutex_unlock( &(st->lock) );
+
+    return depth;
+}
+
+/* Waiting is done on a condition variable, so there is nothing to
+ * select() on.
+ */
+static int TG_queue_notify_fd (Socket_thread *st)
+{
+    st = st;	/* avoid compiler warnings */
+    return -1;
+}
+#endif
+#endif /* USE_LOCKED_QUEUE */
+#endif /* USE_WRITE_THREAD || USE_READ_THREAD */
+
 /* Writes tag, id, size, and then size bytes of buf to
  * the non-blocking socket fd (opened with IT_open_sockets).  
  * Punts on error.  
@@ -332,10 +1715,16 @@ void TG_send (int fd, int tag, int id, int size, const void *buf)
 {
 #ifdef USE_WRITE_THREAD
     int i;
-    Queue_entry * entry;
 #else
     int header[3];
+    struct iovec iov[2];
+#endif
+#ifdef USE_SHM_TRANSPORT
+    Shm_channel *shm;
+    Shm_ref ref;
 #endif
+    Socket_info *info = TG_lookup_socket_info (fd);
+    int packed;
 
     /* Sanity check, size must be >= 0 */
     if (size < 0)
@@ -343,6 +1732,46 @@ void TG_send (int fd, int tag, int id, int size, const void *buf)
 	TG_error ("TG_send: size (%i) < 0!", size);
     }
 
+    if (info != NULL)
+    {
+	info->stats.messages_sent++;
+	info->stats.bytes_sent += size;
+	TG_record_message (info, TG_RECORD_SENT, tag, id, size, buf);
+    }
+
+    /* Only tags without internal flags can be sent another way */
+    if ((tag >= 0) && !(tag & TG_INTERNAL_TAG_FLAGS))
+    {
+#ifdef USE_SHM_TRANSPORT
+	/* Send just a reference to large payloads if they fit in fd's
+	 * shared memory ring
+	 */
+	if ((size >= TG_SHM_MIN_SIZE) &&
+	    ((shm = TG_lookup_shm (fd)) != NULL) && shm->sending &&
+	    TG_shm_put (shm, buf, size, &ref))
+	{
+	    tag |= TG_SHM_TAG_FLAG;
+	    buf = &ref;
+	    size = sizeof(ref);
+	    if (info != NULL)
+		info->stats.shm_messages_sent++;
+	}
+#endif
+
+	/* Compress large payloads, if that was agreed on */
+	if ((size >= TG_COMPRESS_MIN_SIZE) && (info != NULL) &&
+	    (info->options & TG_OPTION_COMPRESS) &&
+	    ((packed = TG_pack_payload (info, buf, size)) > 0))
+	{
+	    tag |= TG_COMPRESS_TAG_FLAG;
+	    buf = info->pack_buf;
+	    size = packed;
+	}
+    }
+
+    if (info != NULL)
+	info->stats.wire_bytes_sent += RECV_HEADER_SIZE + size;
+
 #ifndef USE_WRITE_THREAD
 
 	/* Fill header with tag, id, and size */
@@ -373,14 +1802,12 @@ void TG_send (int fd, int tag, int id, int size, const void *buf)
 	fflush(logfile);
 #endif
 	
-	/* Write header out */
-	TG_internal_write (fd, (char *)header, sizeof(header));
-
-	/* Only write buffer, if size is > 0 */
-	if (size > 0) {
-	    /* Write buffer out */
-	    TG_internal_write (fd, (char *)buf, size);
-	}
+	/* Write header and buffer out together */
+	iov[0].iov_base = (char *)header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = (char *)buf;
+	iov[1].iov_len = size;
+	TG_internal_writev (fd, iov, (size > 0) ? 2 : 1);
 #else
     /* Determine which thread data corresponds to the requested fd */
     for( i = 0; i < NUM_WRITE_THREADS; i++ ) {
@@ -402,36 +1829,10 @@ void TG_send (int fd, int tag, int id, int size, const void *buf)
 	    TG_error( "TG_send: unknown socket (%d)", fd );
     }
 
-    /* Create a new queue entry and put it on the end of the queue */
-    entry = (Queue_entry *)malloc( sizeof(Queue_entry) );
-    if( entry == NULL ) {
-	    TG_error( "TG_send: malloc failed for new queue entry" );
-    }
-
-    if( size > 0 ) {
-	    entry->buf = (void *)malloc(size);
-	    if( entry->buf == NULL ) {
-		    TG_error( "TG_send: malloc failed for buffer of size %d",
-				    size );
-	    }
-	    memcpy( entry->buf, buf, size );
-    } else {
-	    entry->buf = NULL;
-    }
-
-    entry->tag = tag;
-    entry->id = id;
-    entry->size = size;
-    entry->next = NULL;
-
-    /* Put this new entry in the queue of messages to send. */
-    pthread_mutex_lock( &(write_socket_thread[i].lock) );
-    if( write_socket_thread[i].tail != NULL )
-	    write_socket_thread[i].tail->next = entry;
-    write_socket_thread[i].tail = entry;
-    if( write_socket_thread[i].head == NULL )
-	    write_socket_thread[i].head = entry;
-    pthread_mutex_unlock( &(write_socket_thread[i].lock) );
+    /* Put the message in the queue of messages to send; the writer
+     * thread is woken up if it is waiting.
+     */
+    TG_queue_put( &(write_socket_thread[i]), tag, id, size, buf );
 #endif
 
 }
@@ -454,6 +1855,7 @@ int TG_nb_recv (int fd, int *tag, int *id, int *size, void **buf)
 #endif
 }
 
+#ifndef USE_READ_THREAD
 /* Reads tag, id, size, and then size bytes of buf from
  * the non-blocking socket fd.
  * If no data is available, returns 0 .
@@ -465,6 +1867,34 @@ int TG_internal_nb_recv (int fd, int *tag, int *id, int *size, void **buf)
 {
     int header[3];
     int retval;
+    Recv_ring *ring;
+
+    /* If this socket is being read through a ring, the next message may
+     * already be buffered there, so frame it from the ring and hand the
+     * caller its own copy.
+     */
+    if ((ring = TG_lookup_recv_ring (fd, 0)) != NULL)
+    {
+	char *view;
+
+	/* Don't pull a viewed message out from under its caller */
+	if (ring->viewing)
+	    TG_ring_keep_view (ring);
+	if ((retval = TG_ring_nb_recv (ring, tag, id, size, &view)) != 1)
+	    return (retval);
+	if (*size == 0)
+	{
+	    *buf = NULL;
+	    return (1);
+	}
+	if ((*buf = (void *)malloc (*size)) == NULL)
+	{
+	    TG_error ("TG_internal_nb_recv: Out of memory allocating %i bytes!",
+			   *size);
+	}
+	memcpy (*buf, view, *size);
+	return (1);
+    }
 
     /* Read header, return 0 is no message waiting */
     if ( (retval = TG_internal_read (fd, (char *)header, sizeof(header))) == 0)
@@ -529,6 +1959,8 @@ int TG_internal_nb_recv (int fd, int *tag, int *id, int *size, void **buf)
     return (1);
 }
 
+#endif /* !USE_READ_THREAD */
+
 /* Blocking version of TG_nb_recv, will only return when data is ready.
  * Returns -1 socket closed or an error occurred.  Otherwise returns > 0.
  */
@@ -536,157 +1968,158 @@ int TG_recv (int fd, int *tag, int *id, int *size, void **buf)
 {
 
 #ifndef USE_READ_THREAD
-	fd_set readfds;
-	int ready;
-	do {
-		FD_ZERO( &readfds );
-		FD_SET( fd, &readfds );
-		ready = select( fd + 1, &readfds, NULL, NULL, NULL );
-		/* restart if select was interrupted */
-	} while( ready < 0 && errno == EINTR );
+	/* A message may already be sitting in the receive ring */
+	if( !TG_ring_pending( TG_lookup_recv_ring( fd, 0 ) ) )
+		TG_wait_readable( fd );
 
 	return TG_nb_recv( fd, tag, id, size, buf );
 
 #else /* USE_READ_THREAD */
 
-    /* Figure out which thread is handling this file descriptor */
-    int i;
-    Socket_thread * queue_info;
-    Queue_entry * entry;
-
-    for( i = 0; i < NUM_READ_THREADS; i++ ) {
-	    if( fd == read_socket_thread[i].fd ) break;
-
-	    /* If not found yet, initialize this location 
-	     * (assumes slots in array are always filled in
-	     * order, so threads should never be removed)
-	     */
-	    if( read_socket_thread[i].fd == 0 ) {
-		    TG_init_read_thread( fd );
-		    break;
-	    }
-    }
-
-    if( i == NUM_READ_THREADS ) {
-	    TG_error( "Couldn't find or allocate a thread for fd %d\n", fd );
-    }
-    
-    queue_info = &(read_socket_thread[i]);
-    
-    /* Acquire the lock and look at the queue for data */
-    pthread_mutex_lock( &(queue_info->lock) );
-    if( socket_closed ) {
-	    	/* If the socket is already closed, give up and return */
-		pthread_mutex_unlock( &(queue_info->lock) );
-		return -1;
-    }
+    Socket_thread * queue_info = TG_get_read_thread( fd );
 
-    /* Block until the reader thread signals that data is ready */
-    while( queue_info->head == NULL ) {
-	    pthread_cond_wait( &(queue_info->cond), &(queue_info->lock) );
+    /* Block until the reader thread queues data (or the socket closes) */
+    TG_queue_wait( queue_info );
+    if( TG_queue_state( queue_info ) < 0 ) {
+	    *tag = 0;
+	    *id = 0;
+	    *size = 0;
+	    *buf = NULL;
+	    return -1;
     }
 
-    /* Get the data off the queue */
-    entry = queue_info->head;
-    *tag = entry->tag;
-    *id = entry->id;
-    *size = entry->size;
-    *buf = entry->buf;
+    TG_queue_get( queue_info, tag, id, size, (char **)buf, 1 );
 #ifdef DEBUG_QUEUE
     fprintf( stderr, "Reading tag %d id %d size %d\n\n", *tag, *id, *size );
 #endif
 
-    /* Remove the queue entry */
-    queue_info->head = entry->next;
-    if( entry->next == NULL ) queue_info->tail = NULL;
-    free( entry );
-
-    pthread_mutex_unlock( &(queue_info->lock) );
-
     return 1;
 #endif /* USE_READ_THREAD */
 
 }
 
-void TG_flush( int fd )
+/* Zero-copy version of TG_nb_recv.  Same return values, but *buf points
+ * at storage owned by the socket library that stays valid only until the
+ * next TG_nb_recv_view or TG_recv_view call on fd (TG_recv and TG_nb_recv
+ * calls in between leave it alone).  The caller must not free it (but
+ * may modify it in place).
+ */
+int TG_nb_recv_view (int fd, int *tag, int *id, int *size, char **buf)
 {
-#ifdef USE_WRITE_THREAD
-    int i;
+#ifdef USE_READ_THREAD
+	int retval = 0;
+	Socket_thread * queue_info = TG_find_read_thread( fd );
 
-    for( i = 0; i < NUM_THREADS; i++ ) {
-	    if( fd == write_socket_thread[i].fd ) break;
-    }
+	if( queue_info != NULL ) {
+		/* The caller is done with the previous message */
+		TG_queue_release( queue_info );
+		retval = TG_queue_state( queue_info );
+	}
 
-    if( i == NUM_THREADS ) {
-	    TG_error( "TG_send: unknown socket (%d)", fd );
-    }
+	if( retval > 0 ) {
+		TG_queue_get( queue_info, tag, id, size, buf, 0 );
+	} else {
+		*tag = 0;
+		*id = 0;
+		*size = 0;
+		*buf = NULL;
+	}
+	return retval;
+#else
+	Recv_ring * ring = TG_lookup_recv_ring( fd, 1 );
+	int retval;
+
+	/* The caller is done with the previous message */
+	TG_ring_drop_held( ring );
+	retval = TG_ring_nb_recv( ring, tag, id, size, buf );
+	ring->viewing = (retval == 1);
+	return retval;
+#endif
+}
+
+/* Blocking version of TG_nb_recv_view; will only return when a message
+ * has arrived or the socket has closed.
+ */
+int TG_recv_view (int fd, int *tag, int *id, int *size, char **buf)
+{
+#ifdef USE_READ_THREAD
+	Socket_thread * queue_info = TG_get_read_thread( fd );
+
+	/* The caller is done with the previous message */
+	TG_queue_release( queue_info );
+
+	TG_queue_wait( queue_info );
+	if( TG_queue_state( queue_info ) < 0 ) {
+		*tag = 0;
+		*id = 0;
+		*size = 0;
+		*buf = NULL;
+		return -1;
+	}
 
-    /* Wake up the writer thread and tell it to clear the queue */
-    pthread_cond_signal( &(write_socket_thread[i].cond) );
+	TG_queue_get( queue_info, tag, id, size, buf, 0 );
+	return 1;
 #else
-    fd = fd;	/* avoid compiler warnings */
+	Recv_ring * ring = TG_lookup_recv_ring( fd, 1 );
+	int retval;
+
+	/* The caller is done with the previous message */
+	TG_ring_drop_held( ring );
+	while( (retval = TG_ring_nb_recv( ring, tag, id, size, buf )) == 0 )
+		TG_wait_readable( fd );
+	ring->viewing = (retval == 1);
+	return retval;
 #endif
 }
 
+void TG_flush( int fd )
+{
+    /* With threaded writing, the writer thread is woken up as soon as
+     * data is queued, so there is nothing left to do here.
+     */
+    fd = fd;	/* avoid compiler warnings */
+}
+
 #ifdef USE_WRITE_THREAD
 void * TG_write_queue_handler(void * thread_data)
 {
     Socket_thread * socket_handler = thread_data;
-    Queue_entry * local_head, * item, * next;
-    int header[3];
+    int header[WRITE_BATCH][3];
+    struct iovec iov[2 * WRITE_BATCH];
+    int count;
+    int tag, id, size;
+    char * buf;
 
     while( !forever ) {
-	/* Get the lock that controls the queue */
-	pthread_mutex_lock( &(socket_handler->lock) );
-
-	/* Wait for some data to appear in the queue; we must hold
-	 * the lock whenever we examine the queue.  The first time
-	 * through, the lock statement above guarantees this.  On
-	 * later iterations, pthread_cond_wait acquires the lock.
-	 */
-	while( socket_handler->head == NULL ) {
-		pthread_cond_wait( &(socket_handler->cond),
-				&(socket_handler->lock) );
-	}
+	/* Wait for some data to appear in the queue */
+	TG_queue_wait( socket_handler );
 
-	/* Transfer the queue to local control and release the
-	 * lock so that the other thread can continue adding
-	 * data to it.
+	/* Send everything that has been queued (up to WRITE_BATCH
+	 * messages) with one writev, then give the slots back.
 	 */
-	local_head = socket_handler->head;
-	socket_handler->head = socket_handler->tail = NULL;
-
-	pthread_mutex_unlock( &(socket_handler->lock) );
-
-	for( item = local_head; item != NULL; item = next ) {
+	count = 0;
+	while( count < WRITE_BATCH && TG_queue_state( socket_handler ) > 0 ) {
+		TG_queue_get( socket_handler, &tag, &id, &size, &buf, 0 );
 
 		/* Fill header with tag, id, and size */
 		if( tg_need_swap ) {
-			header[0] = SWAP_BYTES(item->tag);
-			header[1] = SWAP_BYTES(item->id);
-			header[2] = SWAP_BYTES(item->size);
+			header[count][0] = SWAP_BYTES(tag);
+			header[count][1] = SWAP_BYTES(id);
+			header[count][2] = SWAP_BYTES(size);
 		} else {
-			header[0] = item->tag;
-			header[1] = item->id;
-			header[2] = item->size;
+			header[count][0] = tag;
+			header[count][1] = id;
+			header[count][2] = size;
 		}
-
-		/* Write header out */
-		TG_internal_write (socket_handler->fd, (char *)header,
-				sizeof(header));
-
-		/* Only write buffer, if size is > 0 */
-		if (item->size > 0) {
-		    /* Write buffer out */
-		    TG_internal_write (socket_handler->fd, (char *)(item->buf),
-				    item->size);
-		}
-
-		if( item->buf != NULL )
-			free( item->buf );
-		next = item->next;
-		free( item );
+		iov[2 * count].iov_base = (char *)header[count];
+		iov[2 * count].iov_len = sizeof(header[count]);
+		iov[2 * count + 1].iov_base = buf;
+		iov[2 * count + 1].iov_len = size;
+		count++;
 	}
+
+	TG_internal_writev( socket_handler->fd, iov, 2 * count );
+	TG_queue_release( socket_handler );
     }
 
     return NULL;
@@ -697,68 +2130,53 @@ void * TG_write_queue_handler(void * thread_data)
 void * TG_read_queue_handler(void * thread_data)
 {
     Socket_thread * socket_handler = thread_data;
-    Queue_entry * item;
+    Recv_ring * ring;
     int tag, id, size;
-    void * buf;
+    char * buf;
+    int retval;
 #ifdef DEBUG_QUEUE
     int i;
 #endif
 
+    /* This thread owns the socket, so it can always read it through
+     * a ring: one read() typically brings in many messages, which are
+     * copied straight from the ring into the queue.
+     */
+    ring = TG_lookup_recv_ring( socket_handler->fd, 1 );
+
     while( !forever ) {
-	    /* Read data from the incoming socket until a complete
-	     * message arrives.
+	    /* Frame the next message, waiting on the socket only when
+	     * nothing is left in the ring.
 	     */ 
-	    fd_set readfd;
-	    do {
-		    int ready;
-		    FD_ZERO( &readfd );
-		    FD_SET( socket_handler->fd, &readfd );
-		    ready = select( socket_handler->fd + 1,
-				    &readfd, NULL, NULL, NULL );
-		    if( ready < 1 ) {
-			    fprintf( stderr, "select returned %d; "
-					    "errno is %d\n", ready, errno );
-		    }
-	    } while( TG_internal_nb_recv( socket_handler->fd,
-				    &tag, &id, &size, &buf ) != 1 );
-
-	    /* Put the new message in the incoming message queue */
-	    item = (Queue_entry *)malloc( sizeof(Queue_entry) );
-	    item->tag = tag;
-	    item->id = id;
-	    item->size = size;
-	    item->buf = buf;
-	    item->next = NULL;
+	    while( (retval = TG_ring_nb_recv( ring, &tag, &id, &size,
+				    &buf )) == 0 ) {
+		    TG_wait_readable( socket_handler->fd );
+	    }
+
+	    /* Let the consumer know the socket is gone rather than
+	     * spinning on a closed descriptor.
+	     */
+	    if( retval < 0 ) {
+		    TG_queue_close( socket_handler );
+		    break;
+	    }
+
 #ifdef DEBUG_QUEUE
 	    fprintf( stderr, "Queue adding tag %d id %d size %d\n",
 			    tag, id, size);
 	    for( i = 0; i < size; i++ ) {
-		    if(isprint(((char*)buf)[i]))
-			    putc( ((char*)buf)[i], stderr );
+		    if(isprint(buf[i]))
+			    putc( buf[i], stderr );
 		    else
-			    fprintf(stderr, "<%x>", ((char*)buf)[i]);
+			    fprintf(stderr, "<%x>", buf[i]);
             }
 	    putc( '\n', stderr );
 #endif
 
-	    pthread_mutex_lock( &(socket_handler->lock) );
-	    if( socket_handler->tail != NULL )
-		    socket_handler->tail->next = item;
-	    socket_handler->tail = item;
-	    if( socket_handler->head == NULL ) {
-		    socket_handler->head = item;
-	    }
-#ifdef DEBUG_QUEUE
-	    for( item = socket_handler->head; item != NULL;
-			    item = item->next ) {
-		    fprintf( stderr, "tag %d id %d size %d\n",
-				    item->tag, item->id, item->size );
-	    }
-	    putc( '\n', stderr );
-#endif
-	    pthread_mutex_unlock( &(socket_handler->lock) );
-	    pthread_cond_signal( &(socket_handler->cond ) );
-	    
+	    /* Put the new message in the incoming message queue
+	     * (waits if the consumer has fallen too far behind)
+	     */
+	    TG_queue_put( socket_handler, tag, id, size, buf );
     }
 
     return NULL;
@@ -769,24 +2187,38 @@ void * TG_read_queue_handler(void * thread_data)
  */
 int TG_read_data_queued( int fd )
 {
-    int i;
-    int data_ready;
+    Socket_thread * queue_info = TG_find_read_thread( fd );
 
-    for( i = 0; i < NUM_READ_THREADS; i++ ) {
-	    if( fd == read_socket_thread[i].fd ) break;
-    }
+    if( queue_info == NULL ) return 0;
+
+    return TG_queue_state( queue_info );
+}
 
-    if( i == NUM_READ_THREADS ) return 0;
+/* Returns the number of messages waiting in the queue for fd */
+int TG_read_queue_depth( int fd )
+{
+    Socket_thread * queue_info = TG_find_read_thread( fd );
 
-    pthread_mutex_lock( &(read_socket_thread[i].lock) );
-    data_ready = (read_socket_thread[i].head != NULL);
-    if( !data_ready && socket_closed ) data_ready = -1;
-    pthread_mutex_unlock( &(read_socket_thread[i].lock) );
+    if( queue_info == NULL ) return 0;
 
-    return data_ready;
+    return TG_queue_depth( queue_info );
 }
 #endif /* USE_READ_THREAD */
 
+/* Returns a descriptor to watch (e.g., with select()) for incoming data
+ * on fd.  For threaded reads, this is the queue's wakeup pipe, which
+ * is only written after TG_read_data_queued (or TG_nb_recv_view) has
+ * found the queue empty; returns -1 if the queue can't provide one.
+ */
+int TG_recv_notify_fd( int fd )
+{
+#ifdef USE_READ_THREAD
+    return TG_queue_notify_fd( TG_get_read_thread( fd ) );
+#else
+    return fd;
+#endif
+}
+
 /* See if there is anything available to read, without blocking */
 int TG_poll_socket( int fd )
 {
@@ -794,12 +2226,247 @@ int TG_poll_socket( int fd )
     fd_set readfds;
     struct timeval timeout;
 
+    /* Bytes already pulled into the receive ring count as available */
+    if( TG_ring_pending( TG_lookup_recv_ring( fd, 0 ) ) )
+	return 1;
+
     FD_ZERO( &readfds );
     FD_SET( fd, &readfds );
     timeout.tv_sec = timeout.tv_usec = 0;
     ready = select( fd + 1, &readfds, NULL, NULL, &timeout );
     return (ready > 0 );
 }
+
+/* Offers the Client our optional transports (see tg_socket.h).  The
+ * offer goes out even if we have nothing to offer, so the Client always
+ * knows what to expect.  The offer's id holds the TG_OPTION_* flags on
+ * offer, and its body describes the shared memory ring, if any.
+ */
+int TG_offer_options (int fd)
+{
+    char offer[1400];
+    int tag, id, size;
+    void *reply;
+    int offered = 0;
+    int accepted;
+#ifdef USE_SHM_TRANSPORT
+    char path[1024];
+    char host[256];
+    Shm_header *header = NULL;
+#endif
+
+    offer[0] = 0;
+#ifdef USE_SHM_TRANSPORT
+    if ((getenv ("TG_NO_SHARED_MEMORY") == NULL) &&
+	(gethostname (host, sizeof(host)) == 0) &&
+	((header = TG_shm_create (path, sizeof(path))) != NULL))
+    {
+	host[sizeof(host)-1] = 0;
+	sprintf (offer, "%s\n%s\n%u", path, host, header->cookie);
+	offered |= TG_OPTION_SHARED_MEMORY;
+    }
+#endif
+    if (getenv ("TG_NO_COMPRESSION") == NULL)
+	offered |= TG_OPTION_COMPRESS;
+    TG_send (fd, TG_OFFER_TAG, offered, strlen (offer) + 1, offer);
+
+    /* The Client answers before sending anything else */
+    if (TG_recv (fd, &tag, &id, &size, &reply) < 0)
+	return (0);
+    if (tag != TG_REPLY_TAG)
+    {
+	TG_error ("TG_offer_options: expected reply to offer, got tag %i "
+		  "(is the Client from another Tool Gear version?)", tag);
+    }
+    free (reply);
+    accepted = id & offered;
+
+#ifdef USE_SHM_TRANSPORT
+    if (header != NULL)
+    {
+	/* Both ends have it mapped by now, if they are going to */
+	unlink (path);
+	if (accepted & TG_OPTION_SHARED_MEMORY)
+	    TG_shm_add_channel (fd, 1, header);
+	else
+	    munmap ((void *)header, SHM_DATA_OFFSET + TG_SHM_RING_SIZE);
+    }
+#endif
+#ifndef USE_READ_THREAD
+    /* Flagged messages are only understood by the ring */
+    TG_lookup_recv_ring (fd, 1);
+#endif
+    TG_add_socket_info (fd, accepted);
+    TG_record_from_env (fd, TG_RECORD_COLLECTOR);
+    return (accepted);
+}
+
+/* Ends the view of fd's first message taken by TG_accept_options.  If
+ * again is nonzero, the message is left to be received again.  Only
+ * works before anything else has been received on fd.
+ */
+static void TG_end_first_view (int fd, int again)
+{
+#ifdef USE_READ_THREAD
+    Socket_thread *st = TG_find_read_thread (fd);
+
+    if (again)
+	st->next--;
+    TG_queue_release (st);
+#else
+    Recv_ring *ring = TG_lookup_recv_ring (fd, 0);
+
+    if (again)
+	ring->last_frame = 0;
+    ring->viewing = 0;
+#endif
+}
+
+/* Answers the Collector's TG_offer_options (see tg_socket.h).  Shared
+ * memory is taken whenever possible; compression only if it isn't,
+ * since there is no point compressing for a local copy.  A Collector
+ * from before the offer existed just starts sending, so its first
+ * message is left for the caller and no options are used.
+ */
+int TG_accept_options (int fd)
+{
+    int tag, id, size;
+    char *offer;
+    int accepted = 0;
+
+    if (TG_recv_view (fd, &tag, &id, &size, &offer) < 0)
+	return (0);
+    if (tag != TG_OFFER_TAG)
+    {
+	TG_end_first_view (fd, 1);
+	TG_add_socket_info (fd, 0);
+	TG_record_from_env (fd, TG_RECORD_CLIENT);
+	return (0);
+    }
+
+#ifdef USE_SHM_TRANSPORT
+    if ((id & TG_OPTION_SHARED_MEMORY) && (size > 1) &&
+	(getenv ("TG_NO_SHARED_MEMORY") == NULL))
+    {
+	Shm_header *header = TG_shm_attach (offer);
+	if (header != NULL)
+	{
+	    TG_shm_add_channel (fd, 0, header);
+	    accepted |= TG_OPTION_SHARED_MEMORY;
+	}
+    }
+#endif
+    TG_end_first_view (fd, 0);
+
+    if ((id & TG_OPTION_COMPRESS) && !(accepted & TG_OPTION_SHARED_MEMORY) &&
+	(getenv ("TG_NO_COMPRESSION") == NULL))
+	accepted |= TG_OPTION_COMPRESS;
+
+#ifndef USE_READ_THREAD
+    /* Flagged messages are only understood by the ring */
+    TG_lookup_recv_ring (fd, 1);
+#endif
+    /* Must be in place before the Collector hears back and starts
+     * sending flagged messages
+     */
+    TG_add_socket_info (fd, accepted);
+    TG_send (fd, TG_REPLY_TAG, accepted, 0, NULL);
+    TG_record_from_env (fd, TG_RECORD_CLIENT);
+    return (accepted);
+}
+
+/* Starts capturing fd's messages in path (see tg_socket.h) */
+int TG_record_socket (int fd, const char *path, int role)
+{
+    Socket_info *info = TG_lookup_socket_info (fd);
+    TG_record_header header;
+    FILE *record;
+
+    if ((info == NULL) || (info->record != NULL))
+	return (0);
+    if ((record = fopen (path, "w")) == NULL)
+	return (0);
+    /* Big writes, since snippets can arrive by the thousands */
+    setvbuf (record, NULL, _IOFBF, 1024*1024);
+
+    header.magic = TG_RECORD_MAGIC;
+    header.version = TG_RECORD_VERSION;
+    header.role = role;
+    header.options = info->options;
+    if (fwrite (&header, sizeof(header), 1, record) != 1)
+    {
+	fclose (record);
+	return (0);
+    }
+
+    info->record_start = TG_socket_clock ();
+    /* A reader thread may start recording as soon as this is set */
+#ifdef TG_MEMORY_BARRIER
+    TG_MEMORY_BARRIER();
+#endif
+    info->record = record;
+    return (1);
+}
+
+/* Stops capturing fd's messages and closes the capture (see tg_socket.h) */
+void TG_stop_recording (int fd)
+{
+    Socket_info *info = TG_lookup_socket_info (fd);
+    FILE *record;
+
+    if ((info == NULL) || (info->record == NULL))
+	return;
+    record = info->record;
+    info->record = NULL;
+    fclose (record);
+}
+
+/* Copies fd's traffic counts into stats (see tg_socket.h) */
+int TG_get_socket_stats (int fd, TG_socket_stats *stats)
+{
+    Socket_info *info = TG_lookup_socket_info (fd);
+
+    if (info == NULL)
+    {
+	memset (stats, 0, sizeof(*stats));
+	return (0);
+    }
+    *stats = info->stats;
+    return (1);
+}
+
+/* Prints fd's traffic counts to stderr (see tg_socket.h) */
+void TG_report_socket_stats (int fd, const char *label)
+{
+    TG_socket_stats stats;
+
+    if (!TG_get_socket_stats (fd, &stats))
+	return;
+
+    fprintf (stderr, "%s: sent %ld messages (%.0f KB, %.0f KB on the wire, "
+	     "%ld through shared memory)\n", label, stats.messages_sent,
+	     stats.bytes_sent / 1024.0, stats.wire_bytes_sent / 1024.0,
+	     stats.shm_messages_sent);
+    if ((stats.compressed_sent > 0) || (stats.compress_skipped > 0))
+    {
+	fprintf (stderr, "%s: compressed %ld messages, %.0f KB -> %.0f KB "
+		 "(ratio %.2f), %ld left as is, %.3f sec\n", label,
+		 stats.compressed_sent, stats.compress_in / 1024.0,
+		 stats.compress_out / 1024.0,
+		 (stats.compress_out > 0) ?
+		 stats.compress_in / stats.compress_out : 1.0,
+		 stats.compress_skipped, stats.compress_time);
+    }
+    fprintf (stderr, "%s: received %ld messages (%.0f KB, %.0f KB on the "
+	     "wire, %ld through shared memory)\n", label,
+	     stats.messages_received, stats.bytes_received / 1024.0,
+	     stats.wire_bytes_received / 1024.0, stats.shm_messages_received);
+    if (stats.compressed_received > 0)
+    {
+	fprintf (stderr, "%s: decompressed %ld messages, %.3f sec\n", label,
+		 stats.compressed_received, stats.decompress_time);
+    }
+}
 /******************************************************************************
 COPYRIGHT AND LICENSE
 
@@ -15,6 +15,9 @@
  * and data transmissions can take place in the background.
  * Normally, we have been using threaded reading for the Client
  * and no threading for the Collector.
+ * The threads hand messages to and from the rest of the process through
+ * lock-free single-producer/single-consumer queues (or, if compiled with
+ * USE_LOCKED_QUEUE, mutex-protected lists).
  *
  * Created by John C. Gyllenhaal, 4/21/00 
  * Modified by John May
@@ -50,9 +53,25 @@ extern void TG_send (int fd, int tag, int id, int size, const void *buf);
  */
 extern int TG_recv (int fd, int *tag, int *id, int *size, void **buf);
 
-/*! For threaded writing, this function tells the write thread to
- * wake up and send the queued data.  For nonthreaded writing, this
- * function does nothing.
+/*! Zero-copy version of TG_nb_recv.  Messages are framed in place from
+ * a per-socket receive buffer that is filled with large reads, so 
+ * *buf points into memory owned by the socket library rather than a
+ * malloc'd copy.  The payload is only valid until the next
+ * TG_nb_recv_view or TG_recv_view call on the same fd, and must NOT
+ * be freed by the caller (it may be modified in place).  TG_recv and
+ * TG_nb_recv calls on the fd in the meantime (e.g., from a handler that
+ * re-enters the event loop) leave it alone.
+ * Returns the same values as TG_nb_recv.
+ */
+extern int TG_nb_recv_view (int fd, int *tag, int *id, int *size, char **buf);
+
+/*! Blocking version of TG_nb_recv_view; will only return when a message
+ * has arrived (returns > 0) or the socket has closed (returns -1).
+ */
+extern int TG_recv_view (int fd, int *tag, int *id, int *size, char **buf);
+
+/*! Kept for compatibility; does nothing.  For threaded writing, the
+ * write thread is woken up as soon as data is queued by TG_send.
  */
 extern void TG_flush(int fd);
 
@@ -68,10 +87,141 @@ extern int TG_nb_recv (int fd, int *tag, int *id, int *size, void **buf);
  */
 extern int TG_read_data_queued( int fd );
 
+/*! For threaded reads, returns the number of messages waiting in the
+ * input queue.  UNDEFINED for nonthreaded reads, like TG_read_data_queued.
+ */
+extern int TG_read_queue_depth( int fd );
+
+/*! Returns a file descriptor that becomes readable when messages arrive
+ * on fd, so callers can wait in select() or an event loop instead of
+ * polling.  For nonthreaded reads, this is fd itself.  For threaded
+ * reads, it is a wakeup pipe that is only signaled after
+ * TG_read_data_queued has reported the queue empty (so drain the queue
+ * until it does, then wait).  Returns -1 if no such descriptor exists
+ * (threaded reads built with USE_LOCKED_QUEUE).
+ */
+extern int TG_recv_notify_fd( int fd );
+
 /*! Determine whether data is wating to be read, without blocking or
  * reading any data.  Returns nonzero if data is available.
  */
 extern int TG_poll_socket( int fd );
+
+/*! Options that TG_offer_options and TG_accept_options can turn on */
+#define TG_OPTION_SHARED_MEMORY	0x1
+#define TG_OPTION_COMPRESS	0x2
+
+/*! Negotiates optional transports with the Client.  Called by the
+ * Collector right after connecting (before any other message is sent
+ * or received on fd); the Client must call TG_accept_options at the
+ * same point.  The options are:
+ *
+ * TG_OPTION_SHARED_MEMORY: if both ends are on the same host, the
+ * Collector's large messages (several KB or more) are copied through a
+ * shared memory ring, and only a short reference to them goes through
+ * fd, which still carries everything else.  Setting TG_NO_SHARED_MEMORY
+ * in the environment turns it down.
+ *
+ * TG_OPTION_COMPRESS: otherwise, messages of 1 KB or more are
+ * compressed (in both directions) when that makes them smaller, which
+ * helps a lot when the connection is tunneled through ssh.  Setting
+ * TG_NO_COMPRESSION in the environment turns it down.
+ *
+ * Nothing changes for callers of TG_send and TG_recv.  Returns the
+ * TG_OPTION_* flags that will be used.
+ */
+extern int TG_offer_options (int fd);
+
+/*! Client side of TG_offer_options: waits for the Collector's offer on
+ * fd, decides what to use, and tells the Collector.  Returns the
+ * TG_OPTION_* flags that will be used.  If the first message isn't an
+ * offer (the Collector predates TG_offer_options), no options are used
+ * and that message is left for the next receive on fd.
+ */
+extern int TG_accept_options (int fd);
+
+/*! Traffic counts for a connection set up with TG_offer_options or
+ * TG_accept_options.  Byte counts are kept as doubles so they don't
+ * wrap on long runs.
+ */
+typedef struct {
+	long	messages_sent;
+	long	messages_received;
+	double	bytes_sent;		/* payload bytes, before compression */
+	double	bytes_received;		/* payload bytes, after decompression */
+	double	wire_bytes_sent;	/* bytes written to fd, headers too */
+	double	wire_bytes_received;	/* bytes read from fd, headers too */
+	long	shm_messages_sent;	/* payload went through shared memory */
+	long	shm_messages_received;
+	long	compressed_sent;	/* messages sent compressed */
+	long	compress_skipped;	/* tried, but they didn't shrink */
+	double	compress_in;		/* bytes of compressed_sent, before */
+	double	compress_out;		/* bytes of compressed_sent, after */
+	double	compress_time;		/* seconds spent compressing */
+	long	compressed_received;
+	double	decompress_time;	/* seconds spent decompressing */
+} TG_socket_stats;
+
+/*! Copies the counts for fd into stats.  Returns 1, or 0 (and zeroes
+ * stats) if fd's traffic isn't being counted.  Counts are updated
+ * without locking, so with threaded sockets they may lag slightly.
+ */
+extern int TG_get_socket_stats (int fd, TG_socket_stats *stats);
+
+/*! Prints fd's counts, including compression ratio and time, to
+ * stderr with label in front.  Prints nothing if fd isn't counted.
+ */
+extern void TG_report_socket_stats (int fd, const char *label);
+
+/*! Capture files written by TG_record_socket start with a
+ * TG_record_header, followed by a TG_record_entry for each message
+ * (in the order sent or received), each followed by size bytes of
+ * payload.  Everything is in the recording host's byte order; a
+ * reader on another host will find magic swapped.  Messages are
+ * recorded as callers of TG_send and TG_recv see them (i.e., before
+ * compression or after decompression).
+ */
+#define TG_RECORD_MAGIC		0x54475243	/* "TGRC" */
+#define TG_RECORD_VERSION	1
+
+/*! Which end of the connection wrote the capture */
+#define TG_RECORD_COLLECTOR	0
+#define TG_RECORD_CLIENT	1
+
+/*! Which way a recorded message went */
+#define TG_RECORD_SENT		0
+#define TG_RECORD_RECEIVED	1
+
+typedef struct {
+	int	magic;		/* TG_RECORD_MAGIC */
+	int	version;	/* TG_RECORD_VERSION */
+	int	role;		/* TG_RECORD_COLLECTOR or TG_RECORD_CLIENT */
+	int	options;	/* TG_OPTION_* in use on the connection */
+} TG_record_header;
+
+typedef struct {
+	int	sec;		/* time since recording started */
+	int	usec;
+	int	direction;	/* TG_RECORD_SENT or TG_RECORD_RECEIVED */
+	int	tag;
+	int	id;
+	int	size;		/* bytes of payload that follow */
+} TG_record_entry;
+
+/*! Starts capturing every message sent or received on fd (which must
+ * have been set up with TG_offer_options or TG_accept_options) in the
+ * file path; role is TG_RECORD_COLLECTOR or TG_RECORD_CLIENT.  Returns
+ * 1, or 0 if the file can't be written or fd is already being
+ * recorded.  Setting TG_RECORD=<prefix> in the environment records the
+ * connection automatically, to <prefix>.client and <prefix>.collector.
+ * The capture is completed when the process exits.
+ */
+extern int TG_record_socket (int fd, const char *path, int role);
+
+/*! Finishes fd's capture early.  With threaded reads, only call this
+ * once nothing more will arrive on fd.
+ */
+extern void TG_stop_recording (int fd);
 #ifdef __cplusplus
            }
 #endif
@@ -11,25 +11,62 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include "command_tags.h"
 #include "tg_source_reader.h"
+#include "lineparser.h"
+#include "messagebuffer.h"
 
 #define SOURCE_PATH_FILE "SourcePath"
 #define DEFAULT_SOURCE_PATH "."
 #define STRING_HEADER_LEN 12
 #define STRING_POINTER_LEN 10
 
+// Files bigger than this are sent by line range (see read_file)
+#define DEFAULT_SOURCE_WINDOW_BYTES (8 * 1024 * 1024)
+// Lines between the offsets kept in a LineIndex
+#define SOURCE_INDEX_INTERVAL 1024
+// Bytes read at a time while indexing
+#define SOURCE_INDEX_BLOCK (256 * 1024)
+
 TGSourceReader:: TGSourceReader( int s, int (*continue_search_cb)(void) )
-	: sourcePath( NULL ), sock( s ), continue_cb( continue_search_cb )
+	: lineIndexes( NULL ), sourcePath( NULL ), sock( s ),
+	continue_cb( continue_search_cb )
 { }
 
 TGSourceReader:: ~TGSourceReader()
 {
 	if( sourcePath )
 		delete sourcePath;
+
+	while( lineIndexes ) {
+		LineIndex * next = lineIndexes->next;
+		free( lineIndexes->path );
+		free( lineIndexes->offsets );
+		delete lineIndexes;
+		lineIndexes = next;
+	}
+}
+
+// Returns the size above which read_file sends a file's line count
+// instead of its text, or 0 if every file should be sent whole
+static off_t source_window_bytes( void )
+{
+	static off_t windowBytes = -1;
+
+	if( windowBytes < 0 ) {
+		char * env = getenv( "TG_SOURCE_WINDOW_BYTES" );
+		windowBytes = DEFAULT_SOURCE_WINDOW_BYTES;
+		if( env != NULL && *env != 0 ) {
+			long long value = atoll( env );
+			windowBytes = ( value > 0 ) ? (off_t) value : 0;
+		}
+	}
+
+	return windowBytes;
 }
 
 void TGSourceReader:: read_file( char * buf, int id )
@@ -57,7 +94,26 @@ void TGSourceReader:: read_file( char * buf, int id )
 	// Should be successful, since filename has be validated
 	stat( fullPath, &fileinfo );
 	
-	if( fileinfo.st_size <= 0 ) {
+	off_t windowBytes = source_window_bytes();
+	if( windowBytes > 0 && fileinfo.st_size > windowBytes ) {
+		// Too big to send whole (and for the Client to hold);
+		// send the line count and let the Client ask for the
+		// lines it shows.
+		LineIndex * index = find_line_index( fullPath );
+		if( index == NULL ) {
+			TG_send( sock, DB_FILE_READ_COMPLETE, id,
+					1, "" );
+			TG_flush( sock );
+			fprintf( stderr, "Failed to read %s\n", fullPath );
+			return;
+		}
+
+		char countbuf[STRING_HEADER_LEN + STRING_POINTER_LEN];
+		int length = TG_pack( countbuf, sizeof( countbuf ), "I",
+				index->lineCount );
+		TG_send( sock, DB_FILE_LINE_COUNT, id, length, countbuf );
+		TG_flush( sock );
+	} else if( fileinfo.st_size <= 0 ) {
 		TG_send( sock, DB_FILE_READ_COMPLETE, id,
 				1, "" );
 		TG_flush( sock );
@@ -94,6 +150,125 @@ void TGSourceReader:: read_file( char * buf, int id )
 	}
 }
 
+void TGSourceReader:: read_file_lines( char * buf, int id )
+{
+	char * fullPath;
+	int first, count;
+	TG_unpack( buf, "SII", &fullPath, &first, &count );
+
+	MessageBuffer lines;
+	LineIndex * index = find_line_index( fullPath );
+	FILE * in;
+	if( index == NULL || first < 1 || count <= 0
+			|| first > index->lineCount
+			|| (in = fopen( fullPath, "r" )) == NULL ) {
+		// Client shows nothing for these lines
+		TG_send( sock, DB_FILE_LINES, id, 1, "" );
+		TG_flush( sock );
+		return;
+	}
+
+	// Seek to the nearest indexed line and skip to the first one
+	int checkpoint = (first - 1) / SOURCE_INDEX_INTERVAL;
+	int lineNo = checkpoint * SOURCE_INDEX_INTERVAL + 1;
+	fseeko( in, index->offsets[checkpoint], SEEK_SET );
+
+	LineParser parser( in, TRUE );
+	const char * line;
+	while( lineNo < first + count
+			&& (line = parser.getNextLine()) != NULL ) {
+		if( lineNo >= first )
+			lines.appendBytes( line, parser.lineLength() );
+		++lineNo;
+	}
+
+	// Client expects \0 termination
+	TG_send( sock, DB_FILE_LINES, id, lines.strlen() + 1,
+			(char *) lines.contents() );
+	TG_flush( sock );
+}
+
+TGSourceReader::LineIndex * TGSourceReader:: find_line_index(
+		const char * fullPath )
+{
+	struct stat fileinfo;
+	if( stat( fullPath, &fileinfo ) < 0 )
+		return NULL;
+
+	// Reuse the index if the file hasn't changed since it was built
+	LineIndex ** prev = &lineIndexes;
+	for( LineIndex * index = lineIndexes; index != NULL;
+			index = index->next ) {
+		if( strcmp( index->path, fullPath ) == 0 ) {
+			if( index->size == fileinfo.st_size
+					&& index->mtime == fileinfo.st_mtime )
+				return index;
+			*prev = index->next;
+			free( index->path );
+			free( index->offsets );
+			delete index;
+			break;
+		}
+		prev = &index->next;
+	}
+
+	int fd = open( fullPath, O_RDONLY );
+	if( fd < 0 )
+		return NULL;
+
+	char * block = new char[SOURCE_INDEX_BLOCK];
+	int maxOffsets = 64;
+	LineIndex * index = new LineIndex;
+	index->path = strdup( fullPath );
+	index->size = fileinfo.st_size;
+	index->mtime = fileinfo.st_mtime;
+	index->lineCount = 0;
+	index->numOffsets = 0;
+	index->offsets = (off_t *) malloc( maxOffsets * sizeof( off_t ) );
+	TG_checkAlloc( index->offsets );
+
+	// Note where every SOURCE_INDEX_INTERVAL'th line starts.  The
+	// last line counts even if it has no newline.
+	off_t blockStart = 0;
+	bool atLineStart = TRUE;
+	ssize_t got;
+	while( (got = read( fd, block, SOURCE_INDEX_BLOCK )) > 0 ) {
+		char * end = block + got;
+		char * p = block;
+		while( p < end ) {
+			if( atLineStart ) {
+				if( index->lineCount % SOURCE_INDEX_INTERVAL
+						== 0 ) {
+					if( index->numOffsets == maxOffsets ) {
+						maxOffsets *= 2;
+						index->offsets = (off_t *)
+							realloc( index->offsets,
+							maxOffsets *
+							sizeof( off_t ) );
+						TG_checkAlloc( index->offsets );
+					}
+					index->offsets[index->numOffsets++] =
+						blockStart + (p - block);
+				}
+				++index->lineCount;
+				atLineStart = FALSE;
+			}
+			char * newline = (char *) memchr( p, '\n', end - p );
+			if( newline == NULL )
+				break;
+			p = newline + 1;
+			atLineStart = TRUE;
+		}
+		blockStart += got;
+	}
+	close( fd );
+	delete [] block;
+
+	index->next = lineIndexes;
+	lineIndexes = index;
+	return index;
+}
+
 void TGSourceReader:: report_search_path( char * buf )
 {
 	char * path_string;
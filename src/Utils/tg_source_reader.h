@@ -36,9 +36,16 @@ public:
 
 	//! Looks a source file and returns its contents, using either an
 	//! absolute path name or a search path specified by the Client or
-	//! in a SourcePath file
+	//! in a SourcePath file.  Files bigger than TG_SOURCE_WINDOW_BYTES (an
+	//! environment variable; 8 MB by default, 0 for no limit) are
+	//! not sent whole; the Client gets their line count and asks
+	//! for the lines it shows with read_file_lines.
 	void read_file( char * buf, int id );
 
+	//! Returns a range of lines (full path, first line, count) from
+	//! a file that read_file reported by line count.
+	void read_file_lines( char * buf, int id );
+
 	//! Handles a request to get the subdirectories of a named 
 	//! directory and returns the result to the Client.
 	void unpack_get_subdirs( char * buf );
@@ -68,6 +75,26 @@ protected:
 	void set_source_path_from_file(void);
 
 private:
+	//! Where every SOURCE_INDEX_INTERVAL'th line of a big file
+	//! starts, so read_file_lines can seek close to any line.
+	//! Kept for each file read this way, and rebuilt if the file
+	//! changes.
+	struct LineIndex {
+		char * path;
+		off_t size;
+		time_t mtime;
+		int lineCount;
+		int numOffsets;
+		off_t * offsets;
+		LineIndex * next;
+	};
+
+	//! Returns the index for fullPath, building it if necessary,
+	//! or NULL if the file can't be read
+	LineIndex * find_line_index( const char * fullPath );
+
+	LineIndex * lineIndexes;
+
 	//! Called by findFile (without a socket name); we relay
 	//! the call to the callback passed to the ctor, and add
 	//! the socket.  Also, handle the case where the user gave
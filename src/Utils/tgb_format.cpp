@@ -0,0 +1,559 @@
+//! \file tgb_format.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+/*
+ * Writing and reading Tool Gear's binary document format (.tgb).
+ * See tgb_format.h for the layout.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "tgb_format.h"
+#include "tg_error.h"
+
+// Records are written out in sections of about this size, which is
+// also about how much TGxmlserver sends the Client at once
+#define TGB_SECTION_SIZE (64*1024)
+
+// Text longer than this is always written in place
+#define TGB_MAX_INTERN_LENGTH 64
+
+// Stop tracking new strings that have only been seen once after this
+// many, so a file full of unique text doesn't fill up memory
+#define TGB_MAX_TRACKED_STRINGS (1024*1024)
+
+// Read .tgb files in at least this size blocks
+#define TGB_READ_SIZE (256*1024)
+
+void TGB_appendVarint (MessageBuffer &buf, unsigned long long value)
+{
+    while (value >= 0x80)
+    {
+	buf.appendChar ((char) ((value & 0x7f) | 0x80));
+	value >>= 7;
+    }
+    buf.appendChar ((char) value);
+}
+
+bool TGB_readVarint (const char *&pos, const char *end,
+		     unsigned long long &value)
+{
+    value = 0;
+    for (int shift = 0; (pos < end) && (shift < 64); shift += 7)
+    {
+	unsigned char byte = (unsigned char) *pos++;
+	value |= ((unsigned long long) (byte & 0x7f)) << shift;
+	if ((byte & 0x80) == 0)
+	    return (TRUE);
+    }
+    return (FALSE);
+}
+
+bool TGB_isTGBFile (int fd, const char *fileName)
+{
+    // pread() leaves the file position alone, so whoever reads the
+    // file next still starts at the beginning
+    char magic[TGB_MAGIC_LENGTH];
+    int got = pread (fd, magic, TGB_MAGIC_LENGTH, 0);
+    if (got == TGB_MAGIC_LENGTH)
+	return (memcmp (magic, TGB_MAGIC, TGB_MAGIC_LENGTH) == 0);
+
+    // A pipe, or a file that hasn't been written yet
+    int len = strlen (fileName);
+    return ((len > 4) && (strcmp (fileName + len - 4, ".tgb") == 0));
+}
+
+TGBWriter::TGBWriter (FILE *out_) :
+    out (out_),
+    newStringCount (0),
+    stringIds ("tgbStrings", DeleteData, 0),
+    stringCount (0),
+    trackedCount (0),
+    statusSet (FALSE),
+    statusWritten (FALSE),
+    writeError (FALSE)
+{
+    if (fwrite (TGB_MAGIC, 1, TGB_MAGIC_LENGTH, out) != TGB_MAGIC_LENGTH)
+	writeError = TRUE;
+
+    MessageBuffer header;
+    TGB_appendVarint (header, TGB_VERSION);
+    writeSection (TGB_SECTION_HEADER, header.contents(), header.strlen());
+}
+
+TGBWriter::~TGBWriter ()
+{
+}
+
+void TGBWriter::writeSection (int type, const char *data, int size)
+{
+    MessageBuffer prefix;
+    prefix.appendChar ((char) type);
+    TGB_appendVarint (prefix, size);
+    if ((fwrite (prefix.contents(), 1, prefix.strlen(), out) !=
+	 (size_t) prefix.strlen()) ||
+	((size > 0) && (fwrite (data, 1, size, out) != (size_t) size)))
+	writeError = TRUE;
+}
+
+void TGBWriter::flushSections ()
+{
+    if (statusSet && !statusWritten)
+    {
+	writeSection (TGB_SECTION_STATUS, NULL, 0);
+	statusWritten = TRUE;
+    }
+
+    // The strings must be in the table before the records that use them
+    if (newStringCount > 0)
+    {
+	MessageBuffer strings;
+	TGB_appendVarint (strings, newStringCount);
+	strings.appendBytes (newStrings.contents(), newStrings.strlen());
+	writeSection (TGB_SECTION_STRINGS, strings.contents(),
+		      strings.strlen());
+	newStrings.clear();
+	newStringCount = 0;
+    }
+
+    if (records.strlen() > 0)
+    {
+	writeSection (TGB_SECTION_RECORDS, records.contents(),
+		      records.strlen());
+	records.clear();
+    }
+}
+
+// Returns str's id in the string table, or -1 if it isn't in it (yet).
+// Unless always is TRUE, a string goes in the table the second time
+// it is seen, so strings that only appear once are just written in place.
+int TGBWriter::intern (const char *str, int len, bool always)
+{
+    // The table needs a terminated key
+    key.clear();
+    key.appendBytes (str, len);
+
+    int *id = stringIds.findEntry (key.contents());
+    if ((id == NULL) && !always)
+    {
+	if (trackedCount < TGB_MAX_TRACKED_STRINGS)
+	{
+	    stringIds.addEntry (key.contents(), new int (-1));
+	    trackedCount++;
+	}
+	return (-1);
+    }
+
+    if (id == NULL)
+    {
+	id = new int (-1);
+	stringIds.addEntry (key.contents(), id);
+	trackedCount++;
+    }
+
+    if (*id < 0)
+    {
+	*id = stringCount++;
+	TGB_appendVarint (newStrings, len);
+	newStrings.appendBytes (str, len);
+	newStringCount++;
+    }
+    return (*id);
+}
+
+void TGBWriter::beginSnippet (int lineOffset)
+{
+    // Only break sections between snippets, so TGxmlserver can send
+    // a section as is
+    if (records.strlen() >= TGB_SECTION_SIZE)
+	flushSections ();
+
+    records.appendChar (TGB_OP_SNIPPET);
+    TGB_appendVarint (records, lineOffset);
+}
+
+void TGBWriter::startElement (const char *name, int len)
+{
+    int id = intern (name, len, TRUE);
+    records.appendChar (TGB_OP_START);
+    TGB_appendVarint (records, id);
+}
+
+void TGBWriter::endElement ()
+{
+    records.appendChar (TGB_OP_END);
+}
+
+void TGBWriter::text (const char *text, int len)
+{
+    if (len <= 0)
+	return;
+
+    // Numbers are stored as numbers only if printing them back gives
+    // exactly the same text (so no leading zeros, '+' signs, etc.)
+    char number[32];
+    char *numberEnd;
+    if ((len < 24) && (((text[0] >= '0') && (text[0] <= '9')) ||
+		       (text[0] == '-') || (text[0] == '.')))
+    {
+	memcpy (number, text, len);
+	number[len] = 0;
+	char printed[32];
+
+	errno = 0;
+	long long intValue = strtoll (number, &numberEnd, 10);
+	if ((*numberEnd == 0) && (errno == 0) &&
+	    (sprintf (printed, "%lld", intValue) == len) &&
+	    (memcmp (printed, text, len) == 0))
+	{
+	    // Zigzag encode, so -1 is 1, 1 is 2, etc.
+	    unsigned long long zigzag = (intValue < 0) ?
+		((~(unsigned long long) intValue) << 1) | 1 :
+		((unsigned long long) intValue) << 1;
+	    records.appendChar (TGB_OP_INT);
+	    TGB_appendVarint (records, zigzag);
+	    return;
+	}
+
+	double doubleValue = strtod (number, &numberEnd);
+	if (*numberEnd == 0)
+	{
+	    for (int precision = 1; precision <= 17; precision++)
+	    {
+		if ((sprintf (printed, "%.*g", precision, doubleValue) == len)
+		    && (memcmp (printed, text, len) == 0))
+		{
+		    unsigned long long bits;
+		    memcpy (&bits, &doubleValue, sizeof (bits));
+		    records.appendChar (TGB_OP_DOUBLE);
+		    TGB_appendVarint (records, precision);
+		    for (int i = 0; i < 8; i++)
+		    {
+			records.appendChar ((char) (bits & 0xff));
+			bits >>= 8;
+		    }
+		    return;
+		}
+	    }
+	}
+    }
+
+    // Short text (element values, the white space between elements)
+    // tends to repeat; message bodies and other long text does not
+    if ((len <= TGB_MAX_INTERN_LENGTH) && (memchr (text, 0, len) == NULL))
+    {
+	int id = intern (text, len, FALSE);
+	if (id >= 0)
+	{
+	    records.appendChar (TGB_OP_STRING);
+	    TGB_appendVarint (records, id);
+	    return;
+	}
+    }
+
+    records.appendChar (TGB_OP_TEXT);
+    TGB_appendVarint (records, len);
+    records.appendBytes (text, len);
+}
+
+bool TGBWriter::finish (bool documentEnd)
+{
+    flushSections ();
+    if (documentEnd)
+	writeSection (TGB_SECTION_END, NULL, 0);
+    if (fflush (out) != 0)
+	writeError = TRUE;
+    return (!writeError && !ferror (out));
+}
+
+TGBSectionReader::TGBSectionReader (FILE *in, const char *fileName_) :
+    fd (fileno (in)),
+    bufSize (TGB_READ_SIZE),
+    pos (0),
+    end (0),
+    headerRead (FALSE),
+    documentEnd (FALSE),
+    statusSet (FALSE),
+    stringCount (0),
+    firstString (0)
+{
+    fileName = strdup (fileName_);
+    if ((buf = (char *) malloc (bufSize)) == NULL)
+	TG_error ("Out of memory allocating %i bytes\n", bufSize);
+}
+
+TGBSectionReader::~TGBSectionReader ()
+{
+    free (buf);
+    free (fileName);
+}
+
+void TGBSectionReader::restart ()
+{
+    pos = 0;
+    end = 0;
+    headerRead = FALSE;
+    documentEnd = FALSE;
+    stringCount = 0;
+}
+
+// Reads more of the file after what is in buf, growing buf if the
+// section being read doesn't fit.  Returns FALSE if nothing more was read.
+bool TGBSectionReader::fill ()
+{
+    if (pos > 0)
+    {
+	memmove (buf, buf + pos, end - pos);
+	end -= pos;
+	pos = 0;
+    }
+
+    if (bufSize - end < TGB_READ_SIZE)
+    {
+	bufSize = (bufSize * 2) + TGB_READ_SIZE;
+	if ((buf = (char *) realloc (buf, bufSize)) == NULL)
+	    TG_error ("Out of memory allocating %i bytes\n", bufSize);
+    }
+
+    int got;
+    do
+    {
+	got = read (fd, buf + end, bufSize - end);
+    } while ((got < 0) && (errno == EINTR));
+
+    if (got <= 0)
+	return (FALSE);
+    end += got;
+    return (TRUE);
+}
+
+bool TGBSectionReader::getNextSection (int &type, const char *&data,
+				       int &size)
+{
+    while (!documentEnd)
+    {
+	if (!headerRead && (end - pos < TGB_MAGIC_LENGTH))
+	{
+	    if (!fill ())
+		return (FALSE);
+	    continue;
+	}
+
+	if (!headerRead && (memcmp (buf + pos, TGB_MAGIC,
+				    TGB_MAGIC_LENGTH) != 0))
+	{
+	    TG_error ("'%s' is not a Tool Gear binary (.tgb) file!\n",
+		      fileName);
+	}
+
+	// Is a whole section (after the magic number, the first time)
+	// in buf?
+	const char *scan = buf + pos + (headerRead ? 0 : TGB_MAGIC_LENGTH);
+	const char *stop = buf + end;
+	unsigned long long length;
+	int sectionType = -1;
+	if (scan < stop)
+	    sectionType = (unsigned char) *scan++;
+	if ((sectionType < 0) || !TGB_readVarint (scan, stop, length) ||
+	    ((unsigned long long) (stop - scan) < length))
+	{
+	    if (!fill ())
+		return (FALSE);
+	    continue;
+	}
+
+	data = scan;
+	size = (int) length;
+	pos = (scan + length) - buf;
+
+	if (!headerRead)
+	{
+	    unsigned long long version = 0;
+	    const char *versionPos = data;
+	    if ((sectionType != TGB_SECTION_HEADER) ||
+		!TGB_readVarint (versionPos, data + size, version))
+	    {
+		TG_error ("'%s' does not start with a .tgb header!\n",
+			  fileName);
+	    }
+	    if (version > TGB_VERSION)
+	    {
+		TG_error ("'%s' is .tgb version %llu, but only version %i "
+			  "and before can be read.\nPlease update Tool Gear "
+			  "or convert the XML file again.\n", fileName,
+			  version, TGB_VERSION);
+	    }
+	    headerRead = TRUE;
+	    continue;
+	}
+
+	switch (sectionType)
+	{
+	  case TGB_SECTION_STRINGS:
+	    {
+		unsigned long long count = 0;
+		const char *countPos = data;
+		TGB_readVarint (countPos, data + size, count);
+		firstString = stringCount;
+		stringCount += (int) count;
+	    }
+	    type = sectionType;
+	    return (TRUE);
+
+	  case TGB_SECTION_RECORDS:
+	    type = sectionType;
+	    return (TRUE);
+
+	  case TGB_SECTION_END:
+	    documentEnd = TRUE;
+	    break;
+
+	  case TGB_SECTION_STATUS:
+	    statusSet = TRUE;
+	    break;
+
+	  default:
+	    // Skip sections from newer versions that don't change
+	    // the meaning of the ones read here
+	    break;
+	}
+    }
+    return (FALSE);
+}
+
+bool TGBRecordReader::next ()
+{
+    if (pos >= end)
+	return (FALSE);
+
+    op_ = (unsigned char) *pos++;
+    switch (op_)
+    {
+      case TGB_OP_END:
+	return (TRUE);
+
+      case TGB_OP_SNIPPET:
+      case TGB_OP_START:
+      case TGB_OP_STRING:
+	if (TGB_readVarint (pos, end, value_))
+	    return (TRUE);
+	break;
+
+      case TGB_OP_TEXT:
+	if (TGB_readVarint (pos, end, value_) &&
+	    (value_ <= (unsigned long long) (end - pos)))
+	{
+	    text_ = pos;
+	    textLength_ = (int) value_;
+	    pos += textLength_;
+	    return (TRUE);
+	}
+	break;
+
+      case TGB_OP_INT:
+	if (TGB_readVarint (pos, end, value_))
+	{
+	    intValue_ = (value_ & 1) ? (long long) ~(value_ >> 1) :
+		(long long) (value_ >> 1);
+	    return (TRUE);
+	}
+	break;
+
+      case TGB_OP_DOUBLE:
+	if (TGB_readVarint (pos, end, value_) && (end - pos >= 8))
+	{
+	    precision_ = (int) value_;
+	    unsigned long long bits = 0;
+	    for (int i = 7; i >= 0; i--)
+		bits = (bits << 8) | (unsigned char) pos[i];
+	    memcpy (&doubleValue_, &bits, sizeof (bits));
+	    pos += 8;
+	    return (TRUE);
+	}
+	break;
+
+      default:
+	break;
+    }
+
+    // Corrupt or unknown record
+    failed_ = TRUE;
+    pos = end;
+    return (FALSE);
+}
+
+int TGBRecordReader::formatNumber (char *buf)
+{
+    if (op_ == TGB_OP_INT)
+	return (sprintf (buf, "%lld", intValue_));
+    else
+	return (sprintf (buf, "%.*g", precision_, doubleValue_));
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -0,0 +1,291 @@
+//! \file tgb_format.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Tool Gear's binary document format (.tgb).  tgxml2tgb converts a Tool
+// Gear XML file to it once.  After that, TGxmlserver sends the file to
+// the Client in large pieces, and the Client replays them straight into
+// its XML handler without scanning or parsing any XML text.
+//
+// A .tgb file is TGB_MAGIC followed by sections.  Each section is a type
+// byte, then the length of its contents (a varint, see below), then the
+// contents:
+//   TGB_SECTION_HEADER   The format version; always the first section
+//   TGB_SECTION_STRINGS  A count, then that many strings (each a length
+//                        and that many bytes of UTF-8), added to the
+//                        string table.  Ids count up from 0 through the
+//                        whole file.
+//   TGB_SECTION_RECORDS  Records (below) for one or more whole snippets,
+//                        using only strings already in the table
+//   TGB_SECTION_END      Empty; the XML document ended (</tool_gear>)
+//   TGB_SECTION_STATUS   Empty; the XML sets the status message itself
+//                        (with <status>), so TGxmlserver shouldn't
+//
+// All numbers are unsigned varints (7 bits a byte, low bits first, with
+// the high bit set on every byte but the last), so files are the same
+// on every machine.  Each record is a TGB_OP byte and its operands:
+//   TGB_OP_SNIPPET  lineOffset   Starts a snippet, split just where
+//                                TGxmlserver splits the XML
+//   TGB_OP_START    nameId       An element start, <name>
+//   TGB_OP_END                   The end of the innermost element
+//   TGB_OP_STRING   textId       Text from the string table
+//   TGB_OP_TEXT     length bytes Text in place (e.g., message bodies)
+//   TGB_OP_INT      value        Text that is an integer, printed with
+//                                %lld (zigzag encoded, so small negative
+//                                numbers stay short)
+//   TGB_OP_DOUBLE   precision, 8 bytes of IEEE double (low byte first)
+//                                Text printed with %.*g
+// Only text that prints back exactly as it was written is stored as a
+// number, so replaying a file gives the XML handler exactly the text
+// it would have parsed.
+
+#ifndef TG_TGB_FORMAT_H
+#define TG_TGB_FORMAT_H
+
+#include <stdio.h>
+#include "messagebuffer.h"
+#include "stringtable.h"
+
+//! Every .tgb file starts with these bytes (the '\r\n' and '\032' catch
+//! files mangled by text-mode transfers)
+#define TGB_MAGIC "\211TGB\r\n\032\n"
+#define TGB_MAGIC_LENGTH 8
+
+//! Version written in the header section
+#define TGB_VERSION 1
+
+//! Section types
+enum TGBSection {
+    TGB_SECTION_HEADER = 1,
+    TGB_SECTION_STRINGS,
+    TGB_SECTION_RECORDS,
+    TGB_SECTION_END,
+    TGB_SECTION_STATUS
+};
+
+//! Record ops in TGB_SECTION_RECORDS
+enum TGBOp {
+    TGB_OP_SNIPPET = 1,
+    TGB_OP_START,
+    TGB_OP_END,
+    TGB_OP_STRING,
+    TGB_OP_TEXT,
+    TGB_OP_INT,
+    TGB_OP_DOUBLE
+};
+
+//! Appends value to buf as a varint
+void TGB_appendVarint (MessageBuffer &buf, unsigned long long value);
+
+//! Reads a varint at pos (which must be before end) into value and
+//! advances pos past it.  Returns FALSE if the varint runs past end.
+bool TGB_readVarint (const char *&pos, const char *end,
+		     unsigned long long &value);
+
+//! Returns TRUE if fd starts with TGB_MAGIC.  If fd can't be read without
+//! disturbing it (e.g., a pipe), goes by whether fileName ends in ".tgb".
+bool TGB_isTGBFile (int fd, const char *fileName);
+
+//! Writes a .tgb file, given the snippets of a Tool Gear XML document
+//! and the elements and text in each.  Short strings are put in the
+//! string table the second time they are seen (element names the first
+//! time), and text that prints back exactly as a number is stored as one.
+class TGBWriter
+{
+public:
+    //! Writes the magic number and header section to out
+    TGBWriter (FILE *out);
+    ~TGBWriter ();
+
+    //! Starts a snippet, lineOffset lines into the XML
+    void beginSnippet (int lineOffset);
+    void startElement (const char *name, int len);
+    void endElement ();
+    //! Adds text (already decoded, i.e., no entities) to the element
+    //! being written.  Adjacent text is simply appended by the reader.
+    void text (const char *text, int len);
+
+    //! Notes that the XML sets the status message itself
+    void setsStatus () {statusSet = TRUE;}
+
+    //! Writes everything out, then an end section if documentEnd
+    //! (i.e., </tool_gear> was read).  Returns FALSE if writing failed.
+    bool finish (bool documentEnd);
+
+private:
+    int intern (const char *str, int len, bool always);
+    void flushSections ();
+    void writeSection (int type, const char *data, int size);
+
+    FILE *out;
+    MessageBuffer records;
+    MessageBuffer newStrings;
+    int newStringCount;
+    MessageBuffer key;		// NUL-terminated copy for lookups
+    StringTable<int> stringIds;	// -1 if seen once, else the id
+    int stringCount;		// Ids given out so far
+    int trackedCount;		// Entries in stringIds
+    bool statusSet;
+    bool statusWritten;
+    bool writeError;
+};
+
+//! Reads the sections of a .tgb file a whole section at a time, using
+//! read() in large blocks.  Like SnippetReader, a read that finds nothing
+//! more (end of file for now) is simply retried on the next call, so a
+//! file that is still being written can be followed.
+class TGBSectionReader
+{
+public:
+    //! Reads from in's file descriptor; in must not have been read
+    //! with stdio.  fileName is used in error messages.
+    TGBSectionReader (FILE *in, const char *fileName);
+    ~TGBSectionReader ();
+
+    //! Sets type, data, and size to the next strings or records section
+    //! and returns TRUE, or returns FALSE if no whole section has been
+    //! written yet.  data is good until the next call.  The other
+    //! sections are handled here.
+    bool getNextSection (int &type, const char *&data, int &size);
+
+    //! Returns TRUE once the end section has been read
+    bool atDocumentEnd () {return (documentEnd);}
+
+    //! Returns TRUE once a status section has been read
+    bool setsStatus () {return (statusSet);}
+
+    //! For the strings section just returned, the id of its first
+    //! string (0 again after a restart)
+    int firstStringId () {return (firstString);}
+
+    //! Starts over at the beginning of the file (after it has been
+    //! truncated or replaced)
+    void restart ();
+
+private:
+    bool fill ();
+
+    int fd;
+    char *fileName;
+    char *buf;
+    int bufSize;
+    int pos;			// Start of the next section in buf
+    int end;			// End of the data read into buf
+    bool headerRead;
+    bool documentEnd;
+    bool statusSet;
+    int stringCount;		// Strings in the sections read so far
+    int firstString;
+};
+
+//! Walks through the records in a TGB_SECTION_RECORDS section.
+class TGBRecordReader
+{
+public:
+    TGBRecordReader (const char *data, int size) :
+	pos (data), end (data + size), failed_ (FALSE) {}
+
+    //! Reads the next record into op and its operands.  Returns FALSE
+    //! at the end of the section, or if it is corrupt (see failed()).
+    bool next ();
+
+    //! TRUE if the records stopped because the section is corrupt
+    bool failed () {return (failed_);}
+
+    //! The TGBOp just read
+    int op () {return (op_);}
+    //! The line offset, element name id, or string id
+    unsigned long long value () {return (value_);}
+    //! For TGB_OP_INT, the integer
+    long long intValue () {return (intValue_);}
+    //! For TGB_OP_DOUBLE, the number and the precision to print it with
+    double doubleValue () {return (doubleValue_);}
+    int precision () {return (precision_);}
+    //! For TGB_OP_TEXT, the (unterminated) text
+    const char *text () {return (text_);}
+    int textLength () {return (textLength_);}
+
+    //! For TGB_OP_INT and TGB_OP_DOUBLE, prints the number into buf (at
+    //! least 32 bytes) just as it was written in the XML; returns length
+    int formatNumber (char *buf);
+
+private:
+    const char *pos;
+    const char *end;
+    bool failed_;
+    int op_;
+    unsigned long long value_;
+    long long intValue_;
+    double doubleValue_;
+    int precision_;
+    const char *text_;
+    int textLength_;
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
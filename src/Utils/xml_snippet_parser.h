@@ -0,0 +1,265 @@
+//! \file xml_snippet_parser.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+
+#ifndef TG_XML_SNIPPET_PARSER_H
+#define TG_XML_SNIPPET_PARSER_H
+
+#include <stdio.h>
+#include <string.h>
+#include "messagebuffer.h"
+#include "snippet_reader.h"
+#include "xml_token_table.h"
+
+/* TRUE and FALSE not defined on some systems */
+#ifndef FALSE
+#define FALSE 0
+#define TRUE (!FALSE)
+#endif
+
+// Top-level Tool Gear XML elements XMLSnippetParser looks for
+enum SnippetTag {
+    ST_TOOL_GEAR = 0, ST_MESSAGE, ST_SITE_DATA, ST_MESSAGE_FOLDER,
+    ST_SITE_PRIORITY, ST_TOOL_TITLE, ST_SITE_COLUMN, ST_ABOUT, ST_STATUS
+};
+static const char * const snippetTagNames[] = {
+    "tool_gear", "message", "site_data", "message_folder",
+    "site_priority", "tool_title", "site_column", "about", "status"
+};
+
+//! Class for incrementally grabbing coherient Tool Gear XML snippets from
+//! a file without using seek (no rewinding file).   Used by TGxmlserver
+//! to send the XML a snippet at a time, and by tgxml2tgb so the snippets
+//! in a .tgb file are split in just the same places.
+class XMLSnippetParser
+{
+public:
+    XMLSnippetParser (FILE *file_in) : reader (file_in),
+				       tags (snippetTagNames,
+					     sizeof(snippetTagNames) /
+					     sizeof(snippetTagNames[0])),
+				       partialParse(FALSE),
+				       lastLT(0), snippetLineOffset(0),
+				       trailingCut(0),
+				       documentStart(FALSE), documentEnd(FALSE),
+				       statusSet(FALSE)
+	{
+	}
+    //! Returns complete and coherient XML snippet containing at least one
+    //! top-level XML <tag></tag> pair.   Uses knowledge of valid Tool Gear
+    //! top-level XML tags to grab snippets, not an XML parser (so very
+    //! little checking of XML correctness.   
+    const char *getNextSnippet()
+	{
+	    // If not mid parse, clear current snippet contents and state
+	    if (!partialParse)
+	    {
+		// Clear snippet buffer
+		sbuf.clear();
+
+		// Last < symbol at start of buffer
+		lastLT = 0;
+
+		// Record how many lines skipped before the snippet
+		snippetLineOffset = reader.lineNumber()-1;
+
+		// Nothing cut from the end of the snippet yet
+		trailingCut = 0;
+	    }
+	    
+	    // Read a tag at a time until run out of input or hit
+	    // the end of a snippet
+	    while (reader.appendToTagEnd (sbuf, lastLT))
+	    {
+		// Get pointer to last element or end of element marker
+		const char *element = sbuf.contents() + lastLT;
+		bool isEnd;
+		int tag = SnippetReader::classifyTag (element, tags, isEnd);
+
+		// DEBUG
+//		fprintf (stderr, "Last element: '%s' (%i-%i)\n", element,
+//			 lastLT, sbuf.strlen());
+
+		// Is it a start tool_gear marker?
+		if (!isEnd && (tag == ST_TOOL_GEAR))
+		{
+//		    fprintf (stderr, "Deleting Tool_Gear marker '%s'!\n",
+//			     element);
+		    sbuf.truncate(lastLT);
+		    documentStart = TRUE;
+		}
+
+		// Only end of element markers matter otherwise
+		else if (!isEnd || (tag < 0))
+		{
+		}
+
+		// Is it an end status marker?
+		else if (tag == ST_STATUS)
+		{
+		    // Flag that XML setting status
+		    statusSet = TRUE;
+		    partialParse = FALSE;
+		    return (sbuf.contents());
+		}
+
+		// Is it a end tool_gear marker?
+		else if (tag == ST_TOOL_GEAR)
+		{
+//		    fprintf (stderr, "Deleting Tool_Gear marker '%s'!\n",
+//			     element);
+		    int cut = sbuf.strlen() - lastLT;
+		    sbuf.truncate(lastLT);
+		    documentEnd = TRUE;
+
+		    // If has XML in there, return it now
+		    if (strchr (sbuf.contents(), '<') != NULL)
+		    {
+			fprintf (stderr, 
+				 "\nTool Gear XML collector Warning: \n"
+				 "   Unrecognized XML at end, sending:\n"
+				 "   '%s'\n",
+				 sbuf.contents());
+			trailingCut = cut;
+			partialParse = FALSE;
+			return (sbuf.contents());
+		    }
+		}
+
+		// Must be an end of element marker we recognize
+		else
+		{
+//		    fprintf (stderr, "End snippet marker %s detected!\n", 
+//			     element);
+		    partialParse = FALSE;
+		    return (sbuf.contents());
+		}
+	    }
+	    // If got here, must be in partial parse
+	    partialParse = TRUE;
+
+	    // Return that there is no complete snippet ready yet
+	    return (NULL);
+	}
+
+    //! Returns the number of lines skipped/processed before the snippet
+    //! Used to correlate XML snippet back to original file lines.
+    int getSnippetOffset () {return (snippetLineOffset);}
+
+    //! Returns the offset in the input file of ptr, which must point
+    //! into the snippet just returned, after any <tool_gear> marker
+    //! deleted from it.  Lets TGxmlserver go back for text in the
+    //! snippet (e.g., message bodies) later.
+    off_t fileOffsetOf (const char *ptr)
+	{
+	    const char *snippetEnd = sbuf.contents() + sbuf.strlen();
+	    return (reader.fileOffset() - trailingCut - (snippetEnd - ptr));
+	}
+
+    //! Returns TRUE once </tool_gear> has been read, that is, the writer
+    //! has finished the file (rather than just not written more yet)
+    bool atDocumentEnd () {return (documentEnd);}
+
+    //! Returns TRUE if <tool_gear> has been read.  Files without it
+    //! (e.g., Umpire's per-task output) hold a fragment of a document.
+    bool sawDocumentStart () {return (documentStart);}
+
+    //! Returns TRUE once a <status> element has been read, meaning the
+    //! XML sets the status message itself
+    bool setsStatus () {return (statusSet);}
+
+    //! Throws away any partial snippet and starts over at line 1, for
+    //! when the input file has been truncated or replaced
+    void restart ()
+	{
+	    reader.restart();
+	    partialParse = FALSE;
+	    documentStart = FALSE;
+	    documentEnd = FALSE;
+	}
+
+    //! Carries on parsing from in, which must be at the offset the old
+    //! input had been read to (see SnippetReader::setInput())
+    void setInput (FILE *in) {reader.setInput (in);}
+
+private:
+    SnippetReader reader;
+    XMLTokenTable tags;
+    MessageBuffer sbuf;
+    bool partialParse;
+    int lastLT;
+    int snippetLineOffset;
+    int trailingCut;		// Bytes of </tool_gear> cut off the end
+    bool documentStart;
+    bool documentEnd;
+    bool statusSet;
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -0,0 +1,179 @@
+//! \file xml_token_table.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+/*
+ * Builds the perfect hash tables used to look up XML element names (see
+ * xml_token_table.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "xml_token_table.h"
+#include "tg_error.h"
+
+XMLTokenTable::XMLTokenTable (const XMLTokenDecl decls[], int count) :
+    slots (NULL), size (0), mult (0)
+{
+    build (decls, count);
+}
+
+XMLTokenTable::XMLTokenTable (const char * const names[], int count) :
+    slots (NULL), size (0), mult (0)
+{
+    XMLTokenDecl *decls = (XMLTokenDecl *) malloc (count * sizeof (XMLTokenDecl));
+    if (decls == NULL)
+	TG_error ("XMLTokenTable: out of memory!");
+
+    for (int i = 0; i < count; i++)
+    {
+	decls[i].name = names[i];
+	decls[i].token = i;
+	decls[i].levelMask = XML_TOKEN_ANY_LEVEL;
+    }
+    build (decls, count);
+    free (decls);
+}
+
+XMLTokenTable::~XMLTokenTable ()
+{
+    free (slots);
+}
+
+// Tries multipliers (and, if none work, bigger tables) until every name
+// lands in its own slot.  Only done once per table, so not worth being
+// clever about.
+void XMLTokenTable::build (const XMLTokenDecl decls[], int count)
+{
+    int i, j;
+
+    // Merge repeated names (declared for different levels) into one
+    // list of unique names, all of whose levels are in levelMask
+    XMLTokenDecl *unique = 
+	(XMLTokenDecl *) malloc (count * sizeof (XMLTokenDecl));
+    if (unique == NULL)
+	TG_error ("XMLTokenTable: out of memory!");
+    int uniqueCount = 0;
+    for (i = 0; i < count; i++)
+    {
+	if (decls[i].name[0] == 0)
+	    TG_error ("XMLTokenTable: empty name declared!");
+
+	for (j = 0; j < uniqueCount; j++)
+	{
+	    if (strcmp (decls[i].name, unique[j].name) == 0)
+		break;
+	}
+	if (j < uniqueCount)
+	{
+	    if (unique[j].token != decls[i].token)
+		TG_error ("XMLTokenTable: '%s' declared as tokens %i and %i!",
+			  decls[i].name, unique[j].token, decls[i].token);
+	    unique[j].levelMask |= decls[i].levelMask;
+	}
+	else
+	{
+	    unique[uniqueCount++] = decls[i];
+	}
+    }
+    decls = unique;
+    count = uniqueCount;
+
+    // Start with the table at most half full
+    for (size = 16; size < 2 * count; size *= 2)
+	;
+
+    for (; size <= 4096; size *= 2)
+    {
+	slots = (Slot *) realloc (slots, size * sizeof (Slot));
+	if (slots == NULL)
+	    TG_error ("XMLTokenTable: out of memory!");
+
+	for (mult = 1; mult < 20000; mult += 2)
+	{
+	    memset (slots, 0, size * sizeof (Slot));
+	    for (i = 0; i < count; i++)
+	    {
+		int len = strlen (decls[i].name);
+		Slot *slot = &slots[hash (decls[i].name, len, mult) & (size-1)];
+		if (slot->len != 0)
+		    break;
+		slot->name = decls[i].name;
+		slot->len = len;
+		slot->token = decls[i].token;
+		slot->levelMask = decls[i].levelMask;
+	    }
+	    if (i == count)
+	    {
+		free (unique);
+		return;
+	    }
+	}
+    }
+    TG_error ("XMLTokenTable: no perfect hash found for %i names!", count);
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
@@ -0,0 +1,177 @@
+//! \file xml_token_table.h
+//!
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+
+#ifndef TG_XML_TOKEN_TABLE_H
+#define TG_XML_TOKEN_TABLE_H
+
+#include <string.h>
+
+//! Bit in XMLTokenDecl::levelMask for nesting level level (all levels
+//! from 31 up share the last bit)
+#define XML_TOKEN_LEVEL(level) (1u << (((level) < 31) ? (level) : 31))
+
+//! Valid at every nesting level
+#define XML_TOKEN_ANY_LEVEL (~0u)
+
+//! One element name known to an XMLTokenTable
+struct XMLTokenDecl
+{
+    const char *name;
+    int token;			//!< Returned by lookup() for name
+    unsigned levelMask;		//!< XML_TOKEN_LEVEL() bits where name is valid
+};
+
+//! Perfect hash of a fixed vocabulary of XML element names, for parsers
+//! that look up every element they see.
+//! Built once from a static list of names; lookup() costs one hash, one
+//! length and level check, and at most one compare (no string hashing
+//! over the whole name, no chaining).  The table size and hash multiplier
+//! are picked at construction so that no two names collide.
+class XMLTokenTable
+{
+public:
+    //! Declares each decls[i].name.  A name may be declared more than
+    //! once (for different levels) but always as the same token.
+    XMLTokenTable (const XMLTokenDecl decls[], int count);
+
+    //! Declares each names[i] as token i, valid at every level
+    XMLTokenTable (const char * const names[], int count);
+
+    ~XMLTokenTable ();
+
+    //! Returns the token for the len characters at name, or -1 if the
+    //! name is not in the table
+    int lookup (const char *name, int len) const
+	{
+	    const Slot *slot = find (name, len);
+	    return ((slot != NULL) ? slot->token : -1);
+	}
+
+    //! Returns the token for the len characters at name if the name is
+    //! valid at nestLevel, otherwise -1
+    int lookup (const char *name, int len, int nestLevel) const
+	{
+	    const Slot *slot = find (name, len);
+	    if ((slot == NULL) || 
+		((slot->levelMask & XML_TOKEN_LEVEL(nestLevel)) == 0))
+		return (-1);
+	    return (slot->token);
+	}
+
+    //! Same as above for a '\0' terminated name
+    int lookup (const char *name) const
+	{
+	    return (lookup (name, strlen (name)));
+	}
+
+private:
+    struct Slot
+    {
+	const char *name;
+	int len;		// 0 if slot empty
+	int token;
+	unsigned levelMask;
+    };
+
+    // Uses the first two and last characters and the length, which
+    // is enough to tell apart the element names Tool Gear deals with
+    // (e.g., min_width and max_width)
+    static unsigned hash (const char *name, int len, unsigned mult)
+	{
+	    unsigned h = ((unsigned char)name[0] * mult) ^
+		((unsigned char)name[len-1] * (mult >> 3)) ^ (len * 31u);
+	    if (len > 1)
+		h += (unsigned char)name[1] * 131u;
+	    return (h ^ (h >> 7));
+	}
+
+    const Slot *find (const char *name, int len) const
+	{
+	    if (len <= 0)
+		return (NULL);
+	    const Slot *slot = &slots[hash (name, len, mult) & (size - 1)];
+	    if ((slot->len != len) || (memcmp (slot->name, name, len) != 0))
+		return (NULL);
+	    return (slot);
+	}
+
+    void build (const XMLTokenDecl decls[], int count);
+
+    // Not copyable (owns slots)
+    XMLTokenTable (const XMLTokenTable &);
+    XMLTokenTable &operator= (const XMLTokenTable &);
+
+    Slot *slots;
+    int size;			// Power of 2
+    unsigned mult;
+};
+
+#endif
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
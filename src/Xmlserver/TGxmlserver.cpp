@@ -8,7 +8,15 @@
 //! sends it to the Client.   Works like tail -f, continuously looks for 
 //! new XML in input file until Client exits, allowing this XML collector
 //! to be used for both post-morten (e.g., MpipView and UmpireView) and 
-//! and live (e.g. MemcheckView) message viewers.
+//! and live (e.g. MemcheckView) message viewers.  Several input files
+//! (e.g., UmpireView's, one per MPI task) can be read at once and merged.
+//! A single file may instead be in the binary .tgb format (see
+//! tgb_format.h), which is sent in large pieces without being scanned.
+//! With -lazy, message bodies are left in a single XML file and sent
+//! only when the Client asks for them.  With -mpip, the input is an
+//! mpiP report, read here (see mpip_info.h) with each message sent as
+//! soon as it is written, so no XML file is needed.  Several mpiP
+//! reports are compared in one view.
 //!
 //! This collector includes the standard capabilities for
 //! serving source code and changing directories.
@@ -18,6 +26,8 @@
 // John Gyllenhaal, 21 March 2005
 
 #include <dirent.h>
+#include <glob.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -29,6 +39,7 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -51,209 +62,835 @@
 #include "lineparser.h"
 #include "tempcharbuf.h"
 #include "messagebuffer.h"
+#include "xml_snippet_parser.h"
+#include "tgb_format.h"
+#include "file_follower.h"
 #include "logfile.h"
 #include "tg_time.h"
 #include "socketmanager.h"
+#include "mpip_info.h"
 
-// Flag that XML input is setting status messages
-bool statusSet = FALSE;
+// How the snippets of several input files are merged (see -order below)
+enum MergeOrder {
+    MERGE_FILE_ORDER,		// Each file's snippets together, files in turn
+    MERGE_ARRIVAL_ORDER		// Each snippet as soon as it has been scanned
+};
+
+// Use at most this many threads to scan merged input files
+#define MERGE_MAX_THREADS 8
+
+// Scanning stops while this many bytes of snippets (from all the inputs
+// together) are waiting to be sent, and starts again once half of them
+// are sent.  In file order the input being sent may always queue up to
+// this many bytes of its own, so it is never held up by those after it.
+#define MERGE_QUEUE_BYTES (1<<20)
+
+// In file order, inputs are only opened once they are this close to
+// being sent (so thousands of files don't all need descriptors at once)
+#define MERGE_OPEN_AHEAD 32
+
+// Keep at most this many inputs open at once (fewer if the descriptor
+// limit is low).  With more inputs than that, those read to end of file
+// are closed and looked at with stat() until they grow.
+#define MERGE_MAX_OPEN 256
+
+// How often (in ms) to try again to open an input, or look for growth
+// in one that was closed
+#define MERGE_RETRY_INTERVAL 1000
+
+//! A snippet scanned from one of the merged input files
+struct MergedSnippet
+{
+    char *xml;
+    int size;
+    int lineOffset;
+    MergedSnippet *next;
+};
+
+//! Scanned snippets waiting to be sent, oldest first
+struct MergeQueue
+{
+    MergedSnippet *head;
+    MergedSnippet *tail;
+    int bytes;
+    bool full;			// A scanner is waiting for room
+};
+
+//! One of the merged input files
+struct MergeInput
+{
+    char *name;
+    bool unlinkIt;
+    FILE *in;			// NULL until opened, and once closed
+    XMLSnippetParser *parser;	// Kept while closed to save descriptors
+    FileFollower *follower;
+    MergeQueue *queue;
+    MergedSnippet *pending;	// Scanned, but there was no room for it
+    off_t resumeAt;		// Offset read to, while parser is kept
+    dev_t dev;			// File read, while parser is kept
+    ino_t ino;
+    bool closed;		// Read to </tool_gear> (or dropped)
+    bool openDeferred;		// Warned that we're out of descriptors
+    bool caughtUp;		// Read to end of file at least once
+    bool complete;		// All of it read (see scanInput())
+    bool setsStatus;		// Has set the status message itself
+};
+
+class SnippetMerger;
 
-//! Class for incrementally grabbing coherient Tool Gear XML snippets from
-//! a file without using seek (no rewinding file).   
-class XMLSnippetParser
+//! A thread scanning some of the merged input files
+struct MergeWorker
+{
+    SnippetMerger *merger;
+    int index;
+    pthread_t thread;
+    int wakePipe[2];
+    FileWatchSet *watchSet;	// Watches all of this worker's inputs
+    bool retryOpen;		// An input is waiting to be (re)opened
+};
+
+//! Scans several Tool Gear XML files (e.g., Umpire's or Memcheck's
+//! output for each MPI task) at once, in worker threads, and hands their
+//! snippets to the main thread, which alone talks to the Client.  Each
+//! file is followed as it grows, just as a single input file is.
+class SnippetMerger
 {
 public:
-    XMLSnippetParser (FILE *file_in) : in (file_in), partialParse(FALSE),
-				       lastLT(0), lineNo(1),
-				       snippetLineOffset(0)
+    SnippetMerger ();
+    ~SnippetMerger ();
+
+    //! Adds an input file, or (if name has wildcards in it) each file
+    //! that matches, in sorted order
+    void addInput (const char *name);
+    //! Unlinks the input added last as soon as it is opened
+    void unlinkLastInput ();
+    void setOrder (MergeOrder mergeOrder) {order = mergeOrder;}
+
+    int inputCount () {return (numInputs);}
+    const char *inputName (int i) {return (inputs[i].name);}
+    bool inputUnlinked (int i) {return (inputs[i].unlinkIt);}
+
+    //! Starts the threads that scan the inputs (skipping any that can't
+    //! be read).  The threads open the inputs as they get to them.
+    //! Returns the number of inputs kept.
+    int start ();
+    //! Stops the scanning threads
+    void stop ();
+
+    //! Becomes readable when there may be something new to send
+    int notifyFd () {return (notifyPipe[0]);}
+    //! Call before taking everything there is to send
+    void clearNotify ();
+
+    //! Returns the next snippet to send (free it with releaseSnippet()),
+    //! or NULL if there isn't one yet
+    MergedSnippet *getSnippet ();
+    void releaseSnippet (MergedSnippet *snippet);
+
+    //! TRUE once each input has been read to end of file and all of
+    //! its snippets have been taken
+    bool allCaughtUp ();
+    //! TRUE once each input is complete and all of its snippets have
+    //! been taken
+    bool allComplete ();
+    //! TRUE if any input has set the status message itself (as of when
+    //! it was last read to end of file)
+    bool setsStatus ();
+
+private:
+    static void *threadMain (void *arg);
+    void scanLoop (MergeWorker *worker);
+    bool openInput (MergeWorker *worker, MergeInput &input);
+    void closeInput (MergeInput &input, bool keepParser);
+    void dropInput (MergeInput &input);
+    bool scanInput (MergeInput &input);
+    void waitForWork (MergeWorker *worker);
+    bool enqueue (MergeInput &input, MergedSnippet *snippet);
+    MergedSnippet *dequeue (MergeQueue &queue);
+    void notifyMain ();
+    void wakeWorkers ();
+
+    MergeInput *inputs;
+    int numInputs;
+    int maxInputs;
+    MergeOrder order;
+    MergeQueue *queues;
+    int numQueues;
+    MergeWorker *workers;
+    int numWorkers;
+    bool threadsRunning;
+
+    // The rest are protected by lock
+    pthread_mutex_t lock;
+    int numOpen;		// Inputs open now
+    int maxOpen;		// Most inputs to have open at once
+    int queued;			// Snippets waiting in all the queues
+    int queuedBytes;		// Their total size
+    bool queuesFull;		// A scanner is waiting for queuedBytes to drop
+    int currentInput;		// Input being sent, in file order
+    int nextQueue;		// Queue to look in next, once all are sent
+    bool stopping;
+    int notifyPipe[2];
+    bool notifyPending;
+};
+
+SnippetMerger::SnippetMerger () :
+    inputs (NULL), numInputs (0), maxInputs (0), order (MERGE_FILE_ORDER),
+    queues (NULL), numQueues (0), workers (NULL), numWorkers (0),
+    threadsRunning (FALSE),
+    numOpen (0), maxOpen (MERGE_MAX_OPEN), queued (0), queuedBytes (0),
+    queuesFull (FALSE), currentInput (0), nextQueue (0), stopping (FALSE),
+    notifyPending (FALSE)
+{
+    pthread_mutex_init (&lock, NULL);
+    notifyPipe[0] = notifyPipe[1] = -1;
+}
+
+SnippetMerger::~SnippetMerger ()
+{
+    stop ();
+    pthread_mutex_destroy (&lock);
+}
+
+void SnippetMerger::addInput (const char *name)
+{
+    // Expand wildcards ourselves, so a pattern matching thousands of
+    // files can be passed down from the Client
+    if (strpbrk (name, "*?[") != NULL)
+    {
+	glob_t matches;
+	if (glob (name, 0, NULL, &matches) != 0)
 	{
+	    fprintf (stderr, "Warning: no input files match '%s'\n", name);
+	    return;
 	}
-    //! Returns complete and coherient XML snippet containing at least one
-    //! top-level XML <tag></tag> pair.   Uses knowledge of valid Tool Gear
-    //! top-level XML tags to grab snippets, not an XML parser (so very
-    //! little checking of XML correctness.   
-    const char *getNextSnippet()
+	for (size_t m = 0; m < matches.gl_pathc; m++)
+	    addInput (matches.gl_pathv[m]);
+	globfree (&matches);
+	return;
+    }
+
+    if (numInputs >= maxInputs)
+    {
+	maxInputs = (maxInputs > 0) ? maxInputs * 2 : 16;
+	inputs = (MergeInput *) realloc (inputs,
+					 maxInputs * sizeof (MergeInput));
+	TG_checkAlloc (inputs);
+    }
+    MergeInput &input = inputs[numInputs++];
+    memset (&input, 0, sizeof (input));
+    input.name = strdup (name);
+    TG_checkAlloc (input.name);
+}
+
+void SnippetMerger::unlinkLastInput ()
+{
+    if (numInputs > 0)
+	inputs[numInputs - 1].unlinkIt = TRUE;
+}
+
+int SnippetMerger::start ()
+{
+    if (pipe (notifyPipe) != 0)
+	TG_errno ("SnippetMerger: unable to create wakeup pipe!");
+    fcntl (notifyPipe[0], F_SETFL, O_NONBLOCK);
+
+    // Use a thread per input, up to one per processor.  (Their pipes
+    // and inotify descriptors are made before any inputs are opened, to
+    // keep the descriptors low enough for select.)
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    numWorkers = (cpus > 0) ? (int) cpus : 1;
+    if (numWorkers > MERGE_MAX_THREADS)
+	numWorkers = MERGE_MAX_THREADS;
+    if (numWorkers > numInputs)
+	numWorkers = numInputs;
+    if (numWorkers < 1)
+	numWorkers = 1;
+    workers = (MergeWorker *) calloc (numWorkers, sizeof (MergeWorker));
+    TG_checkAlloc (workers);
+    for (int w = 0; w < numWorkers; w++)
+    {
+	MergeWorker *worker = &workers[w];
+	worker->merger = this;
+	worker->index = w;
+	if (pipe (worker->wakePipe) != 0)
+	    TG_errno ("SnippetMerger: unable to create wakeup pipe!");
+	fcntl (worker->wakePipe[0], F_SETFL, O_NONBLOCK);
+	fcntl (worker->wakePipe[1], F_SETFL, O_NONBLOCK);
+	worker->watchSet = new FileWatchSet ();
+    }
+
+    // Leave half the descriptors for everything else (e.g., source files)
+    struct rlimit limit;
+    if ((getrlimit (RLIMIT_NOFILE, &limit) == 0) &&
+	(limit.rlim_cur != RLIM_INFINITY) &&
+	((rlim_t) maxOpen > limit.rlim_cur / 2))
+    {
+	maxOpen = (int) (limit.rlim_cur / 2);
+	if (maxOpen < 1)
+	    maxOpen = 1;
+    }
+
+    // Drop any inputs we can't read.  The rest are opened by the
+    // scanning threads as they get to them.
+    int kept = 0;
+    for (int i = 0; i < numInputs; i++)
+    {
+	MergeInput &input = inputs[i];
+	if (access (input.name, R_OK) != 0)
 	{
-	    // If not mid parse, clear current snippet contents and state
-	    if (!partialParse)
-	    {
-		// Clear snippet buffer
-		sbuf.clear();
+	    fprintf (stderr, "Warning: failed to open input file %s\n",
+		     input.name);
+	    free (input.name);
+	    continue;
+	}
+	inputs[kept++] = input;
+    }
+    numInputs = kept;
+    if (numInputs == 0)
+	return (0);
+
+    // In arrival order, all the inputs share one queue
+    numQueues = (order == MERGE_ARRIVAL_ORDER) ? 1 : numInputs;
+    queues = (MergeQueue *) calloc (numQueues, sizeof (MergeQueue));
+    TG_checkAlloc (queues);
+    for (int i = 0; i < numInputs; i++)
+	inputs[i].queue = &queues[(numQueues > 1) ? i : 0];
+
+    // Don't keep workers that would have no inputs
+    while (numWorkers > numInputs)
+    {
+	numWorkers--;
+	close (workers[numWorkers].wakePipe[0]);
+	close (workers[numWorkers].wakePipe[1]);
+	delete workers[numWorkers].watchSet;
+    }
+    for (int w = 0; w < numWorkers; w++)
+    {
+	if (pthread_create (&workers[w].thread, NULL, threadMain,
+			    &workers[w]) != 0)
+	    TG_errno ("SnippetMerger: unable to create scanning thread!");
+    }
+    threadsRunning = TRUE;
+
+    return (numInputs);
+}
 
-		// Last < symbol at start of buffer
-		lastLT = 0;
+void SnippetMerger::stop ()
+{
+    if (!threadsRunning)
+	return;
 
-		// Record how many lines skipped before the snippet
-		snippetLineOffset = lineNo-1;
-	    }
-	    
-	    // Read characters until run out of characters or hit
-	    // the end of a snippet
-	    int ch;
-	    while ((ch = fgetc(in)) != EOF)
-	    {
-		// If got '<', get index in string we are going to place it
-		if (ch == '<')
-		    lastLT = sbuf.strlen();
+    pthread_mutex_lock (&lock);
+    stopping = TRUE;
+    pthread_mutex_unlock (&lock);
+    wakeWorkers ();
 
-		// Add character to end of snippet buffer
-		sbuf.appendChar(ch);
+    for (int w = 0; w < numWorkers; w++)
+	pthread_join (workers[w].thread, NULL);
 
-		// If got '>', see if at end of known snippet terminator
-		if (ch == '>')
-		{
-		    // Get pointer to last element or end of element marker
-		    const char *element = sbuf.contents() + lastLT;
-		    
-		    // DEBUG
-//		    fprintf (stderr, "Last element: '%s' (%i-%i)\n", element,
-//			     lastLT, sbuf.strlen());
-
-		    // Is it a start tool_gear marker?
-		    if (isStartElement (element, "tool_gear"))
-		    {
-//			fprintf (stderr, "Deleting Tool_Gear marker '%s'!\n",
-//				 element);
-			sbuf.truncate(lastLT);
-		    }
+    // The followers go before the watch sets they use
+    for (int i = 0; i < numInputs; i++)
+    {
+	if (inputs[i].in != NULL)
+	    closeInput (inputs[i], FALSE);
+    }
+    for (int w = 0; w < numWorkers; w++)
+    {
+	close (workers[w].wakePipe[0]);
+	close (workers[w].wakePipe[1]);
+	delete workers[w].watchSet;
+    }
+    free (workers);
+    workers = NULL;
+    numWorkers = 0;
+    threadsRunning = FALSE;
+}
 
-		    // Is it a end of element marker we recognize?
-		    else if (isEndElement (element, "message") ||
-			     isEndElement (element, "site_data") ||
-			     isEndElement (element, "message_folder") ||
-			     isEndElement (element, "site_priority") ||
-			     isEndElement (element, "tool_title") ||
-			     isEndElement (element, "site_column") ||
-			     isEndElement (element, "about"))
-		    {
-//			fprintf (stderr, "End snippet marker %s detected!\n", 
-//				 element);
-			partialParse = FALSE;
-			return (sbuf.contents());
-		    }
+void *SnippetMerger::threadMain (void *arg)
+{
+    MergeWorker *worker = (MergeWorker *) arg;
+    worker->merger->scanLoop (worker);
+    return (NULL);
+}
 
-		    // Is it an end status marker?
-		    else if (isEndElement (element, "status"))
-		    {
-			// Flag that XML setting status
-			statusSet = TRUE;
-			partialParse = FALSE;
-			return (sbuf.contents());
-		    }
+// Scans this worker's inputs (every numWorkers'th one) in turn,
+// waiting when there's nothing more to read or no room for it
+void SnippetMerger::scanLoop (MergeWorker *worker)
+{
+    for (;;)
+    {
+	// In file order, only open the inputs that will be sent soon
+	pthread_mutex_lock (&lock);
+	int openLimit = (order == MERGE_FILE_ORDER) ?
+	    currentInput + MERGE_OPEN_AHEAD : numInputs;
+	pthread_mutex_unlock (&lock);
+
+	// Every input that can be read is about to be read to end of
+	// file, so the change notices so far have been dealt with.  (Those
+	// for inputs waiting for room would otherwise keep waking us.)
+	worker->watchSet->drainEvents ();
+
+	bool progress = FALSE;
+	worker->retryOpen = FALSE;
+	for (int i = worker->index; i < numInputs; i += numWorkers)
+	{
+	    MergeInput &input = inputs[i];
+	    if (input.closed)
+		continue;
+	    if ((input.in == NULL) &&
+		((i >= openLimit) || !openInput (worker, input)))
+		continue;
+	    if (scanInput (input))
+		progress = TRUE;
+	}
 
-		    // Is it a end tool_gear marker?
-		    else if (isEndElement (element, "tool_gear"))
-		    {
-//			fprintf (stderr, "Deleting Tool_Gear marker '%s'!\n",
-//				 element);
-			sbuf.truncate(lastLT);
-
-			// If has XML in there, return it now
-			const char *ptr = sbuf.contents();
-			char ch;
-			while ((ch=*ptr) != 0)
-			{
-			    if (ch == '<')
-			    {
-				fprintf (stderr, 
-					 "\nTool Gear XML collector Warning: \n"
-					 "   Unrecognized XML at end, sending:\n"
-					 "   '%s'\n",
-					 sbuf.contents());
-				partialParse = FALSE;
-				return (sbuf.contents());
-			    }
-			    ptr++;
-			}
-		    }
-		}
+	pthread_mutex_lock (&lock);
+	bool stopNow = stopping;
+	pthread_mutex_unlock (&lock);
+	if (stopNow)
+	    break;
 
-		// Increment line number if newline
-		if (ch == '\n')
-		    ++lineNo;
-	    }
-	    // If got here, must be in partial parse
-	    partialParse = TRUE;
+	if (!progress)
+	    waitForWork (worker);
+    }
+}
 
-	    // Return that there is no complete snippet ready yet
-	    return (NULL);
+// Opens the input (again, if it was closed to save descriptors) so
+// scanInput() can read it.  Returns FALSE if it can't be opened yet
+// (it is tried again later) or at all (it is dropped).
+bool SnippetMerger::openInput (MergeWorker *worker, MergeInput &input)
+{
+    // A closed input is only opened again once it has changed
+    struct stat fileStat;
+    if (input.parser != NULL)
+    {
+	if ((stat (input.name, &fileStat) != 0) ||
+	    ((fileStat.st_size == input.resumeAt) &&
+	     (fileStat.st_dev == input.dev) &&
+	     (fileStat.st_ino == input.ino)))
+	{
+	    worker->retryOpen = TRUE;
+	    return (FALSE);
 	}
+    }
 
-    //! Returns the number of lines skipped/processed before the snippet
-    //! Used to correlate XML snippet back to original file lines.
-    int getSnippetOffset () {return (snippetLineOffset);}
+    // Stay within our share of descriptors
+    pthread_mutex_lock (&lock);
+    bool haveRoom = (numOpen < maxOpen);
+    if (haveRoom)
+	numOpen++;
+    pthread_mutex_unlock (&lock);
+    if (!haveRoom)
+    {
+	worker->retryOpen = TRUE;
+	return (FALSE);
+    }
 
-private:
-    bool isEndElement (const char *element, const char *name)
+    input.in = fopen (input.name, "r");
+    if (input.in == NULL)
+    {
+	int openErrno = errno;
+	pthread_mutex_lock (&lock);
+	numOpen--;
+
+	// Out of descriptors after all, so keep to the number open now
+	// and try again once some of them are closed
+	if ((openErrno == EMFILE) || (openErrno == ENFILE))
 	{
-	    // Expect element[0] == '<'
-	    if (element[0] != '<')
+	    maxOpen = (numOpen > 0) ? numOpen : 1;
+	    pthread_mutex_unlock (&lock);
+	    if (!input.openDeferred)
 	    {
-		fprintf (stderr, "Error in XMLSnippetParser::isEndElement: \n"
-			 "  Expect < not '%c' in '%s'!\n", element[0],
-			 element);
-		exit (1);
+		fprintf (stderr, "Warning: too many files open, will open "
+			 "%s later\n", input.name);
+		input.openDeferred = TRUE;
 	    }
+	    worker->retryOpen = TRUE;
+	    return (FALSE);
+	}
+	pthread_mutex_unlock (&lock);
 
-	    // For now, treat as end element only if starts with </
-	    // (Not expecting <foo/> right now as select ending element)
-	    if (element [1] != '/')
-		return (FALSE);
-	    
-	    // Get length of name to limit search
-	    int nameLen = strlen (name);
-	    
-	    // Expect name to follow / if end element of this name
-	    if (strncmp (&element[2], name, nameLen) != 0)
-		return (FALSE);
-
-	    // Have </name but need to make sure 'name' not part of
-	    // longer name by testing character after name in element
-	    // (that is, distinguish </message> from </message_folder>
-	    int nextChar = element[2+nameLen];
-	    if ((nextChar != '>') && !isspace(nextChar))
-		return (FALSE);
-
-	    // If got here, must be end element for 'name'
-	    return (TRUE);
-	}
-
-    bool isStartElement (const char *element, const char *name)
+	// Gone since it was last read?  Look again later.
+	if (input.parser != NULL)
 	{
-	    // Expect element[0] == '<'
-	    if (element[0] != '<')
-	    {
-		fprintf (stderr, "Error in XMLSnippetParser::isStartElement!"
-			 "Expect < not '%c'!\n", element[0]);
-		exit (1);
-	    }
+	    worker->retryOpen = TRUE;
+	    return (FALSE);
+	}
+	fprintf (stderr, "Warning: failed to open input file %s\n",
+		 input.name);
+	dropInput (input);
+	return (FALSE);
+    }
+
+    if (input.parser != NULL)
+    {
+	// Carry on where we left off, unless the file was truncated or
+	// replaced in the meantime (as FileFollower::update() would)
+	fstat (fileno (input.in), &fileStat);
+	if ((fileStat.st_dev == input.dev) && (fileStat.st_ino == input.ino)
+	    && (fileStat.st_size >= input.resumeAt))
+	{
+	    lseek (fileno (input.in), input.resumeAt, SEEK_SET);
+	}
+	else
+	{
+	    fprintf (stderr, "Warning: %s was truncated or replaced, "
+		     "reading it again from the start\n", input.name);
+	    input.parser->restart ();
+	}
+	input.parser->setInput (input.in);
+    }
+    else
+    {
+	// The sections of a .tgb file can't be interleaved with other
+	// files' snippets (their string tables would collide)
+	if (TGB_isTGBFile (fileno (input.in), input.name))
+	{
+	    fprintf (stderr, "Warning: %s is a .tgb file, which can only "
+		     "be viewed by itself; skipping it\n", input.name);
+	    closeInput (input, FALSE);
+	    dropInput (input);
+	    return (FALSE);
+	}
+	input.parser = new XMLSnippetParser (input.in);
+    }
+
+    input.follower = new FileFollower (input.name, fileno (input.in),
+				       1000, !input.unlinkIt,
+				       worker->watchSet);
+    if (input.unlinkIt)
+	unlink (input.name);
+    return (TRUE);
+}
+
+// Closes the input.  If keepParser is TRUE, it is just closed to save
+// descriptors, and openInput() carries on from here once it grows.
+// Otherwise nothing more will be read from it.
+void SnippetMerger::closeInput (MergeInput &input, bool keepParser)
+{
+    if (keepParser)
+    {
+	struct stat fileStat;
+	fstat (fileno (input.in), &fileStat);
+	input.resumeAt = lseek (fileno (input.in), 0, SEEK_CUR);
+	input.dev = fileStat.st_dev;
+	input.ino = fileStat.st_ino;
+    }
+    else
+    {
+	delete input.parser;
+	input.parser = NULL;
+	input.closed = TRUE;
+    }
+
+    delete input.follower;
+    input.follower = NULL;
+    fclose (input.in);
+    input.in = NULL;
+
+    pthread_mutex_lock (&lock);
+    numOpen--;
+    pthread_mutex_unlock (&lock);
+}
+
+// Gives up on an input that can't be read, so the others don't wait
+// for it
+void SnippetMerger::dropInput (MergeInput &input)
+{
+    input.closed = TRUE;
+    pthread_mutex_lock (&lock);
+    input.caughtUp = TRUE;
+    input.complete = TRUE;
+    notifyMain ();
+    pthread_mutex_unlock (&lock);
+}
 
-	    // Get length of name to limit search
-	    int nameLen = strlen (name);
-	    
-	    // Expect name to follow < if start element of this name
-	    if (strncmp (&element[1], name, nameLen) != 0)
-		return (FALSE);
+// Queues the input's snippets until it runs out or its queue fills up.
+// Returns TRUE if any were queued.
+bool SnippetMerger::scanInput (MergeInput &input)
+{
+    bool progress = FALSE;
 
-	    // Have <name but need to make sure 'name' not part of
-	    // longer name by testing character after name in element
-	    // (that is, distinguish <message> from <message_folder>
-	    int nextChar = element[1+nameLen];
-	    if ((nextChar != '>') && !isspace(nextChar))
-		return (FALSE);
+    // Only this input's worker touches pending, parser, and follower
+    if (input.pending != NULL)
+    {
+	pthread_mutex_lock (&lock);
+	bool queuedIt = enqueue (input, input.pending);
+	pthread_mutex_unlock (&lock);
+	if (!queuedIt)
+	    return (FALSE);
+	input.pending = NULL;
+	progress = TRUE;
+    }
+
+    if (input.follower->update ())
+	input.parser->restart ();
 
-	    // If got here, must be end element for 'name'
-	    return (TRUE);
+    const char *xml;
+    while ((xml = input.parser->getNextSnippet ()) != NULL)
+    {
+	MergedSnippet *snippet = (MergedSnippet *) malloc (sizeof (*snippet));
+	TG_checkAlloc (snippet);
+	snippet->size = strlen (xml);
+	snippet->xml = (char *) malloc (snippet->size + 1);
+	TG_checkAlloc (snippet->xml);
+	memcpy (snippet->xml, xml, snippet->size + 1);
+	snippet->lineOffset = input.parser->getSnippetOffset ();
+
+	pthread_mutex_lock (&lock);
+	bool queuedIt = enqueue (input, snippet);
+	pthread_mutex_unlock (&lock);
+	if (!queuedIt)
+	{
+	    input.pending = snippet;
+	    return (progress);
 	}
+	progress = TRUE;
+    }
 
+    // At end of file.  A file is complete once </tool_gear> is read,
+    // or, if it is a fragment without <tool_gear>, at end of file.
+    bool complete = input.parser->atDocumentEnd () ||
+	!input.parser->sawDocumentStart ();
+    pthread_mutex_lock (&lock);
+    input.setsStatus = input.parser->setsStatus ();
+    if (!input.caughtUp || (complete && !input.complete))
+    {
+	input.caughtUp = TRUE;
+	input.complete = complete;
+	notifyMain ();
+    }
+    bool shortOfFds = (numInputs > maxOpen);
+    pthread_mutex_unlock (&lock);
+
+    // Nothing more is expected after </tool_gear>.  Otherwise, if not
+    // every input can be open at once, let the others have a turn.
+    // (An unlinked input can't be opened again, so it stays open.)
+    if (input.parser->atDocumentEnd ())
+	closeInput (input, FALSE);
+    else if (shortOfFds && !input.unlinkIt)
+	closeInput (input, TRUE);
+
+    return (progress);
+}
 
-    MessageBuffer sbuf;
-    FILE *in;
-    bool partialParse;
-    int lastLT;
-    int lineNo;
-    int snippetLineOffset;
-};
+// Waits until one of the worker's inputs changes, the main thread makes
+// room for more snippets, or it is time to look at the files anyway
+void SnippetMerger::waitForWork (MergeWorker *worker)
+{
+    fd_set readfds;
+    FD_ZERO (&readfds);
+    FD_SET (worker->wakePipe[0], &readfds);
+    int maxFd = worker->wakePipe[0];
+    int interval = TG_FOLLOW_SAFETY_INTERVAL;
+
+    // All of the worker's inputs are watched through one descriptor
+    int fd = worker->watchSet->notifyFd ();
+    if ((fd >= 0) && (fd < FD_SETSIZE))
+    {
+	FD_SET (fd, &readfds);
+	if (fd > maxFd)
+	    maxFd = fd;
+    }
+
+    for (int i = worker->index; i < numInputs; i += numWorkers)
+    {
+	// Inputs waiting for room aren't read, so don't look at them
+	if ((inputs[i].in == NULL) || (inputs[i].pending != NULL))
+	    continue;
+	if (inputs[i].follower->waitInterval () < interval)
+	    interval = inputs[i].follower->waitInterval ();
+    }
+    if (worker->retryOpen && (interval > MERGE_RETRY_INTERVAL))
+	interval = MERGE_RETRY_INTERVAL;
+
+    struct timeval timeout;
+    timeout.tv_sec = interval / 1000;
+    timeout.tv_usec = (interval % 1000) * 1000;
+    select (maxFd + 1, &readfds, NULL, NULL, &timeout);
+
+    char junk[64];
+    while (read (worker->wakePipe[0], junk, sizeof (junk)) > 0)
+	;
+}
+
+// Adds a snippet to the input's queue, if there is room.  Called with
+// lock held.
+bool SnippetMerger::enqueue (MergeInput &input, MergedSnippet *snippet)
+{
+    MergeQueue &queue = *input.queue;
+    if (queue.bytes >= MERGE_QUEUE_BYTES)
+    {
+	queue.full = TRUE;
+	return (FALSE);
+    }
+
+    // Share the room among all the inputs, except that the one being
+    // sent in file order has room of its own (or nothing might be sent)
+    bool beingSent = ((order == MERGE_FILE_ORDER) &&
+		      (currentInput < numInputs) &&
+		      (&input == &inputs[currentInput]));
+    if ((queuedBytes >= MERGE_QUEUE_BYTES) && !beingSent)
+    {
+	queuesFull = TRUE;
+	return (FALSE);
+    }
+
+    snippet->next = NULL;
+    if (queue.tail != NULL)
+	queue.tail->next = snippet;
+    else
+	queue.head = snippet;
+    queue.tail = snippet;
+    queue.bytes += snippet->size;
+    queuedBytes += snippet->size;
+    queued++;
+
+    notifyMain ();
+    return (TRUE);
+}
+
+// Takes the oldest snippet from the queue (or returns NULL), waking the
+// workers if they were waiting for room.  Called with lock held.
+MergedSnippet *SnippetMerger::dequeue (MergeQueue &queue)
+{
+    MergedSnippet *snippet = queue.head;
+    if (snippet == NULL)
+	return (NULL);
+
+    queue.head = snippet->next;
+    if (queue.head == NULL)
+	queue.tail = NULL;
+    queue.bytes -= snippet->size;
+    queuedBytes -= snippet->size;
+    queued--;
+
+    bool wake = FALSE;
+    if (queue.full && (queue.bytes < MERGE_QUEUE_BYTES / 2))
+    {
+	queue.full = FALSE;
+	wake = TRUE;
+    }
+    if (queuesFull && (queuedBytes < MERGE_QUEUE_BYTES / 2))
+    {
+	queuesFull = FALSE;
+	wake = TRUE;
+    }
+    if (wake)
+	wakeWorkers ();
+    return (snippet);
+}
+
+MergedSnippet *SnippetMerger::getSnippet ()
+{
+    MergedSnippet *snippet = NULL;
+
+    pthread_mutex_lock (&lock);
+    if (order == MERGE_ARRIVAL_ORDER)
+    {
+	if (numQueues > 0)
+	    snippet = dequeue (queues[0]);
+    }
+    else
+    {
+	// Send each input's snippets until it is complete, then go on
+	// to the next input
+	while (currentInput < numInputs)
+	{
+	    MergeInput &input = inputs[currentInput];
+	    snippet = dequeue (*input.queue);
+	    if ((snippet != NULL) || !input.complete)
+		break;
+	    currentInput++;
+
+	    // The next input now has room of its own for its snippets,
+	    // and another input may now be opened
+	    wakeWorkers ();
+	}
+
+	// Once every input has had its turn, send anything they add
+	// from then on as it comes
+	for (int n = 0; (currentInput >= numInputs) && (snippet == NULL) &&
+		 (n < numQueues); n++)
+	{
+	    snippet = dequeue (queues[nextQueue]);
+	    nextQueue = (nextQueue + 1) % numQueues;
+	}
+    }
+    pthread_mutex_unlock (&lock);
+
+    return (snippet);
+}
+
+void SnippetMerger::releaseSnippet (MergedSnippet *snippet)
+{
+    free (snippet->xml);
+    free (snippet);
+}
+
+bool SnippetMerger::allCaughtUp ()
+{
+    pthread_mutex_lock (&lock);
+    bool caughtUp = (queued == 0);
+    for (int i = 0; caughtUp && (i < numInputs); i++)
+	caughtUp = inputs[i].caughtUp;
+    pthread_mutex_unlock (&lock);
+    return (caughtUp);
+}
+
+bool SnippetMerger::allComplete ()
+{
+    pthread_mutex_lock (&lock);
+    bool complete = (queued == 0);
+    for (int i = 0; complete && (i < numInputs); i++)
+	complete = inputs[i].complete;
+    pthread_mutex_unlock (&lock);
+    return (complete);
+}
+
+bool SnippetMerger::setsStatus ()
+{
+    pthread_mutex_lock (&lock);
+    bool status = FALSE;
+    for (int i = 0; !status && (i < numInputs); i++)
+	status = inputs[i].setsStatus;
+    pthread_mutex_unlock (&lock);
+    return (status);
+}
+
+void SnippetMerger::clearNotify ()
+{
+    pthread_mutex_lock (&lock);
+    char junk[64];
+    while (read (notifyPipe[0], junk, sizeof (junk)) > 0)
+	;
+    notifyPending = FALSE;
+    pthread_mutex_unlock (&lock);
+}
+
+// Wakes the main thread, if it hasn't been already.  Called with lock
+// held.
+void SnippetMerger::notifyMain ()
+{
+    if (notifyPending)
+	return;
+    char c = 0;
+    while ((write (notifyPipe[1], &c, 1) < 0) && (errno == EINTR))
+	;
+    notifyPending = TRUE;
+}
+
+void SnippetMerger::wakeWorkers ()
+{
+    char c = 0;
+    for (int w = 0; w < numWorkers; w++)
+    {
+	while ((write (workers[w].wakePipe[1], &c, 1) < 0) &&
+	       (errno == EINTR))
+	    ;
+    }
+}
 
 // Thread-safe version of error string library for IBM
 #ifdef THREAD_SAFE
@@ -266,17 +903,66 @@ int check_socket( int sock );
 void unpack_change_dir( char * buf, int sock );
 void unpack_input_params( char * buf );
 int check_continue_search(void);
-void parse_input (XMLSnippetParser &XMLParser, SocketManager &sm);
+int serve_input (SocketManager &sm);
+int serve_merged_input (SocketManager &sm);
+int serve_mpip_input (SocketManager &sm);
+int parse_input (XMLSnippetParser &XMLParser, SocketManager &sm);
+int parse_tgb_input (TGBSectionReader &tgbReader, SocketManager &sm);
+int send_merged_input (SocketManager &sm);
+int wait_for_credit (SocketManager &sm);
+const char *index_message_bodies (const char *snippet,
+				  XMLSnippetParser &XMLParser);
+void forget_message_bodies (void);
+void send_message_body (int sock, int index);
+int decode_xml_text (const char *text, int length, MessageBuffer &out);
 
 TGSourceReader * sourceReader;
 bool wait_for_input = TRUE;
 char input_file_name[PATH_MAX + 1];
 bool unlink_input_file = FALSE;
+bool input_complete_sent = FALSE;
+
+// All the input files named, in case there is more than one to merge
+SnippetMerger merger;
 
 
 // Flag that we are terminating normally
 static bool normal_termination = FALSE;
 
+// Flow control: once the Client is told we use it, we only send XML
+// snippets while it has granted us credit (in snippets and bytes), so
+// it never has to buffer more than it asked for.  Requests from the
+// Client (e.g., for source files) are served between snippets and
+// while we wait, so they don't have to wait for the whole file.
+static bool flow_control = FALSE;
+static int snippet_credit = 0;
+static int byte_credit = 0;
+// Look for Client requests every this many snippets
+#define FLOW_POLL_INTERVAL 16
+
+// With -lazy, the bodies of messages (usually most of a big mpiP or
+// Memcheck file) are left in the input file.  Each is replaced by a
+// reference to its entry in body_index, and read back and sent only
+// when the Client asks for it (when the message is opened), so the
+// Client's startup time and memory go with the message headers.
+// Bodies shorter than LAZY_BODY_MIN bytes are sent as they are.
+static bool lazy_bodies = FALSE;
+#define LAZY_BODY_MIN 128
+
+// With -mpip, the input file is an mpiP report rather than XML
+static bool mpip_input = FALSE;
+
+//! Where a message body left in the input file is
+struct MessageBodyEntry
+{
+    off_t offset;
+    int length;			// -1 once the file has been replaced
+};
+static MessageBodyEntry *body_index = NULL;
+static int body_count = 0;
+static int max_bodies = 0;
+static int body_fd = -1;	// Input file the bodies are read from
+
 
 // Make output socket global (but static) so
 // exit_cleanup() can send nice disconnect message
@@ -319,6 +1005,11 @@ void usage( char * program )
 	fprintf( stderr, "Usage: %s <port>\n", program );
 	fprintf( stderr, "   Expects to be called by TGclient to parse an XML file and serve source.\n" );
 	fprintf( stderr, "   Expects to read data from file passed by TGclient\n" );
+	fprintf( stderr, "   Several files (or wildcard patterns) are read at once and merged,\n" );
+	fprintf( stderr, "   each file in turn (-order file) or as they come (-order arrival)\n" );
+	fprintf( stderr, "   With -lazy, message bodies are sent only when the Client asks\n" );
+	fprintf( stderr, "   With -mpip, the file is an mpiP report, sent as it is read\n" );
+	fprintf( stderr, "   (several mpiP reports are compared)\n" );
 }
 
 
@@ -383,6 +1074,44 @@ int main (int argc, char *argv[])
     }
     
 
+    // Several input files (e.g., one per MPI task) are scanned at once
+    // and merged; a single one is followed just as it always has been.
+    // An mpiP report is read and sent just once.
+    if (mpip_input)
+	last_tag = serve_mpip_input (sm);
+    else if (merger.inputCount () > 1)
+	last_tag = serve_merged_input (sm);
+    else
+	last_tag = serve_input (sm);
+
+    if( last_tag == SOCKET_ERROR ) {
+	    fprintf( stderr, "(2) Collector detected error reading socket\n" );
+	    sock = -1;
+	    exit( -1 );
+    }
+    
+    // Flag that we are terminating normally
+    normal_termination = TRUE;
+
+    // Tell the GUI we are exiting
+    TG_send( sock, DPCL_SAYS_QUIT, 0, 0, NULL );
+    TG_flush(sock);
+
+    if( getenv( "TG_SOCKET_STATS" ) != NULL ) {
+	    TG_report_socket_stats( sock, "TGxmlserver" );
+    }
+    
+    return 0;
+}
+
+// Reads and sends the single input file, then serves Client requests
+// (and follows the file) until the Client quits.  Returns the last
+// tag received.
+int serve_input (SocketManager &sm)
+{
+    int last_tag = 0;
+    fd_set readfds;
+
 #if 0
     // Try openning directly with fopen now -JCG 11/07/05
 
@@ -416,6 +1145,13 @@ int main (int argc, char *argv[])
 	    exit( -1 );
     }
     
+    // Follow the file as it is written (see file_follower.h), looking
+    // at it at least every second if we can't be told when it changes.
+    // (Set up before any -unlink, which would leave nothing to watch.)
+    // A file that is replaced is followed too, unless we unlinked it.
+    FileFollower follower ((in == stdin) ? NULL : input_file_name,
+			   fileno (in), 1000, !unlink_input_file);
+
     // If -unlink option specified, unlink the input file now.
     // This should not inhibit reading it but should make sure the
     // file is cleaned up even if the user hits ^C
@@ -425,15 +1161,41 @@ int main (int argc, char *argv[])
 	unlink (input_file_name);
     }
 
-    // DEBUG, create XML parser
-    XMLSnippetParser  XMLParser (in);
+    // A .tgb file (see tgb_format.h) is sent a section at a time, already
+    // split into snippets and tokenized; XML is split into snippets here
+    XMLSnippetParser *XMLParser = NULL;
+    TGBSectionReader *tgbReader = NULL;
+    if (TGB_isTGBFile (fileno (in), input_file_name))
+	tgbReader = new TGBSectionReader (in, input_file_name);
+    else
+	XMLParser = new XMLSnippetParser (in);
+
+    // Bodies can only be left in a file we can go back to (.tgb files
+    // are sent without being scanned, so they keep theirs)
+    if (lazy_bodies && ((in == stdin) || (tgbReader != NULL)))
+    {
+	fprintf (stderr, "Warning: -lazy ignored for %s!\n",
+		 (in == stdin) ? "standard input" : "a .tgb file");
+	lazy_bodies = FALSE;
+    }
+    if (lazy_bodies)
+	body_fd = fileno (in);
+
+    // Send snippets only as fast as the Client takes them
+    sm.sendEnableFlowControl ();
+    flow_control = TRUE;
 
-    parse_input (XMLParser, sm);
+    int parse_tag = (tgbReader != NULL) ? parse_tgb_input (*tgbReader, sm) :
+	parse_input (*XMLParser, sm);
+    if( parse_tag == GUI_SAYS_QUIT || parse_tag == SOCKET_ERROR ) {
+	    last_tag = parse_tag;
+    }
 
     // Let the user that we have sent all the data from the file
     // Only do this if XML doesn't set status message itself
     // Memcheck controls it's status messages
-    if (!statusSet)
+    if ((tgbReader != NULL) ? !tgbReader->setsStatus() :
+	!XMLParser->setsStatus())
     {
 	sm.sendStaticDataComplete ();
     }
@@ -441,19 +1203,29 @@ int main (int argc, char *argv[])
     
     struct timeval timeout, *tvp;
     // Process requests (usually for source code) until we're done
-    do {
+    while( last_tag != GUI_SAYS_QUIT && last_tag != SOCKET_ERROR ) {
 	// block until some data is ready (don't want to
 	// waste cycles spinning)
 	FD_ZERO( &readfds );
 	FD_SET( sock, &readfds );
+	int max_fd = sock;
 
-	// Also watch input file, if reqested.  Break out of the
-	// select call every second to check the file.  (doing
+	// Also watch input file, if reqested.  (doing
 	// select directly on any open fd always returns ready,
 	// even if it's at eof, so we don't want to add fd to readfds!)
+	// The follower's descriptor becomes ready when the file
+	// changes; if there isn't one (or a change is missed), break
+	// out of the select call now and then to check the file.
 	if( wait_for_input ) {
-		timeout.tv_sec = 1;
-		timeout.tv_usec = 0;
+		int notify_fd = follower.notifyFd();
+		if( notify_fd >= 0 ) {
+			FD_SET( notify_fd, &readfds );
+			if( notify_fd > max_fd )
+				max_fd = notify_fd;
+		}
+		int interval = follower.waitInterval();
+		timeout.tv_sec = interval / 1000;
+		timeout.tv_usec = (interval % 1000) * 1000;
 		tvp = &timeout;
 	} else {
 		// No timeout if we're not watching a file
@@ -464,40 +1236,255 @@ int main (int argc, char *argv[])
 	// the tg_socket functions, because this select will
 	// compete with the read thread to be notified of
 	// incoming data.
-	int ready = select( sock + 1, &readfds, NULL, NULL, tvp );
+	int ready = select( max_fd + 1, &readfds, NULL, NULL, tvp );
 	if( ready < 0 && errno != EINTR ) {
 		last_tag = SOCKET_ERROR;
 		break;
 	}
 
-	// Check for input from the client
+	// Check for input from the client.  Take all the requests that
+	// have arrived (several body requests may come at once), since
+	// any already read into the socket library's buffer won't wake
+	// up the select.
 	if( ready > 0 &&  FD_ISSET( sock, &readfds ) ) {
-		last_tag = check_socket( sock );
+		do {
+			last_tag = check_socket( sock );
+		} while( last_tag != GUI_SAYS_QUIT &&
+			 last_tag != SOCKET_ERROR && TG_poll_socket( sock ) );
 	}
 
 	// Check for file input (even if select returned
-	// because there was socket data)
-	if( wait_for_input) {
-	    parse_input(XMLParser, sm);
+	// because there was socket data).  All the change notices
+	// that piled up are handled by this one pass to end of file.
+	if( wait_for_input && last_tag != GUI_SAYS_QUIT
+			&& last_tag != SOCKET_ERROR ) {
+	    if( tgbReader != NULL ) {
+		    if( follower.update() )
+			    tgbReader->restart();
+		    parse_tag = parse_tgb_input(*tgbReader, sm);
+	    } else {
+		    if( follower.update() ) {
+			    XMLParser->restart();
+			    forget_message_bodies();
+		    }
+		    parse_tag = parse_input(*XMLParser, sm);
+	    }
+	    if( parse_tag == GUI_SAYS_QUIT || parse_tag == SOCKET_ERROR ) {
+		    last_tag = parse_tag;
+	    }
 	}
+    }
 
-    } while( last_tag != GUI_SAYS_QUIT
-		    && last_tag != SOCKET_ERROR ) ;
+    delete XMLParser;
+    delete tgbReader;
+    return (last_tag);
+}
 
-    if( last_tag == SOCKET_ERROR ) {
-	    fprintf( stderr, "(2) Collector detected error reading socket\n" );
-	    sock = -1;
-	    exit( -1 );
+// Scans all the input files at once (see SnippetMerger) and sends their
+// snippets, serving Client requests, until the Client quits.  Returns
+// the last tag received.
+int serve_merged_input (SocketManager &sm)
+{
+    int last_tag = 0;
+    fd_set readfds;
+    bool static_complete_sent = FALSE;
+
+    if (merger.start () == 0)
+    {
+	fprintf (stderr, "Failed to open any of the input files\n");
+	exit (-1);
     }
-    
-    // Flag that we are terminating normally
-    normal_termination = TRUE;
 
-    // Tell the GUI we are exiting
-    TG_send( sock, DPCL_SAYS_QUIT, 0, 0, NULL );
-    TG_flush(sock);
-    
-    return 0;
+    // The scanning threads send bodies along with their messages
+    if (lazy_bodies)
+    {
+	fprintf (stderr, "Warning: -lazy ignored when merging files!\n");
+	lazy_bodies = FALSE;
+    }
+
+    // Send snippets only as fast as the Client takes them
+    sm.sendEnableFlowControl ();
+    flow_control = TRUE;
+
+    while( last_tag != GUI_SAYS_QUIT && last_tag != SOCKET_ERROR ) {
+	// Send everything the scanning threads have ready
+	merger.clearNotify();
+	int send_tag = send_merged_input (sm);
+	if( send_tag == GUI_SAYS_QUIT || send_tag == SOCKET_ERROR ) {
+		last_tag = send_tag;
+		break;
+	}
+
+	// Let the user know once all the files have been read (unless
+	// the XML sets the status message itself), and a batch Client
+	// once they have all been finished
+	if( !static_complete_sent && merger.allCaughtUp() ) {
+		if( !merger.setsStatus() )
+			sm.sendStaticDataComplete ();
+		static_complete_sent = TRUE;
+	}
+	if( !input_complete_sent && merger.allComplete() ) {
+		sm.sendInputComplete ();
+		input_complete_sent = TRUE;
+	}
+	sm.flush();
+
+	// Block until the Client or the scanning threads have something
+	FD_ZERO( &readfds );
+	FD_SET( sock, &readfds );
+	FD_SET( merger.notifyFd(), &readfds );
+	int max_fd = (sock > merger.notifyFd()) ? sock : merger.notifyFd();
+	int ready = select( max_fd + 1, &readfds, NULL, NULL, NULL );
+	if( ready < 0 && errno != EINTR ) {
+		last_tag = SOCKET_ERROR;
+		break;
+	}
+
+	// Take all the requests that have arrived, since any already
+	// read into the socket library's buffer won't wake up the select
+	if( ready > 0 &&  FD_ISSET( sock, &readfds ) ) {
+		do {
+			last_tag = check_socket( sock );
+		} while( last_tag != GUI_SAYS_QUIT &&
+			 last_tag != SOCKET_ERROR && TG_poll_socket( sock ) );
+	}
+    }
+
+    merger.stop ();
+    return (last_tag);
+}
+
+// Sends MpipInfo's XML to the Client, each write as an XML snippet, just
+// as parse_input would send the snippets of TGmpip2xml's XML file
+class MpipSnippetSender : public MpipXMLOutput
+{
+public:
+    // Start counting lines after TGmpip2xml's "<tool_gear>\n\n", so
+    // the line offsets match its XML file
+    MpipSnippetSender (SocketManager &sm_) : sm (sm_), line_offset (2),
+	since_poll (0), last_tag (0) {}
+
+    virtual void write (const char *xml, int len);
+    virtual void flush () {sm.flush ();}
+    virtual bool stopped ()
+	{return (last_tag == GUI_SAYS_QUIT || last_tag == SOCKET_ERROR);}
+
+    // GUI_SAYS_QUIT or SOCKET_ERROR if the Client went away while we
+    // were waiting for credit, else 0
+    int lastTag () {return (last_tag);}
+
+private:
+    SocketManager &sm;
+    int line_offset;
+    int since_poll;
+    int last_tag;
+};
+
+// Sends the elements written as the next snippet, when the Client has
+// credit for it
+void MpipSnippetSender::write (const char *xml, int len)
+{
+    // Nothing more to send once the Client is gone
+    if (stopped ())
+	return;
+
+    // Answer Client requests now and then, and hold off if we are out
+    // of credit
+    if( ++since_poll >= FLOW_POLL_INTERVAL ||
+	(flow_control && (snippet_credit <= 0 || byte_credit <= 0)) ) {
+	since_poll = 0;
+	if( (last_tag = wait_for_credit( sm )) != 0 )
+	    return;
+    }
+
+    int size = sm.sendXMLSnippet (xml, line_offset);
+    snippet_credit--;
+    byte_credit -= size;
+
+    // Count the snippet's lines for the next one's offset
+    for (int i = 0; i < len; ++i)
+    {
+	if (xml[i] == '\n')
+	    ++line_offset;
+    }
+}
+
+// Reads the mpiP report named by input_file_name and sends its messages
+// as they are written (see writeMpipXML()), or with several input files,
+// compares them (see writeMpipComparisonXML()).  Then serves Client
+// requests until the Client quits.  Returns the last tag received.
+int serve_mpip_input (SocketManager &sm)
+{
+    int last_tag = 0;
+    fd_set readfds;
+
+    // The report is read by name (by several threads at once)
+    if (strcmp (input_file_name, "-") == 0)
+    {
+	fprintf (stderr, "Can't read an mpiP report from standard input\n");
+	exit (-1);
+    }
+
+    // There's no XML file to leave bodies in, and messages point into
+    // the report, so it has to stay
+    if (lazy_bodies)
+    {
+	fprintf (stderr, "Warning: -lazy ignored with -mpip!\n");
+	lazy_bodies = FALSE;
+    }
+    if (unlink_input_file)
+    {
+	fprintf (stderr, "Warning: -unlink ignored with -mpip!\n");
+	unlink_input_file = FALSE;
+    }
+    // Send snippets only as fast as the Client takes them
+    sm.sendEnableFlowControl ();
+    flow_control = TRUE;
+
+    // The XML sets the status message itself, so no
+    // sendStaticDataComplete() is needed
+    MpipSnippetSender sender (sm);
+    if (merger.inputCount () > 1)
+    {
+	const char **names = new const char *[merger.inputCount ()];
+	for (int i = 0; i < merger.inputCount (); ++i)
+	    names[i] = merger.inputName (i);
+	writeMpipComparisonXML (names, merger.inputCount (), sender);
+	delete [] names;
+    }
+    else
+    {
+	writeMpipXML (input_file_name, sender);
+    }
+    last_tag = sender.lastTag ();
+    if (!sender.stopped ())
+    {
+	sm.sendInputComplete ();
+	input_complete_sent = TRUE;
+    }
+    sm.flush ();
+
+    // Process requests (usually for source code) until we're done
+    while( last_tag != GUI_SAYS_QUIT && last_tag != SOCKET_ERROR ) {
+	// block until some data is ready (don't want to
+	// waste cycles spinning)
+	FD_ZERO( &readfds );
+	FD_SET( sock, &readfds );
+	int ready = select( sock + 1, &readfds, NULL, NULL, NULL );
+	if( ready < 0 && errno != EINTR ) {
+		last_tag = SOCKET_ERROR;
+		break;
+	}
+
+	if( ready > 0 &&  FD_ISSET( sock, &readfds ) ) {
+		do {
+			last_tag = check_socket( sock );
+		} while( last_tag != GUI_SAYS_QUIT &&
+			 last_tag != SOCKET_ERROR && TG_poll_socket( sock ) );
+	}
+    }
+
+    return (last_tag);
 }
 
 //! Process a single GUI request (usually for source code or the name of the
@@ -522,6 +1509,13 @@ int check_socket( int sock )
 		}
 		sourceReader->read_file( buf, id );
 		break;
+	case COLLECTOR_READ_FILE_LINES:
+		if( ! sourceReader ) {
+			sourceReader = new TGSourceReader( sock,
+					check_continue_search );
+		}
+		sourceReader->read_file_lines( buf, id );
+		break;
 	case DPCL_CHANGE_DIR:
 		unpack_change_dir( buf, sock );
 		break;
@@ -546,6 +1540,17 @@ int check_socket( int sock )
 	case COLLECTOR_SET_SEARCH_PATH:
 		sourceReader->unpack_set_source_path( buf );
 		break;
+	case COLLECTOR_GRANT_CREDIT:
+		{
+			int bytes;
+			TG_unpack( buf, "I", &bytes );
+			snippet_credit += id;
+			byte_credit += bytes;
+		}
+		break;
+	case COLLECTOR_READ_MESSAGE_BODY:
+		send_message_body( sock, id );
+		break;
 	};
 
 	free( buf );
@@ -627,6 +1632,10 @@ int connectToClient( int port )
 	}
 	write( sock, (void *) &outval, sizeof(outval) );
 
+	// Use shared memory (same host) or compression (remote client)
+	// for large messages, if the client agrees
+	TG_offer_options( sock );
+
         return sock;
 }
 
@@ -641,6 +1650,8 @@ int check_continue_search( void )
 	    return FALSE;
         } else if( tag == DPCL_SET_HEARTBEAT ) {
 	    return TRUE;	// Ignore heartbeat messages
+        } else if( tag == COLLECTOR_GRANT_CREDIT ) {
+	    return TRUE;	// Credit was recorded by check_socket
         } else if( tag == GUI_SAYS_QUIT ) {
             // Flag that we are terminating normally
             normal_termination = TRUE;
@@ -703,45 +1714,103 @@ void unpack_input_params( char * buf )
 	strncpy( input_file_name, arg_strings, sizeof(input_file_name) );
 	input_file_name[sizeof(input_file_name) - 1] = 0;
 
-	// For now, only -unlink expected after log file, which tells
-	// viewer to unlink (delete) the file after openning it
-	if (num_args > 1)
-	{
-	    // Skip past \0 to next string
-	    arg_strings += strlen( arg_strings ) + 1;
-	    
-	    // Is it '-unlink'?
-	    if (strcmp (arg_strings, "-unlink") == 0)
-		unlink_input_file = TRUE;
-	    else
-		fprintf (stderr, "Warning option '%s' ignored!\n", 
-			 arg_strings);
-	}
-
-#if 0
-	// Here's how to look at any additional arguments that were sent
-	if( num_args > 1 ) {
-		int i;
-		for(  i = 1; i < num_args; ++i ) {
-			// Skip past \0 to next string
+	// More file names (or wildcard patterns) may follow; their
+	// snippets are merged (see SnippetMerger).  -unlink after a
+	// file name tells us to unlink (delete) that file after opening
+	// it, and -order file|arrival says how to merge the files.
+	// -lazy leaves message bodies in the file until they are asked for.
+	// -mpip says the file is an mpiP report.
+	int i;
+	for( i = 0; i < num_args; ++i ) {
+		if( strcmp( arg_strings, "-unlink" ) == 0 ) {
+			merger.unlinkLastInput();
+		} else if( strcmp( arg_strings, "-lazy" ) == 0 ) {
+			lazy_bodies = TRUE;
+		} else if( strcmp( arg_strings, "-mpip" ) == 0 ) {
+			mpip_input = TRUE;
+		} else if( strcmp( arg_strings, "-order" ) == 0 &&
+				i + 1 < num_args ) {
+			// Skip past \0 to the order
 			arg_strings += strlen( arg_strings ) + 1;
-			fprintf( stderr, "\"%s\" ", arg_strings );
+			++i;
+			if( strcmp( arg_strings, "file" ) == 0 )
+				merger.setOrder( MERGE_FILE_ORDER );
+			else if( strcmp( arg_strings, "arrival" ) == 0 )
+				merger.setOrder( MERGE_ARRIVAL_ORDER );
+			else
+				fprintf( stderr, "Warning: -order '%s' "
+					 "ignored!\n", arg_strings );
+		} else if( arg_strings[0] == '-' && arg_strings[1] != 0 ) {
+			fprintf (stderr, "Warning option '%s' ignored!\n", 
+				 arg_strings);
+		} else {
+			merger.addInput( arg_strings );
 		}
+
+		// Skip past \0 to next string
+		arg_strings += strlen( arg_strings ) + 1;
 	}
-#endif
+
+	// A single file (the usual case) is read without the merger
+	if( merger.inputCount() > 0 ) {
+		strncpy( input_file_name, merger.inputName( 0 ),
+			 sizeof(input_file_name) );
+		input_file_name[sizeof(input_file_name) - 1] = 0;
+		unlink_input_file = merger.inputUnlinked( 0 );
+	}
+}
+
+// Handles any Client requests that have arrived, then, if we have
+// used up our credit, waits (handling requests) until the Client
+// grants more.  Returns GUI_SAYS_QUIT or SOCKET_ERROR if we should
+// stop sending, or 0 to go on.
+int wait_for_credit (SocketManager &sm)
+{
+    int tag;
+
+    while( TG_poll_socket( sock ) ) {
+	tag = check_socket( sock );
+	if( tag == GUI_SAYS_QUIT || tag == SOCKET_ERROR )
+	    return tag;
+    }
+
+    // A big snippet may take us below zero bytes; that's fine, we
+    // just don't start another until the Client catches up.
+    if( flow_control && (snippet_credit <= 0 || byte_credit <= 0) ) {
+	// Make sure the Client has everything we owe it
+	sm.flush();
+	while( snippet_credit <= 0 || byte_credit <= 0 ) {
+	    tag = check_socket( sock );
+	    if( tag == GUI_SAYS_QUIT || tag == SOCKET_ERROR )
+		return tag;
+	}
+    }
+    return 0;
 }
 
 // Parses input, return control when run out input (there may be parial
-// line left when this returns
-void parse_input(XMLSnippetParser &XMLParser, SocketManager &sm)
+// line left when this returns.  Returns GUI_SAYS_QUIT or SOCKET_ERROR
+// if the Client went away while we were waiting for credit, else 0.
+int parse_input(XMLSnippetParser &XMLParser, SocketManager &sm)
 {
     // Get pointer to const char * snippet returned by XMLParser
     const char *snippet = NULL;
+    int since_poll = 0;
+    int tag;
     
     // Read the file and look for the list of call sites
     // Also read in pieces of the file header in the process
     while ((snippet = XMLParser.getNextSnippet()) != NULL)
     {
+	// Answer Client requests now and then, and hold off if we
+	// are out of credit
+	if( ++since_poll >= FLOW_POLL_INTERVAL ||
+	    (flow_control && (snippet_credit <= 0 || byte_credit <= 0)) ) {
+	    since_poll = 0;
+	    if( (tag = wait_for_credit( sm )) != 0 )
+		return tag;
+	}
+
 #if 0
 	fprintf( stderr, 
 		 "--------------\n"
@@ -750,15 +1819,335 @@ void parse_input(XMLSnippetParser &XMLParser, SocketManager &sm)
 		 snippet);
 #endif
 
+	// Leave the message bodies in the file, if asked to
+	if (lazy_bodies)
+	    snippet = index_message_bodies (snippet, XMLParser);
+
 	// Send XML Snippet to be parsed and processed
 	// Snippet does not need to be wrapped with <tool_gear></tool_gear>
 	// (although it can be).   It will automatically be wrapped
 	// with <tool_gear_snippet></tool_gear_snippet> before processing
 	// so the XML parser will accept multiple command snippets.
-	sm.sendXMLSnippet (snippet, XMLParser.getSnippetOffset());
+	int size = sm.sendXMLSnippet (snippet, XMLParser.getSnippetOffset());
+	snippet_credit--;
+	byte_credit -= size;
+    }
+
+    // Tell the Client (once) when the whole document has been sent, so
+    // a batch Client knows to stop waiting for more
+    if (XMLParser.atDocumentEnd() && !input_complete_sent)
+    {
+	sm.sendInputComplete ();
+	sm.flush ();
+	input_complete_sent = TRUE;
+    }
+    return 0;
+}
+
+// Like parse_input, but sends the strings and records sections of a .tgb
+// file as they are.  The Client counts each section as one snippet
+// (although a records section holds many) for flow control.
+int parse_tgb_input(TGBSectionReader &tgbReader, SocketManager &sm)
+{
+    int sectionType, size, tag;
+    const char *data;
+
+    while (tgbReader.getNextSection (sectionType, data, size))
+    {
+	// Sections are big, so check for requests and credit before each
+	if( (tag = wait_for_credit( sm )) != 0 )
+	    return tag;
+
+	if (sectionType == TGB_SECTION_STRINGS)
+	    size = sm.sendTGBStrings (tgbReader.firstStringId(), data, size);
+	else
+	    size = sm.sendTGBRecords (data, size);
+	snippet_credit--;
+	byte_credit -= size;
+    }
+
+    if (tgbReader.atDocumentEnd() && !input_complete_sent)
+    {
+	sm.sendInputComplete ();
+	sm.flush ();
+	input_complete_sent = TRUE;
+    }
+    return 0;
+}
+
+// Sends the snippets the merger has ready.  Like parse_input, returns
+// GUI_SAYS_QUIT or SOCKET_ERROR if the Client went away while we were
+// waiting for credit, else 0.
+int send_merged_input (SocketManager &sm)
+{
+    MergedSnippet *snippet;
+    int since_poll = 0;
+    int tag;
+
+    while ((snippet = merger.getSnippet ()) != NULL)
+    {
+	// Answer Client requests now and then, and hold off if we
+	// are out of credit
+	if( ++since_poll >= FLOW_POLL_INTERVAL ||
+	    (flow_control && (snippet_credit <= 0 || byte_credit <= 0)) ) {
+	    since_poll = 0;
+	    if( (tag = wait_for_credit( sm )) != 0 ) {
+		merger.releaseSnippet (snippet);
+		return tag;
+	    }
+	}
+
+	int size = sm.sendXMLSnippet (snippet->xml, snippet->lineOffset);
+	snippet_credit--;
+	byte_credit -= size;
+	merger.releaseSnippet (snippet);
+    }
+    return 0;
+}
+
+// Replaces the body of each message in snippet that is worth leaving
+// in the input file (see lazy_bodies) with a reference to a new entry
+// in body_index:
+//   <body_ref><index>i</index><lines>n</lines></body_ref>
+// where n is the number of lines the body adds to the message.  The
+// body's newlines are kept inside <body_ref>, so the Client's line
+// numbers for the rest of the snippet still match the file.  Returns
+// snippet, or a rewritten copy of it (good until the next call).
+const char *index_message_bodies (const char *snippet,
+				  XMLSnippetParser &XMLParser)
+{
+    static MessageBuffer rewritten;
+    static MessageBuffer decoded;
+    const char *copied = snippet;	// Start of what isn't copied yet
+    const char *scan = snippet;
+    const char *start;
+
+    while ((start = strstr (scan, "<body>")) != NULL)
+    {
+	const char *text = start + strlen ("<body>");
+	const char *end = strstr (text, "</body>");
+	if (end == NULL)
+	    break;
+	scan = end + strlen ("</body>");
+
+	// Short bodies aren't worth a trip back to the file, and bodies
+	// with markup in them (e.g., CDATA sections) are sent as they are
+	int length = end - text;
+	if ((length < LAZY_BODY_MIN) || (memchr (text, '<', length) != NULL))
+	    continue;
+
+	if (body_count >= max_bodies)
+	{
+	    max_bodies = (max_bodies > 0) ? max_bodies * 2 : 1024;
+	    body_index = (MessageBodyEntry *)
+		realloc (body_index, max_bodies * sizeof (MessageBodyEntry));
+	    TG_checkAlloc (body_index);
+	}
+	MessageBodyEntry &entry = body_index[body_count];
+	entry.offset = XMLParser.fileOffsetOf (text);
+	entry.length = length;
+
+	if (copied == snippet)
+	    rewritten.clear ();
+	rewritten.appendBytes (copied, start - copied);
+	rewritten.appendSprintf ("<body_ref><index>%i</index>"
+				 "<lines>%i</lines>", body_count,
+				 decode_xml_text (text, length, decoded));
+	for (const char *nl = text;
+	     (nl = (const char *) memchr (nl, '\n', end - nl)) != NULL; nl++)
+	    rewritten.appendChar ('\n');
+	rewritten.appendSprintf ("</body_ref>");
+	copied = scan;
+	body_count++;
+    }
+
+    if (copied == snippet)
+	return (snippet);
+    rewritten.appendBytes (copied, strlen (copied));
+    return (rewritten.contents ());
+}
+
+// Called when the input file has been replaced: the bodies indexed so
+// far are no longer in it
+void forget_message_bodies (void)
+{
+    for (int i = 0; i < body_count; i++)
+	body_index[i].length = -1;
+}
+
+// Reads message body index (see index_message_bodies) back from the
+// input file and sends it, decoded, to the Client.  If it can't be
+// read, says so in its place.
+void send_message_body (int sock, int index)
+{
+    static MessageBuffer text;
+
+    if ((index < 0) || (index >= body_count) ||
+	(body_index[index].length < 0))
+    {
+	text.sprintf ("(Message body no longer available: "
+		      "the input file was replaced)");
+    }
+    else
+    {
+	MessageBodyEntry &entry = body_index[index];
+	char *raw = (char *) malloc (entry.length);
+	TG_checkAlloc (raw);
+	int got = 0;
+	int error = 0;
+	while (got < entry.length)
+	{
+	    ssize_t n = pread (body_fd, raw + got, entry.length - got,
+			       entry.offset + got);
+	    if ((n < 0) && (errno == EINTR))
+		continue;
+	    if (n < 0)
+		error = errno;
+	    if (n <= 0)
+		break;
+	    got += n;
+	}
+	if (got < entry.length)
+	{
+	    text.sprintf ("(Message body no longer available: %s)",
+			  (error != 0) ? strerror (error) :
+			  "the input file was truncated");
+	}
+	else
+	{
+	    decode_xml_text (raw, entry.length, text);
+	}
+	free (raw);
+    }
+
+    TG_send (sock, DB_MESSAGE_BODY, index, text.strlen () + 1,
+	     text.contents ());
+    TG_flush (sock);
+}
+
+// Decodes the value of a character or entity reference (name is what
+// is between the '&' and the ';').  Returns -1 if it isn't one.
+static int decode_xml_reference (const char *name, int length)
+{
+    static const struct {const char *name; int ch;} entities[] = {
+	{"lt", '<'}, {"gt", '>'}, {"amp", '&'}, {"quot", '"'}, {"apos", '\''}
+    };
+
+    if ((length > 1) && (name[0] == '#'))
+    {
+	bool hex = (name[1] == 'x');
+	int value = 0;
+	int i = hex ? 2 : 1;
+	if (i >= length)
+	    return (-1);
+	for (; i < length; i++)
+	{
+	    int digit;
+	    if ((name[i] >= '0') && (name[i] <= '9'))
+		digit = name[i] - '0';
+	    else if (hex && (name[i] >= 'a') && (name[i] <= 'f'))
+		digit = name[i] - 'a' + 10;
+	    else if (hex && (name[i] >= 'A') && (name[i] <= 'F'))
+		digit = name[i] - 'A' + 10;
+	    else
+		return (-1);
+	    value = value * (hex ? 16 : 10) + digit;
+	    if (value > 0x10FFFF)
+		return (-1);
+	}
+	return (value);
     }
+
+    for (unsigned int e = 0; e < sizeof (entities) / sizeof (entities[0]);
+	 e++)
+    {
+	if ((strncmp (name, entities[e].name, length) == 0) &&
+	    (entities[e].name[length] == 0))
+	    return (entities[e].ch);
+    }
+    return (-1);
 }
 
+// Decodes XML text (with no markup in it) into out, just as the
+// Client's XML parser would: line ends become '\n', references are
+// replaced, and UTF-8 becomes Latin-1, which the Client keeps message
+// text in (other characters become '?').  Returns the number of lines
+// in the result, counting a last line without a newline.
+int decode_xml_text (const char *text, int length, MessageBuffer &out)
+{
+    const unsigned char *pos = (const unsigned char *) text;
+    const unsigned char *end = pos + length;
+    int lines = 0;
+    int last = 0;
+
+    out.clear ();
+    while (pos < end)
+    {
+	// Copy plain ASCII a run at a time
+	const unsigned char *run = pos;
+	while ((run < end) && (*run < 0x80) && (*run != '&') &&
+	       (*run != '\r'))
+	{
+	    if (*run == '\n')
+		lines++;
+	    run++;
+	}
+	if (run > pos)
+	{
+	    out.appendBytes ((const char *) pos, run - pos);
+	    last = run[-1];
+	    pos = run;
+	    continue;
+	}
+
+	int ch = *pos++;
+	if (ch == '\r')
+	{
+	    // Both "\r\n" and a lone '\r' end a line
+	    if ((pos < end) && (*pos == '\n'))
+		pos++;
+	    ch = '\n';
+	}
+	else if (ch == '&')
+	{
+	    const unsigned char *semi =
+		(const unsigned char *) memchr (pos, ';', end - pos);
+	    int value = (semi == NULL) ? -1 :
+		decode_xml_reference ((const char *) pos, semi - pos);
+	    if (value >= 0)
+	    {
+		ch = value;
+		pos = semi + 1;
+	    }
+	}
+	else if (ch >= 0x80)
+	{
+	    // Decode a UTF-8 sequence (a byte that doesn't start a valid
+	    // one is kept as it is)
+	    int more = (ch >= 0xF0) ? 3 : (ch >= 0xE0) ? 2 :
+		(ch >= 0xC0) ? 1 : 0;
+	    int value = ch & (0x3F >> more);
+	    int i;
+	    for (i = 0; (i < more) && (pos + i < end) &&
+		     ((pos[i] & 0xC0) == 0x80); i++)
+		value = (value << 6) | (pos[i] & 0x3F);
+	    if ((more > 0) && (i == more))
+	    {
+		ch = value;
+		pos += more;
+	    }
+	}
+
+	if (ch == '\n')
+	    lines++;
+	out.appendChar ((ch < 256) ? (char) ch : '?');
+	last = ch;
+    }
+
+    if ((length > 0) && (last != '\n'))
+	lines++;
+    return (lines);
+}
 /******************************************************************************
 COPYRIGHT AND LICENSE
 
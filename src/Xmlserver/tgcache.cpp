@@ -0,0 +1,461 @@
+//! \file tgcache.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Keeps converted inputs (.tgb files, see tgb_format.h) for mpipview and
+// memcheckview, so opening the same unchanged file again skips both the
+// conversion to XML and the XML parsing.  The scripts call:
+//
+//   tgcache key <converter> <input>
+//       Prints the key for input as converted by converter: a hash of
+//       the full paths, sizes and modification times of both, and of
+//       the input's contents (all of a small file, samples of a big one).
+//       Fails if caching is turned off or the files can't be read.
+//   tgcache lookup <key>
+//       Prints the cached .tgb file for key (marking it recently used),
+//       or fails if there isn't one.
+//   tgcache store <key> <file.tgb> <converter> <input>
+//       Moves file.tgb into the cache as key's file, if input still has
+//       that key (i.e., didn't change while it was being converted), and
+//       then throws out the least recently used files until the cache
+//       fits in its size limit.
+//
+// The cache is $TG_CACHE_DIR, or ~/.toolgear_cache.  It holds at most
+// $TG_CACHE_MB megabytes (TG_CACHE_DEFAULT_MB if not set); setting it to
+// 0 turns caching off.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef FALSE
+#define FALSE 0
+#define TRUE (!FALSE)
+#endif
+
+// Cache size limit if $TG_CACHE_MB isn't set
+#define TG_CACHE_DEFAULT_MB 512
+
+// Inputs up to this size are hashed whole; bigger ones are sampled in
+// TG_CACHE_SAMPLES blocks of TG_CACHE_SAMPLE_SIZE bytes (including the
+// first and last), which with the size and time is plenty to notice a
+// changed file without reading all of it
+#define TG_CACHE_WHOLE_FILE (16 << 20)
+#define TG_CACHE_SAMPLES 64
+#define TG_CACHE_SAMPLE_SIZE (64 << 10)
+
+// Temporary files left by a store that was killed are removed after this
+// many seconds
+#define TG_CACHE_STALE_TMP (24 * 60 * 60)
+
+static char cache_dir[4096];
+
+// 64-bit FNV-1a hash of len bytes at data, continuing from hash
+static unsigned long long hash_bytes (unsigned long long hash, 
+				      const void *data, size_t len)
+{
+    const unsigned char *ptr = (const unsigned char *) data;
+    for (size_t i = 0; i < len; i++)
+    {
+	hash ^= ptr[i];
+	hash *= 1099511628211ULL;
+    }
+    return (hash);
+}
+
+// Hashes the name, size, and modification time of file_name (made into
+// a full path, so the same name in another directory is another file)
+static bool hash_file_info (unsigned long long &hash, const char *file_name,
+			    struct stat &info)
+{
+    if (stat (file_name, &info) != 0)
+    {
+	fprintf (stderr, "tgcache: can't stat %s: %s\n", file_name, 
+		 strerror (errno));
+	return (FALSE);
+    }
+
+    char path[4096];
+    if ((file_name[0] != '/') && (getcwd (path, sizeof (path)) != NULL))
+    {
+	size_t len = strlen (path);
+	snprintf (path + len, sizeof (path) - len, "/%s", file_name);
+    }
+    else
+    {
+	snprintf (path, sizeof (path), "%s", file_name);
+    }
+
+    long long size = info.st_size;
+    long long mtime = info.st_mtime;
+    hash = hash_bytes (hash, path, strlen (path) + 1);
+    hash = hash_bytes (hash, &size, sizeof (size));
+    hash = hash_bytes (hash, &mtime, sizeof (mtime));
+    return (TRUE);
+}
+
+// Hashes the contents of file_name (size bytes long), or samples of them
+static bool hash_file_contents (unsigned long long &hash, 
+				const char *file_name, off_t size)
+{
+    int fd = open (file_name, O_RDONLY);
+    if (fd < 0)
+    {
+	fprintf (stderr, "tgcache: can't open %s: %s\n", file_name, 
+		 strerror (errno));
+	return (FALSE);
+    }
+
+    static char buf[TG_CACHE_SAMPLE_SIZE];
+    bool whole = (size <= TG_CACHE_WHOLE_FILE);
+    int samples = whole ? 
+	(int) ((size + TG_CACHE_SAMPLE_SIZE - 1) / TG_CACHE_SAMPLE_SIZE) :
+	TG_CACHE_SAMPLES;
+    for (int i = 0; i < samples; i++)
+    {
+	off_t offset = whole ? (off_t) i * TG_CACHE_SAMPLE_SIZE :
+	    (size - TG_CACHE_SAMPLE_SIZE) / (TG_CACHE_SAMPLES - 1) * i;
+	ssize_t got = pread (fd, buf, TG_CACHE_SAMPLE_SIZE, offset);
+	if (got < 0)
+	{
+	    fprintf (stderr, "tgcache: can't read %s: %s\n", file_name,
+		     strerror (errno));
+	    close (fd);
+	    return (FALSE);
+	}
+	hash = hash_bytes (hash, buf, got);
+    }
+
+    close (fd);
+    return (TRUE);
+}
+
+// Puts the key for input converted by converter in key (17 bytes)
+static bool make_key (char *key, const char *converter, const char *input)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    struct stat converterInfo, inputInfo;
+    if (!hash_file_info (hash, converter, converterInfo) ||
+	!hash_file_info (hash, input, inputInfo) ||
+	!hash_file_contents (hash, input, inputInfo.st_size))
+	return (FALSE);
+
+    snprintf (key, 17, "%016llx", hash);
+    return (TRUE);
+}
+
+// Returns the cache size limit in bytes (0 if caching is off)
+static long long cache_limit ()
+{
+    const char *mb = getenv ("TG_CACHE_MB");
+    if ((mb == NULL) || (mb[0] == 0))
+	return ((long long) TG_CACHE_DEFAULT_MB << 20);
+    return (atoll (mb) << 20);
+}
+
+// Sets cache_dir, creating it if necessary
+static bool find_cache_dir ()
+{
+    const char *dir = getenv ("TG_CACHE_DIR");
+    if ((dir != NULL) && (dir[0] != 0))
+    {
+	snprintf (cache_dir, sizeof (cache_dir), "%s", dir);
+    }
+    else
+    {
+	const char *home = getenv ("HOME");
+	if (home == NULL)
+	{
+	    fprintf (stderr, "tgcache: HOME and TG_CACHE_DIR not set\n");
+	    return (FALSE);
+	}
+	snprintf (cache_dir, sizeof (cache_dir), "%s/.toolgear_cache", home);
+    }
+
+    if ((mkdir (cache_dir, 0700) != 0) && (errno != EEXIST))
+    {
+	fprintf (stderr, "tgcache: can't create %s: %s\n", cache_dir,
+		 strerror (errno));
+	return (FALSE);
+    }
+    return (TRUE);
+}
+
+// Copies from_name to to_name (for a store from another file system)
+static bool copy_file (const char *from_name, const char *to_name)
+{
+    FILE *in = fopen (from_name, "r");
+    if (in == NULL)
+	return (FALSE);
+    FILE *out = fopen (to_name, "w");
+    if (out == NULL)
+    {
+	fclose (in);
+	return (FALSE);
+    }
+
+    static char buf[1 << 16];
+    size_t got;
+    bool ok = TRUE;
+    while ((got = fread (buf, 1, sizeof (buf), in)) > 0)
+    {
+	if (fwrite (buf, 1, got, out) != got)
+	{
+	    ok = FALSE;
+	    break;
+	}
+    }
+    if (ferror (in))
+	ok = FALSE;
+    fclose (in);
+    if (fclose (out) != 0)
+	ok = FALSE;
+    return (ok);
+}
+
+//! One file in the cache, for eviction
+struct CacheFile
+{
+    char name[256];
+    time_t mtime;
+    long long size;
+};
+
+static int compare_oldest_first (const void *a, const void *b)
+{
+    time_t aTime = ((const CacheFile *) a)->mtime;
+    time_t bTime = ((const CacheFile *) b)->mtime;
+    return ((aTime < bTime) ? -1 : (aTime > bTime) ? 1 : 0);
+}
+
+// Removes the least recently used .tgb files until the rest fit in limit
+// bytes, and any temporary files left by killed stores
+static void evict (long long limit)
+{
+    DIR *dir = opendir (cache_dir);
+    if (dir == NULL)
+	return;
+
+    CacheFile *files = NULL;
+    int count = 0, maxFiles = 0;
+    long long total = 0;
+    time_t now = time (NULL);
+    struct dirent *entry;
+    while ((entry = readdir (dir)) != NULL)
+    {
+	char path[4096 + 256];
+	struct stat info;
+	snprintf (path, sizeof (path), "%s/%s", cache_dir, entry->d_name);
+	if ((entry->d_name[0] == '.') || (stat (path, &info) != 0) ||
+	    !S_ISREG (info.st_mode))
+	    continue;
+
+	size_t len = strlen (entry->d_name);
+	if ((len > 4) && (strcmp (entry->d_name + len - 4, ".tmp") == 0))
+	{
+	    if (now - info.st_mtime > TG_CACHE_STALE_TMP)
+		unlink (path);
+	    continue;
+	}
+	if ((len < 4) || (len >= sizeof (files[0].name)) ||
+	    (strcmp (entry->d_name + len - 4, ".tgb") != 0))
+	    continue;
+
+	if (count >= maxFiles)
+	{
+	    maxFiles = (maxFiles > 0) ? maxFiles * 2 : 64;
+	    files = (CacheFile *) realloc (files, maxFiles * sizeof (CacheFile));
+	    if (files == NULL)
+	    {
+		fprintf (stderr, "tgcache: out of memory\n");
+		closedir (dir);
+		return;
+	    }
+	}
+	strcpy (files[count].name, entry->d_name);
+	files[count].mtime = info.st_mtime;
+	files[count].size = info.st_size;
+	total += info.st_size;
+	count++;
+    }
+    closedir (dir);
+
+    qsort (files, count, sizeof (CacheFile), compare_oldest_first);
+    for (int i = 0; (i < count) && (total > limit); i++)
+    {
+	char path[4096 + 256];
+	snprintf (path, sizeof (path), "%s/%s", cache_dir, files[i].name);
+	if (unlink (path) == 0)
+	    total -= files[i].size;
+    }
+    free (files);
+}
+
+static int usage (const char *program)
+{
+    fprintf (stderr, 
+	     "Usage: %s key converter input\n"
+	     "       %s lookup key\n"
+	     "       %s store key file.tgb converter input\n"
+	     "       Keeps converted mpipview/memcheckview inputs in "
+	     "$TG_CACHE_DIR\n"
+	     "       (default ~/.toolgear_cache), up to $TG_CACHE_MB "
+	     "megabytes (default %i,\n"
+	     "       0 turns caching off)\n",
+	     program, program, program, TG_CACHE_DEFAULT_MB);
+    return (2);
+}
+
+int main (int argc, char *argv[])
+{
+    if (argc < 2)
+	return (usage (argv[0]));
+    const char *command = argv[1];
+
+    long long limit = cache_limit ();
+    if ((limit <= 0) || !find_cache_dir ())
+	return (1);
+
+    char key[17];
+    if ((strcmp (command, "key") == 0) && (argc == 4))
+    {
+	if (!make_key (key, argv[2], argv[3]))
+	    return (1);
+	printf ("%s\n", key);
+	return (0);
+    }
+
+    // The other commands take a key printed by "key"
+    if (argc < 3)
+	return (usage (argv[0]));
+    if ((strlen (argv[2]) != 16) || 
+	(strspn (argv[2], "0123456789abcdef") != 16))
+    {
+	fprintf (stderr, "tgcache: invalid key '%s'\n", argv[2]);
+	return (1);
+    }
+    char path[4096 + 32];
+    snprintf (path, sizeof (path), "%s/%s.tgb", cache_dir, argv[2]);
+
+    if ((strcmp (command, "lookup") == 0) && (argc == 3))
+    {
+	// Mark it most recently used (utime() with NULL sets the time to
+	// now), which fails if it isn't cached
+	if (utime (path, NULL) != 0)
+	    return (1);
+	printf ("%s\n", path);
+	return (0);
+    }
+
+    if ((strcmp (command, "store") == 0) && (argc == 6))
+    {
+	// Don't keep a conversion of an input that changed under it
+	if (!make_key (key, argv[4], argv[5]) || (strcmp (key, argv[2]) != 0))
+	{
+	    unlink (argv[3]);
+	    return (1);
+	}
+
+	// Move it in under a temporary name, then rename it into place,
+	// so lookups never see part of a file
+	char tmpPath[4096 + 64];
+	snprintf (tmpPath, sizeof (tmpPath), "%s/%s.%ld.tmp", cache_dir, 
+		  argv[2], (long) getpid ());
+	if ((rename (argv[3], tmpPath) != 0) &&
+	    !copy_file (argv[3], tmpPath))
+	{
+	    fprintf (stderr, "tgcache: can't copy %s to %s\n", argv[3],
+		     tmpPath);
+	    unlink (tmpPath);
+	    unlink (argv[3]);
+	    return (1);
+	}
+	unlink (argv[3]);
+	if (rename (tmpPath, path) != 0)
+	{
+	    fprintf (stderr, "tgcache: can't rename %s to %s: %s\n", tmpPath,
+		     path, strerror (errno));
+	    unlink (tmpPath);
+	    return (1);
+	}
+
+	evict (limit);
+	return (0);
+    }
+
+    return (usage (argv[0]));
+}
+
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
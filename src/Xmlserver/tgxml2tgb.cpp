@@ -0,0 +1,412 @@
+//! \file tgxml2tgb.cpp
+/***************************************************************************/
+/* Tool Gear (www.llnl.gov/CASC/tool_gear)                                 */
+/* Version 2.00                                             March 29, 2006 */
+/* Please see COPYRIGHT AND LICENSE information at the end of this file.   */
+/***************************************************************************/
+// Converts a Tool Gear XML file (e.g., from TGmpip2xml or TGmemcheck2xml)
+// to Tool Gear's binary document format (see tgb_format.h), which
+// TGxmlserver and the Client read without any XML parsing.  Convert a
+// file once if it is going to be viewed many times.
+//
+// The XML is split into snippets just as TGxmlserver splits it, and each
+// snippet is broken into elements and text with the little scanner below.
+// It only needs to handle what the Client's XML reader accepts from Tool
+// Gear files: comments, processing instructions (<?xml ...?>), and
+// <!DOCTYPE> are skipped, attributes are ignored (the Client ignores them
+// too), CDATA is text, and the standard and character entities are
+// decoded.  Anything it doesn't understand stops the conversion, rather
+// than writing a .tgb file that shows something different than the XML.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#ifndef FALSE
+#define FALSE 0
+#define TRUE (!FALSE)
+#endif
+#include "messagebuffer.h"
+#include "xml_snippet_parser.h"
+#include "tgb_format.h"
+
+// The Client doesn't handle elements nested deeper than this either
+#define MAX_XML_DEPTH 100
+
+static const char *input_file_name = NULL;
+static const char *output_file_name = NULL;
+static FILE *tgb_out = NULL;
+
+// Elements still open.  Checked across snippets, since splitting the
+// XML into snippets doesn't check that elements match up.
+static char *elementStack[MAX_XML_DEPTH];
+static int depth = 0;
+
+// Prints the error (with the line it is on) and exits, removing the
+// partially written output file
+static void conversion_error (int lineNo, const char *fmt, const char *arg)
+{
+    fprintf (stderr, "tgxml2tgb: %s line %i: ", input_file_name, lineNo);
+    fprintf (stderr, fmt, arg);
+    fprintf (stderr, "\n");
+    if (tgb_out != stdout)
+    {
+	fclose (tgb_out);
+	unlink (output_file_name);
+    }
+    exit (1);
+}
+
+// Appends the text from start to end to text, decoding entities
+static void append_decoded (MessageBuffer &text, const char *start,
+			    const char *end, int lineNo)
+{
+    const char *ptr = start;
+    while (ptr < end)
+    {
+	const char *amp = (const char *) memchr (ptr, '&', end - ptr);
+	if (amp == NULL)
+	{
+	    text.appendBytes (ptr, end - ptr);
+	    return;
+	}
+	text.appendBytes (ptr, amp - ptr);
+
+	const char *semi = (const char *) memchr (amp, ';', end - amp);
+	if ((semi == NULL) || (semi - amp > 12))
+	    conversion_error (lineNo, "'&' without an entity after it%s", "");
+
+	int len = semi - amp - 1;
+	const char *name = amp + 1;
+	if ((len == 2) && (strncmp (name, "lt", 2) == 0))
+	    text.appendChar ('<');
+	else if ((len == 2) && (strncmp (name, "gt", 2) == 0))
+	    text.appendChar ('>');
+	else if ((len == 3) && (strncmp (name, "amp", 3) == 0))
+	    text.appendChar ('&');
+	else if ((len == 4) && (strncmp (name, "quot", 4) == 0))
+	    text.appendChar ('"');
+	else if ((len == 4) && (strncmp (name, "apos", 4) == 0))
+	    text.appendChar ('\'');
+	else if ((len > 1) && (name[0] == '#'))
+	{
+	    // Character reference, written out as UTF-8
+	    char *numEnd;
+	    unsigned long code;
+	    if ((name[1] == 'x') || (name[1] == 'X'))
+		code = strtoul (name + 2, &numEnd, 16);
+	    else
+		code = strtoul (name + 1, &numEnd, 10);
+	    if ((numEnd != semi) || (code == 0) || (code > 0x10ffff))
+	    {
+		MessageBuffer entity;
+		entity.appendBytes (amp, len + 2);
+		conversion_error (lineNo, "bad character reference '%s'",
+				  entity.contents());
+	    }
+
+	    if (code < 0x80)
+		text.appendChar ((char) code);
+	    else if (code < 0x800)
+	    {
+		text.appendChar ((char) (0xc0 | (code >> 6)));
+		text.appendChar ((char) (0x80 | (code & 0x3f)));
+	    }
+	    else if (code < 0x10000)
+	    {
+		text.appendChar ((char) (0xe0 | (code >> 12)));
+		text.appendChar ((char) (0x80 | ((code >> 6) & 0x3f)));
+		text.appendChar ((char) (0x80 | (code & 0x3f)));
+	    }
+	    else
+	    {
+		text.appendChar ((char) (0xf0 | (code >> 18)));
+		text.appendChar ((char) (0x80 | ((code >> 12) & 0x3f)));
+		text.appendChar ((char) (0x80 | ((code >> 6) & 0x3f)));
+		text.appendChar ((char) (0x80 | (code & 0x3f)));
+	    }
+	}
+	else
+	{
+	    MessageBuffer entity;
+	    entity.appendBytes (amp, len + 2);
+	    conversion_error (lineNo, "unknown entity '%s'",
+			      entity.contents());
+	}
+	ptr = semi + 1;
+    }
+}
+
+// Returns the number of newlines from start to end
+static int count_lines (const char *start, const char *end)
+{
+    int count = 0;
+    while ((start = (const char *) memchr (start, '\n', end - start)) != NULL)
+    {
+	count++;
+	start++;
+    }
+    return (count);
+}
+
+// Writes the elements and text in snippet to writer.  lineNo is the
+// snippet's first line in the input, for error messages.
+static void convert_snippet (const char *snippet, int lineNo,
+			     TGBWriter &writer)
+{
+    MessageBuffer text;
+    const char *ptr = snippet;
+    const char *end = snippet + strlen (snippet);
+
+    while (ptr < end)
+    {
+	const char *lt = (const char *) memchr (ptr, '<', end - ptr);
+	if (lt == NULL)
+	    lt = end;
+	append_decoded (text, ptr, lt, lineNo);
+	lineNo += count_lines (ptr, lt);
+	if (lt == end)
+	    break;
+
+	// CDATA is just text
+	if (strncmp (lt, "<![CDATA[", 9) == 0)
+	{
+	    const char *close = strstr (lt + 9, "]]>");
+	    if (close == NULL)
+		conversion_error (lineNo, "unterminated CDATA section%s", "");
+	    text.appendBytes (lt + 9, close - (lt + 9));
+	    lineNo += count_lines (lt, close);
+	    ptr = close + 3;
+	    continue;
+	}
+
+	// Skip comments, processing instructions, and declarations
+	const char *skipEnd = NULL;
+	if (strncmp (lt, "<!--", 4) == 0)
+	{
+	    if ((skipEnd = strstr (lt + 4, "-->")) != NULL)
+		skipEnd += 3;
+	}
+	else if (strncmp (lt, "<?", 2) == 0)
+	{
+	    if ((skipEnd = strstr (lt + 2, "?>")) != NULL)
+		skipEnd += 2;
+	}
+	else if (strncmp (lt, "<!", 2) == 0)
+	{
+	    if ((skipEnd = strchr (lt + 2, '>')) != NULL)
+		skipEnd += 1;
+	}
+	else
+	{
+	    // An element's start or end tag.  Find its end, skipping
+	    // over any quoted attribute values
+	    const char *scan = lt + 1;
+	    char quote = 0;
+	    for (; scan < end; scan++)
+	    {
+		if (quote != 0)
+		{
+		    if (*scan == quote)
+			quote = 0;
+		}
+		else if ((*scan == '"') || (*scan == '\''))
+		    quote = *scan;
+		else if (*scan == '>')
+		    break;
+	    }
+	    if (scan >= end)
+		conversion_error (lineNo, "unterminated tag%s", "");
+
+	    // Text ends at any tag
+	    writer.text (text.contents(), text.strlen());
+	    text.clear();
+
+	    bool isEnd = (lt[1] == '/');
+	    const char *name = lt + (isEnd ? 2 : 1);
+	    int nameLen = 0;
+	    while ((name + nameLen < scan) && (name[nameLen] != '/') &&
+		   !isspace (name[nameLen]))
+		nameLen++;
+	    if (nameLen == 0)
+		conversion_error (lineNo, "tag without a name%s", "");
+
+	    MessageBuffer nameBuf;
+	    nameBuf.appendBytes (name, nameLen);
+	    if (isEnd)
+	    {
+		if ((depth == 0) ||
+		    (strcmp (elementStack[depth-1], nameBuf.contents()) != 0))
+		{
+		    conversion_error (lineNo, "unexpected end tag </%s>",
+				      nameBuf.contents());
+		}
+		free (elementStack[--depth]);
+		writer.endElement ();
+	    }
+	    else
+	    {
+		if (depth >= MAX_XML_DEPTH)
+		    conversion_error (lineNo, "elements nested too deeply "
+				      "at <%s>", nameBuf.contents());
+		writer.startElement (name, nameLen);
+
+		// <name/> ends right away
+		if (scan[-1] == '/')
+		    writer.endElement ();
+		else
+		    elementStack[depth++] = nameBuf.strdup();
+	    }
+	    lineNo += count_lines (lt, scan);
+	    ptr = scan + 1;
+	    continue;
+	}
+
+	if (skipEnd == NULL)
+	    conversion_error (lineNo, "unterminated comment or "
+			      "declaration%s", "");
+	lineNo += count_lines (lt, skipEnd);
+	ptr = skipEnd;
+    }
+
+    writer.text (text.contents(), text.strlen());
+}
+
+int main (int argc, char *argv[])
+{
+    // Expect exactly two arguments, the input XML and output .tgb files
+    if (argc != 3)
+    {
+	fprintf (stderr, "Usage: %s input_tg_xml_filename "
+		 "output_tgb_filename\n", argv[0]);
+	fprintf (stderr, "       Converts Tool Gear XML to the binary .tgb "
+		 "format, which TGui reads directly.\n");
+	fprintf (stderr, "       Setting either filename to '-' specifies "
+		 "stdin or stdout\n");
+	return -1;
+    }
+
+    input_file_name = argv[1];
+    output_file_name = argv[2];
+
+    FILE *xml_in;
+    if (strcmp (input_file_name, "-") == 0)
+	xml_in = stdin;
+    else
+	xml_in = fopen (input_file_name, "r");
+    if (xml_in == NULL)
+    {
+	fprintf (stderr, "tgxml2tgb: failed to open input file %s\n",
+		 input_file_name);
+	return 1;
+    }
+
+    if (strcmp (output_file_name, "-") == 0)
+	tgb_out = stdout;
+    else
+	tgb_out = fopen (output_file_name, "w");
+    if (tgb_out == NULL)
+    {
+	fprintf (stderr, "tgxml2tgb: failed to open output file %s\n",
+		 output_file_name);
+	return 1;
+    }
+
+    XMLSnippetParser parser (xml_in);
+    TGBWriter writer (tgb_out);
+    const char *snippet;
+    while ((snippet = parser.getNextSnippet ()) != NULL)
+    {
+	int lineOffset = parser.getSnippetOffset ();
+	if (parser.setsStatus ())
+	    writer.setsStatus ();
+	writer.beginSnippet (lineOffset);
+	convert_snippet (snippet, lineOffset + 1, writer);
+    }
+
+    if (depth > 0)
+	conversion_error (0, "<%s> never ended", elementStack[depth-1]);
+    if (!parser.atDocumentEnd ())
+    {
+	fprintf (stderr, "tgxml2tgb: Warning: %s has no </tool_gear>, so "
+		 "the viewer will expect more to be written to it\n",
+		 input_file_name);
+    }
+
+    if (!writer.finish (parser.atDocumentEnd ()))
+    {
+	fprintf (stderr, "tgxml2tgb: error writing %s\n", output_file_name);
+	if (tgb_out != stdout)
+	    unlink (output_file_name);
+	return 1;
+    }
+    if (tgb_out != stdout)
+	fclose (tgb_out);
+
+    return 0;
+}
+/******************************************************************************
+COPYRIGHT AND LICENSE
+
+Copyright (c) 2006, The Regents of the University of California.
+Produced at the Lawrence Livermore National Laboratory
+Written by John Gyllenhaal (gyllen@llnl.gov), John May (johnmay@llnl.gov),
+and Martin Schulz (schulz6@llnl.gov).
+UCRL-CODE-220834.
+All rights reserved.
+
+This file is part of Tool Gear.  For details, see www.llnl.gov/CASC/tool_gear.
+
+Redistribution and use in source and binary forms, with or
+without modification, are permitted provided that the following
+conditions are met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the disclaimer below.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the disclaimer (as noted below) in
+  the documentation and/or other materials provided with the distribution.
+
+* Neither the name of the UC/LLNL nor the names of its contributors may
+  be used to endorse or promote products derived from this software without
+  specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OF THE UNIVERSITY 
+OF CALIFORNIA, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE LIABLE 
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE 
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ADDITIONAL BSD NOTICE
+
+1. This notice is required to be provided under our contract with the 
+   U.S. Department of Energy (DOE). This work was produced at the 
+   University of California, Lawrence Livermore National Laboratory 
+   under Contract No. W-7405-ENG-48 with the DOE.
+
+2. Neither the United States Government nor the University of California 
+   nor any of their employees, makes any warranty, express or implied, 
+   or assumes any liability or responsibility for the accuracy, completeness,
+   or usefulness of any information, apparatus, product, or process disclosed,
+   or represents that its use would not infringe privately-owned rights.
+
+3. Also, reference herein to any specific commercial products, process,
+   or services by trade name, trademark, manufacturer or otherwise does not
+   necessarily constitute or imply its endorsement, recommendation, or
+   favoring by the United States Government or the University of California.
+   The views and opinions of authors expressed herein do not necessarily
+   state or reflect those of the United States Government or the University
+   of California, and shall not be used for advertising or product
+   endorsement purposes.
+******************************************************************************/
+
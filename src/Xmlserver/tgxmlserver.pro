@@ -11,33 +11,45 @@ CONFIG += warn_on
 CONFIG -= qt
 # console declaration causes app to be built as a regular command
 # line application rather than a GUI app on Mac OS (and Windows)
-#CONFIG += thread console
-CONFIG += console
+# (thread is for the threads that read several input files at once)
+CONFIG += thread console
 
 # Put executable directly in Tool Gear's bin directory
 DESTDIR = ../../bin
 
 SOURCES = TGxmlserver.cpp ../Utils/logfile.cpp ../Utils/search_path.cpp \
 	   ../Utils/tg_source_reader.cpp ../Utils/tg_socket.c \
+           ../Utils/tg_compress.c \
            ../Utils/tg_pack.cpp ../Utils/tg_swapbytes.c ../Utils/tg_error.c \
            ../Utils/command_tags.cpp ../Utils/collector_pack.cpp \
            ../Utils/lookup_function_lines.cpp \
            ../Utils/tg_time.c ../Utils/messagebuffer.cpp \
-           ../Utils/string_symbol.c ../Utils/l_alloc_new.c
+           ../Utils/snippet_reader.cpp ../Utils/xml_token_table.cpp \
+           ../Utils/file_follower.cpp ../Utils/tgb_format.cpp \
+           ../Utils/string_symbol.c ../Utils/l_alloc_new.c \
+           ../Mpipview/mpip_info.cpp ../Utils/xml_convert_dup.c \
+           ../Utils/number_scanner.cpp
 
 HEADERS =  ../Utils/lineparser.h ../Utils/logfile.h ../Utils/search_path.h \
 	  ../Utils/tg_source_reader.h \
-           ../Utils/messagebuffer.h ../Utils/command_tags.h \
+           ../Utils/messagebuffer.h ../Utils/snippet_reader.h \
+           ../Utils/xml_token_table.h ../Utils/file_follower.h \
+           ../Utils/xml_snippet_parser.h ../Utils/tgb_format.h \
+           ../Utils/command_tags.h \
            ../Utils/socketmanager.h ../Utils/tempcharbuf.h \
            ../Utils/tg_error.h ../Utils/tg_inst_point.h \
            ../Utils/tg_pack.h ../Utils/tg_socket.h \
+           ../Utils/tg_compress.h \
            ../Utils/tg_swapbytes.h ../Utils/tg_time.h \
            ../Utils/tg_typetags.h \
-           ../Utils/string_symbol.h
+           ../Utils/string_symbol.h \
+           ../Mpipview/mpip_info.h ../Utils/xml_convert_dup.h \
+           ../Utils/number_scanner.h ../Utils/field_tokenizer.h \
+           ../Utils/stringtable.h
 
-INCLUDEPATH += . ../Utils  
+INCLUDEPATH += . ../Utils ../Mpipview
 
-DEPENDPATH += . ../Utils 
+DEPENDPATH += . ../Utils ../Mpipview
 
 
 #OSNAME = $$(OSTYPE)
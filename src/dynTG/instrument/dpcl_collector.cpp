@@ -492,6 +492,10 @@ int connectToClient( int port )
 	}
 	write( sock, (void *) &outval, sizeof(outval) );
 
+	// Use shared memory (same host) or compression (remote client)
+	// for large messages, if the client agrees
+	TG_offer_options( sock );
+
         return sock;
 }
 
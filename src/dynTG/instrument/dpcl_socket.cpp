@@ -129,6 +129,13 @@ int dpcl_socket_handler( int fd )
 #endif
 				break;
 #ifdef USE_SOURCE_READER
+			case COLLECTOR_READ_FILE_LINES:
+				if( ! sourceReader ) {
+					sourceReader = new TGSourceReader( fd,
+							check_continue_search );
+				}
+				sourceReader->read_file_lines( buf, id );
+				break;
 			case COLLECTOR_GET_SUBDIRS:
 				if( ! sourceReader ) {
 					sourceReader = new TGSourceReader( fd,